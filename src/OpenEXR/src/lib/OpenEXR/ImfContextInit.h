@@ -105,6 +105,32 @@ public:
         return *this;
     }
 
+    ContextInitializer& setHTJ2KBlockSize (int w, int h) noexcept
+    {
+        _initializer.htj2k_block_width  = w;
+        _initializer.htj2k_block_height = h;
+        return *this;
+    }
+
+    ContextInitializer& setHTJ2KLevels (int levels) noexcept
+    {
+        _initializer.htj2k_levels = levels;
+        return *this;
+    }
+
+    ContextInitializer&
+    setHTJ2KProgression (exr_htj2k_progression_t order) noexcept
+    {
+        _initializer.htj2k_progression = (int) order;
+        return *this;
+    }
+
+    ContextInitializer& setHTJ2KQuantizationStep (float step) noexcept
+    {
+        _initializer.htj2k_quantization_step = step;
+        return *this;
+    }
+
     ContextInitializer& strictHeaderValidation (bool onoff) noexcept
     {
         setFlag (EXR_CONTEXT_FLAG_STRICT_HEADER, onoff);
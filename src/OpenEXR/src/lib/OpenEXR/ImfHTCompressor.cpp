@@ -34,7 +34,20 @@ HTCompressor::HTCompressor (
           EXR_COMPRESSION_LAST_TYPE,
           maxScanLineSize,
           numScanLines > 0 ? numScanLines : 16000)
-{}
+{
+    exr_result_t rv = exr_set_htj2k_block_size (
+        _ctxt, 0, hdr.htj2kBlockWidth (), hdr.htj2kBlockHeight ());
+    if (rv == EXR_ERR_SUCCESS)
+        rv = exr_set_htj2k_levels (_ctxt, 0, hdr.htj2kLevels ());
+    if (rv == EXR_ERR_SUCCESS)
+        rv = exr_set_htj2k_progression (
+            _ctxt, 0, (exr_htj2k_progression_t) hdr.htj2kProgression ());
+    if (rv == EXR_ERR_SUCCESS)
+        rv = exr_set_htj2k_quantization_step (
+            _ctxt, 0, hdr.htj2kQuantizationStep ());
+    if (rv != EXR_ERR_SUCCESS)
+        throw IEX_NAMESPACE::ArgExc ("Invalid HTJ2K compression settings");
+}
 
 HTCompressor::~HTCompressor ()
 {}
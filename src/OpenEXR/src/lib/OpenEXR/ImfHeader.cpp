@@ -74,6 +74,11 @@ struct CompressionRecord
     }
     int   zip_level;
     float dwa_level;
+    int   htj2k_block_width       = 128;
+    int   htj2k_block_height      = 32;
+    int   htj2k_levels            = 5;
+    int   htj2k_progression       = EXR_HTJ2K_PROGRESSION_RPCL;
+    float htj2k_quantization_step = 0.f;
 };
 // NB: This is extra complicated than one would normally write to
 // handle scenario that seems to happen on MacOS/Windows (probably
@@ -705,6 +710,66 @@ Header::dwaCompressionLevel () const
     return retrieveCompressionRecord (this).dwa_level;
 }
 
+int&
+Header::htj2kBlockWidth ()
+{
+    return retrieveCompressionRecord (this).htj2k_block_width;
+}
+
+int
+Header::htj2kBlockWidth () const
+{
+    return retrieveCompressionRecord (this).htj2k_block_width;
+}
+
+int&
+Header::htj2kBlockHeight ()
+{
+    return retrieveCompressionRecord (this).htj2k_block_height;
+}
+
+int
+Header::htj2kBlockHeight () const
+{
+    return retrieveCompressionRecord (this).htj2k_block_height;
+}
+
+int&
+Header::htj2kLevels ()
+{
+    return retrieveCompressionRecord (this).htj2k_levels;
+}
+
+int
+Header::htj2kLevels () const
+{
+    return retrieveCompressionRecord (this).htj2k_levels;
+}
+
+int&
+Header::htj2kProgression ()
+{
+    return retrieveCompressionRecord (this).htj2k_progression;
+}
+
+int
+Header::htj2kProgression () const
+{
+    return retrieveCompressionRecord (this).htj2k_progression;
+}
+
+float&
+Header::htj2kQuantizationStep ()
+{
+    return retrieveCompressionRecord (this).htj2k_quantization_step;
+}
+
+float
+Header::htj2kQuantizationStep () const
+{
+    return retrieveCompressionRecord (this).htj2k_quantization_step;
+}
+
 void
 Header::setName (const string& name)
 {
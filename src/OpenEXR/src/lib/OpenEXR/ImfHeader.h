@@ -286,6 +286,33 @@ public:
     IMF_EXPORT
     float dwaCompressionLevel () const;
 
+    //-----------------------------------------------------
+    // HTJ2K encoder settings, ephemeral like the levels above.
+    // See exr_set_htj2k_block_size() and friends for their ranges;
+    // the progression order is an exr_htj2k_progression_t, and a
+    // quantization step above 0 selects lossy coding of half data.
+    //-----------------------------------------------------
+    IMF_EXPORT
+    int& htj2kBlockWidth ();
+    IMF_EXPORT
+    int htj2kBlockWidth () const;
+    IMF_EXPORT
+    int& htj2kBlockHeight ();
+    IMF_EXPORT
+    int htj2kBlockHeight () const;
+    IMF_EXPORT
+    int& htj2kLevels ();
+    IMF_EXPORT
+    int htj2kLevels () const;
+    IMF_EXPORT
+    int& htj2kProgression ();
+    IMF_EXPORT
+    int htj2kProgression () const;
+    IMF_EXPORT
+    float& htj2kQuantizationStep ();
+    IMF_EXPORT
+    float htj2kQuantizationStep () const;
+
     //-----------------------------------------------------
     // Access to required attributes for multipart files
     // They are optional to non-multipart files and mandatory
@@ -15,20 +15,27 @@
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 
 Zip::Zip (size_t maxRawSize, int level)
-    : _maxRawSize (maxRawSize), _tmpBuffer (0), _zipLevel (level)
+    : _maxRawSize (maxRawSize), _tmpBuffer (0), _zipLevel (level), _ctxt (0)
 {
     _tmpBuffer = new char[_maxRawSize];
+    if (EXR_ERR_SUCCESS !=
+        exr_start_temporary_context (&_ctxt, "<zip>", nullptr))
+        _ctxt = 0;
 }
 
 Zip::Zip (size_t maxScanLineSize, size_t numScanLines, int level)
-    : _maxRawSize (0), _tmpBuffer (0), _zipLevel (level)
+    : _maxRawSize (0), _tmpBuffer (0), _zipLevel (level), _ctxt (0)
 {
     _maxRawSize = uiMult (maxScanLineSize, numScanLines);
     _tmpBuffer  = new char[_maxRawSize];
+    if (EXR_ERR_SUCCESS !=
+        exr_start_temporary_context (&_ctxt, "<zip>", nullptr))
+        _ctxt = 0;
 }
 
 Zip::~Zip ()
 {
+    if (_ctxt) exr_finish (&_ctxt);
     if (_tmpBuffer) delete[] _tmpBuffer;
 }
 
@@ -93,7 +100,7 @@ Zip::compress (const char* raw, int rawSize, char* compressed)
     //
     size_t outSize;
     if (EXR_ERR_SUCCESS != exr_compress_buffer (
-                               nullptr,
+                               _ctxt,
                                _zipLevel,
                                _tmpBuffer,
                                rawSize,
@@ -332,7 +339,7 @@ Zip::uncompress (const char* compressed, int compressedSize, char* raw)
 {
     size_t outSize = 0;
     if (EXR_ERR_SUCCESS != exr_uncompress_buffer (
-                               nullptr,
+                               _ctxt,
                                compressed,
                                (size_t) compressedSize,
                                _tmpBuffer,
@@ -9,6 +9,8 @@
 #include "ImfExport.h"
 #include "ImfNamespace.h"
 
+#include <openexr_context.h>
+
 #include <cstddef>
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
@@ -46,6 +48,13 @@ private:
     size_t _maxRawSize;
     char*  _tmpBuffer;
     int    _zipLevel;
+
+    //
+    // Private Core context holding the cached deflate states, so
+    // each chunk this object codes reuses them instead of allocating
+    // fresh ones. Null if it could not be created.
+    //
+    exr_context_t _ctxt;
 };
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
@@ -42,4 +42,47 @@ struct _exr_context_initializer_v2
     float                         dwa_quality;
 };
 
+struct _exr_context_initializer_v3
+{
+    size_t                        size;
+    exr_error_handler_cb_t        error_handler_fn;
+    exr_memory_allocation_func_t  alloc_fn;
+    exr_memory_free_func_t        free_fn;
+    void*                         user_data;
+    exr_read_func_ptr_t           read_fn;
+    exr_query_size_func_ptr_t     size_fn;
+    exr_write_func_ptr_t          write_fn;
+    exr_destroy_stream_func_ptr_t destroy_fn;
+    int                           max_image_width;
+    int                           max_image_height;
+    int                           max_tile_width;
+    int                           max_tile_height;
+    int                           zip_level;
+    float                         dwa_quality;
+    int                           flags;
+    uint8_t                       pad[4];
+};
+
+struct _exr_context_initializer_v4
+{
+    size_t                        size;
+    exr_error_handler_cb_t        error_handler_fn;
+    exr_memory_allocation_func_t  alloc_fn;
+    exr_memory_free_func_t        free_fn;
+    void*                         user_data;
+    exr_read_func_ptr_t           read_fn;
+    exr_query_size_func_ptr_t     size_fn;
+    exr_write_func_ptr_t          write_fn;
+    exr_destroy_stream_func_ptr_t destroy_fn;
+    int                           max_image_width;
+    int                           max_image_height;
+    int                           max_tile_width;
+    int                           max_tile_height;
+    int                           zip_level;
+    float                         dwa_quality;
+    int                           flags;
+    uint8_t                       pad[4];
+    exr_read_vector_func_ptr_t    read_vector_fn;
+};
+
 #endif /* OPENEXR_BACKWARD_COMPATIBILITY_H */
@@ -11,7 +11,11 @@
 #include "internal_xdr.h"
 #include "internal_file.h"
 
+#include "internal_thread.h"
+
 #include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /**************************************/
@@ -209,57 +213,67 @@ struct priv_chunk_leader
     uint64_t packed_size;
 };
 
-static exr_result_t
-extract_chunk_leader (
-    exr_const_context_t       ctxt,
-    exr_const_priv_part_t     part,
-    int                       partnum,
-    uint64_t                  offset,
-    uint64_t*                 next_offset,
-    struct priv_chunk_leader* leaderdata)
+/* bytes in the leader of a chunk, up to and including the packed size */
+static int
+chunk_leader_size (exr_const_context_t ctxt, exr_const_priv_part_t part)
 {
-    exr_result_t rv = EXR_ERR_SUCCESS;
-    int32_t      data[6];
-    uint64_t     nextoffset = offset;
-    int          rdcnt, ntoread;
-    int64_t      maxval = (int64_t) INT_MAX; // 2GB
-
-    if (ctxt->file_size > 0) maxval = ctxt->file_size;
+    int nints;
 
     if (part->storage_mode == EXR_STORAGE_SCANLINE ||
         part->storage_mode == EXR_STORAGE_DEEP_SCANLINE)
     {
-        ntoread = (ctxt->is_multipart) ? 2 : 1;
-        if (part->storage_mode != EXR_STORAGE_DEEP_SCANLINE) ++ntoread;
+        nints = (ctxt->is_multipart) ? 2 : 1;
+        if (part->storage_mode != EXR_STORAGE_DEEP_SCANLINE) ++nints;
     }
     else if (part->storage_mode == EXR_STORAGE_DEEP_TILED)
     {
         if (ctxt->is_multipart)
-            ntoread = 5;
+            nints = 5;
         else
-            ntoread = 4;
+            nints = 4;
     }
     else if (ctxt->is_multipart)
-        ntoread = 6;
+        nints = 6;
     else
-        ntoread = 5;
+        nints = 5;
 
-    rv = ctxt->do_read (
-        ctxt,
-        data,
-        (size_t) ntoread * sizeof (int32_t),
-        &nextoffset,
-        NULL,
-        EXR_MUST_READ_ALL);
-    if (rv != EXR_ERR_SUCCESS) return rv;
+    if (part->storage_mode == EXR_STORAGE_DEEP_SCANLINE ||
+        part->storage_mode == EXR_STORAGE_DEEP_TILED)
+        return nints * (int) sizeof (int32_t) + 3 * (int) sizeof (int64_t);
+    return nints * (int) sizeof (int32_t);
+}
 
-    priv_to_native32 (data, ntoread);
+/* decode a chunk leader from the raw file bytes. The parallel scan
+ * probes arbitrary offsets, so it asks for quiet to not report every
+ * miss as an error */
+static exr_result_t
+check_chunk_leader (
+    exr_const_context_t       ctxt,
+    exr_const_priv_part_t     part,
+    int                       partnum,
+    const uint8_t*            bytes,
+    int                       quiet,
+    struct priv_chunk_leader* leaderdata)
+{
+    int32_t data[6];
+    int     rdcnt, nints;
+    int64_t maxval = (int64_t) INT_MAX; // 2GB
+
+    if (ctxt->file_size > 0) maxval = ctxt->file_size;
+
+    nints = chunk_leader_size (ctxt, part) / (int) sizeof (int32_t);
+    if (part->storage_mode == EXR_STORAGE_DEEP_SCANLINE ||
+        part->storage_mode == EXR_STORAGE_DEEP_TILED)
+        nints -= 6;
+    memcpy (data, bytes, (size_t) nints * sizeof (int32_t));
+    priv_to_native32 (data, nints);
 
     rdcnt = 0;
     if (ctxt->is_multipart)
     {
         if (data[rdcnt] != partnum)
         {
+            if (quiet) return EXR_ERR_BAD_CHUNK_LEADER;
             return ctxt->print_error (
                 ctxt,
                 EXR_ERR_BAD_CHUNK_LEADER,
@@ -291,19 +305,13 @@ extract_chunk_leader (
     {
         int64_t deep_data[3];
 
-        rv = ctxt->do_read (
-            ctxt,
-            deep_data,
-            3 * sizeof (int64_t),
-            &nextoffset,
-            NULL,
-            EXR_MUST_READ_ALL);
-
-        if (rv != EXR_ERR_SUCCESS) return rv;
+        memcpy (
+            deep_data, bytes + nints * sizeof (int32_t), 3 * sizeof (int64_t));
         priv_to_native64 (deep_data, 3);
 
         if (deep_data[0] < 0 || (deep_data[0] == 0 && (deep_data[1] != 0 || deep_data[2] != 0)))
         {
+            if (quiet) return EXR_ERR_BAD_CHUNK_LEADER;
             return ctxt->print_error (
                 ctxt,
                 EXR_ERR_BAD_CHUNK_LEADER,
@@ -313,6 +321,7 @@ extract_chunk_leader (
         if (deep_data[1] < 0 || deep_data[1] > maxval ||
             (deep_data[1] == 0 && deep_data[2] != 0))
         {
+            if (quiet) return EXR_ERR_BAD_CHUNK_LEADER;
             return ctxt->print_error (
                 ctxt,
                 EXR_ERR_BAD_CHUNK_LEADER,
@@ -327,6 +336,7 @@ extract_chunk_leader (
 
         if (data[rdcnt] < 0 || data[rdcnt] > maxval)
         {
+            if (quiet) return EXR_ERR_BAD_CHUNK_LEADER;
             return ctxt->print_error (
                 ctxt,
                 EXR_ERR_BAD_CHUNK_LEADER,
@@ -335,6 +345,34 @@ extract_chunk_leader (
         }
         leaderdata->packed_size = (uint64_t) data[rdcnt];
     }
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+extract_chunk_leader (
+    exr_const_context_t       ctxt,
+    exr_const_priv_part_t     part,
+    int                       partnum,
+    uint64_t                  offset,
+    uint64_t*                 next_offset,
+    struct priv_chunk_leader* leaderdata)
+{
+    exr_result_t rv;
+    uint8_t      bytes[6 * sizeof (int32_t) + 3 * sizeof (int64_t)];
+    uint64_t     nextoffset = offset;
+
+    rv = ctxt->do_read (
+        ctxt,
+        bytes,
+        (uint64_t) chunk_leader_size (ctxt, part),
+        &nextoffset,
+        NULL,
+        EXR_MUST_READ_ALL);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    rv = check_chunk_leader (ctxt, part, partnum, bytes, 0, leaderdata);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
     nextoffset += leaderdata->packed_size;
 
     *next_offset = nextoffset;
@@ -358,25 +396,18 @@ extract_chunk_size (
 /**************************************/
 
 static exr_result_t
-read_and_validate_chunk_leader (
-    exr_const_context_t   ctxt,
-    exr_const_priv_part_t part,
-    int                   partnum,
-    uint64_t              offset,
-    int*                  indexio,
-    uint64_t*             next_offset)
+validate_chunk_leader (
+    exr_const_context_t             ctxt,
+    exr_const_priv_part_t           part,
+    const struct priv_chunk_leader* leader,
+    int*                            indexio)
 {
-    exr_result_t             rv = EXR_ERR_SUCCESS;
-    struct priv_chunk_leader leader;
-
-    rv = extract_chunk_leader (
-        ctxt, part, partnum, offset, next_offset, &leader);
-    if (rv != EXR_ERR_SUCCESS) return rv;
+    exr_result_t rv = EXR_ERR_SUCCESS;
 
     if (part->storage_mode == EXR_STORAGE_SCANLINE ||
         part->storage_mode == EXR_STORAGE_DEEP_SCANLINE)
     {
-        int64_t chunk = (int64_t) leader.scanline_y;
+        int64_t chunk = (int64_t) leader->scanline_y;
         chunk -= (int64_t) part->data_window.min.y;
         chunk /= part->lines_per_chunk;
 
@@ -388,7 +419,7 @@ read_and_validate_chunk_leader (
                 "Invalid chunk index: %" PRId64
                 " reading scanline %d (datawindow min %d) with lines per chunk %d",
                 chunk,
-                leader.scanline_y,
+                leader->scanline_y,
                 part->data_window.min.y,
                 part->lines_per_chunk);
 
@@ -402,10 +433,10 @@ read_and_validate_chunk_leader (
         rv = validate_and_compute_tile_chunk_off (
             ctxt,
             part,
-            leader.tile_x,
-            leader.tile_y,
-            leader.level_x,
-            leader.level_y,
+            leader->tile_x,
+            leader->tile_y,
+            leader->level_x,
+            leader->level_y,
             &cidx);
 
         *indexio = cidx;
@@ -414,6 +445,594 @@ read_and_validate_chunk_leader (
     return rv;
 }
 
+static exr_result_t
+read_and_validate_chunk_leader (
+    exr_const_context_t   ctxt,
+    exr_const_priv_part_t part,
+    int                   partnum,
+    uint64_t              offset,
+    int*                  indexio,
+    uint64_t*             next_offset)
+{
+    exr_result_t             rv = EXR_ERR_SUCCESS;
+    struct priv_chunk_leader leader;
+
+    rv = extract_chunk_leader (
+        ctxt, part, partnum, offset, next_offset, &leader);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    return validate_chunk_leader (ctxt, part, &leader, indexio);
+}
+
+/**************************************/
+
+/* Parallel reconstruction: the file past the chunk tables is cut into
+ * segments, and each thread finds the first offset in its segment
+ * where a few consecutive plausible chunk leaders line up, then follows
+ * that chain to the end of the segment. The (serial) reconstruction
+ * below then looks leaders up in these results instead of reading them,
+ * and only touches the file where the chains do not meet.
+ */
+#define EXR_RECONSTRUCT_MIN_SEGMENT (4 * 1024 * 1024)
+#define EXR_RECONSTRUCT_SCAN_BLOCK (64 * 1024)
+#define EXR_RECONSTRUCT_SYNC_LEADERS 4
+
+typedef struct
+{
+    uint64_t                 offset;
+    uint64_t                 next_offset;
+    struct priv_chunk_leader leader;
+} chunk_scan_entry_t;
+
+typedef struct
+{
+    exr_const_context_t   ctxt;
+    exr_const_priv_part_t part;
+    int                   partnum;
+    uint64_t              start;
+    uint64_t              end;
+    chunk_scan_entry_t*   entries;
+    int                   count;
+    int                   capacity;
+} chunk_scan_segment_t;
+
+/* quiet version of extract + validate, also rejecting empty chunks
+ * since runs of zeros otherwise look like a chain of leaders. Like the
+ * serial reconstruction, the chunk may run past the end of the file. */
+static int
+probe_chunk_leader (
+    const chunk_scan_segment_t* seg,
+    const uint8_t*              bytes,
+    uint64_t                    offset,
+    struct priv_chunk_leader*   leader,
+    uint64_t*                   next_offset,
+    int*                        chunk)
+{
+    exr_const_context_t   ctxt = seg->ctxt;
+    exr_const_priv_part_t part = seg->part;
+    uint64_t              next;
+
+    if (check_chunk_leader (ctxt, part, seg->partnum, bytes, 1, leader) !=
+        EXR_ERR_SUCCESS)
+        return 0;
+    if (leader->packed_size == 0) return 0;
+
+    next = offset + (uint64_t) chunk_leader_size (ctxt, part) +
+           leader->packed_size;
+
+    if (part->storage_mode == EXR_STORAGE_SCANLINE ||
+        part->storage_mode == EXR_STORAGE_DEEP_SCANLINE)
+    {
+        int64_t y = (int64_t) leader->scanline_y;
+        y -= (int64_t) part->data_window.min.y;
+        if (y < 0 || (y % part->lines_per_chunk) != 0 ||
+            y / part->lines_per_chunk >= part->chunk_count)
+            return 0;
+        *chunk = (int) (y / part->lines_per_chunk);
+    }
+    else
+    {
+        int levx = leader->level_x, levy = leader->level_y;
+
+        if (!part->tiles || !part->tile_level_tile_count_x ||
+            !part->tile_level_tile_count_y || leader->tile_x < 0 ||
+            leader->tile_y < 0 || levx < 0 || levy < 0 ||
+            levx >= part->num_tile_levels_x || levy >= part->num_tile_levels_y)
+            return 0;
+        if (EXR_GET_TILE_LEVEL_MODE ((*(part->tiles->tiledesc))) !=
+                EXR_TILE_RIPMAP_LEVELS &&
+            levx != levy)
+            return 0;
+        if (leader->tile_x >= part->tile_level_tile_count_x[levx] ||
+            leader->tile_y >= part->tile_level_tile_count_y[levy])
+            return 0;
+        /* only used to tell neighbours apart */
+        *chunk = leader->tile_x ^ (leader->tile_y << 12) ^ (levx << 24) ^
+                 (levy << 28);
+    }
+
+    *next_offset = next;
+    return 1;
+}
+
+static int
+read_probe_chunk_leader (
+    const chunk_scan_segment_t* seg,
+    uint64_t                    offset,
+    struct priv_chunk_leader*   leader,
+    uint64_t*                   next_offset,
+    int*                        chunk)
+{
+    uint8_t  bytes[6 * sizeof (int32_t) + 3 * sizeof (int64_t)];
+    uint64_t rdoff = offset;
+
+    if (seg->ctxt->do_read (
+            seg->ctxt,
+            bytes,
+            (uint64_t) chunk_leader_size (seg->ctxt, seg->part),
+            &rdoff,
+            NULL,
+            EXR_MUST_READ_ALL) != EXR_ERR_SUCCESS)
+        return 0;
+    return probe_chunk_leader (seg, bytes, offset, leader, next_offset, chunk);
+}
+
+/* does a chain of leaders starting with this one hold up? */
+static int
+confirm_chunk_chain (
+    const chunk_scan_segment_t* seg, uint64_t next_offset, int chunk)
+{
+    struct priv_chunk_leader leader;
+
+    for (int i = 1; i < EXR_RECONSTRUCT_SYNC_LEADERS; ++i)
+    {
+        int nextchunk;
+
+        if (next_offset >= (uint64_t) seg->ctxt->file_size)
+            return next_offset == (uint64_t) seg->ctxt->file_size;
+        if (!read_probe_chunk_leader (
+                seg, next_offset, &leader, &next_offset, &nextchunk) ||
+            nextchunk == chunk)
+            return 0;
+        chunk = nextchunk;
+    }
+    return 1;
+}
+
+static int
+add_chunk_scan_entry (
+    chunk_scan_segment_t*           seg,
+    uint64_t                        offset,
+    uint64_t                        next_offset,
+    const struct priv_chunk_leader* leader)
+{
+    if (seg->count == seg->capacity)
+    {
+        int                 newcap = seg->capacity ? seg->capacity * 2 : 256;
+        chunk_scan_entry_t* nentries;
+
+        nentries = seg->ctxt->alloc_fn (sizeof (chunk_scan_entry_t) * newcap);
+        if (!nentries) return 0;
+        if (seg->entries)
+        {
+            memcpy (
+                nentries,
+                seg->entries,
+                sizeof (chunk_scan_entry_t) * (size_t) seg->count);
+            seg->ctxt->free_fn (seg->entries);
+        }
+        seg->entries  = nentries;
+        seg->capacity = newcap;
+    }
+    seg->entries[seg->count].offset      = offset;
+    seg->entries[seg->count].next_offset = next_offset;
+    seg->entries[seg->count].leader      = *leader;
+    ++(seg->count);
+    return 1;
+}
+
+static void
+scan_chunk_segment (void* arg)
+{
+    chunk_scan_segment_t*    seg      = arg;
+    exr_const_context_t      ctxt     = seg->ctxt;
+    uint64_t                 leadersz = (uint64_t) chunk_leader_size (ctxt, seg->part);
+    uint64_t                 offset   = seg->end;
+    uint64_t                 next_offset;
+    struct priv_chunk_leader leader;
+    uint8_t*                 block;
+    int                      chunk;
+
+    block = ctxt->alloc_fn (EXR_RECONSTRUCT_SCAN_BLOCK + leadersz);
+    if (!block) return;
+
+    for (uint64_t blockstart = seg->start;
+         blockstart < seg->end && offset == seg->end;
+         blockstart += EXR_RECONSTRUCT_SCAN_BLOCK)
+    {
+        uint64_t rdoff = blockstart;
+        int64_t  nread = 0;
+
+        if (ctxt->do_read (
+                ctxt,
+                block,
+                EXR_RECONSTRUCT_SCAN_BLOCK + leadersz,
+                &rdoff,
+                &nread,
+                EXR_ALLOW_SHORT_READ) != EXR_ERR_SUCCESS)
+            break;
+
+        for (uint64_t p = 0; p < EXR_RECONSTRUCT_SCAN_BLOCK &&
+                             blockstart + p < seg->end &&
+                             p + leadersz <= (uint64_t) nread;
+             ++p)
+        {
+            if (probe_chunk_leader (
+                    seg,
+                    block + p,
+                    blockstart + p,
+                    &leader,
+                    &next_offset,
+                    &chunk) &&
+                confirm_chunk_chain (seg, next_offset, chunk))
+            {
+                offset = blockstart + p;
+                break;
+            }
+        }
+    }
+    ctxt->free_fn (block);
+
+    while (offset < seg->end &&
+           read_probe_chunk_leader (
+               seg, offset, &leader, &next_offset, &chunk))
+    {
+        if (!add_chunk_scan_entry (seg, offset, next_offset, &leader)) break;
+        offset = next_offset;
+    }
+}
+
+static void
+free_chunk_scan (
+    exr_const_context_t ctxt, chunk_scan_segment_t* segs, int nsegs)
+{
+    for (int s = 0; s < nsegs; ++s)
+        if (segs[s].entries) ctxt->free_fn (segs[s].entries);
+    ctxt->free_fn (segs);
+}
+
+static chunk_scan_segment_t*
+parallel_chunk_scan (
+    exr_const_context_t   ctxt,
+    exr_const_priv_part_t part,
+    int                   partnum,
+    uint64_t              offset_start,
+    int*                  nsegsout)
+{
+    chunk_scan_segment_t* segs;
+    exrcore_thread_t*     threads;
+    uint64_t              span, segsize;
+    int                   nsegs = ctxt->reconstruct_threads;
+
+    *nsegsout = 0;
+    if (nsegs < 2 || ctxt->file_size <= 0 ||
+        offset_start >= (uint64_t) ctxt->file_size)
+        return NULL;
+
+    span = (uint64_t) ctxt->file_size - offset_start;
+    if (span / EXR_RECONSTRUCT_MIN_SEGMENT < (uint64_t) nsegs)
+        nsegs = (int) (span / EXR_RECONSTRUCT_MIN_SEGMENT);
+    if (nsegs < 2) return NULL;
+    segsize = span / (uint64_t) nsegs;
+
+    segs    = ctxt->alloc_fn (sizeof (chunk_scan_segment_t) * (size_t) nsegs);
+    threads = ctxt->alloc_fn (sizeof (exrcore_thread_t) * (size_t) nsegs);
+    if (!segs || !threads)
+    {
+        if (segs) ctxt->free_fn (segs);
+        if (threads) ctxt->free_fn (threads);
+        return NULL;
+    }
+
+    memset (segs, 0, sizeof (chunk_scan_segment_t) * (size_t) nsegs);
+    for (int s = 0; s < nsegs; ++s)
+    {
+        segs[s].ctxt    = ctxt;
+        segs[s].part    = part;
+        segs[s].partnum = partnum;
+        segs[s].start   = offset_start + segsize * (uint64_t) s;
+        segs[s].end     = (s == nsegs - 1) ? (uint64_t) ctxt->file_size
+                                           : segs[s].start + segsize;
+    }
+    /* the calling thread takes the first segment */
+    for (int s = 1; s < nsegs; ++s)
+        exrcore_thread_start (threads + s, &scan_chunk_segment, segs + s);
+    scan_chunk_segment (segs);
+    for (int s = 1; s < nsegs; ++s)
+        exrcore_thread_join (threads + s);
+    ctxt->free_fn (threads);
+
+    *nsegsout = nsegs;
+    return segs;
+}
+
+static const chunk_scan_entry_t*
+find_chunk_scan_entry (
+    const chunk_scan_segment_t* segs, int nsegs, uint64_t offset)
+{
+    const chunk_scan_segment_t* seg = NULL;
+    int                         lo, hi;
+
+    for (int s = 0; s < nsegs; ++s)
+    {
+        if (offset >= segs[s].start && offset < segs[s].end)
+        {
+            seg = segs + s;
+            break;
+        }
+    }
+    if (!seg) return NULL;
+
+    lo = 0;
+    hi = seg->count;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (seg->entries[mid].offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < seg->count && seg->entries[lo].offset == offset)
+        return seg->entries + lo;
+    return NULL;
+}
+
+/**************************************/
+
+/* The sidecar is a small header (magic, version and the key below)
+ * followed by one record per reconstructed part: part index, chunk
+ * count, reconstruction result and the table itself, little endian. A
+ * part may be recorded more than once, in which case the last record
+ * wins.
+ */
+#define EXR_CHUNK_INDEX_MAGIC "EXRCIDX"
+#define EXR_CHUNK_INDEX_VERSION 2
+#define EXR_CHUNK_INDEX_HASH_BLOCK 65536
+
+/* what the sidecar was written for: the size and modification time of
+ * the file, and a hash of everything before the first chunk (the
+ * headers and the offset tables as stored), so a file rewritten to the
+ * same size does not pick up a stale table */
+typedef struct
+{
+    int64_t  file_size;
+    int64_t  mtime;
+    uint64_t hash;
+} chunk_index_key_t;
+
+static int
+make_chunk_index_key (exr_const_context_t ctxt, chunk_index_key_t* key)
+{
+    exr_const_priv_part_t lastpart = ctxt->parts[ctxt->num_parts - 1];
+    uint64_t              end, offset = 0;
+    uint64_t              hash = 14695981039346656037ULL; /* FNV-1a */
+    uint8_t*              buf;
+    int                   ok = 1;
+
+    end = lastpart->chunk_table_offset +
+          sizeof (uint64_t) * (uint64_t) lastpart->chunk_count;
+    if (end > (uint64_t) ctxt->file_size) return 0;
+
+    buf = ctxt->alloc_fn (EXR_CHUNK_INDEX_HASH_BLOCK);
+    if (!buf) return 0;
+    while (ok && offset < end)
+    {
+        uint64_t toread = end - offset;
+        int64_t  nread  = 0;
+
+        if (toread > EXR_CHUNK_INDEX_HASH_BLOCK)
+            toread = EXR_CHUNK_INDEX_HASH_BLOCK;
+        ok = ctxt->do_read (
+                 ctxt, buf, toread, &offset, &nread, EXR_MUST_READ_ALL) ==
+             EXR_ERR_SUCCESS;
+        for (int64_t i = 0; ok && i < nread; ++i)
+        {
+            hash ^= buf[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    ctxt->free_fn (buf);
+
+    key->file_size = ctxt->file_size;
+    key->mtime     = internal_exr_file_mtime (ctxt);
+    key->hash      = hash;
+    return ok;
+}
+
+static int
+read_chunk_index_header (FILE* f, const chunk_index_key_t* key)
+{
+    uint8_t  magic[8];
+    uint32_t version;
+    uint64_t vals[3];
+
+    if (fread (magic, 1, 8, f) != 8 ||
+        memcmp (magic, EXR_CHUNK_INDEX_MAGIC, 8) != 0 ||
+        fread (&version, sizeof (version), 1, f) != 1 ||
+        one_to_native32 (version) != EXR_CHUNK_INDEX_VERSION ||
+        fread (vals, sizeof (vals), 1, f) != 1)
+        return 0;
+    priv_to_native64 (vals, 3);
+    return (int64_t) vals[0] == key->file_size &&
+           (int64_t) vals[1] == key->mtime && vals[2] == key->hash;
+}
+
+/* fseek takes a long, which is 32 bits on some platforms */
+static int
+skip_chunk_index_bytes (FILE* f, uint64_t nbytes)
+{
+    while (nbytes > 0)
+    {
+        long step = (long) (nbytes > 0x40000000 ? 0x40000000 : nbytes);
+        if (fseek (f, step, SEEK_CUR) != 0) return 0;
+        nbytes -= (uint64_t) step;
+    }
+    return 1;
+}
+
+static int
+check_chunk_index_table (
+    exr_const_context_t   ctxt,
+    exr_const_priv_part_t part,
+    int                   partnum,
+    const uint64_t*       ctable,
+    uint64_t              chunkminoffset)
+{
+    int first = -1, last = -1;
+
+    for (int ci = 0; ci < part->chunk_count; ++ci)
+    {
+        if (ctable[ci] == 0) continue;
+        if (ctable[ci] < chunkminoffset ||
+            ctable[ci] >= (uint64_t) ctxt->file_size)
+            return 0;
+        if (first < 0) first = ci;
+        last = ci;
+    }
+    if (first < 0) return 1;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        chunk_scan_segment_t     seg;
+        struct priv_chunk_leader leader;
+        uint64_t                 next;
+        int                      ci    = i ? last : first;
+        int                      chunk = ci;
+
+        memset (&seg, 0, sizeof (seg));
+        seg.ctxt    = ctxt;
+        seg.part    = part;
+        seg.partnum = partnum;
+        if (!read_probe_chunk_leader (&seg, ctable[ci], &leader, &next, &chunk))
+            return 0;
+        chunk = ci;
+        if (validate_chunk_leader (ctxt, part, &leader, &chunk) !=
+                EXR_ERR_SUCCESS ||
+            chunk != ci)
+            return 0;
+    }
+    return 1;
+}
+
+static int
+load_chunk_index (
+    exr_const_context_t      ctxt,
+    exr_const_priv_part_t    part,
+    int                      partnum,
+    const chunk_index_key_t* key,
+    uint64_t*                ctable,
+    uint64_t                 chunkminoffset,
+    exr_result_t*            reconstructrv)
+{
+    FILE*     f;
+    int       found = 0;
+    size_t    chunkbytes = sizeof (uint64_t) * (size_t) part->chunk_count;
+    uint64_t* tmp;
+
+    f = internal_exr_open_chunk_index (ctxt, "rb");
+    if (!f) return 0;
+
+    tmp = ctxt->alloc_fn (chunkbytes);
+    if (tmp && read_chunk_index_header (f, key))
+    {
+        int32_t rec[4];
+
+        while (fread (rec, sizeof (rec), 1, f) == 1)
+        {
+            priv_to_native32 (rec, 4);
+            if (rec[1] < 0) break;
+            if (rec[0] == partnum && rec[1] == part->chunk_count)
+            {
+                if (fread (tmp, chunkbytes, 1, f) != 1) break;
+                priv_to_native64 (tmp, part->chunk_count);
+                memcpy (ctable, tmp, chunkbytes);
+                *reconstructrv = (exr_result_t) rec[2];
+                found          = 1;
+            }
+            else if (!skip_chunk_index_bytes (f, (uint64_t) rec[1] * 8))
+                break;
+        }
+    }
+    fclose (f);
+    if (tmp) ctxt->free_fn (tmp);
+
+    return found &&
+           check_chunk_index_table (ctxt, part, partnum, ctable, chunkminoffset);
+}
+
+static void
+save_chunk_index (
+    exr_const_context_t      ctxt,
+    exr_const_priv_part_t    part,
+    int                      partnum,
+    const chunk_index_key_t* key,
+    const uint64_t*          ctable,
+    exr_result_t             reconstructrv)
+{
+    FILE*     f;
+    int32_t   rec[4];
+    size_t    chunkbytes = sizeof (uint64_t) * (size_t) part->chunk_count;
+    uint64_t* tmp;
+
+    tmp = ctxt->alloc_fn (chunkbytes);
+    if (!tmp) return;
+    memcpy (tmp, ctable, chunkbytes);
+    priv_from_native64 (tmp, part->chunk_count);
+
+    rec[0] = partnum;
+    rec[1] = part->chunk_count;
+    rec[2] = (int32_t) reconstructrv;
+    rec[3] = 0;
+    priv_from_native32 (rec, 4);
+
+    /* parts reconstructed from different threads share the file */
+    internal_exr_lock (ctxt);
+    f = internal_exr_open_chunk_index (ctxt, "r+b");
+    if (f && !(read_chunk_index_header (f, key) &&
+               fseek (f, 0, SEEK_END) == 0))
+    {
+        fclose (f);
+        f = NULL;
+    }
+    if (!f)
+    {
+        uint32_t version = one_from_native32 (EXR_CHUNK_INDEX_VERSION);
+        uint64_t vals[3] = {
+            (uint64_t) key->file_size, (uint64_t) key->mtime, key->hash};
+
+        priv_from_native64 (vals, 3);
+        f = internal_exr_open_chunk_index (ctxt, "wb");
+        if (f &&
+            (fwrite (EXR_CHUNK_INDEX_MAGIC, 1, 8, f) != 8 ||
+             fwrite (&version, sizeof (version), 1, f) != 1 ||
+             fwrite (vals, sizeof (vals), 1, f) != 1))
+        {
+            fclose (f);
+            f = NULL;
+        }
+    }
+    if (f)
+    {
+        if (fwrite (rec, sizeof (rec), 1, f) == 1)
+            fwrite (tmp, chunkbytes, 1, f);
+        fclose (f);
+    }
+    internal_exr_unlock (ctxt);
+
+    ctxt->free_fn (tmp);
+}
+
 // this should behave the same as the old ImfMultiPartInputFile
 static exr_result_t
 reconstruct_chunk_table (
@@ -426,6 +1045,10 @@ reconstruct_chunk_table (
     exr_const_priv_part_t curpart = NULL;
     int                   found_ci, computed_ci, partnum = 0;
     size_t                chunkbytes;
+    chunk_scan_segment_t* scan  = NULL;
+    int                   nsegs = 0;
+
+    const chunk_scan_entry_t* scanned;
 
     curpart      = ctxt->parts[ctxt->num_parts - 1];
     offset_start = curpart->chunk_table_offset;
@@ -467,6 +1090,8 @@ reconstruct_chunk_table (
 
     memset (curctable, 0, chunkbytes);
 
+    scan = parallel_chunk_scan (ctxt, part, partnum, offset_start, &nsegs);
+
     for (int ci = 0; ci < part->chunk_count; ++ci)
     {
         if (chunktable[ci] >= offset_start && chunktable[ci] < max_offset)
@@ -479,8 +1104,16 @@ reconstruct_chunk_table (
             computed_ci = part->chunk_count - (ci + 1);
         found_ci = computed_ci;
 
-        rv = read_and_validate_chunk_leader (
-            ctxt, part, partnum, chunk_start, &found_ci, &offset_start);
+        scanned = find_chunk_scan_entry (scan, nsegs, chunk_start);
+        if (scanned)
+        {
+            offset_start = scanned->next_offset;
+            rv           = validate_chunk_leader (
+                ctxt, part, &(scanned->leader), &found_ci);
+        }
+        else
+            rv = read_and_validate_chunk_leader (
+                ctxt, part, partnum, chunk_start, &found_ci, &offset_start);
         if (rv != EXR_ERR_SUCCESS)
         {
             chunk_start = 0;
@@ -505,6 +1138,7 @@ reconstruct_chunk_table (
         }
     }
     ctxt->free_fn (curctable);
+    if (scan) free_chunk_scan (ctxt, scan, nsegs);
 
     return firstfailrv;
 }
@@ -595,7 +1229,26 @@ extract_chunk_table (
                 // then just let the reads fail later. We will do
                 // something similar, except when in strict mode, we
                 // will fail with a corrupt chunk immediately.
-                rv = reconstruct_chunk_table (ctxt, part, ctable);
+                chunk_index_key_t key;
+                int               usekey =
+                    ctxt->chunk_index_filename.str && ctxt->file_size > 0 &&
+                    make_chunk_index_key (ctxt, &key);
+
+                if (!usekey ||
+                    !load_chunk_index (
+                        ctxt,
+                        part,
+                        part->part_index,
+                        &key,
+                        ctable,
+                        chunkoff,
+                        &rv))
+                {
+                    rv = reconstruct_chunk_table (ctxt, part, ctable);
+                    if (usekey && ctxt->mode == EXR_CONTEXT_READ)
+                        save_chunk_index (
+                            ctxt, part, part->part_index, &key, ctable, rv);
+                }
                 if (rv != EXR_ERR_SUCCESS)
                 {
                     if (ctxt->strict_header)
@@ -1501,19 +2154,13 @@ exr_read_tile_chunk_info (
     return EXR_ERR_SUCCESS;
 }
 
-exr_result_t
-exr_read_chunk (
+static exr_result_t
+validate_chunk_read (
     exr_const_context_t     ctxt,
-    int                     part_index,
+    exr_const_priv_part_t   part,
     const exr_chunk_info_t* cinfo,
-    void*                   packed_data)
+    const void*             packed_data)
 {
-    exr_result_t                 rv;
-    uint64_t                     dataoffset, toread;
-    int64_t                      nread;
-    enum _INTERNAL_EXR_READ_MODE rmode = EXR_MUST_READ_ALL;
-    EXR_READONLY_AND_DEFINE_PART (part_index);
-
     if (!cinfo) return ctxt->standard_error (ctxt, EXR_ERR_INVALID_ARGUMENT);
     if (cinfo->packed_size > 0 && !packed_data)
         return ctxt->standard_error (ctxt, EXR_ERR_INVALID_ARGUMENT);
@@ -1536,15 +2183,34 @@ exr_read_chunk (
             EXR_ERR_INVALID_ARGUMENT,
             "mismatched compression type for chunk block info");
 
-    dataoffset = cinfo->data_offset;
-    if (ctxt->file_size > 0 && dataoffset > (uint64_t) ctxt->file_size)
+    if (ctxt->file_size > 0 && cinfo->data_offset > (uint64_t) ctxt->file_size)
         return ctxt->print_error (
             ctxt,
             EXR_ERR_INVALID_ARGUMENT,
             "chunk block info data offset (%" PRIu64
             ") past end of file (%" PRId64 ")",
-            dataoffset,
+            cinfo->data_offset,
             ctxt->file_size);
+    return EXR_ERR_SUCCESS;
+}
+
+exr_result_t
+exr_read_chunk (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    const exr_chunk_info_t* cinfo,
+    void*                   packed_data)
+{
+    exr_result_t                 rv;
+    uint64_t                     dataoffset, toread;
+    int64_t                      nread;
+    enum _INTERNAL_EXR_READ_MODE rmode = EXR_MUST_READ_ALL;
+    EXR_READONLY_AND_DEFINE_PART (part_index);
+
+    rv = validate_chunk_read (ctxt, part, cinfo, packed_data);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    dataoffset = cinfo->data_offset;
 
     /* allow a short read if uncompressed */
     if (part->comp_type == EXR_COMPRESSION_NONE) rmode = EXR_ALLOW_SHORT_READ;
@@ -1574,6 +2240,326 @@ exr_read_chunk (
 
 /**************************************/
 
+/* Runs of chunks are fetched with one request as long as the gaps
+ * between them (chunk leaders, or chunks that were not asked for) are
+ * at most this many bytes, which are read and thrown away. Without a
+ * vectored read, a run is staged in a temporary buffer, so it is also
+ * capped in size. A vectored run takes one entry per chunk and one per
+ * gap, and is kept within IOV_MAX entries: io_uring fails longer
+ * vectors with EINVAL rather than splitting them.
+ */
+#define EXR_READ_CHUNKS_MAX_GAP 4096
+#define EXR_READ_CHUNKS_MAX_STAGED (16 * 1024 * 1024)
+#define EXR_READ_CHUNKS_MAX_VECS 1024
+
+typedef struct
+{
+    uint64_t offset;
+    uint64_t size;
+    void*    dest;
+} chunk_read_span_t;
+
+static int
+compare_chunk_read (const void* a, const void* b)
+{
+    const chunk_read_span_t* ca = a;
+    const chunk_read_span_t* cb = b;
+    if (ca->offset < cb->offset) return -1;
+    if (ca->offset > cb->offset) return 1;
+    return 0;
+}
+
+/* Deal with a run that came up short: uncompressed chunks are zero
+ * filled past the end of the file, as exr_read_chunk does */
+static exr_result_t
+finish_short_read (
+    exr_const_context_t      ctxt,
+    exr_const_priv_part_t    part,
+    const chunk_read_span_t* run,
+    int                      count,
+    int64_t                  nread)
+{
+    uint64_t start = run[0].offset;
+
+    if (nread < 0) return EXR_ERR_READ_IO;
+    for (int i = 0; i < count; ++i)
+    {
+        uint64_t have = 0, rel = run[i].offset - start;
+
+        if ((uint64_t) nread >= rel + run[i].size) continue;
+        if (part->comp_type != EXR_COMPRESSION_NONE)
+            return ctxt->print_error (
+                ctxt,
+                EXR_ERR_READ_IO,
+                "short read of chunk at offset %" PRIu64
+                ", requested %" PRIu64 " bytes",
+                run[i].offset,
+                run[i].size);
+        if ((uint64_t) nread > rel) have = (uint64_t) nread - rel;
+        memset (
+            ((uint8_t*) run[i].dest) + have, 0, (size_t) (run[i].size - have));
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+/* Same grouping as the synchronous path, but every run is handed to the
+ * file backend at once so it can keep several reads in flight.
+ */
+static exr_result_t
+read_spans_queued (
+    exr_const_context_t      ctxt,
+    exr_const_priv_part_t    part,
+    const chunk_read_span_t* spans,
+    int                      nspans)
+{
+    exr_result_t                 rv = EXR_ERR_SUCCESS;
+    internal_exr_read_request_t* reqs;
+    exr_read_vector_t*           vecs;
+    int*                         runstart;
+    uint8_t*                     scratch;
+    int                          nreqs = 0, nvecs = 0;
+
+    reqs = ctxt->alloc_fn (
+        sizeof (internal_exr_read_request_t) * (size_t) nspans);
+    vecs = ctxt->alloc_fn (sizeof (exr_read_vector_t) * 2 * (size_t) nspans);
+    runstart = ctxt->alloc_fn (sizeof (int) * ((size_t) nspans + 1));
+    scratch  = ctxt->alloc_fn (EXR_READ_CHUNKS_MAX_GAP);
+    if (!reqs || !vecs || !runstart || !scratch)
+    {
+        rv = ctxt->standard_error (ctxt, EXR_ERR_OUT_OF_MEMORY);
+        goto cleanup;
+    }
+
+    for (int s = 0; s < nspans;)
+    {
+        uint64_t end = spans[s].offset + spans[s].size;
+        int      e   = s + 1;
+        int      nv  = 1;
+
+        while (e < nspans && spans[e].offset >= end &&
+               spans[e].offset - end <= EXR_READ_CHUNKS_MAX_GAP)
+        {
+            nv += (spans[e].offset > end) ? 2 : 1;
+            if (nv > EXR_READ_CHUNKS_MAX_VECS) break;
+            end = spans[e].offset + spans[e].size;
+            ++e;
+        }
+
+        runstart[nreqs]    = s;
+        reqs[nreqs].offset = spans[s].offset;
+        reqs[nreqs].vecs   = vecs + nvecs;
+        reqs[nreqs].count  = 0;
+        reqs[nreqs].nread  = 0;
+        for (int i = s; i < e; ++i)
+        {
+            uint64_t prevend = (i > s) ? spans[i - 1].offset + spans[i - 1].size
+                                       : spans[s].offset;
+            if (spans[i].offset > prevend)
+            {
+                vecs[nvecs].buffer = scratch;
+                vecs[nvecs].size   = spans[i].offset - prevend;
+                ++nvecs;
+                ++reqs[nreqs].count;
+            }
+            vecs[nvecs].buffer = spans[i].dest;
+            vecs[nvecs].size   = spans[i].size;
+            ++nvecs;
+            ++reqs[nreqs].count;
+        }
+        ++nreqs;
+        s = e;
+    }
+    runstart[nreqs] = nspans;
+
+    rv = ctxt->read_queued_fn (ctxt, reqs, nreqs);
+    for (int r = 0; r < nreqs && rv == EXR_ERR_SUCCESS; ++r)
+    {
+        const chunk_read_span_t* last  = spans + runstart[r + 1] - 1;
+        uint64_t                 total = last->offset + last->size -
+                         reqs[r].offset;
+
+        if (reqs[r].nread < 0 || (uint64_t) reqs[r].nread < total)
+            rv = finish_short_read (
+                ctxt,
+                part,
+                spans + runstart[r],
+                runstart[r + 1] - runstart[r],
+                reqs[r].nread);
+    }
+
+cleanup:
+    if (scratch) ctxt->free_fn (scratch);
+    if (runstart) ctxt->free_fn (runstart);
+    if (vecs) ctxt->free_fn (vecs);
+    if (reqs) ctxt->free_fn (reqs);
+    return rv;
+}
+
+exr_result_t
+exr_read_chunks (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    const exr_chunk_info_t* cinfos,
+    int                     count,
+    void* const*            packed_data)
+{
+    exr_result_t       rv = EXR_ERR_SUCCESS;
+    chunk_read_span_t* spans;
+    exr_read_vector_t* vecs    = NULL;
+    uint8_t*           scratch = NULL;
+    uint8_t*           staged  = NULL;
+    int                nspans  = 0;
+    EXR_READONLY_AND_DEFINE_PART (part_index);
+
+    if (count < 0 || (count > 0 && (!cinfos || !packed_data)))
+        return ctxt->standard_error (ctxt, EXR_ERR_INVALID_ARGUMENT);
+
+    for (int i = 0; i < count; ++i)
+    {
+        rv = validate_chunk_read (ctxt, part, cinfos + i, packed_data[i]);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+    }
+
+    /* the mapping is already as cheap as it gets */
+    if (ctxt->mapped_data || count == 1)
+    {
+        for (int i = 0; i < count && rv == EXR_ERR_SUCCESS; ++i)
+            rv = exr_read_chunk (ctxt, part_index, cinfos + i, packed_data[i]);
+        return rv;
+    }
+    if (count == 0) return EXR_ERR_SUCCESS;
+
+    spans = ctxt->alloc_fn (sizeof (chunk_read_span_t) * (size_t) count);
+    if (!spans) return ctxt->standard_error (ctxt, EXR_ERR_OUT_OF_MEMORY);
+    for (int i = 0; i < count; ++i)
+    {
+        if (cinfos[i].packed_size == 0) continue;
+        spans[nspans].offset = cinfos[i].data_offset;
+        spans[nspans].size   = cinfos[i].packed_size;
+        spans[nspans].dest   = packed_data[i];
+        ++nspans;
+    }
+    qsort (
+        spans,
+        (size_t) nspans,
+        sizeof (chunk_read_span_t),
+        &compare_chunk_read);
+
+    if (ctxt->read_queued_fn && ctxt->read_vector_fn &&
+        ctxt->read_queue_depth > 1 && nspans > 1)
+    {
+        rv = read_spans_queued (ctxt, part, spans, nspans);
+        ctxt->free_fn (spans);
+        return rv;
+    }
+
+    if (ctxt->read_vector_fn)
+    {
+        vecs = ctxt->alloc_fn (
+            sizeof (exr_read_vector_t) * EXR_READ_CHUNKS_MAX_VECS);
+        scratch = ctxt->alloc_fn (EXR_READ_CHUNKS_MAX_GAP);
+        if (!vecs || !scratch)
+            rv = ctxt->standard_error (ctxt, EXR_ERR_OUT_OF_MEMORY);
+    }
+
+    for (int s = 0; s < nspans && rv == EXR_ERR_SUCCESS;)
+    {
+        uint64_t start = spans[s].offset;
+        uint64_t end   = start + spans[s].size;
+        int      e     = s + 1;
+        int      nv    = 1;
+        int64_t  nread;
+
+        /* overlapping chunks (a corrupt table) are read separately */
+        while (e < nspans && spans[e].offset >= end &&
+               spans[e].offset - end <= EXR_READ_CHUNKS_MAX_GAP &&
+               (vecs || spans[e].offset + spans[e].size - start <=
+                            EXR_READ_CHUNKS_MAX_STAGED))
+        {
+            nv += (spans[e].offset > end) ? 2 : 1;
+            if (vecs && nv > EXR_READ_CHUNKS_MAX_VECS) break;
+            end = spans[e].offset + spans[e].size;
+            ++e;
+        }
+
+        if (e - s == 1)
+        {
+            uint64_t dataoffset = start;
+            nread               = 0;
+            rv                  = ctxt->do_read (
+                ctxt,
+                spans[s].dest,
+                spans[s].size,
+                &dataoffset,
+                &nread,
+                EXR_ALLOW_SHORT_READ);
+        }
+        else if (vecs)
+        {
+            int nvecs = 0;
+            for (int i = s; i < e; ++i)
+            {
+                uint64_t prevend =
+                    (i > s) ? spans[i - 1].offset + spans[i - 1].size : start;
+                if (spans[i].offset > prevend)
+                {
+                    vecs[nvecs].buffer = scratch;
+                    vecs[nvecs].size   = spans[i].offset - prevend;
+                    ++nvecs;
+                }
+                vecs[nvecs].buffer = spans[i].dest;
+                vecs[nvecs].size   = spans[i].size;
+                ++nvecs;
+            }
+            nread = ctxt->read_vector_fn (
+                ctxt, ctxt->user_data, vecs, nvecs, start, ctxt->print_error);
+            rv = EXR_ERR_SUCCESS;
+        }
+        else
+        {
+            uint64_t dataoffset = start;
+
+            if (!staged)
+                staged = ctxt->alloc_fn (EXR_READ_CHUNKS_MAX_STAGED);
+            if (!staged)
+            {
+                rv = ctxt->standard_error (ctxt, EXR_ERR_OUT_OF_MEMORY);
+                break;
+            }
+            nread = 0;
+            rv    = ctxt->do_read (
+                ctxt,
+                staged,
+                end - start,
+                &dataoffset,
+                &nread,
+                EXR_ALLOW_SHORT_READ);
+            for (int i = s; i < e && nread > 0; ++i)
+            {
+                uint64_t rel  = spans[i].offset - start;
+                uint64_t have = spans[i].size;
+                if ((uint64_t) nread <= rel) break;
+                if ((uint64_t) nread - rel < have)
+                    have = (uint64_t) nread - rel;
+                memcpy (spans[i].dest, staged + rel, (size_t) have);
+            }
+        }
+
+        if (rv == EXR_ERR_SUCCESS &&
+            (nread < 0 || (uint64_t) nread < end - start))
+            rv = finish_short_read (ctxt, part, spans + s, e - s, nread);
+        s = e;
+    }
+
+    if (staged) ctxt->free_fn (staged);
+    if (scratch) ctxt->free_fn (scratch);
+    if (vecs) ctxt->free_fn (vecs);
+    ctxt->free_fn (spans);
+    return rv;
+}
+
+/**************************************/
+
 exr_result_t
 exr_read_deep_chunk (
     exr_const_context_t     ctxt,
@@ -4,9 +4,15 @@
 */
 
 #include "internal_coding.h"
+#include "internal_memory.h"
 #include "internal_util.h"
+#include "openexr_compression.h"
 
 #include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#    include <windows.h>
+#endif
 
 exr_result_t
 internal_coding_fill_channel_info (
@@ -114,6 +120,262 @@ internal_coding_update_channel_info (
 
 /**************************************/
 
+/* Buffers are kept in size classes of a quarter octave from 4 KiB up
+ * to 2 GiB, so a request is rounded up by at most 25%. Anything larger
+ * bypasses the pool. Idle buffers hold the free list link in their
+ * first bytes.
+ */
+#define EXR_POOL_MIN_SHIFT 12
+#define EXR_POOL_MAX_SHIFT 31
+#define EXR_POOL_CLASS_COUNT ((EXR_POOL_MAX_SHIFT - EXR_POOL_MIN_SHIFT) * 4 + 1)
+
+struct _exr_buffer_pool
+{
+    void*    free_lists[EXR_POOL_CLASS_COUNT];
+    uint64_t cached_bytes;
+    uint64_t max_cached_bytes;
+    int      refcount;
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    CRITICAL_SECTION mutex;
+#    else
+    pthread_mutex_t mutex;
+#    endif
+#endif
+};
+
+static inline void
+pool_lock (exr_buffer_pool_t pool)
+{
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    EnterCriticalSection (&pool->mutex);
+#    else
+    pthread_mutex_lock (&pool->mutex);
+#    endif
+#endif
+}
+
+static inline void
+pool_unlock (exr_buffer_pool_t pool)
+{
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    LeaveCriticalSection (&pool->mutex);
+#    else
+    pthread_mutex_unlock (&pool->mutex);
+#    endif
+#endif
+}
+
+static int
+pool_size_class (size_t sz, size_t* classsz)
+{
+    size_t n;
+    int    e = EXR_POOL_MIN_SHIFT;
+
+    if (sz <= ((size_t) 1 << EXR_POOL_MIN_SHIFT))
+    {
+        *classsz = (size_t) 1 << EXR_POOL_MIN_SHIFT;
+        return 0;
+    }
+    if ((uint64_t) sz > ((uint64_t) 1 << EXR_POOL_MAX_SHIFT)) return -1;
+
+    n = sz - 1;
+    while ((n >> (e + 1)) != 0)
+        ++e;
+    *classsz = ((n >> (e - 2)) + 1) << (e - 2);
+    return (e - EXR_POOL_MIN_SHIFT) * 4 + (int) (n >> (e - 2)) - 3;
+}
+
+static void
+pool_free_cached (exr_buffer_pool_t pool)
+{
+    for (int c = 0; c < EXR_POOL_CLASS_COUNT; ++c)
+    {
+        void* buf = pool->free_lists[c];
+        while (buf)
+        {
+            void* next;
+            memcpy (&next, buf, sizeof (void*));
+            internal_exr_free (buf);
+            buf = next;
+        }
+        pool->free_lists[c] = NULL;
+    }
+    pool->cached_bytes = 0;
+}
+
+exr_result_t
+exr_buffer_pool_create (exr_buffer_pool_t* pool, uint64_t max_cached_bytes)
+{
+    exr_buffer_pool_t ret;
+
+    if (!pool) return EXR_ERR_INVALID_ARGUMENT;
+
+    *pool = NULL;
+    ret   = internal_exr_alloc (sizeof (struct _exr_buffer_pool));
+    if (!ret) return EXR_ERR_OUT_OF_MEMORY;
+
+    memset (ret, 0, sizeof (struct _exr_buffer_pool));
+    ret->max_cached_bytes = max_cached_bytes;
+    ret->refcount         = 1;
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    InitializeCriticalSection (&(ret->mutex));
+#    else
+    if (pthread_mutex_init (&(ret->mutex), NULL) != 0)
+    {
+        internal_exr_free (ret);
+        return EXR_ERR_OUT_OF_MEMORY;
+    }
+#    endif
+#endif
+    *pool = ret;
+    return EXR_ERR_SUCCESS;
+}
+
+void
+internal_exr_release_buffer_pool (exr_buffer_pool_t pool)
+{
+    int last;
+
+    if (!pool) return;
+
+    pool_lock (pool);
+    last = (--(pool->refcount) == 0);
+    pool_unlock (pool);
+    if (!last) return;
+
+    pool_free_cached (pool);
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    DeleteCriticalSection (&(pool->mutex));
+#    else
+    pthread_mutex_destroy (&(pool->mutex));
+#    endif
+#endif
+    internal_exr_free (pool);
+}
+
+exr_result_t
+exr_buffer_pool_destroy (exr_buffer_pool_t* pool)
+{
+    if (!pool) return EXR_ERR_INVALID_ARGUMENT;
+    internal_exr_release_buffer_pool (*pool);
+    *pool = NULL;
+    return EXR_ERR_SUCCESS;
+}
+
+exr_result_t
+exr_buffer_pool_trim (exr_buffer_pool_t pool)
+{
+    if (!pool) return EXR_ERR_INVALID_ARGUMENT;
+    pool_lock (pool);
+    pool_free_cached (pool);
+    pool_unlock (pool);
+    return EXR_ERR_SUCCESS;
+}
+
+exr_result_t
+exr_buffer_pool_get_cached_bytes (exr_buffer_pool_t pool, uint64_t* bytes)
+{
+    if (!pool || !bytes) return EXR_ERR_INVALID_ARGUMENT;
+    pool_lock (pool);
+    *bytes = pool->cached_bytes;
+    pool_unlock (pool);
+    return EXR_ERR_SUCCESS;
+}
+
+exr_result_t
+exr_set_buffer_pool (exr_context_t ctxt, exr_buffer_pool_t pool)
+{
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+
+    if (pool)
+    {
+        pool_lock (pool);
+        ++(pool->refcount);
+        pool_unlock (pool);
+    }
+    internal_exr_release_buffer_pool (ctxt->buffer_pool);
+    ctxt->buffer_pool = pool;
+    return EXR_ERR_SUCCESS;
+}
+
+/* default pipeline allocation, updating sz to the size actually
+ * allocated and setting pooled when the buffer comes from the context's
+ * pool */
+static void*
+coding_alloc_buffer (exr_const_context_t ctxt, size_t* sz, int* pooled)
+{
+    exr_buffer_pool_t pool = ctxt->buffer_pool;
+    size_t            classsz;
+    int               c;
+    void*             buf = NULL;
+
+    *pooled = 0;
+    if (!pool) return ctxt->alloc_fn (*sz);
+
+    c = pool_size_class (*sz, &classsz);
+    if (c < 0) return ctxt->alloc_fn (*sz);
+
+    pool_lock (pool);
+    buf = pool->free_lists[c];
+    if (buf)
+    {
+        memcpy (&(pool->free_lists[c]), buf, sizeof (void*));
+        pool->cached_bytes -= classsz;
+    }
+    pool_unlock (pool);
+
+    if (!buf) buf = internal_exr_alloc (classsz);
+    if (buf)
+    {
+        *sz     = classsz;
+        *pooled = 1;
+    }
+    return buf;
+}
+
+/* pool buffers all come from the library allocator, so one can go back
+ * to whatever pool the context has by now, or be freed outright */
+static void
+coding_free_buffer (exr_const_context_t ctxt, void* buf, size_t sz, int pooled)
+{
+    exr_buffer_pool_t pool = ctxt->buffer_pool;
+    size_t            classsz;
+    int               c;
+
+    if (!pooled)
+    {
+        ctxt->free_fn (buf);
+        return;
+    }
+
+    c = pool ? pool_size_class (sz, &classsz) : -1;
+    if (c < 0 || classsz != sz)
+    {
+        internal_exr_free (buf);
+        return;
+    }
+
+    pool_lock (pool);
+    if (pool->max_cached_bytes == 0 ||
+        pool->cached_bytes + classsz <= pool->max_cached_bytes)
+    {
+        memcpy (buf, &(pool->free_lists[c]), sizeof (void*));
+        pool->free_lists[c] = buf;
+        pool->cached_bytes += classsz;
+        buf                 = NULL;
+    }
+    pool_unlock (pool);
+
+    if (buf) internal_exr_free (buf);
+}
+
+/**************************************/
+
 exr_result_t
 internal_encode_free_buffer (
     exr_encode_pipeline_t*               encode,
@@ -121,8 +383,9 @@ internal_encode_free_buffer (
     void**                               buf,
     size_t*                              sz)
 {
-    void*  curbuf = *buf;
-    size_t cursz  = *sz;
+    void*    curbuf = *buf;
+    size_t   cursz  = *sz;
+    uint32_t bit    = (uint32_t) 1 << bufid;
     if (curbuf)
     {
         if (cursz > 0)
@@ -134,12 +397,14 @@ internal_encode_free_buffer (
                 exr_const_context_t ctxt = encode->context;
                 EXR_CHECK_CONTEXT_AND_PART (encode->part_index);
 
-                ctxt->free_fn (curbuf);
+                coding_free_buffer (
+                    ctxt, curbuf, cursz, (encode->_pooled_buffers & bit) != 0);
             }
         }
         *buf = NULL;
     }
     *sz = 0;
+    encode->_pooled_buffers &= ~bit;
     return EXR_ERR_SUCCESS;
 }
 
@@ -173,9 +438,11 @@ internal_encode_alloc_buffer (
         else
         {
             exr_const_context_t ctxt = encode->context;
+            int                 pooled;
             EXR_CHECK_CONTEXT_AND_PART (encode->part_index);
 
-            curbuf = ctxt->alloc_fn (newsz);
+            curbuf = coding_alloc_buffer (ctxt, &newsz, &pooled);
+            if (pooled) encode->_pooled_buffers |= (uint32_t) 1 << bufid;
         }
 
         if (curbuf == NULL)
@@ -203,8 +470,9 @@ internal_decode_free_buffer (
     void**                               buf,
     size_t*                              sz)
 {
-    void*  curbuf = *buf;
-    size_t cursz  = *sz;
+    void*    curbuf = *buf;
+    size_t   cursz  = *sz;
+    uint32_t bit    = (uint32_t) 1 << bufid;
     if (curbuf)
     {
         if (cursz > 0)
@@ -216,12 +484,14 @@ internal_decode_free_buffer (
                 exr_const_context_t ctxt = decode->context;
                 EXR_CHECK_CONTEXT_AND_PART (decode->part_index);
 
-                ctxt->free_fn (curbuf);
+                coding_free_buffer (
+                    ctxt, curbuf, cursz, (decode->_pooled_buffers & bit) != 0);
             }
         }
         *buf = NULL;
     }
     *sz = 0;
+    decode->_pooled_buffers &= ~bit;
     return EXR_ERR_SUCCESS;
 }
 
@@ -251,9 +521,11 @@ internal_decode_alloc_buffer (
         else
         {
             exr_const_context_t ctxt = decode->context;
+            int                 pooled;
             EXR_CHECK_CONTEXT_AND_PART (decode->part_index);
 
-            curbuf = ctxt->alloc_fn (newsz);
+            curbuf = coding_alloc_buffer (ctxt, &newsz, &pooled);
+            if (pooled) decode->_pooled_buffers |= (uint32_t) 1 << bufid;
         }
 
         if (curbuf == NULL)
@@ -273,3 +545,292 @@ internal_decode_alloc_buffer (
     }
     return EXR_ERR_SUCCESS;
 }
+
+/**************************************/
+
+/* Counters of the pipeline statistics. The totals are independent, so
+ * relaxed ordering is enough; a query running concurrently with
+ * pipelines may see a chunk counted in one stage but not yet the
+ * next */
+#ifdef EXR_HAS_STD_ATOMICS
+typedef atomic_uint_least64_t stats_counter_t;
+
+static inline void
+stats_add (stats_counter_t* c, uint64_t v)
+{
+    atomic_fetch_add_explicit (c, v, memory_order_relaxed);
+}
+
+static inline uint64_t
+stats_load (const stats_counter_t* c)
+{
+    return atomic_load_explicit (
+        EXR_CONST_CAST (stats_counter_t*, c), memory_order_relaxed);
+}
+
+static inline void
+stats_clear (stats_counter_t* c)
+{
+    atomic_store_explicit (c, 0, memory_order_relaxed);
+}
+#elif defined(_MSC_VER)
+typedef LONG64 volatile stats_counter_t;
+
+static inline void
+stats_add (stats_counter_t* c, uint64_t v)
+{
+    InterlockedExchangeAdd64 (c, (LONG64) v);
+}
+
+static inline uint64_t
+stats_load (const stats_counter_t* c)
+{
+    return (uint64_t) InterlockedOr64 (EXR_CONST_CAST (stats_counter_t*, c), 0);
+}
+
+static inline void
+stats_clear (stats_counter_t* c)
+{
+    InterlockedExchange64 (c, 0);
+}
+#endif
+
+enum _internal_exr_pipeline_stat
+{
+    STAT_DECODE_CHUNKS,
+    STAT_READ_NS,
+    STAT_READ_BYTES,
+    STAT_DECOMPRESS_NS,
+    STAT_DECOMPRESS_BYTES,
+    STAT_UNPACK_NS,
+    STAT_ENCODE_CHUNKS,
+    STAT_PACK_NS,
+    STAT_PACKED_BYTES,
+    STAT_COMPRESS_NS,
+    STAT_COMPRESSED_BYTES,
+    STAT_WRITE_NS,
+    STAT_WRITE_BYTES,
+    STAT_COUNT
+};
+
+enum _internal_exr_compression_stat
+{
+    COMP_STAT_DECOMPRESS_CHUNKS,
+    COMP_STAT_DECOMPRESS_NS,
+    COMP_STAT_DECOMPRESS_IN_BYTES,
+    COMP_STAT_DECOMPRESS_OUT_BYTES,
+    COMP_STAT_COMPRESS_CHUNKS,
+    COMP_STAT_COMPRESS_NS,
+    COMP_STAT_COMPRESS_IN_BYTES,
+    COMP_STAT_COMPRESS_OUT_BYTES,
+    COMP_STAT_COUNT
+};
+
+struct _internal_exr_pipeline_stats
+{
+    stats_counter_t totals[STAT_COUNT];
+    stats_counter_t per_compression[EXR_COMPRESSION_LAST_TYPE]
+                                   [COMP_STAT_COUNT];
+};
+
+uint64_t
+internal_exr_stats_clock (void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER        now;
+
+    if (freq.QuadPart == 0) QueryPerformanceFrequency (&freq);
+    QueryPerformanceCounter (&now);
+    return (uint64_t) (
+        ((double) now.QuadPart) * 1e9 / ((double) freq.QuadPart));
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + (uint64_t) ts.tv_nsec;
+#else
+    return (uint64_t) (((double) clock ()) * 1e9 / (double) CLOCKS_PER_SEC);
+#endif
+}
+
+void
+internal_exr_stats_add_decode (
+    exr_const_context_t          ctxt,
+    exr_compression_t            comptype,
+    const exr_decode_pipeline_t* decode,
+    int                          decompressed,
+    uint64_t                     read_ns,
+    uint64_t                     decompress_ns,
+    uint64_t                     unpack_ns)
+{
+    struct _internal_exr_pipeline_stats* stats = ctxt->pipeline_stats;
+    stats_counter_t*                     t     = stats->totals;
+
+    stats_add (t + STAT_DECODE_CHUNKS, 1);
+    stats_add (t + STAT_READ_NS, read_ns);
+    stats_add (
+        t + STAT_READ_BYTES,
+        decode->chunk.packed_size + decode->chunk.sample_count_table_size);
+    stats_add (t + STAT_UNPACK_NS, unpack_ns);
+
+    if (decompressed)
+    {
+        stats_add (t + STAT_DECOMPRESS_NS, decompress_ns);
+        stats_add (t + STAT_DECOMPRESS_BYTES, decode->chunk.unpacked_size);
+
+        if ((int) comptype >= 0 && comptype < EXR_COMPRESSION_LAST_TYPE)
+        {
+            stats_counter_t* c = stats->per_compression[comptype];
+
+            stats_add (c + COMP_STAT_DECOMPRESS_CHUNKS, 1);
+            stats_add (c + COMP_STAT_DECOMPRESS_NS, decompress_ns);
+            stats_add (
+                c + COMP_STAT_DECOMPRESS_IN_BYTES, decode->chunk.packed_size);
+            stats_add (
+                c + COMP_STAT_DECOMPRESS_OUT_BYTES,
+                decode->chunk.unpacked_size);
+        }
+    }
+}
+
+void
+internal_exr_stats_add_encode (
+    exr_const_context_t          ctxt,
+    exr_compression_t            comptype,
+    const exr_encode_pipeline_t* encode,
+    int                          compressed,
+    uint64_t                     write_bytes,
+    uint64_t                     pack_ns,
+    uint64_t                     compress_ns,
+    uint64_t                     write_ns)
+{
+    struct _internal_exr_pipeline_stats* stats = ctxt->pipeline_stats;
+    stats_counter_t*                     t     = stats->totals;
+
+    stats_add (t + STAT_ENCODE_CHUNKS, 1);
+    stats_add (t + STAT_PACK_NS, pack_ns);
+    stats_add (t + STAT_PACKED_BYTES, encode->packed_bytes);
+    stats_add (t + STAT_WRITE_NS, write_ns);
+    stats_add (t + STAT_WRITE_BYTES, write_bytes);
+
+    if (compressed)
+    {
+        stats_add (t + STAT_COMPRESS_NS, compress_ns);
+        stats_add (t + STAT_COMPRESSED_BYTES, encode->compressed_bytes);
+
+        if ((int) comptype >= 0 && comptype < EXR_COMPRESSION_LAST_TYPE)
+        {
+            stats_counter_t* c = stats->per_compression[comptype];
+
+            stats_add (c + COMP_STAT_COMPRESS_CHUNKS, 1);
+            stats_add (c + COMP_STAT_COMPRESS_NS, compress_ns);
+            stats_add (c + COMP_STAT_COMPRESS_IN_BYTES, encode->packed_bytes);
+            stats_add (
+                c + COMP_STAT_COMPRESS_OUT_BYTES, encode->compressed_bytes);
+        }
+    }
+}
+
+static void
+stats_clear_all (struct _internal_exr_pipeline_stats* stats)
+{
+    for (int i = 0; i < STAT_COUNT; ++i)
+        stats_clear (stats->totals + i);
+    for (int c = 0; c < EXR_COMPRESSION_LAST_TYPE; ++c)
+        for (int i = 0; i < COMP_STAT_COUNT; ++i)
+            stats_clear (stats->per_compression[c] + i);
+}
+
+exr_result_t
+exr_set_pipeline_stats (exr_context_t ctxt, int onoff)
+{
+    exr_result_t rv = EXR_ERR_SUCCESS;
+
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+
+    internal_exr_lock (ctxt);
+    if (onoff && !ctxt->pipeline_stats)
+    {
+        ctxt->pipeline_stats =
+            ctxt->alloc_fn (sizeof (struct _internal_exr_pipeline_stats));
+        if (ctxt->pipeline_stats)
+            stats_clear_all (ctxt->pipeline_stats);
+        else
+            rv = ctxt->standard_error (ctxt, EXR_ERR_OUT_OF_MEMORY);
+    }
+    if (rv == EXR_ERR_SUCCESS) ctxt->collect_stats = onoff ? 1 : 0;
+    internal_exr_unlock (ctxt);
+    return rv;
+}
+
+exr_result_t
+exr_get_pipeline_stats (exr_const_context_t ctxt, exr_pipeline_stats_t* stats)
+{
+    const stats_counter_t* t;
+
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+    if (!stats) return ctxt->standard_error (ctxt, EXR_ERR_INVALID_ARGUMENT);
+
+    memset (stats, 0, sizeof (exr_pipeline_stats_t));
+    if (!ctxt->pipeline_stats) return EXR_ERR_SUCCESS;
+
+    t                       = ctxt->pipeline_stats->totals;
+    stats->decode_chunks    = stats_load (t + STAT_DECODE_CHUNKS);
+    stats->read_ns          = stats_load (t + STAT_READ_NS);
+    stats->read_bytes       = stats_load (t + STAT_READ_BYTES);
+    stats->decompress_ns    = stats_load (t + STAT_DECOMPRESS_NS);
+    stats->decompress_bytes = stats_load (t + STAT_DECOMPRESS_BYTES);
+    stats->unpack_ns        = stats_load (t + STAT_UNPACK_NS);
+    stats->encode_chunks    = stats_load (t + STAT_ENCODE_CHUNKS);
+    stats->pack_ns          = stats_load (t + STAT_PACK_NS);
+    stats->packed_bytes     = stats_load (t + STAT_PACKED_BYTES);
+    stats->compress_ns      = stats_load (t + STAT_COMPRESS_NS);
+    stats->compressed_bytes = stats_load (t + STAT_COMPRESSED_BYTES);
+    stats->write_ns         = stats_load (t + STAT_WRITE_NS);
+    stats->write_bytes      = stats_load (t + STAT_WRITE_BYTES);
+    return EXR_ERR_SUCCESS;
+}
+
+exr_result_t
+exr_get_pipeline_compression_stats (
+    exr_const_context_t      ctxt,
+    exr_compression_t        comptype,
+    exr_compression_stats_t* stats)
+{
+    const stats_counter_t* c;
+
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+    if (!stats) return ctxt->standard_error (ctxt, EXR_ERR_INVALID_ARGUMENT);
+    if ((int) comptype < 0 || comptype >= EXR_COMPRESSION_LAST_TYPE)
+        return ctxt->print_error (
+            ctxt,
+            EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+            "Invalid compression type %d",
+            (int) comptype);
+
+    memset (stats, 0, sizeof (exr_compression_stats_t));
+    if (!ctxt->pipeline_stats) return EXR_ERR_SUCCESS;
+
+    c = ctxt->pipeline_stats->per_compression[comptype];
+    stats->decompress_chunks = stats_load (c + COMP_STAT_DECOMPRESS_CHUNKS);
+    stats->decompress_ns     = stats_load (c + COMP_STAT_DECOMPRESS_NS);
+    stats->decompress_in_bytes =
+        stats_load (c + COMP_STAT_DECOMPRESS_IN_BYTES);
+    stats->decompress_out_bytes =
+        stats_load (c + COMP_STAT_DECOMPRESS_OUT_BYTES);
+    stats->compress_chunks    = stats_load (c + COMP_STAT_COMPRESS_CHUNKS);
+    stats->compress_ns        = stats_load (c + COMP_STAT_COMPRESS_NS);
+    stats->compress_in_bytes  = stats_load (c + COMP_STAT_COMPRESS_IN_BYTES);
+    stats->compress_out_bytes = stats_load (c + COMP_STAT_COMPRESS_OUT_BYTES);
+    return EXR_ERR_SUCCESS;
+}
+
+exr_result_t
+exr_reset_pipeline_stats (exr_context_t ctxt)
+{
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+
+    if (ctxt->pipeline_stats) stats_clear_all (ctxt->pipeline_stats);
+    return EXR_ERR_SUCCESS;
+}
@@ -85,29 +85,144 @@ exr_compress_max_buffer_size (size_t in_bytes)
 
 /**************************************/
 
-exr_result_t
-exr_compress_buffer (
-    exr_const_context_t ctxt,
-    int                 level,
-    const void*         in,
-    size_t              in_bytes,
-    void*               out,
-    size_t              out_bytes_avail,
-    size_t*             actual_out)
+/* libdeflate compressor / decompressor objects are large and expensive
+ * to set up, and ZIPS chunks are a single scanline, so a context keeps
+ * the idle ones for reuse. They are allocated through the context's
+ * alloc_fn / free_fn like everything else it owns, and freed with it.
+ * The free list is only touched under the context lock; the deflate work
+ * itself runs unlocked, so the pool grows to the peak number of threads
+ * coding at once.
+ */
+struct _internal_exr_deflate_state
 {
-    struct libdeflate_compressor* comp;
+    struct _internal_exr_deflate_state* next;
+    /* compression level, or -1 for a decompressor */
+    int   level;
+    void* state;
+};
 
+#define EXR_DEFLATE_DECOMPRESSOR -1
+
+static struct _internal_exr_deflate_state*
+acquire_deflate_state (exr_const_context_t ctxt, int level)
+{
+    struct _internal_exr_deflate_state*  cur = NULL;
+    struct _internal_exr_deflate_state** prev;
+    exr_context_t nonc = EXR_CONST_CAST (exr_context_t, ctxt);
 #ifdef EXR_USE_CONFIG_DEFLATE_STRUCT
     struct libdeflate_options opt = {
         .sizeof_options = sizeof (struct libdeflate_options),
         .malloc_func    = ctxt ? ctxt->alloc_fn : internal_exr_alloc,
         .free_func      = ctxt ? ctxt->free_fn : internal_exr_free};
+#endif
 
+    if (ctxt)
+    {
+        internal_exr_lock (ctxt);
+        for (prev = &(nonc->deflate_cache); *prev; prev = &((*prev)->next))
+        {
+            if ((*prev)->level == level)
+            {
+                cur   = *prev;
+                *prev = cur->next;
+                break;
+            }
+        }
+        internal_exr_unlock (ctxt);
+        if (cur) return cur;
+    }
+
+    cur = (ctxt ? ctxt->alloc_fn : internal_exr_alloc) (
+        sizeof (struct _internal_exr_deflate_state));
+    if (!cur) return NULL;
+    cur->next  = NULL;
+    cur->level = level;
+
+#ifdef EXR_USE_CONFIG_DEFLATE_STRUCT
+    if (level == EXR_DEFLATE_DECOMPRESSOR)
+        cur->state = libdeflate_alloc_decompressor_ex (&opt);
+    else
+        cur->state = libdeflate_alloc_compressor_ex (level, &opt);
 #else
     libdeflate_set_memory_allocator (
         ctxt ? ctxt->alloc_fn : internal_exr_alloc,
         ctxt ? ctxt->free_fn : internal_exr_free);
+    if (level == EXR_DEFLATE_DECOMPRESSOR)
+        cur->state = libdeflate_alloc_decompressor ();
+    else
+        cur->state = libdeflate_alloc_compressor (level);
+#endif
+
+    if (!cur->state)
+    {
+        (ctxt ? ctxt->free_fn : internal_exr_free) (cur);
+        return NULL;
+    }
+    return cur;
+}
+
+static void
+free_deflate_state (
+    exr_const_context_t ctxt, struct _internal_exr_deflate_state* st)
+{
+#ifndef EXR_USE_CONFIG_DEFLATE_STRUCT
+    libdeflate_set_memory_allocator (
+        ctxt ? ctxt->alloc_fn : internal_exr_alloc,
+        ctxt ? ctxt->free_fn : internal_exr_free);
 #endif
+    if (st->level == EXR_DEFLATE_DECOMPRESSOR)
+        libdeflate_free_decompressor (st->state);
+    else
+        libdeflate_free_compressor (st->state);
+    (ctxt ? ctxt->free_fn : internal_exr_free) (st);
+}
+
+static void
+release_deflate_state (
+    exr_const_context_t ctxt, struct _internal_exr_deflate_state* st)
+{
+    exr_context_t nonc = EXR_CONST_CAST (exr_context_t, ctxt);
+
+    if (!ctxt)
+    {
+        free_deflate_state (ctxt, st);
+        return;
+    }
+
+    internal_exr_lock (ctxt);
+    st->next            = nonc->deflate_cache;
+    nonc->deflate_cache = st;
+    internal_exr_unlock (ctxt);
+}
+
+void
+internal_exr_destroy_deflate_cache (exr_context_t ctxt)
+{
+    struct _internal_exr_deflate_state* cur = ctxt->deflate_cache;
+
+    ctxt->deflate_cache = NULL;
+    while (cur)
+    {
+        struct _internal_exr_deflate_state* next = cur->next;
+        free_deflate_state (ctxt, cur);
+        cur = next;
+    }
+}
+
+/**************************************/
+
+exr_result_t
+exr_compress_buffer (
+    exr_const_context_t ctxt,
+    int                 level,
+    const void*         in,
+    size_t              in_bytes,
+    void*               out,
+    size_t              out_bytes_avail,
+    size_t*             actual_out)
+{
+    struct _internal_exr_deflate_state* comp;
+    size_t                              outsz;
 
     if (level < 0)
     {
@@ -116,25 +231,18 @@ exr_compress_buffer (
         if (level < 0) level = EXR_DEFAULT_ZLIB_COMPRESS_LEVEL;
     }
 
-#ifdef EXR_USE_CONFIG_DEFLATE_STRUCT
-    comp = libdeflate_alloc_compressor_ex (level, &opt);
-#else
-    comp = libdeflate_alloc_compressor (level);
-#endif
-    if (comp)
-    {
-        size_t outsz;
-        outsz =
-            libdeflate_zlib_compress (comp, in, in_bytes, out, out_bytes_avail);
+    comp = acquire_deflate_state (ctxt, level);
+    if (!comp) return EXR_ERR_OUT_OF_MEMORY;
 
-        libdeflate_free_compressor (comp);
+    outsz = libdeflate_zlib_compress (
+        comp->state, in, in_bytes, out, out_bytes_avail);
 
-        if (outsz != 0)
-        {
-            if (actual_out) *actual_out = outsz;
-            return EXR_ERR_SUCCESS;
-        }
-        return EXR_ERR_OUT_OF_MEMORY;
+    release_deflate_state (ctxt, comp);
+
+    if (outsz != 0)
+    {
+        if (actual_out) *actual_out = outsz;
+        return EXR_ERR_SUCCESS;
     }
     return EXR_ERR_OUT_OF_MEMORY;
 }
@@ -150,15 +258,9 @@ exr_uncompress_buffer (
     size_t              out_bytes_avail,
     size_t*             actual_out)
 {
-    struct libdeflate_decompressor* decomp;
-    enum libdeflate_result          res;
-    size_t                          actual_in_bytes;
-#ifdef EXR_USE_CONFIG_DEFLATE_STRUCT
-    struct libdeflate_options opt = {
-        .sizeof_options = sizeof (struct libdeflate_options),
-        .malloc_func    = ctxt ? ctxt->alloc_fn : internal_exr_alloc,
-        .free_func      = ctxt ? ctxt->free_fn : internal_exr_free};
-#endif
+    struct _internal_exr_deflate_state* decomp;
+    enum libdeflate_result              res;
+    size_t                              actual_in_bytes;
 
 //    if (in_bytes == out_bytes_avail)
 //    {
@@ -169,44 +271,35 @@ exr_uncompress_buffer (
 //        return EXR_ERR_SUCCESS;
 //    }
 
-#ifdef EXR_USE_CONFIG_DEFLATE_STRUCT
-    decomp = libdeflate_alloc_decompressor_ex (&opt);
-#else
-    libdeflate_set_memory_allocator (
-        ctxt ? ctxt->alloc_fn : internal_exr_alloc,
-        ctxt ? ctxt->free_fn : internal_exr_free);
-    decomp = libdeflate_alloc_decompressor ();
-#endif
-    if (decomp)
+    decomp = acquire_deflate_state (ctxt, EXR_DEFLATE_DECOMPRESSOR);
+    if (!decomp) return EXR_ERR_OUT_OF_MEMORY;
+
+    res = libdeflate_zlib_decompress_ex (
+        decomp->state,
+        in,
+        in_bytes,
+        out,
+        out_bytes_avail,
+        &actual_in_bytes,
+        actual_out);
+
+    release_deflate_state (ctxt, decomp);
+
+    if (res == LIBDEFLATE_SUCCESS)
     {
-        res = libdeflate_zlib_decompress_ex (
-            decomp,
-            in,
-            in_bytes,
-            out,
-            out_bytes_avail,
-            &actual_in_bytes,
-            actual_out);
-
-        libdeflate_free_decompressor (decomp);
-
-        if (res == LIBDEFLATE_SUCCESS)
-        {
-            if (in_bytes == actual_in_bytes) return EXR_ERR_SUCCESS;
-            /* it's an error to not consume the full buffer, right? */
-        }
-        else if (res == LIBDEFLATE_INSUFFICIENT_SPACE)
-        {
-            return EXR_ERR_OUT_OF_MEMORY;
-        }
-        else if (res == LIBDEFLATE_SHORT_OUTPUT)
-        {
-            /* TODO: is this an error? */
-            return EXR_ERR_SUCCESS;
-        }
-        return EXR_ERR_CORRUPT_CHUNK;
+        if (in_bytes == actual_in_bytes) return EXR_ERR_SUCCESS;
+        /* it's an error to not consume the full buffer, right? */
     }
-    return EXR_ERR_OUT_OF_MEMORY;
+    else if (res == LIBDEFLATE_INSUFFICIENT_SPACE)
+    {
+        return EXR_ERR_OUT_OF_MEMORY;
+    }
+    else if (res == LIBDEFLATE_SHORT_OUTPUT)
+    {
+        /* TODO: is this an error? */
+        return EXR_ERR_SUCCESS;
+    }
+    return EXR_ERR_CORRUPT_CHUNK;
 }
 
 /**************************************/
@@ -107,6 +107,39 @@ process_query_size (exr_context_t ctxt, exr_context_initializer_t* inits)
 
 /**************************************/
 
+/* exr_start_read_memory: the file is the mapping, which the decode
+ * pipeline borrows chunks from, and header reads copy out of it */
+static int64_t
+memory_read_func (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    void*                       buffer,
+    uint64_t                    sz,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb)
+{
+    uint64_t avail;
+
+    (void) userdata;
+    (void) error_cb;
+
+    /* short reads past the end, the same as pread */
+    if (offset >= ctxt->mapped_size) return 0;
+    avail = ctxt->mapped_size - offset;
+    if (sz < avail) avail = sz;
+    memcpy (buffer, ctxt->mapped_data + offset, (size_t) avail);
+    return (int64_t) avail;
+}
+
+static int64_t
+memory_query_size_func (exr_const_context_t ctxt, void* userdata)
+{
+    (void) userdata;
+    return (int64_t) ctxt->mapped_size;
+}
+
+/**************************************/
+
 static inline exr_context_initializer_t
 fill_context_data (const exr_context_initializer_t* ctxtdata)
 {
@@ -134,6 +167,18 @@ fill_context_data (const exr_context_initializer_t* ctxtdata)
         {
             inits.flags = ctxtdata->flags;
         }
+        if (ctxtdata->size >= sizeof (struct _exr_context_initializer_v4))
+        {
+            inits.read_vector_fn = ctxtdata->read_vector_fn;
+        }
+        if (ctxtdata->size >= sizeof (struct _exr_context_initializer_v5))
+        {
+            inits.htj2k_block_width       = ctxtdata->htj2k_block_width;
+            inits.htj2k_block_height      = ctxtdata->htj2k_block_height;
+            inits.htj2k_levels            = ctxtdata->htj2k_levels;
+            inits.htj2k_progression       = ctxtdata->htj2k_progression;
+            inits.htj2k_quantization_step = ctxtdata->htj2k_quantization_step;
+        }
     }
 
     internal_exr_update_default_handlers (&inits);
@@ -224,20 +269,21 @@ exr_finish (exr_context_t* pctxt)
 
 /**************************************/
 
-exr_result_t
-exr_start_read (
-    exr_context_t*                   ctxt,
-    const char*                      filename,
-    const exr_context_initializer_t* ctxtdata)
+static exr_result_t
+start_read (
+    exr_context_t*             ctxt,
+    const char*                filename,
+    const uint8_t*             data,
+    uint64_t                   size,
+    exr_context_initializer_t* inits)
 {
-    exr_result_t              rv    = EXR_ERR_UNKNOWN;
-    exr_context_t             ret   = NULL;
-    exr_context_initializer_t inits = fill_context_data (ctxtdata);
+    exr_result_t  rv  = EXR_ERR_UNKNOWN;
+    exr_context_t ret = NULL;
 
     if (!ctxt)
     {
-        if (!(inits.flags & EXR_CONTEXT_FLAG_SILENT_HEADER_PARSE))
-            inits.error_handler_fn (
+        if (!(inits->flags & EXR_CONTEXT_FLAG_SILENT_HEADER_PARSE))
+            inits->error_handler_fn (
                 NULL,
                 EXR_ERR_INVALID_ARGUMENT,
                 "Invalid context handle passed to start_read function");
@@ -248,7 +294,7 @@ exr_start_read (
     {
         rv = internal_exr_alloc_context (
             &ret,
-            &inits,
+            inits,
             EXR_CONTEXT_READ,
             sizeof (struct _internal_exr_filehandle));
         if (rv == EXR_ERR_SUCCESS)
@@ -259,14 +305,19 @@ exr_start_read (
                 (exr_context_t) ret, &(ret->filename), filename);
             if (rv == EXR_ERR_SUCCESS)
             {
-                if (!inits.read_fn)
+                if (data)
                 {
-                    inits.size_fn = &default_query_size_func;
-                    rv            = default_init_read_file (ret);
+                    ret->mapped_data = data;
+                    ret->mapped_size = size;
+                }
+                else if (!inits->read_fn)
+                {
+                    inits->size_fn = &default_query_size_func;
+                    rv             = default_init_read_file (ret);
                 }
 
                 if (rv == EXR_ERR_SUCCESS)
-                    rv = process_query_size (ret, &inits);
+                    rv = process_query_size (ret, inits);
                 if (rv == EXR_ERR_SUCCESS) rv = internal_exr_parse_header (ret);
             }
 
@@ -277,8 +328,8 @@ exr_start_read (
     }
     else
     {
-        if (!(inits.flags & EXR_CONTEXT_FLAG_SILENT_HEADER_PARSE))
-            inits.error_handler_fn (
+        if (!(inits->flags & EXR_CONTEXT_FLAG_SILENT_HEADER_PARSE))
+            inits->error_handler_fn (
                 NULL,
                 EXR_ERR_INVALID_ARGUMENT,
                 "Invalid filename passed to start_read function");
@@ -289,6 +340,47 @@ exr_start_read (
     return rv;
 }
 
+exr_result_t
+exr_start_read (
+    exr_context_t*                   ctxt,
+    const char*                      filename,
+    const exr_context_initializer_t* ctxtdata)
+{
+    exr_context_initializer_t inits = fill_context_data (ctxtdata);
+
+    return start_read (ctxt, filename, NULL, 0, &inits);
+}
+
+/**************************************/
+
+exr_result_t
+exr_start_read_memory (
+    exr_context_t*                   ctxt,
+    const char*                      filename,
+    const void*                      data,
+    uint64_t                         size,
+    const exr_context_initializer_t* ctxtdata)
+{
+    exr_context_initializer_t inits = fill_context_data (ctxtdata);
+
+    if (!data || size == 0)
+    {
+        if (!(inits.flags & EXR_CONTEXT_FLAG_SILENT_HEADER_PARSE))
+            inits.error_handler_fn (
+                NULL,
+                EXR_ERR_INVALID_ARGUMENT,
+                "Invalid memory passed to start_read_memory function");
+        if (ctxt) *ctxt = NULL;
+        return EXR_ERR_INVALID_ARGUMENT;
+    }
+
+    inits.read_fn        = &memory_read_func;
+    inits.read_vector_fn = NULL;
+    inits.size_fn        = &memory_query_size_func;
+    inits.flags &= ~EXR_CONTEXT_FLAG_MEMORY_MAP_FILE;
+    return start_read (ctxt, filename, (const uint8_t*) data, size, &inits);
+}
+
 /**************************************/
 
 exr_result_t
@@ -465,6 +557,61 @@ exr_get_user_data (exr_const_context_t ctxt, void** userdata)
 
 /**************************************/
 
+exr_result_t
+exr_set_read_queue_depth (exr_context_t ctxt, int depth)
+{
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+    if (ctxt->mode != EXR_CONTEXT_READ)
+        return ctxt->standard_error (ctxt, EXR_ERR_NOT_OPEN_READ);
+    if (depth < 0 || depth > EXR_MAX_READ_QUEUE_DEPTH)
+        return ctxt->print_error (
+            ctxt,
+            EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+            "Invalid read queue depth %d (max %d)",
+            depth,
+            EXR_MAX_READ_QUEUE_DEPTH);
+
+    ctxt->read_queue_depth = depth;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+exr_set_chunk_reconstruct_threads (exr_context_t ctxt, int nthreads)
+{
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+    if (ctxt->mode != EXR_CONTEXT_READ)
+        return ctxt->standard_error (ctxt, EXR_ERR_NOT_OPEN_READ);
+    if (nthreads < 0 || nthreads > EXR_MAX_RECONSTRUCT_THREADS)
+        return ctxt->print_error (
+            ctxt,
+            EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+            "Invalid chunk table reconstruction thread count %d (max %d)",
+            nthreads,
+            EXR_MAX_RECONSTRUCT_THREADS);
+
+    ctxt->reconstruct_threads = nthreads;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+exr_set_chunk_index_sidecar (exr_context_t ctxt, const char* filename)
+{
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+    if (ctxt->mode != EXR_CONTEXT_READ)
+        return ctxt->standard_error (ctxt, EXR_ERR_NOT_OPEN_READ);
+
+    exr_attr_string_destroy (ctxt, &(ctxt->chunk_index_filename));
+    if (!filename || filename[0] == '\0') return EXR_ERR_SUCCESS;
+    return exr_attr_string_create (
+        ctxt, &(ctxt->chunk_index_filename), filename);
+}
+
+/**************************************/
+
 exr_result_t
 exr_register_attr_type_handler (
     exr_context_t ctxt,
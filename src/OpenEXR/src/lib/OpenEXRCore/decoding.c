@@ -83,6 +83,18 @@ update_pack_unpack_ptrs (exr_decode_pipeline_t* decode)
     return rv;
 }
 
+/* The chunk bytes in the file mapping, or NULL when the file is not
+ * mapped or the range is not fully inside it (such as truncated files)
+ */
+static inline const uint8_t*
+mapped_chunk_data (exr_const_context_t ctxt, uint64_t offset, uint64_t size)
+{
+    if (!ctxt->mapped_data || offset > ctxt->mapped_size ||
+        size > ctxt->mapped_size - offset)
+        return NULL;
+    return ctxt->mapped_data + offset;
+}
+
 static exr_result_t
 read_uncompressed_direct (exr_decode_pipeline_t* decode)
 {
@@ -90,6 +102,7 @@ read_uncompressed_direct (exr_decode_pipeline_t* decode)
     int                 height, start_y;
     uint64_t            dataoffset, toread;
     uint8_t*            cdata;
+    const uint8_t*      mapped;
     exr_const_context_t ctxt = decode->context;
 
     if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
@@ -128,9 +141,18 @@ read_uncompressed_direct (exr_decode_pipeline_t* decode)
             else { cdata += (uint64_t) y * (uint64_t) decc->user_line_stride; }
 
             /* actual read into the output pointer */
-            rv = ctxt->do_read (
-                ctxt, cdata, toread, &dataoffset, NULL, EXR_MUST_READ_ALL);
-            if (rv != EXR_ERR_SUCCESS) return rv;
+            mapped = mapped_chunk_data (ctxt, dataoffset, toread);
+            if (mapped)
+            {
+                memcpy (cdata, mapped, toread);
+                dataoffset += toread;
+            }
+            else
+            {
+                rv = ctxt->do_read (
+                    ctxt, cdata, toread, &dataoffset, NULL, EXR_MUST_READ_ALL);
+                if (rv != EXR_ERR_SUCCESS) return rv;
+            }
 
             // need to swab them to native
             if (decc->bytes_per_element == 2)
@@ -195,6 +217,23 @@ default_read_chunk (exr_decode_pipeline_t* decode)
     }
     else if (decode->chunk.packed_size > 0)
     {
+        const uint8_t* mapped = mapped_chunk_data (
+            ctxt, decode->chunk.data_offset, decode->chunk.packed_size);
+        if (mapped)
+        {
+            /* Borrow the chunk from the mapping: a zero alloc size marks
+             * the buffer as not owned, so it is never freed. When the
+             * chunk is uncompressed it also becomes the unpacked buffer.
+             */
+            internal_decode_free_buffer (
+                decode,
+                EXR_TRANSCODE_BUFFER_PACKED,
+                &(decode->packed_buffer),
+                &(decode->packed_alloc_size));
+            decode->packed_buffer = EXR_CONST_CAST (void*, mapped);
+            return EXR_ERR_SUCCESS;
+        }
+
         rv = internal_decode_alloc_buffer (
             decode,
             EXR_TRANSCODE_BUFFER_PACKED,
@@ -544,6 +583,8 @@ exr_decoding_run (
 {
     exr_result_t rv;
     exr_const_priv_part_t part;
+    int                   timed;
+    uint64_t              tstart = 0, tread = 0, tdecomp = 0;
 
     if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
     if (part_index < 0 || part_index >= ctxt->num_parts)
@@ -564,10 +605,15 @@ exr_decoding_run (
             ctxt,
             EXR_ERR_INVALID_ARGUMENT,
             "Decode pipeline has no read_fn declared");
+
+    timed = ctxt->collect_stats;
+    if (timed) tstart = internal_exr_stats_clock ();
+
     rv = decode->read_fn (decode);
     if (rv != EXR_ERR_SUCCESS)
         return ctxt->report_error (
             ctxt, rv, "Unable to read pixel data block from context");
+    if (timed) tread = internal_exr_stats_clock ();
 
     if (rv == EXR_ERR_SUCCESS) rv = update_pack_unpack_ptrs (decode);
     if (rv != EXR_ERR_SUCCESS)
@@ -581,6 +627,7 @@ exr_decoding_run (
     if (rv != EXR_ERR_SUCCESS)
         return ctxt->report_error (
             ctxt, rv, "Decode pipeline unable to decompress data");
+    if (timed) tdecomp = internal_exr_stats_clock ();
 
     if (rv == EXR_ERR_SUCCESS &&
         (part->storage_mode == EXR_STORAGE_DEEP_SCANLINE ||
@@ -643,7 +690,19 @@ exr_decoding_run (
 
         rv = unpack_sample_table (ctxt, decode);
 
-        if ((decode->decode_flags & EXR_DECODE_SAMPLE_DATA_ONLY)) return rv;
+        if ((decode->decode_flags & EXR_DECODE_SAMPLE_DATA_ONLY))
+        {
+            if (timed && rv == EXR_ERR_SUCCESS)
+                internal_exr_stats_add_decode (
+                    ctxt,
+                    part->comp_type,
+                    decode,
+                    decode->decompress_fn != NULL,
+                    tread - tstart,
+                    tdecomp - tread,
+                    internal_exr_stats_clock () - tdecomp);
+            return rv;
+        }
 
         if (rv != EXR_ERR_SUCCESS)
             return ctxt->report_error (
@@ -667,6 +726,16 @@ exr_decoding_run (
                 ctxt, rv, "Decode pipeline unable to unpack and convert data");
     }
 
+    if (timed)
+        internal_exr_stats_add_decode (
+            ctxt,
+            part->comp_type,
+            decode,
+            decode->decompress_fn != NULL,
+            tread - tstart,
+            tdecomp - tread,
+            internal_exr_stats_clock () - tdecomp);
+
     return rv;
 }
 
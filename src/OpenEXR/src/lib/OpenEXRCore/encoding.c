@@ -12,6 +12,8 @@
 
 #include "openexr_compression.h"
 
+#include <string.h>
+
 /**************************************/
 
 static exr_result_t
@@ -29,63 +31,63 @@ default_yield (exr_encode_pipeline_t* encode)
 /**************************************/
 
 static exr_result_t
-default_write_chunk (exr_encode_pipeline_t* encode)
+write_chunk_data (
+    exr_context_t           ctxt,
+    int                     part_index,
+    const exr_chunk_info_t* cinfo,
+    const void*             packed_data,
+    uint64_t                packed_size,
+    uint64_t                unpacked_size,
+    const void*             sample_data,
+    uint64_t                sample_data_size)
 {
     exr_result_t rv;
 
-    if (!encode) return EXR_ERR_INVALID_ARGUMENT;
-
-    switch (encode->chunk.type)
+    switch (cinfo->type)
     {
         case EXR_STORAGE_SCANLINE:
             rv = exr_write_scanline_chunk (
-                EXR_CONST_CAST (exr_context_t, encode->context),
-                encode->part_index,
-                encode->chunk.start_y,
-                encode->compressed_buffer,
-                encode->compressed_bytes);
+                ctxt, part_index, cinfo->start_y, packed_data, packed_size);
             break;
         case EXR_STORAGE_TILED:
             rv = exr_write_tile_chunk (
-                EXR_CONST_CAST (exr_context_t, encode->context),
-                encode->part_index,
-                encode->chunk.start_x,
-                encode->chunk.start_y,
-                encode->chunk.level_x,
-                encode->chunk.level_y,
-                encode->compressed_buffer,
-                encode->compressed_bytes);
+                ctxt,
+                part_index,
+                cinfo->start_x,
+                cinfo->start_y,
+                cinfo->level_x,
+                cinfo->level_y,
+                packed_data,
+                packed_size);
             break;
         case EXR_STORAGE_DEEP_SCANLINE:
-            if (!encode->packed_sample_count_table ||
-                encode->packed_sample_count_bytes == 0)
+            if (!sample_data || sample_data_size == 0)
                 return EXR_ERR_INVALID_ARGUMENT;
             rv = exr_write_deep_scanline_chunk (
-                EXR_CONST_CAST (exr_context_t, encode->context),
-                encode->part_index,
-                encode->chunk.start_y,
-                encode->compressed_buffer,
-                encode->compressed_bytes,
-                encode->packed_bytes,
-                encode->packed_sample_count_table,
-                encode->packed_sample_count_bytes);
+                ctxt,
+                part_index,
+                cinfo->start_y,
+                packed_data,
+                packed_size,
+                unpacked_size,
+                sample_data,
+                sample_data_size);
             break;
         case EXR_STORAGE_DEEP_TILED:
-            if (!encode->packed_sample_count_table ||
-                encode->packed_sample_count_bytes == 0)
+            if (!sample_data || sample_data_size == 0)
                 return EXR_ERR_INVALID_ARGUMENT;
             rv = exr_write_deep_tile_chunk (
-                EXR_CONST_CAST (exr_context_t, encode->context),
-                encode->part_index,
-                encode->chunk.start_x,
-                encode->chunk.start_y,
-                encode->chunk.level_x,
-                encode->chunk.level_y,
-                encode->compressed_buffer,
-                encode->compressed_bytes,
-                encode->packed_bytes,
-                encode->packed_sample_count_table,
-                encode->packed_sample_count_bytes);
+                ctxt,
+                part_index,
+                cinfo->start_x,
+                cinfo->start_y,
+                cinfo->level_x,
+                cinfo->level_y,
+                packed_data,
+                packed_size,
+                unpacked_size,
+                sample_data,
+                sample_data_size);
             break;
         case EXR_STORAGE_LAST_TYPE:
         default: rv = EXR_ERR_INVALID_ARGUMENT; break;
@@ -95,6 +97,404 @@ default_write_chunk (exr_encode_pipeline_t* encode)
 
 /**************************************/
 
+static exr_result_t
+default_write_chunk (exr_encode_pipeline_t* encode)
+{
+    if (!encode) return EXR_ERR_INVALID_ARGUMENT;
+
+    return write_chunk_data (
+        EXR_CONST_CAST (exr_context_t, encode->context),
+        encode->part_index,
+        &(encode->chunk),
+        encode->compressed_buffer,
+        encode->compressed_bytes,
+        encode->packed_bytes,
+        encode->packed_sample_count_table,
+        encode->packed_sample_count_bytes);
+}
+
+/**************************************/
+
+/* Chunks of an ordered part have to land in the file in chunk order,
+ * but can be packed and compressed in any order. With a reorder
+ * buffer, a thread whose chunk is next in line writes it straight from
+ * its pipeline; any other chunk is copied into a free slot and the
+ * thread moves on. Whoever writes a chunk then writes any slot that
+ * has become next in line. The regular chunk writers update the output
+ * position of the context without the lock, so only the thread holding
+ * the committing flag may write, or even look at that position, and
+ * the offset table is filled in as usual. When every slot is taken,
+ * threads wait for the committer to free one or for their own chunk
+ * to come up.
+ */
+
+enum _INTERNAL_EXR_PENDING_STATE
+{
+    EXR_PENDING_FREE    = 0,
+    EXR_PENDING_FILLING = 1,
+    EXR_PENDING_WAITING = 2,
+    EXR_PENDING_WRITING = 3
+};
+
+typedef struct _internal_exr_pending_chunk
+{
+    int              state;
+    int              part_index;
+    exr_chunk_info_t chunk;
+
+    void*    data;
+    uint64_t data_bytes;
+    uint64_t unpacked_bytes;
+    size_t   data_alloc_size;
+
+    void*    sample_data;
+    uint64_t sample_data_bytes;
+    size_t   sample_data_alloc_size;
+} internal_exr_pending_chunk_t;
+
+struct _internal_exr_reorder_buffer
+{
+    int                           slot_count;
+    int                           committing;
+    exr_result_t                  failure;
+    internal_exr_pending_chunk_t* slots;
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    CONDITION_VARIABLE slot_freed;
+#    else
+    pthread_cond_t slot_freed;
+#    endif
+#endif
+};
+
+static void
+reorder_wake_all (struct _internal_exr_reorder_buffer* rb)
+{
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    WakeAllConditionVariable (&(rb->slot_freed));
+#    else
+    pthread_cond_broadcast (&(rb->slot_freed));
+#    endif
+#else
+    (void) rb;
+#endif
+}
+
+static int
+is_next_chunk (
+    exr_const_context_t ctxt, int part_index, const exr_chunk_info_t* cinfo)
+{
+    return ctxt->cur_output_part == part_index &&
+           ctxt->last_output_chunk == (cinfo->idx - 1);
+}
+
+static exr_result_t
+copy_to_slot (
+    exr_const_context_t ctxt,
+    void**              buf,
+    size_t*             alloc,
+    const void*         src,
+    uint64_t            bytes)
+{
+    if (bytes == 0) return EXR_ERR_SUCCESS;
+    if (*alloc < bytes)
+    {
+        if (*buf) ctxt->free_fn (*buf);
+        *alloc = 0;
+        *buf   = ctxt->alloc_fn (bytes);
+        if (!*buf) return ctxt->standard_error (ctxt, EXR_ERR_OUT_OF_MEMORY);
+        *alloc = bytes;
+    }
+    memcpy (*buf, src, bytes);
+    return EXR_ERR_SUCCESS;
+}
+
+/* called and returns with the context locked, by the committer */
+static exr_result_t
+commit_pending_chunks (
+    exr_context_t ctxt, struct _internal_exr_reorder_buffer* rb)
+{
+    exr_result_t                  rv = EXR_ERR_SUCCESS;
+    internal_exr_pending_chunk_t* pc;
+    int                           s = 0;
+
+    while (s < rb->slot_count && rb->failure == EXR_ERR_SUCCESS)
+    {
+        pc = rb->slots + s;
+        if (pc->state != EXR_PENDING_WAITING ||
+            !is_next_chunk (ctxt, pc->part_index, &(pc->chunk)))
+        {
+            ++s;
+            continue;
+        }
+
+        pc->state = EXR_PENDING_WRITING;
+        internal_exr_unlock (ctxt);
+        rv = write_chunk_data (
+            ctxt,
+            pc->part_index,
+            &(pc->chunk),
+            pc->data,
+            pc->data_bytes,
+            pc->unpacked_bytes,
+            pc->sample_data,
+            pc->sample_data_bytes);
+        internal_exr_lock (ctxt);
+
+        pc->state = EXR_PENDING_FREE;
+        if (rv != EXR_ERR_SUCCESS) rb->failure = rv;
+        reorder_wake_all (rb);
+        /* the next one may be in any slot */
+        s = 0;
+    }
+    return rv;
+}
+
+#if ILMTHREAD_THREADING_ENABLED
+static void
+reorder_wait (exr_context_t ctxt, struct _internal_exr_reorder_buffer* rb)
+{
+#    ifdef _WIN32
+    SleepConditionVariableCS (&(rb->slot_freed), &(ctxt->mutex), INFINITE);
+#    else
+    pthread_cond_wait (&(rb->slot_freed), &(ctxt->mutex));
+#    endif
+}
+#endif
+
+static exr_result_t
+reorder_write_chunk (exr_encode_pipeline_t* encode)
+{
+    exr_result_t                         rv;
+    exr_context_t                        ctxt;
+    struct _internal_exr_reorder_buffer* rb;
+    internal_exr_pending_chunk_t*        pc = NULL;
+
+    if (!encode) return EXR_ERR_INVALID_ARGUMENT;
+
+    ctxt = EXR_CONST_CAST (exr_context_t, encode->context);
+    rb   = ctxt->reorder;
+    if (!rb ||
+        ctxt->parts[encode->part_index]->lineorder == EXR_LINEORDER_RANDOM_Y)
+        return default_write_chunk (encode);
+
+    internal_exr_lock (ctxt);
+    for (;;)
+    {
+        if (rb->failure != EXR_ERR_SUCCESS)
+        {
+            rv = rb->failure;
+            internal_exr_unlock (ctxt);
+            return rv;
+        }
+
+        if (!rb->committing &&
+            is_next_chunk (ctxt, encode->part_index, &(encode->chunk)))
+            break;
+
+        for (int s = 0; s < rb->slot_count; ++s)
+        {
+            if (rb->slots[s].state == EXR_PENDING_FREE)
+            {
+                pc = rb->slots + s;
+                break;
+            }
+        }
+        if (pc) break;
+
+#if ILMTHREAD_THREADING_ENABLED
+        reorder_wait (ctxt, rb);
+#else
+        internal_exr_unlock (ctxt);
+        return ctxt->print_error (
+            ctxt,
+            EXR_ERR_INCORRECT_CHUNK,
+            "Reorder buffer full (%d chunks) holding chunk %d, but last output chunk is %d",
+            rb->slot_count,
+            encode->chunk.idx,
+            ctxt->last_output_chunk);
+#endif
+    }
+
+    if (!pc)
+    {
+        rb->committing = 1;
+        internal_exr_unlock (ctxt);
+        rv = default_write_chunk (encode);
+        internal_exr_lock (ctxt);
+        if (rv == EXR_ERR_SUCCESS)
+            rv = commit_pending_chunks (ctxt, rb);
+        else
+            rb->failure = rv;
+        rb->committing = 0;
+        /* a waiting thread may hold the chunk that is now next */
+        reorder_wake_all (rb);
+        internal_exr_unlock (ctxt);
+        return rv;
+    }
+
+    pc->state = EXR_PENDING_FILLING;
+    internal_exr_unlock (ctxt);
+
+    pc->part_index        = encode->part_index;
+    pc->chunk             = encode->chunk;
+    pc->data_bytes        = encode->compressed_bytes;
+    pc->unpacked_bytes    = encode->packed_bytes;
+    pc->sample_data_bytes = encode->packed_sample_count_table
+                                ? encode->packed_sample_count_bytes
+                                : 0;
+    rv                    = copy_to_slot (
+        ctxt,
+        &(pc->data),
+        &(pc->data_alloc_size),
+        encode->compressed_buffer,
+        encode->compressed_bytes);
+    if (rv == EXR_ERR_SUCCESS)
+        rv = copy_to_slot (
+            ctxt,
+            &(pc->sample_data),
+            &(pc->sample_data_alloc_size),
+            encode->packed_sample_count_table,
+            pc->sample_data_bytes);
+
+    internal_exr_lock (ctxt);
+    if (rv == EXR_ERR_SUCCESS)
+    {
+        pc->state = EXR_PENDING_WAITING;
+        /*
+         * the chunk before may have been written while copying; if
+         * somebody is committing, they pick this one up before they
+         * let go
+         */
+        if (!rb->committing)
+        {
+            rb->committing = 1;
+            rv             = commit_pending_chunks (ctxt, rb);
+            rb->committing = 0;
+            reorder_wake_all (rb);
+        }
+    }
+    else
+    {
+        /* a lost chunk would leave everyone behind it waiting forever */
+        pc->state   = EXR_PENDING_FREE;
+        rb->failure = rv;
+        reorder_wake_all (rb);
+    }
+    internal_exr_unlock (ctxt);
+    return rv;
+}
+
+/* a chunk that fails before reaching write_fn never arrives, so the
+ * threads holding later chunks have to be told not to wait for it */
+static void
+reorder_fail (exr_context_t ctxt, exr_result_t rv)
+{
+    struct _internal_exr_reorder_buffer* rb;
+
+    internal_exr_lock (ctxt);
+    rb = ctxt->reorder;
+    if (rb)
+    {
+        if (rb->failure == EXR_ERR_SUCCESS) rb->failure = rv;
+        reorder_wake_all (rb);
+    }
+    internal_exr_unlock (ctxt);
+}
+
+/**************************************/
+
+void
+internal_exr_destroy_reorder_buffer (exr_context_t ctxt)
+{
+    struct _internal_exr_reorder_buffer* rb = ctxt->reorder;
+
+    if (!rb) return;
+
+    ctxt->reorder = NULL;
+    for (int s = 0; s < rb->slot_count; ++s)
+    {
+        if (rb->slots[s].data) ctxt->free_fn (rb->slots[s].data);
+        if (rb->slots[s].sample_data) ctxt->free_fn (rb->slots[s].sample_data);
+    }
+#if ILMTHREAD_THREADING_ENABLED && !defined(_WIN32)
+    pthread_cond_destroy (&(rb->slot_freed));
+#endif
+    ctxt->free_fn (rb);
+}
+
+/**************************************/
+
+exr_result_t
+exr_encoding_set_reorder_buffer (exr_context_t ctxt, int max_pending_chunks)
+{
+    struct _internal_exr_reorder_buffer* rb;
+    size_t                               bytes;
+
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+
+    internal_exr_lock (ctxt);
+    if (ctxt->mode != EXR_CONTEXT_WRITE &&
+        ctxt->mode != EXR_CONTEXT_WRITING_DATA)
+        return EXR_UNLOCK_AND_RETURN (
+            ctxt->standard_error (ctxt, EXR_ERR_NOT_OPEN_WRITE));
+
+    if (max_pending_chunks < 0)
+        return EXR_UNLOCK_AND_RETURN (ctxt->print_error (
+            ctxt,
+            EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+            "Invalid reorder buffer size %d",
+            max_pending_chunks));
+
+    rb = ctxt->reorder;
+    if (rb)
+    {
+        for (int s = 0; s < rb->slot_count; ++s)
+        {
+            if (rb->slots[s].state != EXR_PENDING_FREE)
+                return EXR_UNLOCK_AND_RETURN (ctxt->report_error (
+                    ctxt,
+                    EXR_ERR_INVALID_ARGUMENT,
+                    "Unable to change the reorder buffer while chunks are pending"));
+        }
+        internal_exr_destroy_reorder_buffer (ctxt);
+    }
+
+    if (max_pending_chunks == 0)
+        return EXR_UNLOCK_AND_RETURN (EXR_ERR_SUCCESS);
+
+    bytes = sizeof (struct _internal_exr_reorder_buffer) +
+            sizeof (internal_exr_pending_chunk_t) * (size_t) max_pending_chunks;
+    rb = ctxt->alloc_fn (bytes);
+    if (!rb)
+        return EXR_UNLOCK_AND_RETURN (
+            ctxt->standard_error (ctxt, EXR_ERR_OUT_OF_MEMORY));
+    memset (rb, 0, bytes);
+
+    rb->slot_count = max_pending_chunks;
+    rb->failure    = EXR_ERR_SUCCESS;
+    rb->slots      = (internal_exr_pending_chunk_t*) (rb + 1);
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    InitializeConditionVariable (&(rb->slot_freed));
+#    else
+    if (pthread_cond_init (&(rb->slot_freed), NULL) != 0)
+    {
+        ctxt->free_fn (rb);
+        return EXR_UNLOCK_AND_RETURN (ctxt->report_error (
+            ctxt,
+            EXR_ERR_OUT_OF_MEMORY,
+            "Unable to initialize reorder buffer condition variable"));
+    }
+#    endif
+#endif
+    ctxt->reorder = rb;
+    return EXR_UNLOCK_AND_RETURN (EXR_ERR_SUCCESS);
+}
+
+/**************************************/
+
 exr_result_t
 exr_encoding_initialize (
     exr_const_context_t     ctxt,
@@ -165,8 +565,16 @@ exr_encoding_choose_default_routines (
     encode->convert_and_pack_fn = internal_exr_match_encode (encode, isdeep);
     if (part->comp_type != EXR_COMPRESSION_NONE)
         encode->compress_fn = &exr_compress_chunk;
-    encode->yield_until_ready_fn = &default_yield;
-    encode->write_fn             = &default_write_chunk;
+    if (ctxt->reorder)
+    {
+        encode->yield_until_ready_fn = NULL;
+        encode->write_fn             = &reorder_write_chunk;
+    }
+    else
+    {
+        encode->yield_until_ready_fn = &default_yield;
+        encode->write_fn             = &default_write_chunk;
+    }
 
     return EXR_UNLOCK_WRITE_AND_RETURN (EXR_ERR_SUCCESS);
 }
@@ -209,12 +617,15 @@ exr_encoding_update (
 
 /**************************************/
 
-exr_result_t
-exr_encoding_run (
+static exr_result_t
+run_encoding (
     exr_const_context_t ctxt, int part_index, exr_encode_pipeline_t* encode)
 {
     exr_result_t rv           = EXR_ERR_SUCCESS;
     uint64_t     packed_bytes = 0;
+    int          timed        = 0;
+    int          compressed   = 0;
+    uint64_t     tstart = 0, tpack = 0, tcomp = 0, twrite = 0;
     EXR_LOCK_WRITE_AND_DEFINE_PART (part_index);
 
     if (!encode)
@@ -290,6 +701,9 @@ exr_encoding_run (
              (uint64_t) (encc->bytes_per_element));
     }
 
+    timed = ctxt->collect_stats;
+    if (timed) tstart = internal_exr_stats_clock ();
+
     encode->packed_bytes = 0;
     if (encode->convert_and_pack_fn)
     {
@@ -314,6 +728,7 @@ exr_encoding_run (
             "Encode pipeline has no packing function declared and packed buffer is null or appears to need packing"));
     }
     if (ctxt->mode == EXR_CONTEXT_WRITE) internal_exr_unlock (ctxt);
+    if (timed) tpack = internal_exr_stats_clock ();
 
     if ((part->storage_mode == EXR_STORAGE_DEEP_SCANLINE ||
          part->storage_mode == EXR_STORAGE_DEEP_TILED) &&
@@ -328,7 +743,8 @@ exr_encoding_run (
     {
         if (encode->compress_fn && encode->packed_bytes > 0)
         {
-            rv = encode->compress_fn (encode);
+            rv         = encode->compress_fn (encode);
+            compressed = 1;
         }
         else
         {
@@ -356,12 +772,36 @@ exr_encoding_run (
         }
     }
 
+    if (timed) tcomp = internal_exr_stats_clock ();
+
     if (rv == EXR_ERR_SUCCESS && encode->yield_until_ready_fn)
         rv = encode->yield_until_ready_fn (encode);
 
+    /* waiting for the turn of the chunk is not part of the write */
+    if (timed) twrite = internal_exr_stats_clock ();
+
     if (rv == EXR_ERR_SUCCESS && encode->write_fn)
         rv = encode->write_fn (encode);
 
+    if (timed && rv == EXR_ERR_SUCCESS)
+    {
+        uint64_t write_bytes = encode->compressed_bytes;
+
+        if (part->storage_mode == EXR_STORAGE_DEEP_SCANLINE ||
+            part->storage_mode == EXR_STORAGE_DEEP_TILED)
+            write_bytes += encode->packed_sample_count_bytes;
+
+        internal_exr_stats_add_encode (
+            ctxt,
+            part->comp_type,
+            encode,
+            compressed,
+            encode->write_fn ? write_bytes : 0,
+            tpack - tstart,
+            tcomp - tpack,
+            internal_exr_stats_clock () - twrite);
+    }
+
     if ((part->storage_mode == EXR_STORAGE_DEEP_SCANLINE ||
          part->storage_mode == EXR_STORAGE_DEEP_TILED) &&
         encode->sample_count_table != NULL)
@@ -374,6 +814,18 @@ exr_encoding_run (
     return rv;
 }
 
+exr_result_t
+exr_encoding_run (
+    exr_const_context_t ctxt, int part_index, exr_encode_pipeline_t* encode)
+{
+    exr_result_t rv = run_encoding (ctxt, part_index, encode);
+
+    if (rv != EXR_ERR_SUCCESS && encode && encode->context == ctxt &&
+        encode->write_fn == &reorder_write_chunk)
+        reorder_fail (EXR_CONST_CAST (exr_context_t, ctxt), rv);
+    return rv;
+}
+
 /**************************************/
 
 exr_result_t
@@ -109,6 +109,31 @@ exr_result_t internal_decode_alloc_buffer (
 
 /**************************************/
 
+/* pipeline statistics, only called when ctxt->collect_stats is set.
+ * The stage times are in nanoseconds of internal_exr_stats_clock */
+uint64_t internal_exr_stats_clock (void);
+
+void internal_exr_stats_add_decode (
+    exr_const_context_t          ctxt,
+    exr_compression_t            comptype,
+    const exr_decode_pipeline_t* decode,
+    int                          decompressed,
+    uint64_t                     read_ns,
+    uint64_t                     decompress_ns,
+    uint64_t                     unpack_ns);
+
+void internal_exr_stats_add_encode (
+    exr_const_context_t          ctxt,
+    exr_compression_t            comptype,
+    const exr_encode_pipeline_t* encode,
+    int                          compressed,
+    uint64_t                     write_bytes,
+    uint64_t                     pack_ns,
+    uint64_t                     compress_ns,
+    uint64_t                     write_ns);
+
+/**************************************/
+
 static inline float
 half_to_float (uint16_t hv)
 {
@@ -17,6 +17,9 @@ void internal_zip_deconstruct_bytes (
 void internal_zip_reconstruct_bytes (
     uint8_t* out, uint8_t* scratch_source, uint64_t count);
 
+/* frees the libdeflate states cached by a context */
+void internal_exr_destroy_deflate_cache (exr_context_t ctxt);
+
 exr_result_t internal_exr_apply_rle (exr_encode_pipeline_t* encode);
 
 exr_result_t internal_exr_apply_zip (exr_encode_pipeline_t* encode);
@@ -37,6 +40,9 @@ exr_result_t internal_exr_apply_dwab (exr_encode_pipeline_t* encode);
 extern "C" {
 #endif
 exr_result_t internal_exr_apply_ht (exr_encode_pipeline_t* encode);
+
+/* frees the OpenJPH codestreams cached by a context */
+void internal_exr_destroy_ht_cache (exr_context_t ctxt);
 #ifdef __cplusplus
 }
 #endif
@@ -28,4 +28,10 @@
 #define EXR_SHORTNAME_MAXLEN 31
 #define EXR_LONGNAME_MAXLEN 255
 
+/* io_uring caps a ring at 32768 entries, and reads past a few thousand
+ * in flight no longer help */
+#define EXR_MAX_READ_QUEUE_DEPTH 4096
+
+#define EXR_MAX_RECONSTRUCT_THREADS 256
+
 #endif /* OPENEXR_PRIV_CONSTANTS_H */
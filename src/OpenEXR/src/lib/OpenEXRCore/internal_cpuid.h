@@ -125,6 +125,75 @@ check_for_x86_simd (int* f16c, int* avx, int* sse2)
 #endif
 }
 
+/*
+ * AVX2, and the AVX-512 subset used by the wider kernels (F and BW),
+ * are in leaf 7 of cpuid. Both need the AVX checks above to pass, and
+ * AVX-512 additionally that the OS saves the opmask and zmm state.
+ */
+static inline void
+check_for_x86_avx2_avx512 (int* avx2, int* avx512)
+{
+#ifdef __e2k__
+#    if defined(__AVX2__)
+    *avx2 = 1;
+#    else
+    *avx2 = 0;
+#    endif
+#    if defined(__AVX512F__) && defined(__AVX512BW__)
+    *avx512 = 1;
+#    else
+    *avx512 = 0;
+#    endif
+
+#elif OPENEXR_ENABLE_X86_SIMD_CHECK
+    int f16c, avx, sse2;
+#    if defined(_WIN32)
+    int regs[4] = {0};
+#    else
+    unsigned int regs[4] = {0};
+#    endif
+    unsigned int xcr0 = 0;
+
+    *avx2   = 0;
+    *avx512 = 0;
+
+    check_for_x86_simd (&f16c, &avx, &sse2);
+    if (!avx) return;
+
+#    if defined(_WIN32)
+    __cpuid (regs, 0);
+    if (regs[0] < 7) return;
+    __cpuidex (regs, 7, 0);
+#    else
+    if (__get_cpuid_max (0, 0) < 7) return;
+    __cpuid_count (7, 0, regs[0], regs[1], regs[2], regs[3]);
+#    endif
+
+    /* AVX2 is bit 5 of EBX (reg 1), AVX512F bit 16, AVX512BW bit 30 */
+    *avx2 = (regs[1] & (1 << 5)) ? 1 : 0;
+    if (!(regs[1] & (1 << 16)) || !(regs[1] & (1 << 30))) return;
+
+    /* avx being set means we are on x86_64 and xgetbv is usable */
+#    if defined(_MSC_VER)
+#        if defined(OPENEXR_IMF_HAVE_GCC_INLINE_ASM_AVX)
+    xcr0 = (unsigned int) _xgetbv (0);
+#        endif
+#    elif defined(_M_X64) || defined(__x86_64__)
+    __asm__ __volatile__ ("xgetbv"
+                          : /* Output  */ "=a"(xcr0), "=d"(regs[3])
+                          : /* Input   */ "c"(0)
+                          : /* Clobber */);
+#    endif
+    /* eax bit 5 - opmask, bit 6 - upper zmm0-15, bit 7 - zmm16-31 */
+    if ((xcr0 & 0xe0) == 0xe0) *avx512 = 1;
+
+#else
+    // not on x86
+    *avx2   = 0;
+    *avx512 = 0;
+#endif
+}
+
 static inline int
 has_native_half (void)
 {
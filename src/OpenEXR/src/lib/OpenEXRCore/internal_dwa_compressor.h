@@ -551,6 +551,7 @@ DwaCompressor_compress (DwaCompressor* me)
                     outDataSize,
                     (const uint16_t*) me->_packedAcBuffer,
                     *totalAcUncompressedCount,
+                    1,
                     me->_encode->scratch_buffer_1,
                     me->_encode->scratch_alloc_size_1);
                 if (rv != EXR_ERR_SUCCESS)
@@ -560,9 +561,9 @@ DwaCompressor_compress (DwaCompressor* me)
                         memcpy (
                             me->_encode->compressed_buffer,
                             me->_encode->packed_buffer,
-                            me->_encode->packed_alloc_size);
+                            me->_encode->packed_bytes);
                         me->_encode->compressed_bytes =
-                            me->_encode->packed_alloc_size;
+                            me->_encode->packed_bytes;
                         return EXR_ERR_SUCCESS;
                     }
                     return rv;
@@ -488,7 +488,7 @@ LossyDctDecoder_execute (
             {
                 if (!blockIsConstant)
                 {
-                    csc709Inverse64 (
+                    (*csc709Inverse64) (
                         chanData[0]->_dctData,
                         chanData[1]->_dctData,
                         chanData[2]->_dctData);
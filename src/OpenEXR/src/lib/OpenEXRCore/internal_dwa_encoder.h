@@ -22,6 +22,9 @@
 #    if __has_builtin(__builtin_clz)
 #        define USE_CLZ 1
 #    endif
+#    if __has_builtin(__builtin_ctzll)
+#        define USE_CTZ 1
+#    endif
 #endif
 #ifndef USE_POPCOUNT
 #    define USE_POPCOUNT 0
@@ -45,6 +48,20 @@ static int __inline __builtin_clz(uint32_t v)
 #    endif
 #endif
 
+#ifndef USE_CTZ
+#    if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+static int __inline __builtin_ctzll(uint64_t v)
+{
+    unsigned long r;
+    _BitScanForward64(&r, v);
+    return (int) r;
+}
+#        define USE_CTZ 1
+#    else
+#        define USE_CTZ 0
+#    endif
+#endif
+
 //
 // Base 'class' for encoding using the lossy DCT scheme
 //
@@ -307,6 +324,27 @@ static int inline countLeadingZeros( uint32_t x )
 }
 #endif
 
+// only for non-zero values
+#if USE_CTZ
+static inline int
+countTrailingZeros64 (uint64_t src)
+{
+    return __builtin_ctzll (src);
+}
+#else
+static inline int
+countTrailingZeros64 (uint64_t src)
+{
+    int n = 0;
+    while (!(src & 1))
+    {
+        src >>= 1;
+        ++n;
+    }
+    return n;
+}
+#endif
+
 //
 // Take a DCT coefficient, as well as an acceptable error. Search
 // nearby values within the error tolerance, that have fewer
@@ -897,53 +935,28 @@ quantizeCoeffAndZigXDR (
     const float* restrict tolerances,
     const uint16_t* restrict halftols)
 {
-    //static const int remap[] = {
-    //    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
-    //    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
-    //    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
-    //    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
-    // inv_remap computed from original zigzag lookup remap so we can
-    // deposit into a random destination instead of pulling from a source
-    // and save a temporary and loop
-    static const int inv_remap[] = {
-        0, 1, 5, 6, 14, 15, 27, 28, 2, 4, 7, 13, 16, 26, 29, 42,
-        3, 8, 12, 17, 25, 30, 41, 43, 9, 11, 18, 24, 31, 40, 44, 53,
-        10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60,
-        21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63};
-
-    // manually unrolling seems to help on at least x86
-    for ( int i = 0; i < 64; i += 4 )
+    uint16_t halfCoeff[64];
+    uint64_t todo;
+
+    //
+    // Most coefficients are below their tolerance and quantize to
+    // 0, which the conversion takes care of, only the others need
+    // the search in algoQuantize
+    //
+
+    todo = (*convertFloatToHalfTol64) (halfCoeff, dctvals, tolerances);
+    while (todo != 0)
     {
-        uint16_t       src0     = float_to_half (dctvals[i+0]);
-        uint16_t       src1     = float_to_half (dctvals[i+1]);
-        uint16_t       src2     = float_to_half (dctvals[i+2]);
-        uint16_t       src3     = float_to_half (dctvals[i+3]);
-        const float    errTol0  = tolerances[i+0];
-        const float    errTol1  = tolerances[i+1];
-        const float    errTol2  = tolerances[i+2];
-        const float    errTol3  = tolerances[i+3];
-        const uint16_t herrTol0 = halftols[i+0];
-        const uint16_t herrTol1 = halftols[i+1];
-        const uint16_t herrTol2 = halftols[i+2];
-        const uint16_t herrTol3 = halftols[i+3];
-        src0 = algoQuantize (src0, herrTol0, errTol0, half_to_float (src0));
-        src1 = algoQuantize (src1, herrTol1, errTol1, half_to_float (src1));
-        src2 = algoQuantize (src2, herrTol2, errTol2, half_to_float (src2));
-        src3 = algoQuantize (src3, herrTol3, errTol3, half_to_float (src3));
-
-        halfZigCoeff[inv_remap[i+0]] = one_from_native16 (src0);
-        halfZigCoeff[inv_remap[i+1]] = one_from_native16 (src1);
-        halfZigCoeff[inv_remap[i+2]] = one_from_native16 (src2);
-        halfZigCoeff[inv_remap[i+3]] = one_from_native16 (src3);
+        int      i   = countTrailingZeros64 (todo);
+        uint16_t src = halfCoeff[i];
+
+        halfCoeff[i] =
+            algoQuantize (src, halftols[i], tolerances[i], half_to_float (src));
+        todo &= todo - 1;
     }
-//    for ( int i = 0; i < 64; ++i )
-//    {
-//        uint16_t       src     = float_to_half (dctvals[i]);
-//        const float    errTol  = tolerances[i];
-//        const uint16_t herrTol = halftols[i];
-//        src = algoQuantize (src, herrTol, errTol, half_to_float (src));
-//        halfZigCoeff[inv_remap[i]] = one_from_native16 (src);
-//    }
+
+    (*toHalfZigZag) (halfCoeff, halfZigCoeff);
+    priv_from_native16 (halfZigCoeff, 64);
 }
 
 /**************************************/
@@ -966,6 +979,7 @@ LossyDctEncoder_execute (
     int numBlocksY = (int) (ceilf ((float) e->_height / 8.0f));
 
     uint16_t halfZigCoef[64];
+    uint16_t halfBlock[64];
 
     uint16_t* currAcComp            = (uint16_t*) e->_packedAc;
     int       tmpHalfBufferElements = 0;
@@ -1041,19 +1055,43 @@ LossyDctEncoder_execute (
 
     for (int blocky = 0; blocky < numBlocksY; ++blocky)
     {
+        int vy[8];
+
+        //
+        // Break the source into 8x8 blocks. If we don't
+        // fit at the edges, mirror.
+        //
+
+        for (int y = 0; y < 8; ++y)
+        {
+            vy[y] = 8 * blocky + y;
+
+            if (vy[y] >= e->_height)
+                vy[y] = e->_height - (vy[y] - (e->_height - 1));
+
+            if (vy[y] < 0) vy[y] = e->_height - 1;
+        }
+
         for (int blockx = 0; blockx < numBlocksX; ++blockx)
         {
-            uint16_t              h;
+            int                   vx[8];
             const float* restrict quantTable;
             const uint16_t* restrict hquantTable;
 
+            for (int x = 0; x < 8; ++x)
+            {
+                vx[x] = 8 * blockx + x;
+
+                if (vx[x] >= e->_width)
+                    vx[x] = e->_width - (vx[x] - (e->_width - 1));
+
+                if (vx[x] < 0) vx[x] = e->_width - 1;
+            }
+
             for (int chan = 0; chan < numComp; ++chan)
             {
                 //
-                // Break the source into 8x8 blocks. If we don't
-                // fit at the edges, mirror.
-                //
-                // Also, convert from linear to nonlinear representation.
+                // Convert from linear to nonlinear representation.
                 // Our source is assumed to be XDR, and we need to convert
                 // to NATIVE prior to converting to float.
                 //
@@ -1064,30 +1102,23 @@ LossyDctEncoder_execute (
 
                 for (int y = 0; y < 8; ++y)
                 {
-                    for (int x = 0; x < 8; ++x)
-                    {
-                        int vx = 8 * blockx + x;
-                        int vy = 8 * blocky + y;
-
-                        if (vx >= e->_width)
-                            vx = e->_width - (vx - (e->_width - 1));
-
-                        if (vx < 0) vx = e->_width - 1;
+                    const uint16_t* row =
+                        (const uint16_t*) (chanData[chan]->_rows)[vy[y]];
 
-                        if (vy >= e->_height)
-                            vy = e->_height - (vy - (e->_height - 1));
-
-                        if (vy < 0) vy = e->_height - 1;
-
-                        h = ((const uint16_t*) (chanData[chan]->_rows)[vy])[vx];
-
-                        if (e->_toNonlinear) { h = e->_toNonlinear[h]; }
-                        else { h = one_to_native16 (h); }
+                    if (e->_toNonlinear)
+                    {
+                        for (int x = 0; x < 8; ++x)
+                            halfBlock[y * 8 + x] = e->_toNonlinear[row[vx[x]]];
+                    }
+                    else
+                    {
+                        for (int x = 0; x < 8; ++x)
+                            halfBlock[y * 8 + x] = one_to_native16 (row[vx[x]]);
+                    }
+                } // y
 
-                        chanData[chan]->_dctData[y * 8 + x] = half_to_float (h);
-                    } // x
-                }     // y
-            }         // chan
+                (*convertHalfToFloat64) (chanData[chan]->_dctData, halfBlock);
+            } // chan
 
             //
             // Color space conversion
@@ -1095,7 +1126,7 @@ LossyDctEncoder_execute (
 
             if (numComp == 3)
             {
-                csc709Forward64 (
+                (*csc709Forward64) (
                     chanData[0]->_dctData,
                     chanData[1]->_dctData,
                     chanData[2]->_dctData);
@@ -1108,7 +1139,7 @@ LossyDctEncoder_execute (
                 //
                 // Forward DCT
                 //
-                dctForward8x8 (chanData[chan]->_dctData);
+                (*dctForward8x8) (chanData[chan]->_dctData);
 
                 //
                 // Quantize to half, zigzag, and convert to XDR
@@ -46,6 +46,33 @@
 #    endif /* __LP64__ */
 #endif     /* OPENEXR_IMF_HAVE_GCC_INLINE_ASM_AVX */
 
+//
+// The AVX2 and AVX-512 paths use intrinsics. Unless the whole library
+// is built for those instruction sets, the functions are compiled for
+// them individually, and picked at runtime in initializeFuncs().
+//
+
+#if defined(_M_X64) || defined(__x86_64__)
+#    if defined(__AVX2__) && defined(__F16C__)
+#        define IMF_HAVE_AVX2_INTRINSICS 1
+#        define IMF_TARGET_AVX2
+#    elif defined(__GNUC__) || defined(__clang__)
+#        define IMF_HAVE_AVX2_INTRINSICS 1
+#        define IMF_TARGET_AVX2 __attribute__ ((target ("avx2,f16c")))
+#    endif
+#    if defined(__AVX512F__) && defined(__AVX512BW__)
+#        define IMF_HAVE_AVX512_INTRINSICS 1
+#        define IMF_TARGET_AVX512
+#    elif defined(__GNUC__) || defined(__clang__)
+#        define IMF_HAVE_AVX512_INTRINSICS 1
+#        define IMF_TARGET_AVX512                                              \
+            __attribute__ ((target ("avx512f,avx512bw")))
+#    endif
+#    if defined(IMF_HAVE_AVX2_INTRINSICS) || defined(IMF_HAVE_AVX512_INTRINSICS)
+#        include <immintrin.h>
+#    endif
+#endif
+
 #define _SSE_ALIGNMENT 32
 #define _SSE_ALIGNMENT_MASK 0x0F
 #define _AVX_ALIGNMENT_MASK 0x1F
@@ -55,6 +82,19 @@
 #endif
 
 #include "OpenEXRConfigInternal.h"
+
+//
+// The SSE2, AVX2 and scalar versions only give the same results as
+// long as the compiler keeps each multiply and add separate. Builds
+// with FMA enabled (-march=native and the like) may fuse them, and
+// differently in each version, so turn that off for the DWA code.
+//
+
+#if defined(__clang__)
+#    pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#    pragma GCC optimize("fp-contract=off")
+#endif
 #ifdef OPENEXR_MISSING_ARM_VLD1
 /* Workaround for missing vld1q_f32_x2 in older gcc versions.  */
 
@@ -101,8 +141,8 @@ csc709Inverse (float* comp0, float* comp1, float* comp2)
 // No scaling or offsets, just the matrix
 //
 
-static inline void
-csc709Inverse64 (float* comp0, float* comp1, float* comp2)
+static void
+csc709Inverse64_scalar (float* comp0, float* comp1, float* comp2)
 {
     for (int i = 0; i < 64; ++i)
         csc709Inverse (comp0 + i, comp1 + i, comp2 + i);
@@ -114,8 +154,8 @@ csc709Inverse64 (float* comp0, float* comp1, float* comp2)
 // SSE2 color space conversion
 //
 
-static inline void
-csc709Inverse64 (float* comp0, float* comp1, float* comp2)
+static void
+csc709Inverse64_sse2 (float* comp0, float* comp1, float* comp2)
 {
     __m128 c0 = {1.5747f, 1.5747f, 1.5747f, 1.5747f};
     __m128 c1 = {1.8556f, 1.8556f, 1.8556f, 1.8556f};
@@ -172,8 +212,8 @@ csc709Inverse64 (float* comp0, float* comp1, float* comp2)
 // primary chromaticies, with no scaling or offsets.
 //
 
-static inline void
-csc709Forward64 (float* comp0, float* comp1, float* comp2)
+static void
+csc709Forward64_scalar (float* comp0, float* comp1, float* comp2)
 {
     float src[3];
 
@@ -357,6 +397,17 @@ convertFloatToHalf64_scalar (uint16_t* dst, float* src)
         dst[i] = float_to_half (src[i]);
 }
 
+//
+// And back, for the source blocks of the encoder
+//
+
+static void
+convertHalfToFloat64_scalar (float* dst, const uint16_t* src)
+{
+    for (int i = 0; i < 64; ++i)
+        dst[i] = half_to_float (src[i]);
+}
+
 #ifdef IMF_HAVE_NEON_AARCH64
 
 void
@@ -527,6 +578,64 @@ fromHalfZigZag_scalar (uint16_t* src, float* dst)
     dst[63] = half_to_float (src[63]);
 }
 
+//
+// The zig-zag order as tables, sZigZagOrder[i] being the normal
+// index of the i-th coefficient in zig-zag order, and sZigZagInverse
+// the zig-zag index of each coefficient in normal order (the dst
+// table above).
+//
+
+static const uint16_t sZigZagOrder[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+static const uint16_t sZigZagInverse[64] = {
+    0,  1,  5,  6,  14, 15, 27, 28, 2,  4,  7,  13, 16, 26, 29, 42,
+    3,  8,  12, 17, 25, 30, 41, 43, 9,  11, 18, 24, 31, 40, 44, 53,
+    10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60,
+    21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63};
+
+//
+// Reorder an 8x8 block of HALF in normal order to zig-zag order,
+// the inverse of fromHalfZigZag without the conversion.
+//
+
+static void
+toHalfZigZag_scalar (const uint16_t* src, uint16_t* dst)
+{
+    for (int i = 0; i < 64; ++i)
+        dst[i] = src[sZigZagOrder[i]];
+}
+
+//
+// First step of the quantization of an 8x8 block of DCT
+// coefficients: convert to HALF, and zero every value smaller in
+// magnitude than its tolerance, which is most of them. Returns a
+// mask of the values left, bit i for dst[i], which need the full
+// search for the value with the fewest bits within tolerance.
+//
+
+static uint64_t
+convertFloatToHalfTol64_scalar (
+    uint16_t* dst, const float* src, const float* tolerances)
+{
+    uint64_t todo = 0;
+
+    for (int i = 0; i < 64; ++i)
+    {
+        uint16_t h = float_to_half (src[i]);
+
+        if (fabsf (half_to_float (h)) < tolerances[i])
+            h = 0;
+        else
+            todo |= (uint64_t) 1 << i;
+        dst[i] = h;
+    }
+    return todo;
+}
+
 //
 // If we can form the correct ordering in xmm registers,
 // we can use F16C to convert from HALF -> FLOAT. However,
@@ -1894,7 +2003,7 @@ dctInverse8x8_avx_7 (float* data)
 //
 
 static void
-dctForward8x8 (float* data)
+dctForward8x8_scalar (float* data)
 {
     float A0, A1, A2, A3, A4, A5, A6, A7;
     float K0, K1, rot_x, rot_y;
@@ -2076,7 +2185,7 @@ dctForward8x8 (float* data)
 //
 
 static void
-dctForward8x8 (float* data)
+dctForward8x8_sse2 (float* data)
 {
     __m128* srcVec = (__m128*) data;
     __m128  a0Vec, a1Vec, a2Vec, a3Vec, a4Vec, a5Vec, a6Vec, a7Vec;
@@ -2279,6 +2388,519 @@ dctForward8x8 (float* data)
 
 /**************************************/
 
+//
+// AVX2 implementations. The arithmetic is in the same order as the
+// SSE2 (or, for the forward CSC, scalar) versions, and nothing gets
+// fused (see the note on contraction at the top), so they give the
+// same bits, which testDWASimdPaths in OpenEXRCoreTest checks. On
+// AVX machines without AVX2 the inline-asm inverse DCT above is
+// still used, and it can differ from these in the last bits.
+//
+
+#ifdef IMF_HAVE_AVX2_INTRINSICS
+
+IMF_TARGET_AVX2 static void
+csc709Inverse64_avx2 (float* comp0, float* comp1, float* comp2)
+{
+    const __m256 c0 = _mm256_set1_ps (1.5747f);
+    const __m256 c1 = _mm256_set1_ps (1.8556f);
+    const __m256 c2 = _mm256_set1_ps (-0.1873f);
+    const __m256 c3 = _mm256_set1_ps (-0.4682f);
+
+    for (int i = 0; i < 64; i += 8)
+    {
+        __m256 src0 = _mm256_loadu_ps (comp0 + i);
+        __m256 src1 = _mm256_loadu_ps (comp1 + i);
+        __m256 src2 = _mm256_loadu_ps (comp2 + i);
+
+        _mm256_storeu_ps (
+            comp0 + i, _mm256_add_ps (src0, _mm256_mul_ps (src2, c0)));
+        _mm256_storeu_ps (
+            comp1 + i,
+            _mm256_add_ps (
+                _mm256_add_ps (_mm256_mul_ps (src1, c2), src0),
+                _mm256_mul_ps (src2, c3)));
+        _mm256_storeu_ps (
+            comp2 + i, _mm256_add_ps (_mm256_mul_ps (c1, src1), src0));
+    }
+}
+
+IMF_TARGET_AVX2 static void
+csc709Forward64_avx2 (float* comp0, float* comp1, float* comp2)
+{
+    const __m256 y0  = _mm256_set1_ps (0.2126f);
+    const __m256 y1  = _mm256_set1_ps (0.7152f);
+    const __m256 y2  = _mm256_set1_ps (0.0722f);
+    const __m256 cb0 = _mm256_set1_ps (-0.1146f);
+    const __m256 cb1 = _mm256_set1_ps (0.3854f);
+    const __m256 cb2 = _mm256_set1_ps (0.5000f);
+    const __m256 cr0 = _mm256_set1_ps (0.5000f);
+    const __m256 cr1 = _mm256_set1_ps (0.4542f);
+    const __m256 cr2 = _mm256_set1_ps (0.0458f);
+
+    for (int i = 0; i < 64; i += 8)
+    {
+        __m256 src0 = _mm256_loadu_ps (comp0 + i);
+        __m256 src1 = _mm256_loadu_ps (comp1 + i);
+        __m256 src2 = _mm256_loadu_ps (comp2 + i);
+
+        _mm256_storeu_ps (
+            comp0 + i,
+            _mm256_add_ps (
+                _mm256_add_ps (_mm256_mul_ps (y0, src0), _mm256_mul_ps (y1, src1)),
+                _mm256_mul_ps (y2, src2)));
+        _mm256_storeu_ps (
+            comp1 + i,
+            _mm256_add_ps (
+                _mm256_sub_ps (
+                    _mm256_mul_ps (cb0, src0), _mm256_mul_ps (cb1, src1)),
+                _mm256_mul_ps (cb2, src2)));
+        _mm256_storeu_ps (
+            comp2 + i,
+            _mm256_sub_ps (
+                _mm256_sub_ps (
+                    _mm256_mul_ps (cr0, src0), _mm256_mul_ps (cr1, src1)),
+                _mm256_mul_ps (cr2, src2)));
+    }
+}
+
+//
+// Inverse DCT, as the SSE2 version. The row pass does two rows at a
+// time, one in each 128-bit lane, so with an odd number of non-zero
+// rows it also runs over the first zeroed one, which stays zero.
+//
+
+IMF_TARGET_AVX2 static inline void
+dctInverse8x8_avx2 (float* data, int zeroedRows)
+{
+    const __m256 a = _mm256_set1_ps (3.535536e-01f);
+    const __m256 b = _mm256_set1_ps (4.903927e-01f);
+    const __m256 c = _mm256_set1_ps (4.619398e-01f);
+    const __m256 d = _mm256_set1_ps (4.157349e-01f);
+    const __m256 e = _mm256_set1_ps (2.777855e-01f);
+    const __m256 f = _mm256_set1_ps (1.913422e-01f);
+    const __m256 g = _mm256_set1_ps (9.754573e-02f);
+
+    // clang-format off
+    const __m256 c0 = _mm256_setr_ps (
+        3.535536e-01f, 3.535536e-01f, 3.535536e-01f, 3.535536e-01f,
+        3.535536e-01f, 3.535536e-01f, 3.535536e-01f, 3.535536e-01f);
+    const __m256 c1 = _mm256_setr_ps (
+        4.619398e-01f, 1.913422e-01f, -1.913422e-01f, -4.619398e-01f,
+        4.619398e-01f, 1.913422e-01f, -1.913422e-01f, -4.619398e-01f);
+    const __m256 c2 = _mm256_setr_ps (
+        3.535536e-01f, -3.535536e-01f, -3.535536e-01f, 3.535536e-01f,
+        3.535536e-01f, -3.535536e-01f, -3.535536e-01f, 3.535536e-01f);
+    const __m256 c3 = _mm256_setr_ps (
+        1.913422e-01f, -4.619398e-01f, 4.619398e-01f, -1.913422e-01f,
+        1.913422e-01f, -4.619398e-01f, 4.619398e-01f, -1.913422e-01f);
+    const __m256 c4 = _mm256_setr_ps (
+        4.903927e-01f, 4.157349e-01f, 2.777855e-01f, 9.754573e-02f,
+        4.903927e-01f, 4.157349e-01f, 2.777855e-01f, 9.754573e-02f);
+    const __m256 c5 = _mm256_setr_ps (
+        4.157349e-01f, -9.754573e-02f, -4.903927e-01f, -2.777855e-01f,
+        4.157349e-01f, -9.754573e-02f, -4.903927e-01f, -2.777855e-01f);
+    const __m256 c6 = _mm256_setr_ps (
+        2.777855e-01f, -4.903927e-01f, 9.754573e-02f, 4.157349e-01f,
+        2.777855e-01f, -4.903927e-01f, 9.754573e-02f, 4.157349e-01f);
+    const __m256 c7 = _mm256_setr_ps (
+        9.754573e-02f, -2.777855e-01f, 4.157349e-01f, -4.903927e-01f,
+        9.754573e-02f, -2.777855e-01f, 4.157349e-01f, -4.903927e-01f);
+    // clang-format on
+
+    __m256 in[8], alpha[4], beta[4], theta[4], gamma[4];
+
+    //
+    // Rows - lo holds the first halves of two rows, hi the second
+    // halves, then the same matrix-vector product as the SSE2 rows
+    //
+
+    for (int row = 0; row < 8 - zeroedRows; row += 2)
+    {
+        __m256 r0 = _mm256_loadu_ps (data + 8 * row);
+        __m256 r1 = _mm256_loadu_ps (data + 8 * row + 8);
+        __m256 lo = _mm256_permute2f128_ps (r0, r1, 0x20);
+        __m256 hi = _mm256_permute2f128_ps (r0, r1, 0x31);
+        __m256 evenSum, oddSum;
+
+        evenSum = _mm256_add_ps (
+            _mm256_setzero_ps (),
+            _mm256_mul_ps (_mm256_shuffle_ps (lo, lo, 0x00), c0));
+        evenSum = _mm256_add_ps (
+            evenSum, _mm256_mul_ps (_mm256_shuffle_ps (lo, lo, 0xaa), c1));
+        evenSum = _mm256_add_ps (
+            evenSum, _mm256_mul_ps (_mm256_shuffle_ps (hi, hi, 0x00), c2));
+        evenSum = _mm256_add_ps (
+            evenSum, _mm256_mul_ps (_mm256_shuffle_ps (hi, hi, 0xaa), c3));
+
+        oddSum = _mm256_add_ps (
+            _mm256_setzero_ps (),
+            _mm256_mul_ps (_mm256_shuffle_ps (lo, lo, 0x55), c4));
+        oddSum = _mm256_add_ps (
+            oddSum, _mm256_mul_ps (_mm256_shuffle_ps (lo, lo, 0xff), c5));
+        oddSum = _mm256_add_ps (
+            oddSum, _mm256_mul_ps (_mm256_shuffle_ps (hi, hi, 0x55), c6));
+        oddSum = _mm256_add_ps (
+            oddSum, _mm256_mul_ps (_mm256_shuffle_ps (hi, hi, 0xff), c7));
+
+        lo = _mm256_add_ps (evenSum, oddSum);
+        hi = _mm256_sub_ps (evenSum, oddSum);
+        hi = _mm256_shuffle_ps (hi, hi, _MM_SHUFFLE (0, 1, 2, 3));
+
+        _mm256_storeu_ps (data + 8 * row, _mm256_permute2f128_ps (lo, hi, 0x20));
+        _mm256_storeu_ps (
+            data + 8 * row + 8, _mm256_permute2f128_ps (lo, hi, 0x31));
+    }
+
+    //
+    // Columns - all 8 at once
+    //
+
+    for (int i = 0; i < 8; ++i)
+        in[i] = _mm256_loadu_ps (data + 8 * i);
+
+    alpha[0] = _mm256_mul_ps (c, in[2]);
+    alpha[1] = _mm256_mul_ps (f, in[2]);
+    alpha[2] = _mm256_mul_ps (c, in[6]);
+    alpha[3] = _mm256_mul_ps (f, in[6]);
+
+    beta[0] = _mm256_add_ps (
+        _mm256_add_ps (_mm256_mul_ps (in[1], b), _mm256_mul_ps (in[3], d)),
+        _mm256_add_ps (_mm256_mul_ps (in[5], e), _mm256_mul_ps (in[7], g)));
+
+    beta[1] = _mm256_sub_ps (
+        _mm256_sub_ps (_mm256_mul_ps (in[1], d), _mm256_mul_ps (in[3], g)),
+        _mm256_add_ps (_mm256_mul_ps (in[5], b), _mm256_mul_ps (in[7], e)));
+
+    beta[2] = _mm256_add_ps (
+        _mm256_sub_ps (_mm256_mul_ps (in[1], e), _mm256_mul_ps (in[3], b)),
+        _mm256_add_ps (_mm256_mul_ps (in[5], g), _mm256_mul_ps (in[7], d)));
+
+    beta[3] = _mm256_add_ps (
+        _mm256_sub_ps (_mm256_mul_ps (in[1], g), _mm256_mul_ps (in[3], e)),
+        _mm256_sub_ps (_mm256_mul_ps (in[5], d), _mm256_mul_ps (in[7], b)));
+
+    theta[0] = _mm256_mul_ps (a, _mm256_add_ps (in[0], in[4]));
+    theta[3] = _mm256_mul_ps (a, _mm256_sub_ps (in[0], in[4]));
+
+    theta[1] = _mm256_add_ps (alpha[0], alpha[3]);
+    theta[2] = _mm256_sub_ps (alpha[1], alpha[2]);
+
+    gamma[0] = _mm256_add_ps (theta[0], theta[1]);
+    gamma[1] = _mm256_add_ps (theta[3], theta[2]);
+    gamma[2] = _mm256_sub_ps (theta[3], theta[2]);
+    gamma[3] = _mm256_sub_ps (theta[0], theta[1]);
+
+    _mm256_storeu_ps (data, _mm256_add_ps (gamma[0], beta[0]));
+    _mm256_storeu_ps (data + 8, _mm256_add_ps (gamma[1], beta[1]));
+    _mm256_storeu_ps (data + 16, _mm256_add_ps (gamma[2], beta[2]));
+    _mm256_storeu_ps (data + 24, _mm256_add_ps (gamma[3], beta[3]));
+
+    _mm256_storeu_ps (data + 32, _mm256_sub_ps (gamma[3], beta[3]));
+    _mm256_storeu_ps (data + 40, _mm256_sub_ps (gamma[2], beta[2]));
+    _mm256_storeu_ps (data + 48, _mm256_sub_ps (gamma[1], beta[1]));
+    _mm256_storeu_ps (data + 56, _mm256_sub_ps (gamma[0], beta[0]));
+}
+
+IMF_TARGET_AVX2 static void
+dctInverse8x8_avx2_0 (float* data)
+{
+    dctInverse8x8_avx2 (data, 0);
+}
+
+IMF_TARGET_AVX2 static void
+dctInverse8x8_avx2_1 (float* data)
+{
+    dctInverse8x8_avx2 (data, 1);
+}
+
+IMF_TARGET_AVX2 static void
+dctInverse8x8_avx2_2 (float* data)
+{
+    dctInverse8x8_avx2 (data, 2);
+}
+
+IMF_TARGET_AVX2 static void
+dctInverse8x8_avx2_3 (float* data)
+{
+    dctInverse8x8_avx2 (data, 3);
+}
+
+IMF_TARGET_AVX2 static void
+dctInverse8x8_avx2_4 (float* data)
+{
+    dctInverse8x8_avx2 (data, 4);
+}
+
+IMF_TARGET_AVX2 static void
+dctInverse8x8_avx2_5 (float* data)
+{
+    dctInverse8x8_avx2 (data, 5);
+}
+
+IMF_TARGET_AVX2 static void
+dctInverse8x8_avx2_6 (float* data)
+{
+    dctInverse8x8_avx2 (data, 6);
+}
+
+IMF_TARGET_AVX2 static void
+dctInverse8x8_avx2_7 (float* data)
+{
+    dctInverse8x8_avx2 (data, 7);
+}
+
+//
+// Forward DCT, as the SSE2 version but on all 8 columns at once,
+// with a full 8x8 transpose between the two passes.
+//
+
+IMF_TARGET_AVX2 static void
+dctForward8x8_avx2 (float* data)
+{
+    const __m256 c4Vec     = _mm256_set1_ps (.70710678f);
+    const __m256 c4NegVec  = _mm256_set1_ps (-.70710678f);
+    const __m256 c1HalfVec = _mm256_set1_ps (.490392640f);
+    const __m256 c2HalfVec = _mm256_set1_ps (.461939770f);
+    const __m256 c3HalfVec = _mm256_set1_ps (.415734810f);
+    const __m256 c5HalfVec = _mm256_set1_ps (.277785120f);
+    const __m256 c6HalfVec = _mm256_set1_ps (.191341720f);
+    const __m256 c7HalfVec = _mm256_set1_ps (.097545161f);
+    const __m256 halfVec   = _mm256_set1_ps (.5f);
+
+    __m256 v[8], t[8];
+    __m256 a0Vec, a1Vec, a2Vec, a3Vec, a4Vec, a5Vec, a6Vec, a7Vec;
+    __m256 k0Vec, k1Vec, rotXVec, rotYVec;
+
+    for (int i = 0; i < 8; ++i)
+        v[i] = _mm256_loadu_ps (data + 8 * i);
+
+    for (int iter = 0; iter < 2; ++iter)
+    {
+        a0Vec = _mm256_add_ps (v[0], v[7]);
+        a1Vec = _mm256_add_ps (v[1], v[2]);
+        a3Vec = _mm256_add_ps (v[3], v[4]);
+        a5Vec = _mm256_add_ps (v[5], v[6]);
+
+        a7Vec = _mm256_sub_ps (v[0], v[7]);
+        a2Vec = _mm256_sub_ps (v[1], v[2]);
+        a4Vec = _mm256_sub_ps (v[3], v[4]);
+        a6Vec = _mm256_sub_ps (v[5], v[6]);
+
+        k0Vec = _mm256_mul_ps (c4Vec, _mm256_add_ps (a0Vec, a3Vec));
+        k1Vec = _mm256_mul_ps (c4Vec, _mm256_add_ps (a1Vec, a5Vec));
+
+        v[0] = _mm256_mul_ps (_mm256_add_ps (k0Vec, k1Vec), halfVec);
+        v[4] = _mm256_mul_ps (_mm256_sub_ps (k0Vec, k1Vec), halfVec);
+
+        k0Vec = _mm256_sub_ps (a2Vec, a6Vec);
+        k1Vec = _mm256_sub_ps (a0Vec, a3Vec);
+
+        v[2] = _mm256_add_ps (
+            _mm256_mul_ps (c6HalfVec, k0Vec), _mm256_mul_ps (c2HalfVec, k1Vec));
+        v[6] = _mm256_sub_ps (
+            _mm256_mul_ps (c6HalfVec, k1Vec), _mm256_mul_ps (c2HalfVec, k0Vec));
+
+        k0Vec = _mm256_mul_ps (_mm256_sub_ps (a1Vec, a5Vec), c4Vec);
+        k1Vec = _mm256_mul_ps (_mm256_add_ps (a2Vec, a6Vec), c4NegVec);
+
+        rotXVec = _mm256_sub_ps (a7Vec, k0Vec);
+        rotYVec = _mm256_add_ps (a4Vec, k1Vec);
+
+        v[3] = _mm256_sub_ps (
+            _mm256_mul_ps (c3HalfVec, rotXVec),
+            _mm256_mul_ps (c5HalfVec, rotYVec));
+        v[5] = _mm256_add_ps (
+            _mm256_mul_ps (c5HalfVec, rotXVec),
+            _mm256_mul_ps (c3HalfVec, rotYVec));
+
+        rotXVec = _mm256_add_ps (a7Vec, k0Vec);
+        rotYVec = _mm256_sub_ps (k1Vec, a4Vec);
+
+        v[1] = _mm256_sub_ps (
+            _mm256_mul_ps (c1HalfVec, rotXVec),
+            _mm256_mul_ps (c7HalfVec, rotYVec));
+        v[7] = _mm256_add_ps (
+            _mm256_mul_ps (c7HalfVec, rotXVec),
+            _mm256_mul_ps (c1HalfVec, rotYVec));
+
+        //
+        // Transpose, interleaving pairs of rows, then pairs of pairs
+        // within each 128-bit lane, then swapping lanes
+        //
+
+        t[0] = _mm256_unpacklo_ps (v[0], v[1]);
+        t[1] = _mm256_unpackhi_ps (v[0], v[1]);
+        t[2] = _mm256_unpacklo_ps (v[2], v[3]);
+        t[3] = _mm256_unpackhi_ps (v[2], v[3]);
+        t[4] = _mm256_unpacklo_ps (v[4], v[5]);
+        t[5] = _mm256_unpackhi_ps (v[4], v[5]);
+        t[6] = _mm256_unpacklo_ps (v[6], v[7]);
+        t[7] = _mm256_unpackhi_ps (v[6], v[7]);
+
+        v[0] = _mm256_shuffle_ps (t[0], t[2], 0x44);
+        v[1] = _mm256_shuffle_ps (t[0], t[2], 0xee);
+        v[2] = _mm256_shuffle_ps (t[1], t[3], 0x44);
+        v[3] = _mm256_shuffle_ps (t[1], t[3], 0xee);
+        v[4] = _mm256_shuffle_ps (t[4], t[6], 0x44);
+        v[5] = _mm256_shuffle_ps (t[4], t[6], 0xee);
+        v[6] = _mm256_shuffle_ps (t[5], t[7], 0x44);
+        v[7] = _mm256_shuffle_ps (t[5], t[7], 0xee);
+
+        t[0] = _mm256_permute2f128_ps (v[0], v[4], 0x20);
+        t[1] = _mm256_permute2f128_ps (v[1], v[5], 0x20);
+        t[2] = _mm256_permute2f128_ps (v[2], v[6], 0x20);
+        t[3] = _mm256_permute2f128_ps (v[3], v[7], 0x20);
+        t[4] = _mm256_permute2f128_ps (v[0], v[4], 0x31);
+        t[5] = _mm256_permute2f128_ps (v[1], v[5], 0x31);
+        t[6] = _mm256_permute2f128_ps (v[2], v[6], 0x31);
+        t[7] = _mm256_permute2f128_ps (v[3], v[7], 0x31);
+
+        for (int i = 0; i < 8; ++i)
+            v[i] = t[i];
+    }
+
+    for (int i = 0; i < 8; ++i)
+        _mm256_storeu_ps (data + 8 * i, v[i]);
+}
+
+IMF_TARGET_AVX2 static void
+convertFloatToHalf64_avx2 (uint16_t* dst, float* src)
+{
+    for (int i = 0; i < 64; i += 8)
+        _mm_storeu_si128 (
+            (__m128i*) (dst + i),
+            _mm256_cvtps_ph (
+                _mm256_loadu_ps (src + i), _MM_FROUND_TO_NEAREST_INT));
+}
+
+IMF_TARGET_AVX2 static void
+convertHalfToFloat64_avx2 (float* dst, const uint16_t* src)
+{
+    for (int i = 0; i < 64; i += 8)
+        _mm256_storeu_ps (
+            dst + i,
+            _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i*) (src + i))));
+}
+
+IMF_TARGET_AVX2 static uint64_t
+convertFloatToHalfTol64_avx2 (
+    uint16_t* dst, const float* src, const float* tolerances)
+{
+    const __m256 absMask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+    uint64_t     todo    = 0;
+
+    for (int i = 0; i < 64; i += 8)
+    {
+        __m128i h =
+            _mm256_cvtps_ph (_mm256_loadu_ps (src + i), _MM_FROUND_TO_NEAREST_INT);
+        __m256 zero = _mm256_cmp_ps (
+            _mm256_and_ps (_mm256_cvtph_ps (h), absMask),
+            _mm256_loadu_ps (tolerances + i),
+            _CMP_LT_OQ);
+        __m256i zero32 = _mm256_castps_si256 (zero);
+
+        h = _mm_andnot_si128 (
+            _mm_packs_epi32 (
+                _mm256_castsi256_si128 (zero32),
+                _mm256_extracti128_si256 (zero32, 1)),
+            h);
+        _mm_storeu_si128 ((__m128i*) (dst + i), h);
+
+        todo |= (uint64_t) (~_mm256_movemask_ps (zero) & 0xff) << i;
+    }
+    return todo;
+}
+
+#endif /* IMF_HAVE_AVX2_INTRINSICS */
+
+//
+// AVX-512 implementations, where moving all 64 values of a block
+// through two registers replaces the zig-zag shuffling, and the
+// conversions go 16 values at a time.
+//
+
+#ifdef IMF_HAVE_AVX512_INTRINSICS
+
+IMF_TARGET_AVX512 static void
+fromHalfZigZag_avx512 (uint16_t* src, float* dst)
+{
+    __m512i lo = _mm512_loadu_si512 (src);
+    __m512i hi = _mm512_loadu_si512 (src + 32);
+    __m512i d0 = _mm512_permutex2var_epi16 (
+        lo, _mm512_loadu_si512 (sZigZagInverse), hi);
+    __m512i d1 = _mm512_permutex2var_epi16 (
+        lo, _mm512_loadu_si512 (sZigZagInverse + 32), hi);
+
+    _mm512_storeu_ps (dst, _mm512_cvtph_ps (_mm512_castsi512_si256 (d0)));
+    _mm512_storeu_ps (
+        dst + 16, _mm512_cvtph_ps (_mm512_extracti64x4_epi64 (d0, 1)));
+    _mm512_storeu_ps (dst + 32, _mm512_cvtph_ps (_mm512_castsi512_si256 (d1)));
+    _mm512_storeu_ps (
+        dst + 48, _mm512_cvtph_ps (_mm512_extracti64x4_epi64 (d1, 1)));
+}
+
+IMF_TARGET_AVX512 static void
+toHalfZigZag_avx512 (const uint16_t* src, uint16_t* dst)
+{
+    __m512i lo = _mm512_loadu_si512 (src);
+    __m512i hi = _mm512_loadu_si512 (src + 32);
+
+    _mm512_storeu_si512 (
+        dst,
+        _mm512_permutex2var_epi16 (lo, _mm512_loadu_si512 (sZigZagOrder), hi));
+    _mm512_storeu_si512 (
+        dst + 32,
+        _mm512_permutex2var_epi16 (
+            lo, _mm512_loadu_si512 (sZigZagOrder + 32), hi));
+}
+
+IMF_TARGET_AVX512 static void
+convertFloatToHalf64_avx512 (uint16_t* dst, float* src)
+{
+    for (int i = 0; i < 64; i += 16)
+        _mm256_storeu_si256 (
+            (__m256i*) (dst + i),
+            _mm512_cvtps_ph (
+                _mm512_loadu_ps (src + i), _MM_FROUND_TO_NEAREST_INT));
+}
+
+IMF_TARGET_AVX512 static void
+convertHalfToFloat64_avx512 (float* dst, const uint16_t* src)
+{
+    for (int i = 0; i < 64; i += 16)
+        _mm512_storeu_ps (
+            dst + i,
+            _mm512_cvtph_ps (_mm256_loadu_si256 ((const __m256i*) (src + i))));
+}
+
+IMF_TARGET_AVX512 static uint64_t
+convertFloatToHalfTol64_avx512 (
+    uint16_t* dst, const float* src, const float* tolerances)
+{
+    uint64_t todo = 0;
+
+    for (int i = 0; i < 64; i += 16)
+    {
+        __m512    v = _mm512_loadu_ps (src + i);
+        __m256i   h = _mm512_cvtps_ph (v, _MM_FROUND_TO_NEAREST_INT);
+        __mmask16 keep = _mm512_cmp_ps_mask (
+            _mm512_abs_ps (_mm512_cvtph_ps (h)),
+            _mm512_loadu_ps (tolerances + i),
+            _CMP_NLT_UQ);
+
+        _mm256_storeu_si256 (
+            (__m256i*) (dst + i),
+            _mm512_maskz_cvtps_ph (keep, v, _MM_FROUND_TO_NEAREST_INT));
+        todo |= (uint64_t) keep << i;
+    }
+    return todo;
+}
+
+#endif /* IMF_HAVE_AVX512_INTRINSICS */
+
+/**************************************/
+
 //
 // Function pointer to dispatch to an appropriate
 // convertFloatToHalf64_* impl, based on runtime cpu checking.
@@ -2288,12 +2910,42 @@ dctForward8x8 (float* data)
 static void (*convertFloatToHalf64) (uint16_t*, float*) =
     convertFloatToHalf64_scalar;
 
+static void (*convertHalfToFloat64) (float*, const uint16_t*) =
+    convertHalfToFloat64_scalar;
+
 //
 // Function pointer for dispatching a fromHalfZigZag_ impl
 //
 
 static void (*fromHalfZigZag) (uint16_t*, float*) = fromHalfZigZag_scalar;
 
+//
+// And for the other direction, converting and quantizing in
+// convertFloatToHalfTol64, then reordering in toHalfZigZag
+//
+
+static uint64_t (*convertFloatToHalfTol64) (
+    uint16_t*, const float*, const float*) = convertFloatToHalfTol64_scalar;
+
+static void (*toHalfZigZag) (const uint16_t*, uint16_t*) = toHalfZigZag_scalar;
+
+//
+// Color space conversions and the forward DCT, where the SSE2 (or
+// scalar) versions are known at compile time
+//
+
+#ifdef IMF_HAVE_SSE2
+static void (*csc709Inverse64) (float*, float*, float*) = csc709Inverse64_sse2;
+static void (*dctForward8x8) (float*)                   = dctForward8x8_sse2;
+#else
+static void (*csc709Inverse64) (float*, float*, float*) =
+    csc709Inverse64_scalar;
+static void (*dctForward8x8) (float*) = dctForward8x8_scalar;
+#endif
+
+static void (*csc709Forward64) (float*, float*, float*) =
+    csc709Forward64_scalar;
+
 //
 // Dispatch the inverse DCT on an 8x8 block, where the last
 // n rows can be all zeros. The n=0 case converts the full block.
@@ -2366,5 +3018,45 @@ initializeFuncs (void)
         dctInverse8x8_6 = dctInverse8x8_sse2_6;
         dctInverse8x8_7 = dctInverse8x8_sse2_7;
     }
+
+#    if defined(IMF_HAVE_AVX2_INTRINSICS) || defined(IMF_HAVE_AVX512_INTRINSICS)
+    {
+        int avx2 = 0, avx512 = 0;
+
+        check_for_x86_avx2_avx512 (&avx2, &avx512);
+
+#        ifdef IMF_HAVE_AVX2_INTRINSICS
+        if (avx2 && f16c)
+        {
+            csc709Inverse64         = csc709Inverse64_avx2;
+            csc709Forward64         = csc709Forward64_avx2;
+            dctForward8x8           = dctForward8x8_avx2;
+            convertFloatToHalf64    = convertFloatToHalf64_avx2;
+            convertHalfToFloat64    = convertHalfToFloat64_avx2;
+            convertFloatToHalfTol64 = convertFloatToHalfTol64_avx2;
+
+            dctInverse8x8_0 = dctInverse8x8_avx2_0;
+            dctInverse8x8_1 = dctInverse8x8_avx2_1;
+            dctInverse8x8_2 = dctInverse8x8_avx2_2;
+            dctInverse8x8_3 = dctInverse8x8_avx2_3;
+            dctInverse8x8_4 = dctInverse8x8_avx2_4;
+            dctInverse8x8_5 = dctInverse8x8_avx2_5;
+            dctInverse8x8_6 = dctInverse8x8_avx2_6;
+            dctInverse8x8_7 = dctInverse8x8_avx2_7;
+        }
+#        endif
+
+#        ifdef IMF_HAVE_AVX512_INTRINSICS
+        if (avx512 && f16c)
+        {
+            fromHalfZigZag          = fromHalfZigZag_avx512;
+            toHalfZigZag            = toHalfZigZag_avx512;
+            convertFloatToHalf64    = convertFloatToHalf64_avx512;
+            convertHalfToFloat64    = convertHalfToFloat64_avx512;
+            convertFloatToHalfTol64 = convertFloatToHalfTol64_avx512;
+        }
+#        endif
+    }
+#    endif
 #endif
 }
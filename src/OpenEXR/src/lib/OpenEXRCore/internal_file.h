@@ -8,6 +8,8 @@
 
 #include "internal_structs.h"
 
+#include <stdio.h>
+
 #define EXR_FILE_VERSION 2
 #define EXR_FILE_VERSION_MASK 0x000000FF
 #define EXR_TILED_FLAG 0x00000200
@@ -42,4 +44,13 @@ internal_exr_validate_shared_attrs (exr_context_t ctxt,
 exr_result_t
 internal_exr_validate_write_part (exr_context_t ctxt, exr_priv_part_t curpart);
 
+/* in the platform file implementation (compiled via context.c), opens
+ * the chunk index sidecar with stdio, taking the name as utf-8 the same
+ * as the file itself */
+FILE* internal_exr_open_chunk_index (exr_const_context_t ctxt, const char* mode);
+
+/* in the platform file implementation, the modification time of a file
+ * opened by the built-in backend, 0 for any other stream */
+int64_t internal_exr_file_mtime (exr_const_context_t ctxt);
+
 #endif /* OPENEXR_PRIVATE_FILE_UTIL_H */
@@ -0,0 +1,354 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_PRIVATE_HALF_BUFFER_H
+#define OPENEXR_PRIVATE_HALF_BUFFER_H
+
+/*
+ * Bulk half <-> float conversion of a line of values, shared by the
+ * unpack and pack routines. Where the instructions may not be
+ * available at compile time, the conversion is dispatched through a
+ * function pointer set by the choose_*_impl functions, which the
+ * users call when matching their routines.
+ */
+
+#include "internal_coding.h"
+#include "internal_cpuid.h"
+#include "internal_xdr.h"
+
+/**************************************/
+
+#if (defined(__x86_64__) || defined(_M_X64))
+#    if defined(__AVX__) && (defined(__F16C__) || defined(__GNUC__) || defined(__clang__))
+#        define USE_F16C_INTRINSICS
+#    elif (defined(__GNUC__) || defined(__clang__))
+#        define ENABLE_F16C_TEST
+#    endif
+#elif defined(__aarch64__) && !EXR_HOST_IS_NOT_LITTLE_ENDIAN
+/* half <-> single conversion is part of the base AArch64 SIMD set, so
+ * there is nothing to check at runtime */
+#    define USE_NEON_HALF_CONVERSION
+#    include <arm_neon.h>
+#endif
+
+#if defined(USE_F16C_INTRINSICS) || defined(ENABLE_F16C_TEST)
+#    if defined(USE_F16C_INTRINSICS)
+static inline void
+half_to_float_buffer (float* out, const uint16_t* in, int w)
+#    elif defined(ENABLE_F16C_TEST)
+__attribute__ ((target ("f16c"))) static void
+half_to_float_buffer_f16c (float* out, const uint16_t* in, int w)
+#    endif
+{
+    while (w >= 8)
+    {
+        _mm256_storeu_ps (
+            out, _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i*) in)));
+        out += 8;
+        in += 8;
+        w -= 8;
+    }
+    // gcc < 9 does not have loadu_si64
+#    if defined(__clang__) || (__GNUC__ >= 9)
+    switch (w)
+    {
+        case 7:
+            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
+            out[4] = half_to_float (in[4]);
+            out[5] = half_to_float (in[5]);
+            out[6] = half_to_float (in[6]);
+            break;
+        case 6:
+            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
+            out[4] = half_to_float (in[4]);
+            out[5] = half_to_float (in[5]);
+            break;
+        case 5:
+            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
+            out[4] = half_to_float (in[4]);
+            break;
+        case 4: _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in))); break;
+        case 3:
+            out[0] = half_to_float (in[0]);
+            out[1] = half_to_float (in[1]);
+            out[2] = half_to_float (in[2]);
+            break;
+        case 2:
+            out[0] = half_to_float (in[0]);
+            out[1] = half_to_float (in[1]);
+            break;
+        case 1: out[0] = half_to_float (in[0]); break;
+    }
+#    else
+    while (w > 0)
+    {
+        *out++ = half_to_float (*in++);
+        --w;
+    }
+#    endif
+}
+#endif
+
+#if defined(USE_NEON_HALF_CONVERSION)
+static inline void
+half_to_float_buffer (float* out, const uint16_t* in, int w)
+{
+    while (w >= 8)
+    {
+        uint16x8_t h = vld1q_u16 (in);
+        vst1q_f32 (out, vcvt_f32_f16 (vreinterpret_f16_u16 (vget_low_u16 (h))));
+        vst1q_f32 (out + 4, vcvt_high_f32_f16 (vreinterpretq_f16_u16 (h)));
+        out += 8;
+        in += 8;
+        w -= 8;
+    }
+    if (w >= 4)
+    {
+        vst1q_f32 (out, vcvt_f32_f16 (vreinterpret_f16_u16 (vld1_u16 (in))));
+        out += 4;
+        in += 4;
+        w -= 4;
+    }
+    while (w > 0)
+    {
+        *out++ = half_to_float (*in++);
+        --w;
+    }
+}
+
+static inline void
+choose_half_to_float_impl (void)
+{}
+#endif
+
+#ifndef USE_F16C_INTRINSICS
+static inline void
+half_to_float4 (float* out, const uint16_t* src)
+{
+    out[0] = half_to_float (src[0]);
+    out[1] = half_to_float (src[1]);
+    out[2] = half_to_float (src[2]);
+    out[3] = half_to_float (src[3]);
+}
+
+static inline void
+half_to_float8 (float* out, const uint16_t* src)
+{
+    half_to_float4 (out, src);
+    half_to_float4 (out + 4, src + 4);
+}
+#else
+/* when we explicitly compile against f16, force it in, do not need a chooser */
+static inline void
+choose_half_to_float_impl (void)
+{}
+#endif
+
+#ifdef ENABLE_F16C_TEST
+static void
+half_to_float_buffer_impl (float* out, const uint16_t* in, int w)
+{
+    while (w >= 8)
+    {
+        half_to_float8 (out, in);
+        out += 8;
+        in += 8;
+        w -= 8;
+    }
+    switch (w)
+    {
+        case 7:
+            half_to_float4 (out, in);
+            out[4] = half_to_float (in[4]);
+            out[5] = half_to_float (in[5]);
+            out[6] = half_to_float (in[6]);
+            break;
+        case 6:
+            half_to_float4 (out, in);
+            out[4] = half_to_float (in[4]);
+            out[5] = half_to_float (in[5]);
+            break;
+        case 5:
+            half_to_float4 (out, in);
+            out[4] = half_to_float (in[4]);
+            break;
+        case 4: half_to_float4 (out, in); break;
+        case 3:
+            out[0] = half_to_float (in[0]);
+            out[1] = half_to_float (in[1]);
+            out[2] = half_to_float (in[2]);
+            break;
+        case 2:
+            out[0] = half_to_float (in[0]);
+            out[1] = half_to_float (in[1]);
+            break;
+        case 1: out[0] = half_to_float (in[0]); break;
+    }
+}
+
+static void (*half_to_float_buffer) (float*, const uint16_t*, int) =
+    &half_to_float_buffer_impl;
+
+static inline void
+choose_half_to_float_impl (void)
+{
+    if (has_native_half ()) half_to_float_buffer = &half_to_float_buffer_f16c;
+}
+
+#endif /* ENABLE_F16C_TEST */
+
+#if !(defined(ENABLE_F16C_TEST) || defined(USE_F16C_INTRINSICS) ||           \
+      defined(USE_NEON_HALF_CONVERSION))
+
+static inline void
+half_to_float_buffer (float* out, const uint16_t* in, int w)
+{
+#    if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+    for (int x = 0; x < w; ++x)
+        out[x] = half_to_float (one_to_native16 (in[x]));
+#    else
+    while (w >= 8)
+    {
+        half_to_float8 (out, in);
+        out += 8;
+        in += 8;
+        w -= 8;
+    }
+    switch (w)
+    {
+        case 7:
+            half_to_float4 (out, in);
+            out[4] = half_to_float (in[4]);
+            out[5] = half_to_float (in[5]);
+            out[6] = half_to_float (in[6]);
+            break;
+        case 6:
+            half_to_float4 (out, in);
+            out[4] = half_to_float (in[4]);
+            out[5] = half_to_float (in[5]);
+            break;
+        case 5:
+            half_to_float4 (out, in);
+            out[4] = half_to_float (in[4]);
+            break;
+        case 4: half_to_float4 (out, in); break;
+        case 3:
+            out[0] = half_to_float (in[0]);
+            out[1] = half_to_float (in[1]);
+            out[2] = half_to_float (in[2]);
+            break;
+        case 2:
+            out[0] = half_to_float (in[0]);
+            out[1] = half_to_float (in[1]);
+            break;
+        case 1: out[0] = half_to_float (in[0]); break;
+    }
+#    endif
+}
+
+static inline void
+choose_half_to_float_impl (void)
+{}
+
+#endif
+
+/**************************************/
+
+/* narrowing of FLOAT channels into HALF outputs, same dispatch scheme
+ * as above. The rounding of the f16c instruction with
+ * _MM_FROUND_TO_NEAREST_INT, and of the NEON conversion under the
+ * default rounding mode, matches float_to_half for all non-NaN
+ * inputs */
+#if defined(USE_F16C_INTRINSICS) || defined(ENABLE_F16C_TEST)
+#    if defined(USE_F16C_INTRINSICS)
+static inline void
+float_to_half_buffer (uint16_t* out, const uint32_t* in, int w)
+#    elif defined(ENABLE_F16C_TEST)
+__attribute__ ((target ("f16c"))) static void
+float_to_half_buffer_f16c (uint16_t* out, const uint32_t* in, int w)
+#    endif
+{
+    while (w >= 8)
+    {
+        _mm_storeu_si128 (
+            (__m128i*) out,
+            _mm256_cvtps_ph (
+                _mm256_loadu_ps ((const float*) in), _MM_FROUND_TO_NEAREST_INT));
+        out += 8;
+        in += 8;
+        w -= 8;
+    }
+    while (w > 0)
+    {
+        *out++ = float_to_half_int (*in++);
+        --w;
+    }
+}
+#endif
+
+#ifdef ENABLE_F16C_TEST
+static void
+float_to_half_buffer_impl (uint16_t* out, const uint32_t* in, int w)
+{
+    for (int x = 0; x < w; ++x)
+        out[x] = float_to_half_int (in[x]);
+}
+
+static void (*float_to_half_buffer) (uint16_t*, const uint32_t*, int) =
+    &float_to_half_buffer_impl;
+
+static inline void
+choose_float_to_half_impl (void)
+{
+    if (has_native_half ())
+        float_to_half_buffer = &float_to_half_buffer_f16c;
+}
+#else
+static inline void
+choose_float_to_half_impl (void)
+{}
+#endif
+
+#if defined(USE_NEON_HALF_CONVERSION)
+static inline void
+float_to_half_buffer (uint16_t* out, const uint32_t* in, int w)
+{
+    const float* fin = (const float*) in;
+
+    while (w >= 8)
+    {
+        float16x4_t lo = vcvt_f16_f32 (vld1q_f32 (fin));
+        float16x8_t hv = vcvt_high_f16_f32 (lo, vld1q_f32 (fin + 4));
+        vst1q_u16 (out, vreinterpretq_u16_f16 (hv));
+        out += 8;
+        fin += 8;
+        w -= 8;
+    }
+    if (w >= 4)
+    {
+        vst1_u16 (out, vreinterpret_u16_f16 (vcvt_f16_f32 (vld1q_f32 (fin))));
+        out += 4;
+        fin += 4;
+        w -= 4;
+    }
+    while (w > 0)
+    {
+        *out++ = float_to_half (*fin++);
+        --w;
+    }
+}
+#endif
+
+#if !(defined(ENABLE_F16C_TEST) || defined(USE_F16C_INTRINSICS) ||           \
+      defined(USE_NEON_HALF_CONVERSION))
+static inline void
+float_to_half_buffer (uint16_t* out, const uint32_t* in, int w)
+{
+    for (int x = 0; x < w; ++x)
+        out[x] = float_to_half_int (one_to_native32 (in[x]));
+}
+#endif
+
+#endif /* OPENEXR_PRIVATE_HALF_BUFFER_H */
@@ -4,8 +4,10 @@
 */
 
 #include <limits>
+#include <new>
 #include <string>
 #include <fstream>
+#include <string.h>
 
 #include <openjph/ojph_arch.h>
 #include <openjph/ojph_file.h>
@@ -16,7 +18,9 @@
 
 #include "openexr_decode.h"
 #include "openexr_encode.h"
+#include "internal_compress.h"
 #include "internal_ht_common.h"
+#include "internal_structs.h"
 
 /**
  * OpenJPH output file that is backed by a fixed-size memory buffer
@@ -157,17 +161,201 @@ class staticmem_outfile : public ojph::outfile_base
     ojph::ui8 *cur_ptr;
   };
 
+/*
+ * Constructing an ojph::codestream sets up its allocators and
+ * transform tables, and create() then lays out every tile, line and
+ * codeblock structure. restart() keeps all of those allocations, so
+ * rather than rebuilding a codestream for each chunk, idle ones are
+ * cached by the context along with their channel map, the same way
+ * compression.c caches libdeflate states.
+ */
+struct _internal_exr_ht_state
+{
+    struct _internal_exr_ht_state* next;
+    bool                           is_encoder;
+
+    ojph::codestream                   cs;
+    std::vector<CodestreamChannelInfo> cs_to_file_ch;
+
+    /* encoder: the channel names the map above was computed for, and
+     * whether they were detected as RGB */
+    std::vector<const char*> map_names;
+    bool                     is_rgb;
+
+    /* byte offset of each file channel in a line */
+    std::vector<size_t> file_line_offsets;
+};
+
+static _internal_exr_ht_state*
+acquire_ht_state (exr_const_context_t ctxt, bool is_encoder)
+{
+    _internal_exr_ht_state*  cur = NULL;
+    _internal_exr_ht_state** prev;
+    exr_context_t            nonc = EXR_CONST_CAST (exr_context_t, ctxt);
+    void*                    mem;
+
+    internal_exr_lock (ctxt);
+    for (prev = &(nonc->ht_cache); *prev; prev = &((*prev)->next))
+    {
+        if ((*prev)->is_encoder == is_encoder)
+        {
+            cur   = *prev;
+            *prev = cur->next;
+            break;
+        }
+    }
+    internal_exr_unlock (ctxt);
+    if (cur) return cur;
+
+    mem = ctxt->alloc_fn (sizeof (_internal_exr_ht_state));
+    if (!mem) return NULL;
+
+    try
+    {
+        cur = new (mem) _internal_exr_ht_state;
+    }
+    catch ( ... )
+    {
+        ctxt->free_fn (mem);
+        return NULL;
+    }
+    cur->next       = NULL;
+    cur->is_encoder = is_encoder;
+    cur->is_rgb     = false;
+    return cur;
+}
+
+static void
+free_ht_state (exr_const_context_t ctxt, _internal_exr_ht_state* st)
+{
+    st->~_internal_exr_ht_state ();
+    ctxt->free_fn (st);
+}
+
+static void
+release_ht_state (exr_const_context_t ctxt, _internal_exr_ht_state* st)
+{
+    exr_context_t nonc = EXR_CONST_CAST (exr_context_t, ctxt);
+
+    try
+    {
+        st->cs.restart ();
+    }
+    catch ( ... )
+    {
+        free_ht_state (ctxt, st);
+        return;
+    }
+
+    internal_exr_lock (ctxt);
+    st->next       = nonc->ht_cache;
+    nonc->ht_cache = st;
+    internal_exr_unlock (ctxt);
+}
+
+extern "C" void
+internal_exr_destroy_ht_cache (exr_context_t ctxt)
+{
+    _internal_exr_ht_state* cur = ctxt->ht_cache;
+
+    ctxt->ht_cache = NULL;
+    while (cur)
+    {
+        _internal_exr_ht_state* next = cur->next;
+        free_ht_state (ctxt, cur);
+        cur = next;
+    }
+}
+
+/*
+ * The irreversible wavelet only keeps half codes close to where they
+ * were, in the monotonic order the binary complement NLT gives them,
+ * which can still push a code past the largest finite half into the
+ * Inf and NaN patterns. Lossy codestreams clamp codes to the finite
+ * range on both ends.
+ */
+static inline int16_t
+clamp_to_finite_half (int16_t h)
+{
+    uint16_t u = (uint16_t) h;
+    if ((u & 0x7fff) > 0x7bff) u = (uint16_t) ((u & 0x8000) | 0x7bff);
+    return (int16_t) u;
+}
+
+/* OpenJPH lines hold 32-bit integers, OpenEXR pixels are 16 or 32 bits */
+static inline void
+copy_from_line (
+    uint8_t*              dst,
+    const ojph::line_buf* line,
+    int32_t               width,
+    bool                  is_half,
+    bool                  is_lossy)
+{
+    if (is_half)
+    {
+        int16_t*          out = (int16_t*) dst;
+        const ojph::si32* in  = line->i32;
+        if (is_lossy)
+        {
+            for (int32_t p = 0; p < width; p++)
+                out[p] = clamp_to_finite_half ((int16_t) in[p]);
+        }
+        else
+        {
+            for (int32_t p = 0; p < width; p++)
+                out[p] = (int16_t) in[p];
+        }
+    }
+    else
+        memcpy (dst, line->i32, (size_t) width * sizeof (int32_t));
+}
+
+static inline void
+copy_to_line (
+    ojph::line_buf* line,
+    const uint8_t*  src,
+    int32_t         width,
+    bool            is_half,
+    bool            is_lossy)
+{
+    if (is_half)
+    {
+        ojph::si32*    out = line->i32;
+        const int16_t* in  = (const int16_t*) src;
+        if (is_lossy)
+        {
+            for (int32_t p = 0; p < width; p++)
+                out[p] = clamp_to_finite_half (in[p]);
+        }
+        else
+        {
+            for (int32_t p = 0; p < width; p++)
+                out[p] = in[p];
+        }
+    }
+    else
+        memcpy (line->i32, src, (size_t) width * sizeof (int32_t));
+}
+
+/*
+ * The SIMD sample converters OpenJPH applies to pushed lines load whole
+ * vectors, so may read this far past the end of a line.
+ */
+#define HT_LINE_OVERREAD_BYTES 64
+
 static exr_result_t
 ht_undo_impl (
-    exr_decode_pipeline_t* decode,
-    const void*            compressed_data,
-    uint64_t               comp_buf_size,
-    void*                  uncompressed_data,
-    uint64_t               uncompressed_size)
+    _internal_exr_ht_state* st,
+    exr_decode_pipeline_t*  decode,
+    const void*             compressed_data,
+    uint64_t                comp_buf_size,
+    void*                   uncompressed_data,
+    uint64_t                uncompressed_size)
 {
     exr_result_t rv = EXR_ERR_SUCCESS;
 
-    std::vector<CodestreamChannelInfo> cs_to_file_ch (decode->channel_count);
+    std::vector<CodestreamChannelInfo>& cs_to_file_ch = st->cs_to_file_ch;
+    std::vector<size_t>&                line_offsets  = st->file_line_offsets;
 
     /* read the channel map */
 
@@ -177,17 +365,22 @@ ht_undo_impl (
     if (static_cast<std::size_t>(decode->channel_count) != cs_to_file_ch.size ())
         return EXR_ERR_CORRUPT_CHUNK;
 
+    line_offsets.resize (decode->channel_count);
+    size_t bpl = 0;
+    for (int16_t c = 0; c < decode->channel_count; c++)
+    {
+        line_offsets[c] = bpl;
+        bpl += (size_t) decode->channels[c].width *
+               decode->channels[c].bytes_per_element;
+    }
+
     for (int cs_i = 0; cs_i < decode->channel_count; cs_i++)
     {
         int file_i = cs_to_file_ch[cs_i].file_index;
         if (file_i >= decode->channel_count)
             return EXR_ERR_CORRUPT_CHUNK;
 
-        size_t computedoffset = 0;
-        for (int i = 0; i < file_i; ++i)
-            computedoffset += decode->channels[i].width *
-                              decode->channels[i].bytes_per_element;
-        cs_to_file_ch[cs_i].raster_line_offset = computedoffset;
+        cs_to_file_ch[cs_i].raster_line_offset = line_offsets[file_i];
     }
 
     ojph::mem_infile infile;
@@ -195,11 +388,13 @@ ht_undo_impl (
         reinterpret_cast<const ojph::ui8*> (compressed_data) + header_sz,
         comp_buf_size - header_sz);
 
-    ojph::codestream cs;
+    ojph::codestream& cs = st->cs;
     cs.read_headers (&infile);
 
     ojph::param_siz siz = cs.access_siz ();
 
+    bool is_lossy = !cs.access_cod ().is_reversible ();
+
     ojph::ui32 image_height =
         siz.get_image_extent ().y - siz.get_image_offset ().y;
 
@@ -208,12 +403,9 @@ ht_undo_impl (
         || decode->channel_count != siz.get_num_components())
         return EXR_ERR_CORRUPT_CHUNK;
 
-    int  bpl       = 0;
     bool is_planar = false;
     for (int16_t c = 0; c < decode->channel_count; c++)
     {
-        bpl +=
-            decode->channels[c].bytes_per_element * decode->channels[c].width;
         if (decode->channels[c].x_samples > 1 ||
             decode->channels[c].y_samples > 1)
         { is_planar = true; }
@@ -237,6 +429,8 @@ ht_undo_impl (
 
             if (decode->channels[file_c].height == 0) continue;
 
+            bool is_half =
+                decode->channels[file_c].data_type == EXR_PIXEL_HALF;
             uint8_t* line_pixels = static_cast<uint8_t*> (uncompressed_data);
 
             for (int64_t y = decode->chunk.start_y;
@@ -253,27 +447,12 @@ ht_undo_impl (
                         cur_line = cs.pull (next_comp);
                         assert (next_comp == c);
 
-                        if (decode->channels[file_c].data_type ==
-                            EXR_PIXEL_HALF)
-                        {
-                            int16_t* channel_pixels = (int16_t*) line_pixels;
-                            for (int16_t p = 0;
-                                 p < decode->channels[file_c].width;
-                                 p++)
-                            {
-                                *channel_pixels++ = cur_line->i32[p];
-                            }
-                        }
-                        else
-                        {
-                            int32_t* channel_pixels = (int32_t*) line_pixels;
-                            for (int16_t p = 0;
-                                 p < decode->channels[file_c].width;
-                                 p++)
-                            {
-                                *channel_pixels++ = cur_line->i32[p];
-                            }
-                        }
+                        copy_from_line (
+                            line_pixels,
+                            cur_line,
+                            decode->channels[file_c].width,
+                            is_half,
+                            is_lossy);
                     }
 
                     line_pixels += decode->channels[line_c].bytes_per_element *
@@ -295,26 +474,12 @@ ht_undo_impl (
                 int file_c = cs_to_file_ch[c].file_index;
                 cur_line   = cs.pull (next_comp);
                 assert (next_comp == c);
-                if (decode->channels[file_c].data_type == EXR_PIXEL_HALF)
-                {
-                    int16_t* channel_pixels =
-                        (int16_t*) (line_pixels + cs_to_file_ch[c].raster_line_offset);
-                    for (int16_t p = 0; p < decode->channels[file_c].width;
-                         p++)
-                    {
-                        *channel_pixels++ = cur_line->i32[p];
-                    }
-                }
-                else
-                {
-                    int32_t* channel_pixels =
-                        (int32_t*) (line_pixels + cs_to_file_ch[c].raster_line_offset);
-                    for (int16_t p = 0; p < decode->channels[file_c].width;
-                         p++)
-                    {
-                        *channel_pixels++ = cur_line->i32[p];
-                    }
-                }
+                copy_from_line (
+                    line_pixels + cs_to_file_ch[c].raster_line_offset,
+                    cur_line,
+                    decode->channels[file_c].width,
+                    decode->channels[file_c].data_type == EXR_PIXEL_HALF,
+                    is_lossy);
             }
             line_pixels += bpl;
         }
@@ -333,40 +498,83 @@ internal_exr_undo_ht (
     void*                  uncompressed_data,
     uint64_t               uncompressed_size)
 {
+    exr_result_t            rv;
+    _internal_exr_ht_state* st = acquire_ht_state (decode->context, false);
+
+    if (!st) return EXR_ERR_OUT_OF_MEMORY;
+
     try
     {
-        return ht_undo_impl (decode, compressed_data, comp_buf_size,
-                             uncompressed_data, uncompressed_size);
+        rv = ht_undo_impl (st, decode, compressed_data, comp_buf_size,
+                           uncompressed_data, uncompressed_size);
     }
     catch ( ... )
     {
+        free_ht_state (decode->context, st);
+        return EXR_ERR_CORRUPT_CHUNK;
     }
 
-    return EXR_ERR_CORRUPT_CHUNK;
+    release_ht_state (decode->context, st);
+    return rv;
 }
 
 
 ////////////////////////////////////////
 
 
+static bool
+ht_channel_map (_internal_exr_ht_state* st, exr_encode_pipeline_t* encode)
+{
+    /* the channel names belong to the part's channel list, so the same
+     * pointers mean the same channels and the RGB detection still holds,
+     * only the line offsets depend on the chunk width */
+    bool same = st->map_names.size () == (size_t) encode->channel_count;
+    for (int16_t c = 0; same && c < encode->channel_count; c++)
+        same = st->map_names[c] == encode->channels[c].channel_name;
+
+    if (!same)
+    {
+        st->is_rgb = make_channel_map (
+            encode->channel_count, encode->channels, st->cs_to_file_ch);
+        st->map_names.resize (encode->channel_count);
+        for (int16_t c = 0; c < encode->channel_count; c++)
+            st->map_names[c] = encode->channels[c].channel_name;
+        return st->is_rgb;
+    }
+
+    size_t offset = 0;
+    st->file_line_offsets.resize (encode->channel_count);
+    for (int16_t c = 0; c < encode->channel_count; c++)
+    {
+        st->file_line_offsets[c] = offset;
+        offset += (size_t) encode->channels[c].width *
+                  encode->channels[c].bytes_per_element;
+    }
+    for (int16_t c = 0; c < encode->channel_count; c++)
+        st->cs_to_file_ch[c].raster_line_offset =
+            st->file_line_offsets[st->cs_to_file_ch[c].file_index];
+
+    return st->is_rgb;
+}
+
 static exr_result_t
-ht_apply_impl (exr_encode_pipeline_t* encode)
+ht_apply_impl (_internal_exr_ht_state* st, exr_encode_pipeline_t* encode)
 {
     exr_result_t rv = EXR_ERR_SUCCESS;
 
-    std::vector<CodestreamChannelInfo> cs_to_file_ch (encode->channel_count);
-    bool                               isRGB = make_channel_map (
-        encode->channel_count, encode->channels, cs_to_file_ch);
+    std::vector<CodestreamChannelInfo>& cs_to_file_ch = st->cs_to_file_ch;
+    bool isRGB = ht_channel_map (st, encode);
 
     int image_height = encode->chunk.height;
     int image_width  = encode->chunk.width;
 
-    ojph::codestream cs;
+    ojph::codestream& cs = st->cs;
 
     ojph::param_siz siz = cs.access_siz ();
     ojph::param_nlt nlt = cs.access_nlt ();
 
     bool isPlanar = false;
+    bool allHalf  = true;
     siz.set_num_components (encode->channel_count);
     int bpl = 0;
     for (int16_t c = 0; c < encode->channel_count; c++)
@@ -384,6 +592,9 @@ ht_apply_impl (exr_encode_pipeline_t* encode)
             encode->channels[file_c].data_type == EXR_PIXEL_HALF ? 16 : 32,
             encode->channels[file_c].data_type != EXR_PIXEL_UINT);
 
+        if (encode->channels[file_c].data_type != EXR_PIXEL_HALF)
+            allHalf = false;
+
         if (encode->channels[file_c].x_samples > 1 ||
             encode->channels[file_c].y_samples > 1)
         { isPlanar = true; }
@@ -396,13 +607,55 @@ ht_apply_impl (exr_encode_pipeline_t* encode)
 
     siz.set_image_offset (ojph::point (0, 0));
     siz.set_image_extent (ojph::point (image_width, image_height));
+    /* restart() keeps the tile size a reused codestream defaulted to */
+    siz.set_tile_size (ojph::size (image_width, image_height));
+
+    int                     block_w, block_h, levels;
+    exr_htj2k_progression_t order;
+    float                   qstep;
+
+    rv = exr_get_htj2k_block_size (
+        encode->context, encode->part_index, &block_w, &block_h);
+    if (rv == EXR_ERR_SUCCESS)
+        rv = exr_get_htj2k_levels (encode->context, encode->part_index, &levels);
+    if (rv == EXR_ERR_SUCCESS)
+        rv = exr_get_htj2k_progression (
+            encode->context, encode->part_index, &order);
+    if (rv == EXR_ERR_SUCCESS)
+        rv = exr_get_htj2k_quantization_step (
+            encode->context, encode->part_index, &qstep);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    /*
+     * The irreversible path codes samples as floats, which cannot
+     * hold the 32-bit patterns of float and uint channels, so those
+     * always stay lossless.
+     */
+    if (!allHalf) qstep = 0.f;
+
+    static const char* const progression_names[] = {
+        "LRCP", "RLCP", "RPCL", "PCRL", "CPRL"};
 
     ojph::param_cod cod = cs.access_cod ();
 
     cod.set_color_transform (isRGB && !isPlanar);
-    cod.set_reversible (true);
-    cod.set_block_dims (128, 32);
-    cod.set_num_decomposition (5);
+    cod.set_reversible (qstep <= 0.f);
+    cod.set_block_dims (block_w, block_h);
+    cod.set_num_decomposition (levels);
+    cod.set_progression_order (progression_names[order]);
+    if (qstep > 0.f) cs.access_qcd ().set_irrev_quant (qstep);
+
+    /*
+     * OpenJPH only reads the lines that are pushed to it, so 32-bit
+     * channels are handed over in place from the packed buffer rather
+     * than copied into the codestream's own line first. Lines too close
+     * to the end of the buffer for the converters' vector loads are
+     * still copied.
+     */
+    ojph::line_buf packed_line;
+    size_t         packed_avail = encode->packed_alloc_size
+                                      ? encode->packed_alloc_size
+                                      : encode->packed_bytes;
 
     try
     {
@@ -421,6 +674,30 @@ ht_apply_impl (exr_encode_pipeline_t* encode)
         ojph::ui32      next_comp = 0;
         ojph::line_buf* cur_line  = cs.exchange (NULL, next_comp);
 
+        auto push_line = [&] (const uint8_t* src, int file_c) {
+            int32_t width   = encode->channels[file_c].width;
+            bool    is_half = encode->channels[file_c].data_type ==
+                           EXR_PIXEL_HALF;
+            size_t  end     = (size_t) (src - (const uint8_t*)
+                                                 encode->packed_buffer) +
+                         (size_t) width * 4 + HT_LINE_OVERREAD_BYTES;
+
+            if (!is_half && end <= packed_avail)
+            {
+                packed_line.i32      = (ojph::si32*) src;
+                packed_line.size     = (size_t) width;
+                packed_line.pre_size = 0;
+                packed_line.flags =
+                    ojph::line_buf::LFT_32BIT | ojph::line_buf::LFT_INTEGER;
+                cur_line = cs.exchange (&packed_line, next_comp);
+            }
+            else
+            {
+                copy_to_line (cur_line, src, width, is_half, qstep > 0.f);
+                cur_line = cs.exchange (cur_line, next_comp);
+            }
+        };
+
         if (cs.is_planar ())
         {
             for (int16_t c = 0; c < encode->channel_count; c++)
@@ -443,30 +720,8 @@ ht_apply_impl (exr_encode_pipeline_t* encode)
 
                         if (line_c == file_c)
                         {
-                            if (encode->channels[file_c].data_type ==
-                                EXR_PIXEL_HALF)
-                            {
-                                int16_t* channel_pixels = (int16_t*) (line_pixels);
-                                for (int32_t p = 0;
-                                     p < encode->channels[file_c].width;
-                                    p++)
-                                {
-                                    cur_line->i32[p] = *channel_pixels++;
-                                }
-                            }
-                            else
-                            {
-                                int32_t* channel_pixels = (int32_t*) (line_pixels);
-                                for (int32_t p = 0;
-                                     p < encode->channels[file_c].width;
-                                    p++)
-                                {
-                                    cur_line->i32[p] = *channel_pixels++;
-                                }
-                            }
-
                             assert (next_comp == c);
-                            cur_line = cs.exchange (cur_line, next_comp);
+                            push_line (line_pixels, file_c);
                         }
 
                         line_pixels += encode->channels[line_c].bytes_per_element *
@@ -486,30 +741,10 @@ ht_apply_impl (exr_encode_pipeline_t* encode)
             {
                 for (int16_t c = 0; c < encode->channel_count; c++)
                 {
-                    int file_c = cs_to_file_ch[c].file_index;
-
-                    if (encode->channels[file_c].data_type == EXR_PIXEL_HALF)
-                    {
-                        int16_t* channel_pixels =
-                            (int16_t*) (line_pixels + cs_to_file_ch[c].raster_line_offset);
-                        for (int32_t p = 0; p < encode->channels[file_c].width;
-                            p++)
-                        {
-                            cur_line->i32[p] = *channel_pixels++;
-                        }
-                    }
-                    else
-                    {
-                        int32_t* channel_pixels =
-                            (int32_t*) (line_pixels + cs_to_file_ch[c].raster_line_offset);
-                        for (int32_t p = 0; p < encode->channels[file_c].width;
-                            p++)
-                        {
-                            cur_line->i32[p] = *channel_pixels++;
-                        }
-                    }
                     assert (next_comp == c);
-                    cur_line = cs.exchange (cur_line, next_comp);
+                    push_line (
+                        line_pixels + cs_to_file_ch[c].raster_line_offset,
+                        cs_to_file_ch[c].file_index);
                 }
                 line_pixels += bpl;
             }
@@ -517,25 +752,42 @@ ht_apply_impl (exr_encode_pipeline_t* encode)
 
         cs.flush ();
 
-        assert (output.get_size () >= 0);
         encode->compressed_bytes = output.get_size () + header_sz;
     } catch (const std::range_error& e) {
         encode->compressed_bytes = encode->packed_bytes;
     }
 
+    /* a chunk the size of the packed data is read back as uncompressed */
+    if (encode->compressed_bytes >= encode->packed_bytes)
+    {
+        memcpy (
+            encode->compressed_buffer,
+            encode->packed_buffer,
+            encode->packed_bytes);
+        encode->compressed_bytes = encode->packed_bytes;
+    }
+
     return rv;
 }
 
 extern "C" exr_result_t
 internal_exr_apply_ht (exr_encode_pipeline_t* encode)
 {
+    exr_result_t            rv;
+    _internal_exr_ht_state* st = acquire_ht_state (encode->context, true);
+
+    if (!st) return EXR_ERR_OUT_OF_MEMORY;
+
     try
     {
-        return ht_apply_impl (encode);
+        rv = ht_apply_impl (st, encode);
     }
     catch ( ... )
     {
+        free_ht_state (encode->context, st);
+        return EXR_ERR_INCORRECT_CHUNK;
     }
 
-    return EXR_ERR_INCORRECT_CHUNK;
+    release_ht_state (encode->context, st);
+    return rv;
 }
@@ -27,6 +27,9 @@
 #define SHORTEST_LONG_RUN (2 + LONG_ZEROCODE_RUN - SHORT_ZEROCODE_RUN)
 #define LONGEST_LONG_RUN (255 + SHORTEST_LONG_RUN)
 
+// most streams the symbols may be split into
+#define HUF_MAX_STREAMS 8
+
 #ifndef OUR_LIKELY
 #    if defined(__GNUC__) || defined(__clang__) || defined(__INTEL_COMPILER)
 #        define OUR_LIKELY(x) (__builtin_expect ((x), 1))
@@ -1594,44 +1597,75 @@ fasthuf_decode_enabled (void)
 #endif
 }
 
-static exr_result_t
-fasthuf_decode (
-    exr_const_context_t         pctxt,
-    FastHufDecoder* NO_ALIAS    fhd,
-    const uint8_t* NO_ALIAS     src,
-    uint64_t                    numSrcBits,
-    uint16_t* NO_ALIAS          dst,
-    uint64_t                    numDstElems)
+//
+// State of the decode of one bitstream
+//
+
+typedef struct FastHufStream
 {
+    //
+    // 64-bit buffer holding the current bits in the stream, and
+    // another holding the next bits in the stream
+    //
+    uint64_t buffer;
+    uint64_t bufferBack;
+    int      bufferNumBits;
+    int      bufferBackNumBits;
+
     //
     // Current position (byte/bit) in the src data stream
     // (after the first buffer fill)
     //
-    uint64_t buffer, bufferBack, dstIdx, tMin;
-    int      bufferNumBits, bufferBackNumBits;
-    uint32_t rleSym;
-
-    const uint8_t* NO_ALIAS currByte = src + 2 * sizeof (uint64_t);
+    const uint8_t* currByte;
+    uint64_t       numSrcBits;
 
-    numSrcBits -= 8 * 2 * sizeof (uint64_t);
+    uint16_t* dst;
+    uint64_t  dstIdx;
+    uint64_t  numDstElems;
+} FastHufStream;
 
-    //
-    // 64-bit buffer holding the current bits in the stream
-    //
+static inline void
+fasthuf_stream_init (
+    FastHufStream* NO_ALIAS st,
+    const uint8_t* NO_ALIAS src,
+    uint64_t                numSrcBits,
+    uint16_t* NO_ALIAS      dst,
+    uint64_t                numDstElems)
+{
+    st->buffer            = READ64 (src);
+    st->bufferNumBits     = 64;
+    st->bufferBack        = READ64 ((src + sizeof (uint64_t)));
+    st->bufferBackNumBits = 64;
+    st->currByte          = src + 2 * sizeof (uint64_t);
+    st->numSrcBits        = numSrcBits - 8 * 2 * sizeof (uint64_t);
+    st->dst               = dst;
+    st->dstIdx            = 0;
+    st->numDstElems       = numDstElems;
+}
 
-    buffer        = READ64 (src);
-    bufferNumBits = 64;
+//
+// Decode the rest of a stream
+//
 
-    //
-    // 64-bit buffer holding the next bits in the stream
-    //
+static exr_result_t
+fasthuf_decode (
+    exr_const_context_t             pctxt,
+    FastHufDecoder* NO_ALIAS        fhd,
+    const FastHufStream* NO_ALIAS   st)
+{
+    uint64_t buffer            = st->buffer;
+    uint64_t bufferBack        = st->bufferBack;
+    int      bufferNumBits     = st->bufferNumBits;
+    int      bufferBackNumBits = st->bufferBackNumBits;
 
-    bufferBack        = READ64 ((src + sizeof (uint64_t)));
-    bufferBackNumBits = 64;
-    dstIdx            = 0;
+    const uint8_t* NO_ALIAS currByte = st->currByte;
 
-    tMin = fhd->_tableMin;
-    rleSym = fhd->_rleSymbol;
+    uint64_t  numSrcBits  = st->numSrcBits;
+    uint16_t* dst         = st->dst;
+    uint64_t  dstIdx      = st->dstIdx;
+    uint64_t  numDstElems = st->numDstElems;
+    uint64_t  tMin        = fhd->_tableMin;
+    uint32_t  rleSym      = fhd->_rleSymbol;
 
     while (dstIdx < numDstElems)
     {
@@ -1818,6 +1852,221 @@ fasthuf_decode (
     return EXR_ERR_SUCCESS;
 }
 
+// Symbols each stream decodes per round of fasthuf_decode_streams
+#define FASTHUF_ROUND_SYMBOLS 4
+
+// Bits a stream must have left to start a round: a round uses at most
+// FASTHUF_ROUND_SYMBOLS * (MAX_CODE_LEN + 8) bits, the loads past
+// those, and then the two 64-bit loads to resume the stream with
+// fasthuf_decode after it
+#define FASTHUF_ROUND_MARGIN_BITS 512
+
+//
+// Decode several streams sharing one table a few symbols from each
+// at a time, so the (serial) work of one stream overlaps with the
+// others. The codes are read from a window loaded at the bit position
+// of the stream, which is cheaper than keeping the buffers of
+// fasthuf_decode topped up, while every stream has data and output
+// enough left for a round without further checks. The ends of the
+// streams are left to fasthuf_decode.
+//
+
+static exr_result_t
+fasthuf_decode_streams (
+    exr_const_context_t            pctxt,
+    FastHufDecoder* NO_ALIAS       fhd,
+    const uint8_t* const* NO_ALIAS src,
+    const uint64_t* NO_ALIAS       numSrcBits,
+    uint16_t* const* NO_ALIAS      dst,
+    const uint64_t* NO_ALIAS       numDstElems,
+    int                            nstreams)
+{
+    uint64_t      pos[HUF_MAX_STREAMS];
+    uint64_t      posEnd[HUF_MAX_STREAMS];
+    uint64_t      dstIdx[HUF_MAX_STREAMS];
+    uint64_t      tMin   = fhd->_tableMin;
+    int           rleSym = fhd->_rleSymbol;
+    FastHufStream st;
+    exr_result_t  rv;
+    int           s;
+
+    for (s = 0; s < nstreams; ++s)
+    {
+        pos[s]    = 0;
+        posEnd[s] = (numSrcBits[s] > FASTHUF_ROUND_MARGIN_BITS)
+                        ? numSrcBits[s] - FASTHUF_ROUND_MARGIN_BITS
+                        : 0;
+        dstIdx[s] = 0;
+    }
+
+    for (;;)
+    {
+        for (s = 0; s < nstreams; ++s)
+        {
+            if (pos[s] >= posEnd[s] ||
+                dstIdx[s] + FASTHUF_ROUND_SYMBOLS * 256 > numDstElems[s])
+                break;
+        }
+        if (s < nstreams) break;
+
+        for (s = 0; s < nstreams; ++s)
+        {
+            const uint8_t* p;
+            uint16_t*      d     = dst[s];
+            uint64_t       di    = dstIdx[s];
+            uint64_t       bits  = pos[s];
+            uint64_t       w     = 0;
+            int            avail = 0; // valid bits at the top of w
+
+            for (int k = 0; k < FASTHUF_ROUND_SYMBOLS; ++k)
+            {
+                int symbol, codeLen;
+
+                if (avail < TABLE_LOOKUP_BITS)
+                {
+                    w = READ64 (src[s] + (bits >> 3));
+                    w <<= (bits & 7);
+                    avail = 64 - (int) (bits & 7);
+                }
+
+                if (OUR_LIKELY(tMin <= w))
+                {
+                    int tableIdx = (int) (w >> INDEX_BIT_SHIFT);
+                    codeLen      = fhd->_tableCodeLen[tableIdx];
+                    symbol       = fhd->_tableSymbol[tableIdx];
+                }
+                else
+                {
+                    uint64_t id;
+
+                    // a long code may need more bits than are left,
+                    // up to the full 64 bits
+                    if (avail < fhd->_maxCodeLength)
+                    {
+                        p = src[s] + (bits >> 3);
+                        w = READ64 (p);
+                        if (bits & 7)
+                        {
+                            w <<= (bits & 7);
+                            w |= ((uint64_t) p[8]) >> (8 - (bits & 7));
+                        }
+                        avail = 64;
+                    }
+
+                    codeLen = TABLE_LOOKUP_BITS + 1;
+                    while (fhd->_ljBase[codeLen] > w)
+                        codeLen++;
+
+                    id = fhd->_ljOffset[codeLen] + (w >> (64 - codeLen));
+                    if (OUR_UNLIKELY(
+                            codeLen > fhd->_maxCodeLength ||
+                            id >= (uint64_t) fhd->_numSymbols))
+                    {
+                        if (pctxt)
+                            pctxt->print_error (
+                                pctxt,
+                                EXR_ERR_CORRUPT_CHUNK,
+                                "Huffman decode error (Decoded an invalid symbol)");
+                        return EXR_ERR_CORRUPT_CHUNK;
+                    }
+                    symbol = fhd->_idToSymbol[id];
+                }
+
+                w <<= codeLen;
+                avail -= codeLen;
+                bits += (uint64_t) codeLen;
+
+                if (symbol == rleSym)
+                {
+                    uint32_t rleCount;
+
+                    if (avail < 8)
+                    {
+                        w = READ64 (src[s] + (bits >> 3));
+                        w <<= (bits & 7);
+                        avail = 64 - (int) (bits & 7);
+                    }
+                    rleCount = (uint32_t) (w >> 56);
+
+                    if (OUR_UNLIKELY(di < 1 || rleCount == 0))
+                    {
+                        if (pctxt)
+                            pctxt->print_error (
+                                pctxt,
+                                EXR_ERR_CORRUPT_CHUNK,
+                                "Huffman decode error (Invalid RLE code)");
+                        return EXR_ERR_CORRUPT_CHUNK;
+                    }
+
+                    for (uint32_t i = 0; i < rleCount; ++i)
+                        d[di + (uint64_t) i] = d[di - 1];
+
+                    di += rleCount;
+                    w <<= 8;
+                    avail -= 8;
+                    bits += 8;
+                }
+                else
+                    d[di++] = (uint16_t) symbol;
+            }
+
+            pos[s]    = bits;
+            dstIdx[s] = di;
+        }
+    }
+
+    for (s = 0; s < nstreams; ++s)
+    {
+        uint64_t skip = pos[s] & 7;
+
+        fasthuf_stream_init (
+            &st,
+            src[s] + (pos[s] >> 3),
+            numSrcBits[s] - (pos[s] - skip),
+            dst[s],
+            numDstElems[s]);
+        st.buffer <<= skip;
+        st.bufferNumBits -= (int) skip;
+        st.dstIdx = dstIdx[s];
+
+        rv = fasthuf_decode (pctxt, fhd, &st);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+//
+// Layout of the symbols split into several streams: the symbols are
+// cut into nstreams runs of (nearly) equal length, each coded into
+// its own bitstream with the one table. The header of the single
+// stream layout is kept, with the number of streams in the word which
+// is otherwise zero, and the table is followed by the length in bits
+// of each stream, then the streams, each starting on a byte. nBits is
+// the size in bits of all of that after the table.
+//
+
+// shorter streams do not save enough to pay for their length and
+// padding
+#define HUF_MIN_STREAM_SYMBOLS 4096
+
+static inline uint64_t
+huf_stream_start (uint64_t nRaw, int nstreams, int s)
+{
+    return ((nRaw + (uint64_t) nstreams - 1) / (uint64_t) nstreams) *
+           (uint64_t) s;
+}
+
+static inline uint64_t
+huf_stream_symbols (uint64_t nRaw, int nstreams, int s)
+{
+    if (s + 1 < nstreams)
+        return huf_stream_start (nRaw, nstreams, s + 1) -
+               huf_stream_start (nRaw, nstreams, s);
+    return nRaw - huf_stream_start (nRaw, nstreams, s);
+}
+
 /**************************************/
 
 uint64_t
@@ -1850,6 +2099,7 @@ internal_huf_compress (
     uint64_t        outsz,
     const uint16_t* raw,
     uint64_t        nRaw,
+    int             nstreams,
     void*           spare,
     uint64_t        sparebytes)
 {
@@ -1874,8 +2124,12 @@ internal_huf_compress (
     }
 
     if (outsz < 20) return EXR_ERR_INVALID_ARGUMENT;
-    if (sparebytes != internal_exr_huf_compress_spare_bytes ())
+    if (sparebytes < internal_exr_huf_compress_spare_bytes ())
         return EXR_ERR_INVALID_ARGUMENT;
+    if (nstreams < 1 || nstreams > HUF_MAX_STREAMS)
+        return EXR_ERR_INVALID_ARGUMENT;
+
+    if (nRaw < (uint64_t) nstreams * HUF_MIN_STREAM_SYMBOLS) nstreams = 1;
 
     freq  = (uint64_t*) spare;
     scode = freq + HUF_ENCSIZE;
@@ -1893,16 +2147,51 @@ internal_huf_compress (
         (uint32_t) (((uintptr_t) tableEnd) - ((uintptr_t) tableStart));
     dataStart = tableEnd;
 
-    rv = hufEncode (freq, raw, nRaw, iM, dataStart, maxcompout, &nBits);
-    if (rv != EXR_ERR_SUCCESS) return rv;
+    if (nstreams > 1)
+    {
+        uint8_t* streamLengths = tableEnd;
+        uint64_t totalBits;
+
+        if ((uint64_t) (maxcompout - tableEnd) < 4 * (uint64_t) nstreams)
+            return EXR_ERR_ARGUMENT_OUT_OF_RANGE;
+        dataStart = tableEnd + 4 * nstreams;
 
-    dataLength = (nBits + 7) / 8;
+        for (int s = 0; s < nstreams; ++s)
+        {
+            rv = hufEncode (
+                freq,
+                raw + huf_stream_start (nRaw, nstreams, s),
+                huf_stream_symbols (nRaw, nstreams, s),
+                iM,
+                dataStart,
+                maxcompout,
+                &nBits);
+            if (rv != EXR_ERR_SUCCESS) return rv;
+
+            writeUInt (streamLengths + 4 * s, nBits);
+            dataStart += (nBits + 7) / 8;
+        }
+
+        totalBits = ((uint64_t) (dataStart - tableEnd)) * 8;
+        if (totalBits > (uint64_t) UINT32_MAX)
+            return EXR_ERR_ARGUMENT_OUT_OF_RANGE;
+        nBits      = (uint32_t) totalBits;
+        dataLength = 0;
+    }
+    else
+    {
+        rv = hufEncode (freq, raw, nRaw, iM, dataStart, maxcompout, &nBits);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+
+        dataLength = (nBits + 7) / 8;
+    }
 
     writeUInt (compressed, im);
     writeUInt (compressed + 4, iM);
     writeUInt (compressed + 8, tableLength);
     writeUInt (compressed + 12, nBits);
-    writeUInt (compressed + 16, 0); // room for future extensions
+    // room for future extensions, and now the stream count
+    writeUInt (compressed + 16, (nstreams > 1) ? (uint32_t) nstreams : 0);
 
     *encbytes =
         (((uintptr_t) dataStart) + ((uintptr_t) dataLength) -
@@ -1910,6 +2199,60 @@ internal_huf_compress (
     return EXR_ERR_SUCCESS;
 }
 
+//
+// Find the streams of the multiple stream layout, and check they fit
+// in the data and produce the expected number of symbols
+//
+
+static exr_result_t
+huf_find_streams (
+    exr_const_context_t pctxt,
+    const uint8_t*      compressed,
+    uint64_t            nCompressed,
+    uint32_t            tableLength,
+    uint64_t            nBytes,
+    uint64_t            nRaw,
+    int                 nstreams,
+    const uint8_t**     streamData,
+    uint64_t*           streamBits)
+{
+    const uint8_t* streamLengths = compressed + 20 + (uint64_t) tableLength;
+    const uint8_t* dataEnd;
+    const uint8_t* next;
+
+    if ((uint64_t) tableLength + 20 + nBytes > nCompressed ||
+        nBytes < 4 * (uint64_t) nstreams ||
+        huf_stream_start (nRaw, nstreams, nstreams - 1) >= nRaw)
+    {
+        if (pctxt)
+            pctxt->print_error (
+                pctxt,
+                EXR_ERR_CORRUPT_CHUNK,
+                "Huffman decode error (Invalid stream layout)");
+        return EXR_ERR_CORRUPT_CHUNK;
+    }
+
+    dataEnd = streamLengths + nBytes;
+    next    = streamLengths + 4 * nstreams;
+    for (int s = 0; s < nstreams; ++s)
+    {
+        streamBits[s] = readUInt (streamLengths + 4 * s);
+        streamData[s] = next;
+        if ((streamBits[s] + 7) / 8 > (uint64_t) (dataEnd - next))
+        {
+            if (pctxt)
+                pctxt->print_error (
+                    pctxt,
+                    EXR_ERR_CORRUPT_CHUNK,
+                    "Huffman decode error (Stream %d past end of data)",
+                    s);
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+        next += (streamBits[s] + 7) / 8;
+    }
+    return EXR_ERR_SUCCESS;
+}
+
 exr_result_t
 internal_huf_decompress (
     exr_decode_pipeline_t* decode,
@@ -1920,12 +2263,15 @@ internal_huf_decompress (
     void*                  spare,
     uint64_t               sparebytes)
 {
-    uint32_t            im, iM, nBits;
+    uint32_t            im, iM, nBits, tableLength, nstreams;
     uint64_t            nBytes;
     const uint8_t*      ptr;
     exr_result_t        rv;
     exr_const_context_t pctxt            = NULL;
     const uint64_t      hufInfoBlockSize = 5 * sizeof (uint32_t);
+    const uint8_t*      streamData[HUF_MAX_STREAMS];
+    uint64_t            streamBits[HUF_MAX_STREAMS];
+    int                 fast;
 
     if (decode) pctxt = decode->context;
     //
@@ -1937,14 +2283,14 @@ internal_huf_decompress (
         return EXR_ERR_SUCCESS;
     }
 
-    if (sparebytes != internal_exr_huf_decompress_spare_bytes ())
+    if (sparebytes < internal_exr_huf_decompress_spare_bytes ())
         return EXR_ERR_INVALID_ARGUMENT;
 
-    im = readUInt (compressed);
-    iM = readUInt (compressed + 4);
-    // uint32_t tableLength = readUInt (compressed + 8);
-    nBits = readUInt (compressed + 12);
-    // uint32_t future = readUInt (compressed + 16);
+    im          = readUInt (compressed);
+    iM          = readUInt (compressed + 4);
+    tableLength = readUInt (compressed + 8);
+    nBits       = readUInt (compressed + 12);
+    nstreams    = readUInt (compressed + 16);
 
     if (im >= HUF_ENCSIZE || iM >= HUF_ENCSIZE) return EXR_ERR_CORRUPT_CHUNK;
 
@@ -1955,22 +2301,81 @@ internal_huf_decompress (
     // must be nBytes remaining in buffer
     if (hufInfoBlockSize + nBytes > nCompressed) return EXR_ERR_OUT_OF_MEMORY;
 
+    if (nstreams != 0)
+    {
+        if (nstreams < 2 || nstreams > HUF_MAX_STREAMS)
+        {
+            if (pctxt)
+                pctxt->print_error (
+                    pctxt,
+                    EXR_ERR_CORRUPT_CHUNK,
+                    "Huffman decode error (Invalid stream count %u)",
+                    nstreams);
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+
+        rv = huf_find_streams (
+            pctxt,
+            compressed,
+            nCompressed,
+            tableLength,
+            nBytes,
+            nRaw,
+            (int) nstreams,
+            streamData,
+            streamBits);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+    }
+    else
+    {
+        nstreams      = 1;
+        streamBits[0] = nBits;
+    }
+
     //
     // Fast decoder needs at least 2x64-bits of compressed data, and
     // needs to be run-able on this platform. Otherwise, fall back
     // to the original decoder
     //
-    if (fasthuf_decode_enabled () && nBits > 128)
+    fast = fasthuf_decode_enabled ();
+    for (uint32_t s = 0; s < nstreams; ++s)
+        if (streamBits[s] <= 128) fast = 0;
+
+    if (fast)
     {
         FastHufDecoder* fhd = (FastHufDecoder*) spare;
 
         rv = fasthuf_initialize (
             pctxt, fhd, &ptr, nCompressed - hufInfoBlockSize, im, iM, (int) iM);
-        if (rv == EXR_ERR_SUCCESS)
+        if (rv == EXR_ERR_SUCCESS && nstreams > 1)
         {
+            uint16_t* streamDst[HUF_MAX_STREAMS];
+            uint64_t  streamSymbols[HUF_MAX_STREAMS];
+
+            for (int s = 0; s < (int) nstreams; ++s)
+            {
+                streamDst[s] =
+                    raw + huf_stream_start (nRaw, (int) nstreams, s);
+                streamSymbols[s] =
+                    huf_stream_symbols (nRaw, (int) nstreams, s);
+            }
+            rv = fasthuf_decode_streams (
+                pctxt,
+                fhd,
+                streamData,
+                streamBits,
+                streamDst,
+                streamSymbols,
+                (int) nstreams);
+        }
+        else if (rv == EXR_ERR_SUCCESS)
+        {
+            FastHufStream st;
+
             if ((uint64_t) (ptr - compressed) + nBytes > nCompressed)
                 return EXR_ERR_OUT_OF_MEMORY;
-            rv = fasthuf_decode (pctxt, fhd, ptr, nBits, raw, nRaw);
+            fasthuf_stream_init (&st, ptr, nBits, raw, nRaw);
+            rv = fasthuf_decode (pctxt, fhd, &st);
         }
     }
     else
@@ -1985,7 +2390,19 @@ internal_huf_decompress (
         if (nBits > 8 * nLeft) return EXR_ERR_CORRUPT_CHUNK;
 
         rv = hufBuildDecTable (pctxt, freq, im, iM, hdec);
-        if (rv == EXR_ERR_SUCCESS)
+        if (rv == EXR_ERR_SUCCESS && nstreams > 1)
+        {
+            for (int s = 0; s < (int) nstreams && rv == EXR_ERR_SUCCESS; ++s)
+                rv = hufDecode (
+                    freq,
+                    hdec,
+                    streamData[s],
+                    streamBits[s],
+                    iM,
+                    huf_stream_symbols (nRaw, (int) nstreams, s),
+                    raw + huf_stream_start (nRaw, (int) nstreams, s));
+        }
+        else if (rv == EXR_ERR_SUCCESS)
             rv = hufDecode (freq, hdec, ptr, nBits, iM, nRaw, raw);
 
         hufFreeDecTable (pctxt, hdec);
@@ -9,6 +9,10 @@
 #include "openexr_errors.h"
 #include "openexr_decode.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 uint64_t internal_exr_huf_compress_spare_bytes (void);
 uint64_t internal_exr_huf_decompress_spare_bytes (void);
 
@@ -18,6 +22,7 @@ exr_result_t internal_huf_compress (
     uint64_t        outsz,
     const uint16_t* raw,
     uint64_t        nRaw,
+    int             nstreams,
     void*           spare,
     uint64_t        sparebytes);
 
@@ -30,4 +35,8 @@ exr_result_t internal_huf_decompress (
     void*                  spare,
     uint64_t               sparebytes);
 
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
 #endif /* OPENEXR_CORE_HUF_CODING_H */
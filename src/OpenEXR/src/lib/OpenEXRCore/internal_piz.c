@@ -135,44 +135,6 @@ wenc14 (uint16_t a, uint16_t b, uint16_t* l, uint16_t* h)
     *h = (uint16_t) ds;
 }
 
-static inline void
-wdec14_4 (uint16_t* px, uint16_t* p01, uint16_t* p10, uint16_t* p11)
-{
-    /* pre swap
-     * px, p01, p10, p11
-     * px -> a
-     * p10 -> b
-     * p01 -> c
-     * p11 -> d
-     * */
-    int16_t a = (int16_t) *px;
-    int16_t b = (int16_t) *p10;
-    int16_t c = (int16_t) *p01;
-    int16_t d = (int16_t) *p11;
-
-    int ai = (int) a;
-    int bi = (int) b;
-    int ci = (int) c;
-    int di = (int) d;
-
-    int i00 = ai + (bi & 1) + (bi >> 1);
-    int i10 = i00 - bi;
-    int i01 = ci + (di & 1) + (di >> 1);
-    int i11 = i01 - di;
-
-    ai = i00 + (i01 & 1) + (i01 >> 1);
-    bi = ai - i01;
-    ci = i10 + (i11 & 1) + (i11 >> 1);
-    di = ci - i11;
-
-    /* different output order */
-    /* px, p01, p10, p11 */
-    *px  = (uint16_t) ai;
-    *p01 = (uint16_t) bi;
-    *p10 = (uint16_t) ci;
-    *p11 = (uint16_t) di;
-}
-
 static inline void
 wdec14 (uint16_t l, uint16_t h, uint16_t* a, uint16_t* b)
 {
@@ -229,232 +191,648 @@ wdec16 (uint16_t l, uint16_t h, uint16_t* a, uint16_t* b)
 
 /**************************************/
 
-static void
-wav_2D_encode (uint16_t* in, int nx, int ox, int ny, int oy, uint16_t mx)
+/* Each level of the transform is done a row pair at a time: the
+ * horizontal step splits each row into its even and odd samples, and
+ * the vertical step combines the two rows element by element. The words of 32-bit channels are
+ * transformed independently but in the same pattern, so both words of
+ * a value are handled in the same pass by pairing whole values. The
+ * vector code reproduces the 16-bit arithmetic of the functions above
+ * exactly.
+ */
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define PIZ_USE_SSE2_WAVELET
+#    include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#    define PIZ_USE_NEON_WAVELET
+#    include <arm_neon.h>
+#endif
+
+enum wav_op
 {
-    int w14 = (mx < (1 << 14)) ? 1 : 0;
-    int n   = (nx > ny) ? ny : nx;
-    int p   = 1; // == 1 <<  level
-    int p2  = 2; // == 1 << (level+1)
+    WAV_ENC14,
+    WAV_ENC16,
+    WAV_DEC14,
+    WAV_DEC16
+};
 
-    //
-    // Hierarchical loop on smaller dimension n
-    //
+static inline void
+wav_op_1 (uint16_t* a, uint16_t* b, enum wav_op op)
+{
+    switch (op)
+    {
+        case WAV_ENC14: wenc14 (*a, *b, a, b); break;
+        case WAV_ENC16: wenc16 (*a, *b, a, b); break;
+        case WAV_DEC14: wdec14 (*a, *b, a, b); break;
+        case WAV_DEC16: wdec16 (*a, *b, a, b); break;
+    }
+}
+
+#if defined(PIZ_USE_SSE2_WAVELET)
+
+typedef __m128i wav_vec_t;
+
+static inline wav_vec_t
+wav_load (const uint16_t* p)
+{
+    return _mm_loadu_si128 ((const __m128i*) p);
+}
+
+static inline void
+wav_store (uint16_t* p, wav_vec_t v)
+{
+    _mm_storeu_si128 ((__m128i*) p, v);
+}
+
+/* 8 pairs of 16-bit values */
+static inline void
+wav_load_pairs16 (const uint16_t* p, wav_vec_t* a, wav_vec_t* b)
+{
+    __m128i v0 = wav_load (p);
+    __m128i v1 = wav_load (p + 8);
+
+    /* sign extended, so the saturation never applies */
+    *a = _mm_packs_epi32 (
+        _mm_srai_epi32 (_mm_slli_epi32 (v0, 16), 16),
+        _mm_srai_epi32 (_mm_slli_epi32 (v1, 16), 16));
+    *b = _mm_packs_epi32 (_mm_srai_epi32 (v0, 16), _mm_srai_epi32 (v1, 16));
+}
+
+static inline void
+wav_store_pairs16 (uint16_t* p, wav_vec_t a, wav_vec_t b)
+{
+    wav_store (p, _mm_unpacklo_epi16 (a, b));
+    wav_store (p + 8, _mm_unpackhi_epi16 (a, b));
+}
+
+/* 4 pairs of 32-bit values */
+static inline void
+wav_load_pairs32 (const uint16_t* p, wav_vec_t* a, wav_vec_t* b)
+{
+    __m128 v0 = _mm_castsi128_ps (wav_load (p));
+    __m128 v1 = _mm_castsi128_ps (wav_load (p + 8));
 
-    while (p2 <= n)
+    *a = _mm_castps_si128 (_mm_shuffle_ps (v0, v1, _MM_SHUFFLE (2, 0, 2, 0)));
+    *b = _mm_castps_si128 (_mm_shuffle_ps (v0, v1, _MM_SHUFFLE (3, 1, 3, 1)));
+}
+
+static inline void
+wav_store_pairs32 (uint16_t* p, wav_vec_t a, wav_vec_t b)
+{
+    wav_store (p, _mm_unpacklo_epi32 (a, b));
+    wav_store (p + 8, _mm_unpackhi_epi32 (a, b));
+}
+
+static inline void
+wav_op_v (wav_vec_t* a, wav_vec_t* b, enum wav_op op)
+{
+    const __m128i one  = _mm_set1_epi16 (1);
+    const __m128i bias = _mm_set1_epi16 ((short) A_OFFSET);
+    __m128i       l, h, ao;
+
+    switch (op)
     {
-        uint16_t* py  = in;
-        uint16_t* ey  = in + oy * (ny - p2);
-        int       oy1 = oy * p;
-        int       oy2 = oy * p2;
-        int       ox1 = ox * p;
-        int       ox2 = ox * p2;
-        uint16_t  i00, i01, i10, i11;
-
-        //
-        // Y loop
-        //
-
-        for (; py <= ey; py += oy2)
-        {
-            uint16_t* px = py;
-            uint16_t* ex = py + ox * (nx - p2);
+        case WAV_ENC14:
+            /* (a + b) >> 1 without leaving 16 bits */
+            l = _mm_add_epi16 (
+                _mm_add_epi16 (_mm_srai_epi16 (*a, 1), _mm_srai_epi16 (*b, 1)),
+                _mm_and_si128 (_mm_and_si128 (*a, *b), one));
+            *b = _mm_sub_epi16 (*a, *b);
+            *a = l;
+            break;
+        case WAV_ENC16:
+            ao = _mm_xor_si128 (*a, bias);
+            l  = _mm_add_epi16 (
+                _mm_add_epi16 (_mm_srli_epi16 (ao, 1), _mm_srli_epi16 (*b, 1)),
+                _mm_and_si128 (_mm_and_si128 (ao, *b), one));
+            /* d < 0, i.e. ao < b unsigned */
+            h = _mm_cmplt_epi16 (*a, _mm_xor_si128 (*b, bias));
+            l  = _mm_add_epi16 (l, _mm_and_si128 (h, bias));
+            *b = _mm_sub_epi16 (ao, *b);
+            *a = l;
+            break;
+        case WAV_DEC14:
+            h  = *b;
+            *a = _mm_add_epi16 (
+                _mm_add_epi16 (*a, _mm_and_si128 (h, one)),
+                _mm_srai_epi16 (h, 1));
+            *b = _mm_sub_epi16 (*a, h);
+            break;
+        case WAV_DEC16:
+            h  = *b;
+            *b = _mm_sub_epi16 (*a, _mm_srli_epi16 (h, 1));
+            *a = _mm_add_epi16 (_mm_add_epi16 (h, *b), bias);
+            break;
+    }
+}
+
+#elif defined(PIZ_USE_NEON_WAVELET)
+
+typedef uint16x8_t wav_vec_t;
+
+static inline wav_vec_t
+wav_load (const uint16_t* p)
+{
+    return vld1q_u16 (p);
+}
+
+static inline void
+wav_store (uint16_t* p, wav_vec_t v)
+{
+    vst1q_u16 (p, v);
+}
+
+static inline void
+wav_load_pairs16 (const uint16_t* p, wav_vec_t* a, wav_vec_t* b)
+{
+    uint16x8x2_t v = vld2q_u16 (p);
+    *a             = v.val[0];
+    *b             = v.val[1];
+}
 
-            //
-            // X loop
-            //
+static inline void
+wav_store_pairs16 (uint16_t* p, wav_vec_t a, wav_vec_t b)
+{
+    uint16x8x2_t v;
+    v.val[0] = a;
+    v.val[1] = b;
+    vst2q_u16 (p, v);
+}
+
+static inline void
+wav_load_pairs32 (const uint16_t* p, wav_vec_t* a, wav_vec_t* b)
+{
+    uint32x4x2_t v = vld2q_u32 ((const uint32_t*) p);
+    *a             = vreinterpretq_u16_u32 (v.val[0]);
+    *b             = vreinterpretq_u16_u32 (v.val[1]);
+}
+
+static inline void
+wav_store_pairs32 (uint16_t* p, wav_vec_t a, wav_vec_t b)
+{
+    uint32x4x2_t v;
+    v.val[0] = vreinterpretq_u32_u16 (a);
+    v.val[1] = vreinterpretq_u32_u16 (b);
+    vst2q_u32 ((uint32_t*) p, v);
+}
+
+static inline void
+wav_op_v (wav_vec_t* a, wav_vec_t* b, enum wav_op op)
+{
+    const uint16x8_t one  = vdupq_n_u16 (1);
+    const uint16x8_t bias = vdupq_n_u16 ((uint16_t) A_OFFSET);
+    uint16x8_t       l, h, ao;
+
+    switch (op)
+    {
+        case WAV_ENC14:
+            l = vreinterpretq_u16_s16 (vhaddq_s16 (
+                vreinterpretq_s16_u16 (*a), vreinterpretq_s16_u16 (*b)));
+            *b = vsubq_u16 (*a, *b);
+            *a = l;
+            break;
+        case WAV_ENC16:
+            ao = veorq_u16 (*a, bias);
+            l  = vaddq_u16 (
+                vhaddq_u16 (ao, *b), vandq_u16 (vcltq_u16 (ao, *b), bias));
+            *b = vsubq_u16 (ao, *b);
+            *a = l;
+            break;
+        case WAV_DEC14:
+            h  = *b;
+            *a = vaddq_u16 (
+                vaddq_u16 (*a, vandq_u16 (h, one)),
+                vreinterpretq_u16_s16 (
+                    vshrq_n_s16 (vreinterpretq_s16_u16 (h), 1)));
+            *b = vsubq_u16 (*a, h);
+            break;
+        case WAV_DEC16:
+            h  = *b;
+            *b = vsubq_u16 (*a, vshrq_n_u16 (h, 1));
+            *a = vaddq_u16 (vaddq_u16 (h, *b), bias);
+            break;
+    }
+}
+
+#endif
+
+static inline void
+wav_butterfly (
+    uint16_t* p00, uint16_t* p01, uint16_t* p10, uint16_t* p11, enum wav_op op)
+{
+    /* in locals, as the rows could alias */
+    uint16_t v00 = *p00;
+    uint16_t v01 = *p01;
+    uint16_t v10 = *p10;
+    uint16_t v11 = *p11;
+
+    /* encoding goes across then down, decoding the reverse */
+    if (op == WAV_ENC14 || op == WAV_ENC16)
+    {
+        wav_op_1 (&v00, &v01, op);
+        wav_op_1 (&v10, &v11, op);
+        wav_op_1 (&v00, &v10, op);
+        wav_op_1 (&v01, &v11, op);
+    }
+    else
+    {
+        wav_op_1 (&v00, &v10, op);
+        wav_op_1 (&v01, &v11, op);
+        wav_op_1 (&v00, &v01, op);
+        wav_op_1 (&v10, &v11, op);
+    }
+
+    *p00 = v00;
+    *p01 = v01;
+    *p10 = v10;
+    *p11 = v11;
+}
+
+/* The values a level works on, nx by ny of them with ox words each,
+ * xs words apart in a row and rows ys words apart. Each level works on
+ * the values at even x and y of the level before, nx / 2 by ny / 2 of
+ * them (rounded down, so a last odd value drops out of the coarser
+ * levels).
+ */
+typedef struct
+{
+    uint16_t* p;
+    int       nx, ny;
+    size_t    xs, ys;
+} wav_grid_t;
+
+static inline void
+wav_level_rows (
+    uint16_t* row0, uint16_t* row1, int nx, int ox, size_t xs, enum wav_op op)
+{
+    int enc = (op == WAV_ENC14 || op == WAV_ENC16);
+    int x   = 0;
 
-            for (; px <= ex; px += ox2)
+#if defined(PIZ_USE_SSE2_WAVELET) || defined(PIZ_USE_NEON_WAVELET)
+    /* 16 words at a time, when the values are neighbours */
+    if (xs == (size_t) ox)
+    {
+        for (; x + 16 / ox <= (nx & ~1); x += 16 / ox)
+        {
+            uint16_t* p0 = row0 + x * ox;
+            uint16_t* p1 = row1 + x * ox;
+            wav_vec_t a0, b0, a1, b1;
+
+            if (ox == 1)
             {
-                uint16_t* p01 = px + ox1;
-                uint16_t* p10 = px + oy1;
-                uint16_t* p11 = p10 + ox1;
-
-                //
-                // 2D wavelet encoding
-                //
-
-                if (w14)
-                {
-                    wenc14 (*px, *p01, &i00, &i01);
-                    wenc14 (*p10, *p11, &i10, &i11);
-                    wenc14 (i00, i10, px, p10);
-                    wenc14 (i01, i11, p01, p11);
-                }
-                else
-                {
-                    wenc16 (*px, *p01, &i00, &i01);
-                    wenc16 (*p10, *p11, &i10, &i11);
-                    wenc16 (i00, i10, px, p10);
-                    wenc16 (i01, i11, p01, p11);
-                }
+                wav_load_pairs16 (p0, &a0, &b0);
+                wav_load_pairs16 (p1, &a1, &b1);
+            }
+            else
+            {
+                wav_load_pairs32 (p0, &a0, &b0);
+                wav_load_pairs32 (p1, &a1, &b1);
             }
 
-            //
-            // Encode (1D) odd column (still in Y loop)
-            //
-
-            if (nx & p)
+            if (enc)
+            {
+                wav_op_v (&a0, &b0, op);
+                wav_op_v (&a1, &b1, op);
+            }
+            wav_op_v (&a0, &a1, op);
+            wav_op_v (&b0, &b1, op);
+            if (!enc)
             {
-                uint16_t* p10 = px + oy1;
+                wav_op_v (&a0, &b0, op);
+                wav_op_v (&a1, &b1, op);
+            }
 
-                if (w14)
-                    wenc14 (*px, *p10, px, p10);
-                else
-                    wenc16 (*px, *p10, px, p10);
+            if (ox == 1)
+            {
+                wav_store_pairs16 (p0, a0, b0);
+                wav_store_pairs16 (p1, a1, b1);
+            }
+            else
+            {
+                wav_store_pairs32 (p0, a0, b0);
+                wav_store_pairs32 (p1, a1, b1);
             }
         }
+    }
+#else
+    (void) enc;
+#endif
+    for (; x + 1 < nx; x += 2)
+    {
+        uint16_t* p0 = row0 + x * xs;
+        uint16_t* p1 = row1 + x * xs;
+
+        wav_butterfly (p0, p0 + xs, p1, p1 + xs, op);
+        if (ox == 2)
+            wav_butterfly (p0 + 1, p0 + xs + 1, p1 + 1, p1 + xs + 1, op);
+    }
 
-        //
-        // Encode (1D) odd line (must loop in X)
-        //
+    /* odd column, only combined down */
+    if (nx & 1)
+    {
+        uint16_t* p0 = row0 + x * xs;
+        uint16_t* p1 = row1 + x * xs;
+
+        wav_op_1 (p0, p1, op);
+        if (ox == 2) wav_op_1 (p0 + 1, p1 + 1, op);
+    }
+}
 
-        if (ny & p)
+/* odd line, only combined across */
+static inline void
+wav_level_last_row (uint16_t* row, int nx, int ox, size_t xs, enum wav_op op)
+{
+    int x = 0;
+
+#if defined(PIZ_USE_SSE2_WAVELET) || defined(PIZ_USE_NEON_WAVELET)
+    if (xs == (size_t) ox)
+    {
+        for (; x + 16 / ox <= (nx & ~1); x += 16 / ox)
         {
-            uint16_t* px = py;
-            uint16_t* ex = py + ox * (nx - p2);
+            uint16_t* p0 = row + x * ox;
+            wav_vec_t a, b;
 
-            for (; px <= ex; px += ox2)
+            if (ox == 1)
             {
-                uint16_t* p01 = px + ox1;
+                wav_load_pairs16 (p0, &a, &b);
+                wav_op_v (&a, &b, op);
+                wav_store_pairs16 (p0, a, b);
+            }
+            else
+            {
+                wav_load_pairs32 (p0, &a, &b);
+                wav_op_v (&a, &b, op);
+                wav_store_pairs32 (p0, a, b);
+            }
+        }
+    }
+#endif
+    for (; x + 1 < nx; x += 2)
+    {
+        uint16_t* p0 = row + x * xs;
+
+        wav_op_1 (p0, p0 + xs, op);
+        if (ox == 2) wav_op_1 (p0 + 1, p0 + xs + 1, op);
+    }
+}
+
+static inline void
+wav_level_impl (const wav_grid_t* g, int ox, enum wav_op op)
+{
+    int y;
+
+    for (y = 0; y + 1 < g->ny; y += 2)
+        wav_level_rows (
+            g->p + ((size_t) y) * g->ys,
+            g->p + ((size_t) (y + 1)) * g->ys,
+            g->nx,
+            ox,
+            g->xs,
+            op);
+
+    if (g->ny & 1)
+        wav_level_last_row (g->p + ((size_t) y) * g->ys, g->nx, ox, g->xs, op);
+}
+
+static void
+wav_level (const wav_grid_t* g, int ox, enum wav_op op)
+{
+    /* a copy of the loops for each, rather than choosing per pair */
+    switch (op)
+    {
+        case WAV_ENC14: wav_level_impl (g, ox, WAV_ENC14); break;
+        case WAV_ENC16: wav_level_impl (g, ox, WAV_ENC16); break;
+        case WAV_DEC14: wav_level_impl (g, ox, WAV_DEC14); break;
+        case WAV_DEC16: wav_level_impl (g, ox, WAV_DEC16); break;
+    }
+}
+
+#if defined(PIZ_USE_SSE2_WAVELET) || defined(PIZ_USE_NEON_WAVELET)
+
+/* With vectors, the values of the next level are copied out to a
+ * compact grid, which keeps every level as simple as the first, with
+ * neighbouring pairs, instead of walking ever larger strides over the
+ * whole array.
+ */
+static void
+wav_next_grid (wav_grid_t* next, const wav_grid_t* g, int ox, uint16_t** tmp)
+{
+    uint16_t* out = *tmp;
+    int       n;
 
-                if (w14)
-                    wenc14 (*px, *p01, px, p01);
-                else
-                    wenc16 (*px, *p01, px, p01);
+    next->p  = out;
+    next->nx = g->nx / 2;
+    next->ny = g->ny / 2;
+    next->xs = (size_t) ox;
+    next->ys = ((size_t) next->nx) * ((size_t) ox);
+    n        = next->nx * ox;
+
+    for (int y = 0; y < next->ny; ++y)
+    {
+        const uint16_t* row = g->p + ((size_t) (2 * y)) * g->ys;
+        int             i   = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            wav_vec_t a, b;
+
+            if (ox == 1)
+                wav_load_pairs16 (row + 2 * i, &a, &b);
+            else
+                wav_load_pairs32 (row + 2 * i, &a, &b);
+            wav_store (out + i, a);
+        }
+        for (; i < n; i += ox)
+        {
+            out[i] = row[2 * i];
+            if (ox == 2) out[i + 1] = row[2 * i + 1];
+        }
+        out += n;
+    }
+    *tmp = out;
+}
+
+/* put the values of a compact grid back */
+static void
+wav_put_grid (const wav_grid_t* g, const wav_grid_t* next, int ox)
+{
+    const uint16_t* in = next->p;
+    int             n  = next->nx * ox;
+
+    for (int y = 0; y < next->ny; ++y)
+    {
+        uint16_t* row = g->p + ((size_t) (2 * y)) * g->ys;
+        int       i   = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            wav_vec_t a, b;
+
+            if (ox == 1)
+            {
+                wav_load_pairs16 (row + 2 * i, &a, &b);
+                wav_store_pairs16 (row + 2 * i, wav_load (in + i), b);
+            }
+            else
+            {
+                wav_load_pairs32 (row + 2 * i, &a, &b);
+                wav_store_pairs32 (row + 2 * i, wav_load (in + i), b);
             }
         }
+        for (; i < n; i += ox)
+        {
+            row[2 * i] = in[i];
+            if (ox == 2) row[2 * i + 1] = in[i + 1];
+        }
+        in += n;
+    }
+}
 
-        //
-        // Next level
-        //
+/* words of scratch needed by wav_2D_encode / wav_2D_decode */
+static uint64_t
+wav_2D_scratch_words (int nx, int ox, int ny)
+{
+    uint64_t words = 0;
 
-        p = p2;
-        p2 <<= 1;
+    while (nx >= 4 && ny >= 4)
+    {
+        nx /= 2;
+        ny /= 2;
+        words += ((uint64_t) nx) * ((uint64_t) ny) * ((uint64_t) ox);
     }
+    return words;
 }
 
+#else
+
+/* without vectors, the next level is worked on in place */
+static void
+wav_next_grid (wav_grid_t* next, const wav_grid_t* g, int ox, uint16_t** tmp)
+{
+    (void) ox;
+    (void) tmp;
+    next->p  = g->p;
+    next->nx = g->nx / 2;
+    next->ny = g->ny / 2;
+    next->xs = g->xs * 2;
+    next->ys = g->ys * 2;
+}
+
+static void
+wav_put_grid (const wav_grid_t* g, const wav_grid_t* next, int ox)
+{
+    (void) g;
+    (void) next;
+    (void) ox;
+}
+
+static uint64_t
+wav_2D_scratch_words (int nx, int ox, int ny)
+{
+    (void) nx;
+    (void) ox;
+    (void) ny;
+    return 0;
+}
+
+#endif
+
+/* the most scratch of any channel of a chunk */
+static uint64_t
+wav_chunk_scratch_words (const exr_coding_channel_info_t* chans, int nchans)
+{
+    uint64_t words = 0;
+
+    for (int c = 0; c < nchans; ++c)
+    {
+        uint64_t w = wav_2D_scratch_words (
+            chans[c].width, chans[c].bytes_per_element / 2, chans[c].height);
+        if (w > words) words = w;
+    }
+    return words;
+}
+
+/* the grid halves each level, so int dimensions can not need more */
+#define WAV_MAX_LEVELS 32
+
 /**************************************/
 
 static void
-wav_2D_decode (
+wav_2D_encode (
     uint16_t* in, // io: values are transformed in place
     int       nx, // i : x size
-    int       ox, // i : x offset
+    int       ox, // i : words per value
     int       ny, // i : y size
-    int       oy, // i : y offset
-    uint16_t  mx)  // i : maximum in[x][y] value
+    uint16_t  mx, // i : maximum in[x][y] value
+    uint16_t* tmp) // : wav_2D_scratch_words of scratch
 {
-    int w14 = (mx < (1 << 14)) ? 1 : 0;
-    int n   = (nx > ny) ? ny : nx;
-    int p   = 1;
-    int p2;
+    enum wav_op op = (mx < (1 << 14)) ? WAV_ENC14 : WAV_ENC16;
+    wav_grid_t  g[WAV_MAX_LEVELS];
+    int         l = 0;
 
-    //
-    // Search max level
-    //
-
-    while (p <= n)
-        p <<= 1;
-
-    p >>= 1;
-    p2 = p;
-    p >>= 1;
+    g[0].p  = in;
+    g[0].nx = nx;
+    g[0].ny = ny;
+    g[0].xs = (size_t) ox;
+    g[0].ys = ((size_t) nx) * ((size_t) ox);
 
     //
-    // Hierarchical loop on smaller dimension n
+    // Hierarchical loop on smaller dimension
     //
 
-    while (p >= 1)
+    while (g[l].nx >= 2 && g[l].ny >= 2)
     {
-        uint16_t* py  = in;
-        uint16_t* ey  = in + oy * (ny - p2);
-        int       oy1 = oy * p;
-        int       oy2 = oy * p2;
-        int       ox1 = ox * p;
-        int       ox2 = ox * p2;
-        uint16_t  i00, i01, i10, i11;
-
-        //
-        // Y loop
-        //
-
-        for (; py <= ey; py += oy2)
-        {
-            uint16_t* px = py;
-            uint16_t* ex = py + ox * (nx - p2);
+        wav_level (g + l, ox, op);
 
-            //
-            // X loop
-            //
+        if (g[l].nx < 4 || g[l].ny < 4) break;
 
-            for (; px <= ex; px += ox2)
-            {
-                uint16_t* p01 = px + ox1;
-                uint16_t* p10 = px + oy1;
-                uint16_t* p11 = p10 + ox1;
-
-                //
-                // 2D wavelet decoding
-                //
-
-                if (w14)
-                {
-                    wdec14_4 (px, p01, p10, p11);
-                }
-                else
-                {
-                    wdec16 (*px, *p10, &i00, &i10);
-                    wdec16 (*p01, *p11, &i01, &i11);
-                    wdec16 (i00, i01, px, p01);
-                    wdec16 (i10, i11, p10, p11);
-                }
-            }
-
-            //
-            // Decode (1D) odd column (still in Y loop)
-            //
+        wav_next_grid (g + l + 1, g + l, ox, &tmp);
+        ++l;
+    }
 
-            if (nx & p)
-            {
-                uint16_t* p10 = px + oy1;
+    for (; l > 0; --l)
+        wav_put_grid (g + l - 1, g + l, ox);
+}
 
-                if (w14)
-                    wdec14 (*px, *p10, &i00, p10);
-                else
-                    wdec16 (*px, *p10, &i00, p10);
-                *px = i00;
-            }
-        }
+/**************************************/
 
-        //
-        // Decode (1D) odd line (must loop in X)
-        //
+static void
+wav_2D_decode (
+    uint16_t* in, // io: values are transformed in place
+    int       nx, // i : x size
+    int       ox, // i : words per value
+    int       ny, // i : y size
+    uint16_t  mx, // i : maximum in[x][y] value
+    uint16_t* tmp) // : wav_2D_scratch_words of scratch
+{
+    enum wav_op op = (mx < (1 << 14)) ? WAV_DEC14 : WAV_DEC16;
+    wav_grid_t  g[WAV_MAX_LEVELS];
+    int         l = 0;
 
-        if (ny & p)
-        {
-            uint16_t* px = py;
-            uint16_t* ex = py + ox * (nx - p2);
+    g[0].p  = in;
+    g[0].nx = nx;
+    g[0].ny = ny;
+    g[0].xs = (size_t) ox;
+    g[0].ys = ((size_t) nx) * ((size_t) ox);
 
-            for (; px <= ex; px += ox2)
-            {
-                uint16_t* p01 = px + ox1;
+    //
+    // Search max level, then decode from there back up
+    //
 
-                if (w14)
-                    wdec14 (*px, *p01, &i00, p01);
-                else
-                    wdec16 (*px, *p01, &i00, p01);
-                *px = i00;
-            }
-        }
+    while (g[l].nx >= 4 && g[l].ny >= 4)
+    {
+        wav_next_grid (g + l + 1, g + l, ox, &tmp);
+        ++l;
+    }
 
-        //
-        // Next level
-        //
+    if (g[l].nx < 2 || g[l].ny < 2) return;
 
-        p2 = p;
-        p >>= 1;
+    for (; l > 0; --l)
+    {
+        wav_level (g + l, ox, op);
+        wav_put_grid (g + l - 1, g + l, ox);
     }
+    wav_level (g, ox, op);
 }
 
 exr_result_t
@@ -476,6 +854,14 @@ internal_exr_apply_piz (exr_encode_pipeline_t* encode)
     uint64_t       packedbytes = encode->packed_bytes;
     uint64_t       ndata       = packedbytes / 2;
     uint16_t*      wavbuf;
+    uint16_t*      wavtmp;
+    uint64_t       wavtmpWords = wav_chunk_scratch_words (
+        encode->channels, encode->channel_count);
+    int            hufStreams;
+
+    rv = exr_get_piz_huffman_streams (
+        encode->context, encode->part_index, &hufStreams);
+    if (rv != EXR_ERR_SUCCESS) return rv;
 
     rv = internal_encode_alloc_buffer (
         encode,
@@ -491,12 +877,13 @@ internal_exr_apply_piz (exr_encode_pipeline_t* encode)
         &(encode->scratch_buffer_2),
         &(encode->scratch_alloc_size_2),
         BITMAP_SIZE * sizeof (uint8_t) + USHORT_RANGE * sizeof (uint16_t) +
-            hufSpareBytes);
+            hufSpareBytes + wavtmpWords * sizeof (uint16_t));
     if (rv != EXR_ERR_SUCCESS) return rv;
 
     hufspare = encode->scratch_buffer_2;
     bitmap   = hufspare + hufSpareBytes;
     lut      = (uint16_t*) (bitmap + BITMAP_SIZE);
+    wavtmp   = lut + USHORT_RANGE;
 
     packed = encode->packed_buffer;
     for (int y = 0; y < encode->chunk.height; ++y)
@@ -566,10 +953,7 @@ internal_exr_apply_piz (exr_encode_pipeline_t* encode)
         nx     = curc->width;
         ny     = curc->height;
         wcount = (int) (curc->bytes_per_element / 2);
-        for (int j = 0; j < wcount; ++j)
-        {
-            wav_2D_encode (wavbuf + j, nx, wcount, ny, wcount * nx, maxValue);
-        }
+        wav_2D_encode (wavbuf, nx, wcount, ny, maxValue, wavtmp);
         wavbuf += nx * ny * wcount;
     }
 
@@ -586,6 +970,7 @@ internal_exr_apply_piz (exr_encode_pipeline_t* encode)
         encode->compressed_alloc_size - nOut,
         encode->scratch_buffer_1,
         ndata,
+        hufStreams,
         hufspare,
         hufSpareBytes);
     if (rv != EXR_ERR_SUCCESS)
@@ -638,6 +1023,9 @@ internal_exr_undo_piz (
     size_t         hufSpareBytes = internal_exr_huf_decompress_spare_bytes ();
     uint16_t       minNonZero, maxNonZero, maxValue;
     uint16_t*      wavbuf;
+    uint16_t*      wavtmp;
+    uint64_t       wavtmpWords = wav_chunk_scratch_words (
+        decode->channels, decode->channel_count);
     uint32_t       hufbytes;
 
     rv = internal_decode_alloc_buffer (
@@ -654,12 +1042,13 @@ internal_exr_undo_piz (
         &(decode->scratch_buffer_2),
         &(decode->scratch_alloc_size_2),
         BITMAP_SIZE * sizeof (uint8_t) + USHORT_RANGE * sizeof (uint16_t) +
-            hufSpareBytes);
+            hufSpareBytes + wavtmpWords * sizeof (uint16_t));
     if (rv != EXR_ERR_SUCCESS) return rv;
 
     hufspare = decode->scratch_buffer_2;
     lut      = (uint16_t*) (hufspare + hufSpareBytes);
     bitmap   = (uint8_t*) (lut + USHORT_RANGE);
+    wavtmp   = (uint16_t*) (bitmap + BITMAP_SIZE);
 
     //
     // Read range compression data
@@ -722,10 +1111,7 @@ internal_exr_undo_piz (
         nx     = curc->width;
         ny     = curc->height;
         wcount = (int) (curc->bytes_per_element / 2);
-        for (int j = 0; j < wcount; ++j)
-        {
-            wav_2D_decode (wavbuf + j, nx, wcount, ny, wcount * nx, maxValue);
-        }
+        wav_2D_decode (wavbuf, nx, wcount, ny, maxValue, wavtmp);
         wavbuf += nx * ny * wcount;
     }
 
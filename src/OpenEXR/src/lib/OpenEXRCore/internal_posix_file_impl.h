@@ -9,6 +9,7 @@
 #include <errno.h>
 
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -28,15 +29,83 @@
 #    define CAN_USE_PREAD 0
 #endif
 
+#if CAN_USE_PREAD &&                                                           \
+    (defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) ||      \
+     defined(__OpenBSD__))
+#    include <sys/uio.h>
+#    define CAN_USE_PREADV 1
+/* entries handed to each preadv call */
+#    define EXR_PREADV_BATCH 64
+#else
+#    define CAN_USE_PREADV 0
+#endif
+
+/* EXR_HAVE_IO_URING is set by the build when linux/io_uring.h exists;
+ * the rings are driven with raw syscalls to avoid needing liburing */
+#if CAN_USE_PREADV && defined(EXR_HAVE_IO_URING)
+#    include <linux/io_uring.h>
+#    include <sched.h>
+#    include <sys/syscall.h>
+#    if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#        define CAN_USE_IO_URING 1
+#    endif
+#endif
+#ifndef CAN_USE_IO_URING
+#    define CAN_USE_IO_URING 0
+#endif
+
+#if CAN_USE_IO_URING
+struct _internal_exr_uring
+{
+    int                  fd;
+    unsigned             entries;
+    unsigned*            sq_tail;
+    unsigned*            sq_mask;
+    unsigned*            sq_array;
+    unsigned*            cq_head;
+    unsigned*            cq_tail;
+    unsigned*            cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void*                sq_map;
+    size_t               sq_map_size;
+    void*                cq_map;
+    size_t               cq_map_size;
+    size_t               sqes_size;
+};
+
+static void
+uring_close (struct _internal_exr_uring* r)
+{
+    if (r->sqes) munmap (r->sqes, r->sqes_size);
+    if (r->cq_map && r->cq_map != r->sq_map) munmap (r->cq_map, r->cq_map_size);
+    if (r->sq_map) munmap (r->sq_map, r->sq_map_size);
+    if (r->fd >= 0) close (r->fd);
+}
+#endif
+
 #if CAN_USE_PREAD
 struct _internal_exr_filehandle
 {
-    int fd;
+    int      fd;
+    void*    map;
+    uint64_t map_size;
+#    if CAN_USE_IO_URING
+    /* built by the first queued read and kept until the file is closed.
+     * ring_state is 1 when open, -1 once the kernel refused one; only
+     * the caller holding ring_busy (set under the context lock) may
+     * touch the ring or its state */
+    struct _internal_exr_uring ring;
+    int                        ring_state;
+    int                        ring_busy;
+#    endif
 };
 #else
 struct _internal_exr_filehandle
 {
-    int fd;
+    int      fd;
+    void*    map;
+    uint64_t map_size;
 #    if ILMTHREAD_THREADING_ENABLED
     pthread_mutex_t mutex;
 #    endif
@@ -52,6 +121,10 @@ default_shutdown (exr_const_context_t c, void* userdata, int failed)
     struct _internal_exr_filehandle* fh = userdata;
     if (fh)
     {
+        if (fh->map) munmap (fh->map, (size_t) fh->map_size);
+#if CAN_USE_IO_URING
+        if (fh->ring_state > 0) uring_close (&(fh->ring));
+#endif
         if (fh->fd >= 0) close (fh->fd);
 #if !CAN_USE_PREAD
 #    if ILMTHREAD_THREADING_ENABLED
@@ -209,6 +282,470 @@ default_read_func (
 
 /**************************************/
 
+#if CAN_USE_PREADV
+static int64_t
+default_read_vector_func (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    const exr_read_vector_t*    vecs,
+    int                         count,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb)
+{
+    struct _internal_exr_filehandle* fh = userdata;
+    struct iovec                     iov[EXR_PREADV_BATCH];
+    int64_t                          rv, retsz = 0;
+    int                              first, niov;
+
+    if (!fh || fh->fd < 0)
+    {
+        if (error_cb)
+            error_cb (
+                ctxt, EXR_ERR_INVALID_ARGUMENT, "Invalid file handle pointer");
+        return -1;
+    }
+
+    for (int v = 0; v < count; v += niov)
+    {
+        uint64_t batchsz = 0;
+
+        niov = count - v;
+        if (niov > EXR_PREADV_BATCH) niov = EXR_PREADV_BATCH;
+        for (int i = 0; i < niov; ++i)
+        {
+            if (sizeof (size_t) == 4 && vecs[v + i].size >= (uint64_t) UINT32_MAX)
+            {
+                if (error_cb)
+                    error_cb (
+                        ctxt,
+                        EXR_ERR_INVALID_ARGUMENT,
+                        "read request size too large for architecture");
+                return -1;
+            }
+            iov[i].iov_base = vecs[v + i].buffer;
+            iov[i].iov_len  = (size_t) vecs[v + i].size;
+            batchsz += vecs[v + i].size;
+        }
+
+        first = 0;
+        while (batchsz > 0)
+        {
+            rv = preadv (fh->fd, iov + first, niov - first, (off_t) offset);
+            if (rv < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN) continue;
+                if (error_cb)
+                    error_cb (
+                        ctxt,
+                        EXR_ERR_READ_IO,
+                        "Unable to read %" PRIu64 " bytes: %s",
+                        batchsz,
+                        strerror (errno));
+                return -1;
+            }
+            /* end of file */
+            if (rv == 0) return retsz;
+
+            retsz += rv;
+            offset += (uint64_t) rv;
+            batchsz -= (uint64_t) rv;
+            /* skip what was filled, and trim a partially filled entry */
+            while (first < niov && (size_t) rv >= iov[first].iov_len)
+            {
+                rv -= (int64_t) iov[first].iov_len;
+                ++first;
+            }
+            if (first < niov)
+            {
+                iov[first].iov_base = ((char*) iov[first].iov_base) + rv;
+                iov[first].iov_len -= (size_t) rv;
+            }
+        }
+    }
+    return retsz;
+}
+#endif
+
+/**************************************/
+
+#if CAN_USE_IO_URING
+
+/* progress of one request, which may take several submissions if the
+ * kernel returns a short read before the end of the file */
+struct _internal_exr_uring_read
+{
+    struct iovec* iov;
+    int           first;
+    int           niov;
+    uint64_t      offset;
+    uint64_t      remaining;
+};
+
+static int
+uring_open (struct _internal_exr_uring* r, unsigned entries)
+{
+    struct io_uring_params p;
+    uint8_t*               sq;
+    uint8_t*               cq;
+
+    memset (r, 0, sizeof (*r));
+    memset (&p, 0, sizeof (p));
+    r->fd = (int) syscall (__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) return -1;
+
+    r->entries     = p.sq_entries;
+    r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+    r->cq_map_size =
+        p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (r->cq_map_size > r->sq_map_size) r->sq_map_size = r->cq_map_size;
+        r->cq_map_size = r->sq_map_size;
+    }
+
+    r->sq_map = mmap (
+        NULL,
+        r->sq_map_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        r->fd,
+        IORING_OFF_SQ_RING);
+    if (r->sq_map == MAP_FAILED)
+    {
+        r->sq_map = NULL;
+        uring_close (r);
+        return -1;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        r->cq_map = r->sq_map;
+    else
+    {
+        r->cq_map = mmap (
+            NULL,
+            r->cq_map_size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            r->fd,
+            IORING_OFF_CQ_RING);
+        if (r->cq_map == MAP_FAILED)
+        {
+            r->cq_map = NULL;
+            uring_close (r);
+            return -1;
+        }
+    }
+
+    r->sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+    r->sqes      = mmap (
+        NULL,
+        r->sqes_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        r->fd,
+        IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED)
+    {
+        r->sqes = NULL;
+        uring_close (r);
+        return -1;
+    }
+
+    sq          = r->sq_map;
+    cq          = r->cq_map;
+    r->sq_tail  = (unsigned*) (sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned*) (sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*) (sq + p.sq_off.array);
+    r->cq_head  = (unsigned*) (cq + p.cq_off.head);
+    r->cq_tail  = (unsigned*) (cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned*) (cq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+    return 0;
+}
+
+static void
+uring_queue_read (
+    struct _internal_exr_uring*            r,
+    int                                    fd,
+    const struct _internal_exr_uring_read* rd,
+    uint64_t                               tag)
+{
+    unsigned             tail = *(r->sq_tail);
+    unsigned             idx  = tail & *(r->sq_mask);
+    struct io_uring_sqe* sqe  = r->sqes + idx;
+
+    memset (sqe, 0, sizeof (*sqe));
+    sqe->opcode    = IORING_OP_READV;
+    sqe->fd        = fd;
+    sqe->addr      = (uint64_t) (uintptr_t) (rd->iov + rd->first);
+    sqe->len       = (unsigned) (rd->niov - rd->first);
+    sqe->off       = rd->offset;
+    sqe->user_data = tag;
+    r->sq_array[idx] = idx;
+    __atomic_store_n (r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Take the file's ring for one batch, building it on first use or
+ * rebuilding it when the queue depth has grown past it. Returns NULL
+ * when another thread is using it or no ring can be had, and the
+ * caller reads without one.
+ */
+static struct _internal_exr_uring*
+uring_acquire (
+    exr_const_context_t ctxt, struct _internal_exr_filehandle* fh, int depth)
+{
+    int busy;
+
+    internal_exr_lock (ctxt);
+    busy          = fh->ring_busy;
+    fh->ring_busy = 1;
+    internal_exr_unlock (ctxt);
+    if (busy) return NULL;
+
+    if (fh->ring_state > 0 && fh->ring.entries < (unsigned) depth)
+    {
+        uring_close (&(fh->ring));
+        fh->ring_state = 0;
+    }
+    if (fh->ring_state == 0)
+    {
+        if (uring_open (&(fh->ring), (unsigned) depth) == 0)
+            fh->ring_state = 1;
+        else
+            fh->ring_state = -1;
+    }
+    if (fh->ring_state > 0) return &(fh->ring);
+
+    internal_exr_lock (ctxt);
+    fh->ring_busy = 0;
+    internal_exr_unlock (ctxt);
+    return NULL;
+}
+
+static void
+uring_release (exr_const_context_t ctxt, struct _internal_exr_filehandle* fh)
+{
+    internal_exr_lock (ctxt);
+    fh->ring_busy = 0;
+    internal_exr_unlock (ctxt);
+}
+
+/* Issue every request with up to read_queue_depth of them in flight.
+ * Anything that keeps the ring from being set up (old kernel, seccomp
+ * filters in containers), or another thread already using it, falls
+ * back to preadv one at a time.
+ */
+static exr_result_t
+default_read_queued_func (
+    exr_const_context_t ctxt, internal_exr_read_request_t* reqs, int count)
+{
+    struct _internal_exr_filehandle* fh = ctxt->user_data;
+    struct _internal_exr_uring*      ring  = NULL;
+    struct _internal_exr_uring_read* rds;
+    struct iovec*                    iovs;
+    size_t                           nvecs = 0;
+    int                              next = 0, inflight = 0, done = 0;
+    unsigned                         queued = 0;
+    int                              depth = ctxt->read_queue_depth;
+    exr_result_t                     rv    = EXR_ERR_SUCCESS;
+
+    for (int i = 0; i < count; ++i)
+        nvecs += (size_t) reqs[i].count;
+
+    rds  = ctxt->alloc_fn (sizeof (struct _internal_exr_uring_read) * count);
+    iovs = ctxt->alloc_fn (sizeof (struct iovec) * nvecs);
+    /* the ring is sized for the full depth so later batches reuse it */
+    if (rds && iovs && depth >= 2) ring = uring_acquire (ctxt, fh, depth);
+    if (!ring)
+    {
+        if (rds) ctxt->free_fn (rds);
+        if (iovs) ctxt->free_fn (iovs);
+        for (int i = 0; i < count; ++i)
+            reqs[i].nread = default_read_vector_func (
+                ctxt,
+                ctxt->user_data,
+                reqs[i].vecs,
+                reqs[i].count,
+                reqs[i].offset,
+                ctxt->print_error);
+        return EXR_ERR_SUCCESS;
+    }
+    if (depth > count) depth = count;
+    if ((unsigned) depth > ring->entries) depth = (int) ring->entries;
+
+    nvecs = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        rds[i].iov       = iovs + nvecs;
+        rds[i].first     = 0;
+        rds[i].niov      = reqs[i].count;
+        rds[i].offset    = reqs[i].offset;
+        rds[i].remaining = 0;
+        for (int v = 0; v < reqs[i].count; ++v)
+        {
+            iovs[nvecs].iov_base = reqs[i].vecs[v].buffer;
+            iovs[nvecs].iov_len  = (size_t) reqs[i].vecs[v].size;
+            rds[i].remaining += reqs[i].vecs[v].size;
+            ++nvecs;
+        }
+        reqs[i].nread = 0;
+    }
+
+    while (done < count)
+    {
+        unsigned head, tail;
+        long     ret;
+
+        while (next < count && inflight < depth)
+        {
+            uring_queue_read (ring, fh->fd, rds + next, (uint64_t) next);
+            ++next;
+            ++inflight;
+            ++queued;
+        }
+
+        do
+        {
+            ret = syscall (
+                __NR_io_uring_enter,
+                ring->fd,
+                queued,
+                1,
+                IORING_ENTER_GETEVENTS,
+                NULL,
+                0);
+        } while (ret < 0 && errno == EINTR);
+        if (ret >= 0) queued -= (unsigned) ret;
+        else
+        {
+            rv = ctxt->print_error (
+                ctxt,
+                EXR_ERR_READ_IO,
+                "Unable to submit queued reads: %s",
+                strerror (errno));
+            break;
+        }
+
+        head = *(ring->cq_head);
+        tail = __atomic_load_n (ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            const struct io_uring_cqe* cqe =
+                ring->cqes + (head & *(ring->cq_mask));
+            int                              i   = (int) cqe->user_data;
+            struct _internal_exr_uring_read* rd  = rds + i;
+            int64_t                          res = cqe->res;
+
+            --inflight;
+            if (res == -EINTR || res == -EAGAIN) res = 0;
+            else if (res < 0)
+            {
+                reqs[i].nread = -1;
+                ++done;
+                continue;
+            }
+            else if (res == 0)
+            {
+                /* end of file */
+                ++done;
+                continue;
+            }
+
+            reqs[i].nread += res;
+            rd->offset += (uint64_t) res;
+            rd->remaining -= (uint64_t) res;
+            if (rd->remaining == 0)
+            {
+                ++done;
+                continue;
+            }
+
+            /* short read: skip what was filled and queue the rest again */
+            while (rd->first < rd->niov &&
+                   (size_t) res >= rd->iov[rd->first].iov_len)
+            {
+                res -= (int64_t) rd->iov[rd->first].iov_len;
+                ++(rd->first);
+            }
+            rd->iov[rd->first].iov_base =
+                ((char*) rd->iov[rd->first].iov_base) + res;
+            rd->iov[rd->first].iov_len -= (size_t) res;
+            uring_queue_read (ring, fh->fd, rd, (uint64_t) i);
+            ++inflight;
+            ++queued;
+        }
+        __atomic_store_n (ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    /* after a failed submit, reads the kernel already took may still be
+     * filling the caller's buffers, so wait them out before returning */
+    while (inflight > (int) queued)
+    {
+        unsigned head, tail;
+
+        if (syscall (
+                __NR_io_uring_enter,
+                ring->fd,
+                0,
+                1,
+                IORING_ENTER_GETEVENTS,
+                NULL,
+                0) < 0 &&
+            errno != EINTR)
+            sched_yield ();
+
+        head = *(ring->cq_head);
+        tail = __atomic_load_n (ring->cq_tail, __ATOMIC_ACQUIRE);
+        inflight -= (int) (tail - head);
+        __atomic_store_n (ring->cq_head, tail, __ATOMIC_RELEASE);
+    }
+
+    /* entries the kernel never took are still in the submission queue,
+     * so a failed batch drops the ring and the next one builds afresh */
+    if (rv != EXR_ERR_SUCCESS)
+    {
+        uring_close (ring);
+        fh->ring_state = 0;
+    }
+    uring_release (ctxt, fh);
+    ctxt->free_fn (iovs);
+    ctxt->free_fn (rds);
+    return rv;
+}
+
+#endif /* CAN_USE_IO_URING */
+
+/**************************************/
+
+static int64_t
+default_mmap_read_func (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    void*                       buffer,
+    uint64_t                    sz,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb)
+{
+    struct _internal_exr_filehandle* fh = userdata;
+    uint64_t                         avail;
+
+    if (!fh || !fh->map)
+    {
+        if (error_cb)
+            error_cb (
+                ctxt, EXR_ERR_INVALID_ARGUMENT, "Invalid file mapping");
+        return -1;
+    }
+
+    /* short reads past the end, the same as pread */
+    if (offset >= fh->map_size) return 0;
+    avail = fh->map_size - offset;
+    if (sz < avail) avail = sz;
+    memcpy (buffer, ((const uint8_t*) fh->map) + offset, (size_t) avail);
+    return (int64_t) avail;
+}
+
+/**************************************/
+
 static int64_t
 default_write_func (
     exr_const_context_t         ctxt,
@@ -330,7 +867,13 @@ default_init_read_file (exr_context_t file)
     int                              fd;
     struct _internal_exr_filehandle* fh = file->user_data;
 
-    fh->fd = -1;
+    fh->fd       = -1;
+    fh->map      = NULL;
+    fh->map_size = 0;
+#if CAN_USE_IO_URING
+    fh->ring_state = 0;
+    fh->ring_busy  = 0;
+#endif
 #if !CAN_USE_PREAD
 #    if ILMTHREAD_THREADING_ENABLED
     fd = pthread_mutex_init (&(fh->mutex), NULL);
@@ -345,6 +888,16 @@ default_init_read_file (exr_context_t file)
 
     file->destroy_fn = &default_shutdown;
     file->read_fn    = &default_read_func;
+#if CAN_USE_PREADV
+    file->read_vector_fn = &default_read_vector_func;
+#else
+    file->read_vector_fn = NULL;
+#endif
+#if CAN_USE_IO_URING
+    file->read_queued_fn = &default_read_queued_func;
+#else
+    file->read_queued_fn = NULL;
+#endif
 
     fd = open (file->filename.str, O_RDONLY | O_CLOEXEC);
     if (fd < 0)
@@ -355,6 +908,36 @@ default_init_read_file (exr_context_t file)
             strerror (errno));
 
     fh->fd = fd;
+
+    /* Mapping is only an optimization: on any failure keep using
+     * pread. The pages are private and writable so the decoders may
+     * treat chunk data like any other buffer without touching the file.
+     */
+    if (file->memory_map_file)
+    {
+        struct stat sbuf;
+        if (fstat (fd, &sbuf) == 0 && sbuf.st_size > 0 &&
+            (uint64_t) sbuf.st_size <= (uint64_t) SIZE_MAX)
+        {
+            void* map = mmap (
+                NULL,
+                (size_t) sbuf.st_size,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE,
+                fd,
+                0);
+            if (map != MAP_FAILED)
+            {
+                fh->map              = map;
+                fh->map_size         = (uint64_t) sbuf.st_size;
+                file->mapped_data    = map;
+                file->mapped_size    = fh->map_size;
+                file->read_fn        = &default_mmap_read_func;
+                file->read_vector_fn = NULL;
+                file->read_queued_fn = NULL;
+            }
+        }
+    }
     return EXR_ERR_SUCCESS;
 }
 
@@ -381,6 +964,12 @@ default_init_write_file (exr_context_t file)
 #endif
 
     fh->fd           = -1;
+    fh->map          = NULL;
+    fh->map_size     = 0;
+#if CAN_USE_IO_URING
+    fh->ring_state = 0;
+    fh->ring_busy  = 0;
+#endif
     file->destroy_fn = &default_shutdown;
     file->write_fn   = &default_write_func;
 
@@ -476,3 +1065,25 @@ make_temp_filename (exr_context_t ret)
             newlen + 1);
     return EXR_ERR_SUCCESS;
 }
+
+/**************************************/
+
+FILE*
+internal_exr_open_chunk_index (exr_const_context_t ctxt, const char* mode)
+{
+    return fopen (ctxt->chunk_index_filename.str, mode);
+}
+
+/**************************************/
+
+int64_t
+internal_exr_file_mtime (exr_const_context_t ctxt)
+{
+    struct _internal_exr_filehandle* fh = ctxt->user_data;
+    struct stat                      sbuf;
+
+    if (ctxt->destroy_fn != &default_shutdown || !fh || fh->fd < 0 ||
+        fstat (fh->fd, &sbuf) != 0)
+        return 0;
+    return (int64_t) sbuf.st_mtime;
+}
@@ -6,6 +6,7 @@
 #include "openexr_config.h"
 #include "internal_structs.h"
 #include "internal_attr.h"
+#include "internal_compress.h"
 #include "internal_constants.h"
 #include "internal_memory.h"
 
@@ -222,6 +223,13 @@ internal_exr_add_part (
 
     part->zip_compression_level = f->default_zip_level;
     part->dwa_compression_level = f->default_dwa_quality;
+    part->piz_huffman_streams   = 1;
+
+    part->htj2k_block_width       = f->default_htj2k_block_width;
+    part->htj2k_block_height      = f->default_htj2k_block_height;
+    part->htj2k_levels            = f->default_htj2k_levels;
+    part->htj2k_progression       = f->default_htj2k_progression;
+    part->htj2k_quantization_step = f->default_htj2k_quantization_step;
 
     /* put it into the part table */
     if (ncount > 1)
@@ -377,6 +385,31 @@ internal_exr_alloc_context (
         if (initializers->dwa_quality >= 0.f)
             ret->default_dwa_quality = initializers->dwa_quality;
 
+        ret->default_htj2k_block_width       = 128;
+        ret->default_htj2k_block_height      = 32;
+        ret->default_htj2k_levels            = 5;
+        ret->default_htj2k_progression       = EXR_HTJ2K_PROGRESSION_RPCL;
+        ret->default_htj2k_quantization_step = 0.f;
+        if (initializers->htj2k_block_width > 0 &&
+            initializers->htj2k_block_height > 0 &&
+            internal_exr_valid_htj2k_block_size (
+                initializers->htj2k_block_width,
+                initializers->htj2k_block_height))
+        {
+            ret->default_htj2k_block_width  = initializers->htj2k_block_width;
+            ret->default_htj2k_block_height = initializers->htj2k_block_height;
+        }
+        if (initializers->htj2k_levels >= 0 &&
+            initializers->htj2k_levels <= EXR_HTJ2K_MAX_LEVELS)
+            ret->default_htj2k_levels = initializers->htj2k_levels;
+        if (initializers->htj2k_progression >= 0 &&
+            initializers->htj2k_progression < EXR_HTJ2K_PROGRESSION_LAST_TYPE)
+            ret->default_htj2k_progression = initializers->htj2k_progression;
+        if (initializers->htj2k_quantization_step >= 0.f &&
+            initializers->htj2k_quantization_step <= 1.f)
+            ret->default_htj2k_quantization_step =
+                initializers->htj2k_quantization_step;
+
         if (initializers->flags & EXR_CONTEXT_FLAG_STRICT_HEADER)
             ret->strict_header = 1;
         if (initializers->flags & EXR_CONTEXT_FLAG_SILENT_HEADER_PARSE)
@@ -386,13 +419,16 @@ internal_exr_alloc_context (
              EXR_CONTEXT_FLAG_DISABLE_CHUNK_RECONSTRUCTION);
         ret->legacy_header =
             (initializers->flags & EXR_CONTEXT_FLAG_WRITE_LEGACY_HEADER);
+        ret->memory_map_file =
+            (initializers->flags & EXR_CONTEXT_FLAG_MEMORY_MAP_FILE) ? 1 : 0;
 
         ret->file_size       = -1;
         ret->max_name_length = EXR_SHORTNAME_MAXLEN;
 
-        ret->destroy_fn = initializers->destroy_fn;
-        ret->read_fn    = initializers->read_fn;
-        ret->write_fn   = initializers->write_fn;
+        ret->destroy_fn     = initializers->destroy_fn;
+        ret->read_fn        = initializers->read_fn;
+        ret->read_vector_fn = initializers->read_vector_fn;
+        ret->write_fn       = initializers->write_fn;
 
 #if ILMTHREAD_THREADING_ENABLED
 #    ifdef _WIN32
@@ -449,8 +485,14 @@ internal_exr_destroy_context (exr_context_t ctxt)
 
     exr_attr_string_destroy (ctxt, &(ctxt->filename));
     exr_attr_string_destroy (ctxt, &(ctxt->tmp_filename));
+    exr_attr_string_destroy (ctxt, &(ctxt->chunk_index_filename));
     exr_attr_list_destroy (ctxt, &(ctxt->custom_handlers));
     internal_exr_destroy_parts (ctxt);
+    internal_exr_destroy_deflate_cache (ctxt);
+    internal_exr_destroy_ht_cache (ctxt);
+    internal_exr_destroy_reorder_buffer (ctxt);
+    internal_exr_release_buffer_pool (ctxt->buffer_pool);
+    if (ctxt->pipeline_stats) dofree (ctxt->pipeline_stats);
 #if ILMTHREAD_THREADING_ENABLED
 #    ifdef _WIN32
     DeleteCriticalSection (&(ctxt->mutex));
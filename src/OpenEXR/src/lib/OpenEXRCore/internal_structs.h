@@ -125,6 +125,13 @@ struct _priv_exr_part_t
 
     int32_t zip_compression_level;
     float   dwa_compression_level;
+    int32_t piz_huffman_streams;
+
+    int32_t htj2k_block_width;
+    int32_t htj2k_block_height;
+    int32_t htj2k_levels;
+    int32_t htj2k_progression;
+    float   htj2k_quantization_step;
 
     int32_t  num_tile_levels_x;
     int32_t  num_tile_levels_y;
@@ -161,6 +168,17 @@ enum _INTERNAL_EXR_CONTEXT_MODE
     EXR_CONTEXT_WRITE_FINISHED
 };
 
+/* one read of a queued batch: consecutive bytes at offset, scattered
+ * over vecs, see exr_read_chunks */
+typedef struct _internal_exr_read_request
+{
+    uint64_t                 offset;
+    const exr_read_vector_t* vecs;
+    int                      count;
+    /* out: bytes read (short at the end of the file), or -1 */
+    int64_t nread;
+} internal_exr_read_request_t;
+
 struct _priv_exr_context_t
 {
     uint8_t mode;
@@ -176,6 +194,9 @@ struct _priv_exr_context_t
 
     exr_attr_string_t filename;
     exr_attr_string_t tmp_filename;
+    /* optional sidecar holding reconstructed chunk tables, see
+     * exr_set_chunk_index_sidecar */
+    exr_attr_string_t chunk_index_filename;
 
     exr_result_t (*do_read) (
         exr_const_context_t file,
@@ -208,12 +229,31 @@ struct _priv_exr_context_t
     int   default_zip_level;
     float default_dwa_quality;
 
+    int   default_htj2k_block_width;
+    int   default_htj2k_block_height;
+    int   default_htj2k_levels;
+    int   default_htj2k_progression;
+    float default_htj2k_quantization_step;
+
     void*                         real_user_data;
     void*                         user_data;
     exr_destroy_stream_func_ptr_t destroy_fn;
 
     int64_t             file_size;
     exr_read_func_ptr_t read_fn;
+    /* optional, see exr_read_chunks */
+    exr_read_vector_func_ptr_t read_vector_fn;
+    /* built-in file backend only, reads with up to read_queue_depth
+     * requests in flight */
+    exr_result_t (*read_queued_fn) (
+        exr_const_context_t ctxt, internal_exr_read_request_t* reqs, int count);
+    int read_queue_depth;
+    /* threads scanning a file with a broken chunk table */
+    int reconstruct_threads;
+
+    /* whole file, when memory mapped by the built-in read backend */
+    const uint8_t* mapped_data;
+    uint64_t       mapped_size;
 
     exr_write_func_ptr_t write_fn;
     /* used when writing under a mutex, is there a better way? */
@@ -232,6 +272,23 @@ struct _priv_exr_context_t
 
     exr_attribute_list_t custom_handlers;
 
+    /* idle libdeflate states, see compression.c */
+    struct _internal_exr_deflate_state* deflate_cache;
+
+    /* idle OpenJPH codestreams, see internal_ht.cpp */
+    struct _internal_exr_ht_state* ht_cache;
+
+    /* chunks waiting for their turn when writing from many threads,
+     * see encoding.c */
+    struct _internal_exr_reorder_buffer* reorder;
+
+    /* shared pipeline buffers, see exr_set_buffer_pool */
+    exr_buffer_pool_t buffer_pool;
+
+    /* counters of exr_set_pipeline_stats, allocated when first
+     * enabled and kept until the context is destroyed */
+    struct _internal_exr_pipeline_stats* pipeline_stats;
+
     /* mostly needed for writing, but used during read to ensure
      * custom attribute handlers are safe */
 #if ILMTHREAD_THREADING_ENABLED
@@ -243,12 +300,25 @@ struct _priv_exr_context_t
 #endif
     uint8_t disable_chunk_reconstruct;
     uint8_t legacy_header;
-    uint8_t _pad[2];
+    uint8_t memory_map_file;
+    uint8_t collect_stats;
     uint32_t orig_version_and_flags;
 };
 
 #define EXR_CONST_CAST(t, v) ((t) (uintptr_t) v)
 
+/* limits of the HTJ2K encoder (OpenJPH) on the tunable settings */
+#define EXR_HTJ2K_MAX_LEVELS 32
+
+static inline int
+internal_exr_valid_htj2k_block_size (int w, int h)
+{
+    /* powers of two, 4 to 1024, with an area of at most 4096 */
+    if (w < 4 || w > 1024 || (w & (w - 1)) != 0) return 0;
+    if (h < 4 || h > 1024 || (h & (h - 1)) != 0) return 0;
+    return w * h <= 4096;
+}
+
 static inline void
 internal_exr_lock (exr_const_context_t c)
 {
@@ -349,5 +419,8 @@ exr_result_t internal_exr_alloc_context (
     enum _INTERNAL_EXR_CONTEXT_MODE  mode,
     size_t                           extra_data);
 void internal_exr_destroy_context (exr_context_t ctxt);
+void internal_exr_destroy_reorder_buffer (exr_context_t ctxt);
+
+void internal_exr_release_buffer_pool (exr_buffer_pool_t pool);
 
 #endif /* OPENEXR_PRIVATE_STRUCTS_H */
@@ -50,4 +50,74 @@ exrcore_call_once (exrcore_once_flag* flag, void (*func) (void))
 }
 #endif
 
+/* Short-lived worker threads, for the few places the library splits
+ * up work on its own. When a thread cannot be started (or threading is
+ * disabled), the work is done on the calling thread instead.
+ */
+typedef struct
+{
+    void (*fn) (void*);
+    void* arg;
+    int   started;
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    HANDLE handle;
+#    else
+    pthread_t handle;
+#    endif
+#endif
+} exrcore_thread_t;
+
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+static inline DWORD WINAPI
+exrcore_thread_main (LPVOID param)
+{
+    exrcore_thread_t* t = (exrcore_thread_t*) param;
+    t->fn (t->arg);
+    return 0;
+}
+#    else
+static inline void*
+exrcore_thread_main (void* param)
+{
+    exrcore_thread_t* t = (exrcore_thread_t*) param;
+    t->fn (t->arg);
+    return NULL;
+}
+#    endif
+#endif
+
+static inline void
+exrcore_thread_start (exrcore_thread_t* t, void (*fn) (void*), void* arg)
+{
+    t->fn      = fn;
+    t->arg     = arg;
+    t->started = 0;
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    t->handle  = CreateThread (NULL, 0, &exrcore_thread_main, t, 0, NULL);
+    t->started = (t->handle != NULL);
+#    else
+    t->started = (pthread_create (&t->handle, NULL, &exrcore_thread_main, t) == 0);
+#    endif
+#endif
+    if (!t->started) fn (arg);
+}
+
+static inline void
+exrcore_thread_join (exrcore_thread_t* t)
+{
+    if (!t->started) return;
+#if ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    WaitForSingleObject (t->handle, INFINITE);
+    CloseHandle (t->handle);
+#    else
+    pthread_join (t->handle, NULL);
+#    endif
+#endif
+    t->started = 0;
+}
+
 #endif /* OPENEXR_PRIVATE_THREAD_H */
@@ -297,6 +297,10 @@ default_init_read_file (exr_context_t file)
     fh->fd           = INVALID_HANDLE_VALUE;
     file->destroy_fn = &default_shutdown;
     file->read_fn    = &default_read_func;
+    /* no vectored read on Windows: exr_read_chunks falls back to
+     * read_fn, staging each run of chunks in a temporary buffer */
+    file->read_vector_fn = NULL;
+    file->read_queued_fn = NULL;
 
     wcFn = widen_filename (file, file->filename.str);
     if (wcFn)
@@ -473,3 +477,42 @@ make_temp_filename (exr_context_t ret)
             (uint64_t) newlen + 1);
     return EXR_ERR_SUCCESS;
 }
+
+/**************************************/
+
+FILE*
+internal_exr_open_chunk_index (exr_const_context_t ctxt, const char* mode)
+{
+    wchar_t  wcMode[4];
+    wchar_t* wcFn;
+    FILE*    f = NULL;
+    int      i;
+
+    for (i = 0; i < 3 && mode[i]; ++i)
+        wcMode[i] = (wchar_t) mode[i];
+    wcMode[i] = 0;
+
+    wcFn = widen_filename (
+        EXR_CONST_CAST (exr_context_t, ctxt), ctxt->chunk_index_filename.str);
+    if (wcFn)
+    {
+        f = _wfopen (wcFn, wcMode);
+        ctxt->free_fn (wcFn);
+    }
+    return f;
+}
+
+/**************************************/
+
+int64_t
+internal_exr_file_mtime (exr_const_context_t ctxt)
+{
+    struct _internal_exr_filehandle* fh = ctxt->user_data;
+    FILETIME                         ft;
+
+    if (ctxt->destroy_fn != &default_shutdown || !fh ||
+        fh->fd == INVALID_HANDLE_VALUE ||
+        !GetFileTime (fh->fd, NULL, NULL, &ft))
+        return 0;
+    return (int64_t) (((uint64_t) ft.dwHighDateTime << 32) | ft.dwLowDateTime);
+}
@@ -98,6 +98,26 @@ exr_result_t exr_read_chunk (
     const exr_chunk_info_t* cinfo,
     void*                   packed_data);
 
+/** Read the packed data blocks for several chunks at once.
+ *
+ * Equivalent to calling exr_read_chunk() for each of the @p count
+ * chunks in @p cinfos into the matching entry of @p packed_data, but
+ * chunks which are contiguous or nearly so in the file (such as
+ * consecutive scanline chunks, which are only separated by their
+ * chunk leaders) are fetched with a single request. If the context
+ * has a read_vector_fn (the built-in file backend does, where the
+ * platform supports it) each request is scattered straight into the
+ * chunk buffers; otherwise it is read into a temporary buffer and
+ * copied out. The chunks may be listed in any order.
+ */
+EXR_EXPORT
+exr_result_t exr_read_chunks (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    const exr_chunk_info_t* cinfos,
+    int                     count,
+    void* const*            packed_data);
+
 /**
  * Read chunk for deep data.
  *
@@ -104,6 +104,81 @@ exr_result_t exr_compress_chunk (exr_encode_pipeline_t *encode_state);
 EXR_EXPORT
 exr_result_t exr_uncompress_chunk (exr_decode_pipeline_t *decode_state);
 
+/** Totals of the stages of the decode and encode pipelines run against
+ * a context, see @ref exr_set_pipeline_stats.
+ *
+ * Times are in nanoseconds of wall clock, summed over all threads, so
+ * with several threads running pipelines they may add up to more than
+ * the elapsed time. Byte counts of the read and write stages include
+ * the deep sample count tables.
+ */
+typedef struct
+{
+    uint64_t decode_chunks;    /**< Chunks through @ref exr_decoding_run. */
+    uint64_t read_ns;          /**< Time reading chunk data. */
+    uint64_t read_bytes;       /**< Bytes read. */
+    uint64_t decompress_ns;    /**< Time decompressing. */
+    uint64_t decompress_bytes; /**< Bytes produced by decompression. */
+    uint64_t unpack_ns;        /**< Time unpacking into user buffers. */
+
+    uint64_t encode_chunks;    /**< Chunks through @ref exr_encoding_run. */
+    uint64_t pack_ns;          /**< Time packing from user buffers. */
+    uint64_t packed_bytes;     /**< Bytes produced by packing. */
+    uint64_t compress_ns;      /**< Time compressing. */
+    uint64_t compressed_bytes; /**< Bytes produced by compression. */
+    uint64_t write_ns;         /**< Time writing chunk data. */
+    uint64_t write_bytes;      /**< Bytes written. */
+} exr_pipeline_stats_t;
+
+/** Totals of the chunks (de)compressed with one compression type, see
+ * @ref exr_get_pipeline_compression_stats.
+ */
+typedef struct
+{
+    uint64_t decompress_chunks;
+    uint64_t decompress_ns;
+    uint64_t decompress_in_bytes;
+    uint64_t decompress_out_bytes;
+
+    uint64_t compress_chunks;
+    uint64_t compress_ns;
+    uint64_t compress_in_bytes;
+    uint64_t compress_out_bytes;
+} exr_compression_stats_t;
+
+/** @brief Enable or disable collection of pipeline statistics.
+ *
+ * When enabled, @ref exr_decoding_run and @ref exr_encoding_run time
+ * each of their stages and count the bytes passing through them. The
+ * counters are updated atomically, so pipelines may be run from any
+ * number of threads. When disabled (the default) the only cost is a
+ * flag check per chunk. Disabling keeps the totals so far available.
+ * Should be enabled before pipelines are started.
+ */
+EXR_EXPORT
+exr_result_t exr_set_pipeline_stats (exr_context_t ctxt, int onoff);
+
+/** @brief Query the pipeline statistics collected so far.
+ *
+ * Zeroes @p stats when collection was never enabled.
+ */
+EXR_EXPORT
+exr_result_t exr_get_pipeline_stats (
+    exr_const_context_t ctxt, exr_pipeline_stats_t* stats);
+
+/** @brief Query the statistics of the (de)compression stages for one
+ * compression type.
+ */
+EXR_EXPORT
+exr_result_t exr_get_pipeline_compression_stats (
+    exr_const_context_t      ctxt,
+    exr_compression_t        comptype,
+    exr_compression_stats_t* stats);
+
+/** @brief Reset all pipeline statistics to zero. */
+EXR_EXPORT
+exr_result_t exr_reset_pipeline_stats (exr_context_t ctxt);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
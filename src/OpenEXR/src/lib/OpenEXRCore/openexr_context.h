@@ -126,8 +126,10 @@ typedef int64_t (*exr_query_size_func_ptr_t) (
  * caching of data to give the appearance of being able to seek/read
  * atomically.
  *
- * TODO: This does not handle the ability to mmap a file and get to
- * zero copy
+ * Custom read functions always copy into the buffer provided. To
+ * decode straight out of a memory mapped file instead, use the
+ * built-in file backend with EXR_CONTEXT_FLAG_MEMORY_MAP_FILE, or
+ * exr_start_read_memory() for a file already in memory.
  */
 typedef int64_t (*exr_read_func_ptr_t) (
     exr_const_context_t         ctxt,
@@ -137,6 +139,33 @@ typedef int64_t (*exr_read_func_ptr_t) (
     uint64_t                    offset,
     exr_stream_error_func_ptr_t error_cb);
 
+/** @brief One destination buffer of a vectored read. */
+typedef struct _exr_read_vector
+{
+    void*    buffer;
+    uint64_t size;
+} exr_read_vector_t;
+
+/** @brief Vectored read custom function pointer
+ *
+ * Optional companion to \c exr_read_func_ptr_t, with the semantics of
+ * preadv: reads consecutive bytes starting at @p offset, filling each
+ * of the @p count buffers in turn. Returns the total number of bytes
+ * read, which may be short at the end of the file, or -1 on error.
+ *
+ * Used by exr_read_chunks() to fetch runs of neighboring chunks with
+ * one request, which matters when per-request latency is high (such
+ * as network file systems). The same thread-safety requirements as
+ * the read function apply.
+ */
+typedef int64_t (*exr_read_vector_func_ptr_t) (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    const exr_read_vector_t*    vecs,
+    int                         count,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb);
+
 /** Write custom function pointer
  *
  *  Used to write data to a custom output. Expects similar semantics to
@@ -190,7 +219,7 @@ typedef int64_t (*exr_write_func_ptr_t) (
  * \endcode
  *
  */
-typedef struct _exr_context_initializer_v3
+typedef struct _exr_context_initializer_v5
 {
     /** @brief Size member to tag initializer for version stability.
      *
@@ -324,6 +353,40 @@ typedef struct _exr_context_initializer_v3
     int flags;
 
     uint8_t pad[4];
+
+    /** @brief Custom vectored read routine.
+     *
+     * Optional, only used alongside a custom read_fn. If `NULL`,
+     * exr_read_chunks() falls back to read_fn.
+     *
+     * @sa exr_read_vector_func_ptr_t
+     */
+    exr_read_vector_func_ptr_t read_vector_fn;
+
+    /** Initialize the default HTJ2K code-block width and height for
+     * this context. Zero keeps the library default (128x32). See
+     * exr_set_htj2k_block_size().
+     */
+    int htj2k_block_width;
+    int htj2k_block_height;
+
+    /** Initialize the default number of HTJ2K wavelet decomposition
+     * levels for this context. Negative keeps the library default
+     * (5). See exr_set_htj2k_levels().
+     */
+    int htj2k_levels;
+
+    /** Initialize the default HTJ2K progression order for this
+     * context, one of the \c exr_htj2k_progression_t values. Negative
+     * keeps the library default (RPCL). See exr_set_htj2k_progression().
+     */
+    int htj2k_progression;
+
+    /** Initialize the default HTJ2K quantization step for this
+     * context. Negative keeps the library default (0, lossless). See
+     * exr_set_htj2k_quantization_step().
+     */
+    float htj2k_quantization_step;
 } exr_context_initializer_t;
 
 /** @brief context flag which will enforce strict header validation
@@ -350,10 +413,21 @@ typedef struct _exr_context_initializer_v3
 /** @brief Writes an old-style, sorted header with minimal information */
 #define EXR_CONTEXT_FLAG_WRITE_LEGACY_HEADER (1 << 3)
 
+/** @brief Memory maps the file when reading with the built-in file backend
+ *
+ * The default decode pipeline then decompresses chunks directly from
+ * the mapping instead of reading them into a packed buffer, and
+ * uncompressed chunks are not copied at all. This is only valid for
+ * reading contexts without a custom read_fn, and is currently ignored
+ * on Windows or when the mapping fails. The file must not be
+ * truncated while the context is open.
+ */
+#define EXR_CONTEXT_FLAG_MEMORY_MAP_FILE (1 << 4)
+
 /* clang-format off */
 /** @brief Simple macro to initialize the context initializer with default values. */
 #define EXR_DEFAULT_CONTEXT_INITIALIZER                                        \
-    { sizeof (exr_context_initializer_t), 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -2, -1.f, 0, { 0, 0, 0, 0 } }
+    { sizeof (exr_context_initializer_t), 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -2, -1.f, 0, { 0, 0, 0, 0 }, 0, 0, 0, -1, -1, -1.f }
 /* clang-format on */
 
 /** @} */ /* context function pointer declarations */
@@ -411,6 +485,27 @@ EXR_EXPORT exr_result_t exr_start_read (
     const char*                      filename,
     const exr_context_initializer_t* ctxtdata);
 
+/** @brief Create and initialize a read-only exr context over a
+ * complete file that is already in memory.
+ *
+ * This behaves like exr_start_read(), but the file is the @p size
+ * bytes at @p data, and the filename is for informational purposes
+ * only. The memory is used like a memory mapped file (see
+ * EXR_CONTEXT_FLAG_MEMORY_MAP_FILE): the default decode pipeline
+ * decompresses chunks directly from it, and does not copy
+ * uncompressed chunks at all. Any read_fn, read_vector_fn and size_fn
+ * in @p ctxtdata are ignored.
+ *
+ * The memory is only ever read, and must stay valid and unchanged
+ * until the context is finished with exr_finish().
+ */
+EXR_EXPORT exr_result_t exr_start_read_memory (
+    exr_context_t*                   ctxt,
+    const char*                      filename,
+    const void*                      data,
+    uint64_t                         size,
+    const exr_context_initializer_t* ctxtdata);
+
 /** @brief Enum describing how default files are handled during write. */
 typedef enum exr_default_write_mode
 {
@@ -526,6 +621,90 @@ exr_get_file_version_and_flags (exr_const_context_t ctxt, uint32_t* ver);
 EXR_EXPORT exr_result_t
 exr_get_user_data (exr_const_context_t ctxt, void** userdata);
 
+/** @brief Let exr_read_chunks() keep up to @p depth reads in flight.
+ *
+ * Only the built-in file backend on Linux uses this, when the library
+ * was built with io_uring support and the kernel allows it. Otherwise,
+ * or with a depth of 1 or less (the default), the reads are issued one
+ * after another. Deep queues are needed to keep fast NVMe devices
+ * busy. The ring is built by the first queued read and kept until the
+ * file is closed; raising the depth later builds a deeper one.
+ */
+EXR_EXPORT exr_result_t
+exr_set_read_queue_depth (exr_context_t ctxt, int depth);
+
+/** @brief Use up to @p nthreads threads to rebuild a broken chunk table.
+ *
+ * When the chunk offset table of a part is incomplete (for example the
+ * writer was killed before finishing the file), the table is rebuilt by
+ * following the chunk leaders through the file. With more than one
+ * thread, the file is split into segments that are scanned for chunk
+ * leaders concurrently, and the results are stitched together along the
+ * chain of leaders. The default of 0 (or 1) scans on the calling thread.
+ * Must be set before the first chunk is queried.
+ */
+EXR_EXPORT exr_result_t
+exr_set_chunk_reconstruct_threads (exr_context_t ctxt, int nthreads);
+
+/** @brief Keep reconstructed chunk tables in a sidecar file.
+ *
+ * When a part of the file needs its chunk table rebuilt, the sidecar at
+ * @p filename is checked first, and used if it was written for a file
+ * with the same size, modification time and header bytes (including
+ * the stored offset tables), and its entries point at matching chunk
+ * leaders.
+ * Otherwise the table is rebuilt and stored in the sidecar for the next
+ * time the file is opened. Failing to read or write the sidecar is not
+ * an error. Pass `NULL` to stop using a sidecar. Must be set before the
+ * first chunk is queried.
+ */
+EXR_EXPORT exr_result_t
+exr_set_chunk_index_sidecar (exr_context_t ctxt, const char* filename);
+
+/** Opaque, thread-safe cache of pipeline buffers.
+ *
+ * The packed, unpacked and scratch buffers of the decode and encode
+ * pipelines are returned here when freed (by a new chunk needing a
+ * larger buffer, or by @ref exr_decoding_destroy / @ref
+ * exr_encoding_destroy), and handed out again to later pipelines of any
+ * context using the same pool. This avoids reallocating the same sizes
+ * when working through many files.
+ */
+typedef struct _exr_buffer_pool* exr_buffer_pool_t;
+
+/** @brief Create a buffer pool.
+ *
+ * Buffers are allocated with the default memory routines (see @ref
+ * exr_set_default_memory_routines) in size classes of a quarter of a
+ * power of two. When @p max_cached_bytes is nonzero, buffers released
+ * past that many idle bytes are freed instead of being kept.
+ */
+EXR_EXPORT exr_result_t
+exr_buffer_pool_create (exr_buffer_pool_t* pool, uint64_t max_cached_bytes);
+
+/** @brief Release the caller's reference to the pool.
+ *
+ * Contexts using the pool hold their own reference, so the pool (and
+ * its idle buffers) stays alive until the last of them is finished.
+ */
+EXR_EXPORT exr_result_t exr_buffer_pool_destroy (exr_buffer_pool_t* pool);
+
+/** @brief Free all idle buffers held by the pool. */
+EXR_EXPORT exr_result_t exr_buffer_pool_trim (exr_buffer_pool_t pool);
+
+/** @brief Query the number of bytes held in idle buffers. */
+EXR_EXPORT exr_result_t
+exr_buffer_pool_get_cached_bytes (exr_buffer_pool_t pool, uint64_t* bytes);
+
+/** @brief Take pipeline buffers of this context from @p pool.
+ *
+ * Applies to pipelines that do not provide their own `alloc_fn` and
+ * `free_fn`. Must be set before any decode or encode pipeline is
+ * initialized for the context. Pass `NULL` to stop using a pool.
+ */
+EXR_EXPORT exr_result_t
+exr_set_buffer_pool (exr_context_t ctxt, exr_buffer_pool_t pool);
+
 /** Any opaque attribute data entry of the specified type is tagged
  * with these functions enabling downstream users to unpack (or pack)
  * the data.
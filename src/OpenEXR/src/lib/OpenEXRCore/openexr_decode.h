@@ -264,6 +264,12 @@ typedef struct _exr_decode_pipeline
      * this being used.
      */
     exr_coding_channel_info_t _quick_chan_store[5];
+
+    /** Internal bookkeeping: which of the buffers were taken from the
+     * buffer pool of the context, one bit per
+     * exr_transcoding_pipeline_buffer_id_t. Leave alone.
+     */
+    uint32_t _pooled_buffers;
 } exr_decode_pipeline_t;
 
 /** @brief Simple macro to initialize an empty decode pipeline. */
@@ -277,6 +277,12 @@ typedef struct _exr_encode_pipeline
      * this being used.
      */
     exr_coding_channel_info_t _quick_chan_store[5];
+
+    /** Internal bookkeeping: which of the buffers were taken from the
+     * buffer pool of the context, one bit per
+     * exr_transcoding_pipeline_buffer_id_t. Leave alone.
+     */
+    uint32_t _pooled_buffers;
 } exr_encode_pipeline_t;
 
 /** @brief Simple macro to initialize an empty decode pipeline. */
@@ -333,6 +339,29 @@ exr_result_t exr_encoding_run (
     int                    part_index,
     exr_encode_pipeline_t* encode_pipe);
 
+/** Enable writing chunks of a part from many threads at once.
+ *
+ * Normally each thread must wait its turn, as chunks of an ordered
+ * part (increasing / decreasing y) have to be written to the file in
+ * chunk order. With a reorder buffer, a chunk that is encoded ahead of
+ * its turn is copied aside (up to max_pending_chunks of them), and
+ * written, with the offset table filled in, as soon as the chunks
+ * before it have been written. If the buffer is full, exr_encoding_run()
+ * blocks until a slot is freed.
+ *
+ * Must be called before exr_encoding_choose_default_routines(), which
+ * then installs a write_fn using the buffer and no yield_until_ready_fn.
+ * Chunks must be handed out to threads in chunk order, so the chunk
+ * that is next in line is always being encoded by somebody; a
+ * max_pending_chunks of about the number of threads keeps them from
+ * waiting on each other. Every chunk handed out has to go through
+ * exr_encoding_run(); once one fails, later chunks fail with the same
+ * error rather than wait for it. Passing 0 releases the buffer.
+ */
+EXR_EXPORT
+exr_result_t
+exr_encoding_set_reorder_buffer (exr_context_t ctxt, int max_pending_chunks);
+
 /** Free any intermediate memory in the encoding pipeline.
  *
  * This does NOT free any pointers referred to in the channel info
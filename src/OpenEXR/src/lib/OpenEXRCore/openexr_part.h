@@ -234,6 +234,146 @@ EXR_EXPORT exr_result_t exr_get_dwa_compression_level (
 EXR_EXPORT exr_result_t
 exr_set_dwa_compression_level (exr_context_t ctxt, int part_index, float level);
 
+/** @brief Retrieve the number of Huffman streams written by PIZ
+ * compression for the specified part.
+ *
+ * This value is NOT persisted in the file, and only exists for the
+ * lifetime of the context, so will be at the default value when just
+ * reading a file.
+ */
+EXR_EXPORT exr_result_t exr_get_piz_huffman_streams (
+    exr_const_context_t ctxt, int part_index, int* streams);
+
+/** @brief Set the number of Huffman streams written by PIZ
+ * compression for the specified part.
+ *
+ * The default, 1, writes the single bitstream every reader
+ * understands. With 2 to 8, the coded values of each chunk are split
+ * in that many bitstreams sharing one table, which this library
+ * decodes side by side, decoding faster. Only readers based on this
+ * version of the library or later can read such files. Chunks too
+ * small to gain anything still use a single stream.
+ *
+ * This value is NOT persisted in the file, and only exists for the
+ * lifetime of the context, so this value will be ignored when
+ * reading a file (where the stream count is read from each chunk).
+ */
+EXR_EXPORT exr_result_t
+exr_set_piz_huffman_streams (exr_context_t ctxt, int part_index, int streams);
+
+/** @brief Enum declaring the progression orders an HTJ2K codestream
+ * can be written in, in the order of the JPEG 2000 COD marker.
+ */
+typedef enum
+{
+    EXR_HTJ2K_PROGRESSION_LRCP = 0,
+    EXR_HTJ2K_PROGRESSION_RLCP = 1,
+    EXR_HTJ2K_PROGRESSION_RPCL = 2,
+    EXR_HTJ2K_PROGRESSION_PCRL = 3,
+    EXR_HTJ2K_PROGRESSION_CPRL = 4,
+    EXR_HTJ2K_PROGRESSION_LAST_TYPE /**< Invalid value, provided for range checking. */
+} exr_htj2k_progression_t;
+
+/** @brief Retrieve the code-block size HTJ2K compression uses for
+ * the specified part.
+ *
+ * This value is NOT persisted in the file, and only exists for the
+ * lifetime of the context, so will be at the default value when just
+ * reading a file.
+ */
+EXR_EXPORT exr_result_t exr_get_htj2k_block_size (
+    exr_const_context_t ctxt, int part_index, int* width, int* height);
+
+/** @brief Set the code-block size HTJ2K compression uses for the
+ * specified part.
+ *
+ * Both dimensions must be powers of two from 4 to 1024, and the
+ * block no larger than 4096 samples. The default is 128x32.
+ *
+ * This value is NOT persisted in the file, and only exists for the
+ * lifetime of the context, so this value will be ignored when
+ * reading a file.
+ */
+EXR_EXPORT exr_result_t exr_set_htj2k_block_size (
+    exr_context_t ctxt, int part_index, int width, int height);
+
+/** @brief Retrieve the number of wavelet decomposition levels HTJ2K
+ * compression uses for the specified part.
+ *
+ * This value is NOT persisted in the file, and only exists for the
+ * lifetime of the context, so will be at the default value when just
+ * reading a file.
+ */
+EXR_EXPORT exr_result_t
+exr_get_htj2k_levels (exr_const_context_t ctxt, int part_index, int* levels);
+
+/** @brief Set the number of wavelet decomposition levels HTJ2K
+ * compression uses for the specified part.
+ *
+ * From 0 to 32, the default is 5. Chunks are small images, so
+ * lowering this for scanline files or small tiles costs little.
+ *
+ * This value is NOT persisted in the file, and only exists for the
+ * lifetime of the context, so this value will be ignored when
+ * reading a file.
+ */
+EXR_EXPORT exr_result_t
+exr_set_htj2k_levels (exr_context_t ctxt, int part_index, int levels);
+
+/** @brief Retrieve the progression order HTJ2K compression uses for
+ * the specified part.
+ *
+ * This value is NOT persisted in the file, and only exists for the
+ * lifetime of the context, so will be at the default value when just
+ * reading a file.
+ */
+EXR_EXPORT exr_result_t exr_get_htj2k_progression (
+    exr_const_context_t ctxt, int part_index, exr_htj2k_progression_t* order);
+
+/** @brief Set the progression order HTJ2K compression uses for the
+ * specified part. The default is \c EXR_HTJ2K_PROGRESSION_RPCL.
+ *
+ * This value is NOT persisted in the file, and only exists for the
+ * lifetime of the context, so this value will be ignored when
+ * reading a file.
+ */
+EXR_EXPORT exr_result_t exr_set_htj2k_progression (
+    exr_context_t ctxt, int part_index, exr_htj2k_progression_t order);
+
+/** @brief Retrieve the quantization step HTJ2K compression uses for
+ * the specified part.
+ *
+ * This value is NOT persisted in the file, and only exists for the
+ * lifetime of the context, so will be at the default value when just
+ * reading a file.
+ */
+EXR_EXPORT exr_result_t exr_get_htj2k_quantization_step (
+    exr_const_context_t ctxt, int part_index, float* step);
+
+/** @brief Set the quantization step HTJ2K compression uses for the
+ * specified part.
+ *
+ * The default, 0, selects the reversible wavelet and lossless
+ * coding. A step greater than 0 and at most 1 selects the
+ * irreversible wavelet, and quantizes coefficients with that step
+ * relative to the full range of the 16-bit codes of half samples,
+ * so the error is roughly relative to their magnitude: 2^-16 is
+ * about one code and nearly lossless, larger steps write smaller,
+ * lossier files. A sample can end up a few times step * 65536 codes
+ * away from where it was, in the order of the half values, so from
+ * about 2^-10 up the error grows quickly, and values near zero can
+ * change sign. Decoded samples are always finite, Inf and NaN are
+ * not kept and come back as the largest finite half of their sign.
+ * This only applies to chunks where all channels are half, others
+ * are still coded losslessly.
+ *
+ * This value is NOT persisted in the file, and only exists for the
+ * lifetime of the context, so this value will be ignored when
+ * reading a file.
+ */
+EXR_EXPORT exr_result_t exr_set_htj2k_quantization_step (
+    exr_context_t ctxt, int part_index, float step);
+
 /**************************************/
 
 /** @defgroup PartMetadata Functions to get and set metadata for a particular part.
@@ -6,8 +6,201 @@
 #include "openexr_encode.h"
 
 #include "internal_coding.h"
+#include "internal_half_buffer.h"
 #include "internal_xdr.h"
 
+#include <string.h>
+
+/**************************************/
+
+/* splitting of 3 / 4 channel pixels back in to the per-channel
+ * lines of the packed buffer (the inverse of the interleaving in
+ * unpack.c). These are only matched on little endian hosts, where
+ * the packed data is a straight copy of the user values */
+#if !EXR_HOST_IS_NOT_LITTLE_ENDIAN
+#    if defined(__SSE2__) || defined(_M_X64) ||                                \
+        (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#        define PACK_USE_SSE2_DEINTERLEAVE
+#        include <emmintrin.h>
+#    elif defined(__ARM_NEON)
+#        define PACK_USE_NEON_DEINTERLEAVE
+#        include <arm_neon.h>
+#    endif
+#endif
+
+static inline void
+deinterleave_16bit_3chan (
+    uint16_t* out0, uint16_t* out1, uint16_t* out2, const uint16_t* in, int w)
+{
+    int x = 0;
+#if defined(PACK_USE_NEON_DEINTERLEAVE)
+    for (; x + 8 <= w; x += 8)
+    {
+        uint16x8x3_t v = vld3q_u16 (in);
+        vst1q_u16 (out0 + x, v.val[0]);
+        vst1q_u16 (out1 + x, v.val[1]);
+        vst1q_u16 (out2 + x, v.val[2]);
+        in += 24;
+    }
+#endif
+    for (; x < w; ++x)
+    {
+        out0[x] = in[0];
+        out1[x] = in[1];
+        out2[x] = in[2];
+        in += 3;
+    }
+}
+
+static inline void
+deinterleave_16bit_4chan (
+    uint16_t*       out0,
+    uint16_t*       out1,
+    uint16_t*       out2,
+    uint16_t*       out3,
+    const uint16_t* in,
+    int             w)
+{
+    int x = 0;
+#if defined(PACK_USE_SSE2_DEINTERLEAVE)
+    for (; x + 8 <= w; x += 8)
+    {
+        __m128i v0 = _mm_loadu_si128 ((const __m128i*) in);
+        __m128i v1 = _mm_loadu_si128 ((const __m128i*) (in + 8));
+        __m128i v2 = _mm_loadu_si128 ((const __m128i*) (in + 16));
+        __m128i v3 = _mm_loadu_si128 ((const __m128i*) (in + 24));
+        /* a0 a2 b0 b2 c0 c2 d0 d2 / a1 a3 b1 b3 c1 c3 d1 d3 ... */
+        __m128i l01 = _mm_unpacklo_epi16 (v0, v1);
+        __m128i h01 = _mm_unpackhi_epi16 (v0, v1);
+        __m128i l23 = _mm_unpacklo_epi16 (v2, v3);
+        __m128i h23 = _mm_unpackhi_epi16 (v2, v3);
+        /* a0 a1 a2 a3 b0 b1 b2 b3 / c0 c1 c2 c3 d0 d1 d2 d3 ... */
+        __m128i s0 = _mm_unpacklo_epi16 (l01, h01);
+        __m128i s1 = _mm_unpackhi_epi16 (l01, h01);
+        __m128i s2 = _mm_unpacklo_epi16 (l23, h23);
+        __m128i s3 = _mm_unpackhi_epi16 (l23, h23);
+
+        _mm_storeu_si128 ((__m128i*) (out0 + x), _mm_unpacklo_epi64 (s0, s2));
+        _mm_storeu_si128 ((__m128i*) (out1 + x), _mm_unpackhi_epi64 (s0, s2));
+        _mm_storeu_si128 ((__m128i*) (out2 + x), _mm_unpacklo_epi64 (s1, s3));
+        _mm_storeu_si128 ((__m128i*) (out3 + x), _mm_unpackhi_epi64 (s1, s3));
+        in += 32;
+    }
+#elif defined(PACK_USE_NEON_DEINTERLEAVE)
+    for (; x + 8 <= w; x += 8)
+    {
+        uint16x8x4_t v = vld4q_u16 (in);
+        vst1q_u16 (out0 + x, v.val[0]);
+        vst1q_u16 (out1 + x, v.val[1]);
+        vst1q_u16 (out2 + x, v.val[2]);
+        vst1q_u16 (out3 + x, v.val[3]);
+        in += 32;
+    }
+#endif
+    for (; x < w; ++x)
+    {
+        out0[x] = in[0];
+        out1[x] = in[1];
+        out2[x] = in[2];
+        out3[x] = in[3];
+        in += 4;
+    }
+}
+
+static inline void
+deinterleave_32bit_3chan (
+    uint32_t* out0, uint32_t* out1, uint32_t* out2, const uint32_t* in, int w)
+{
+    int x = 0;
+#if defined(PACK_USE_SSE2_DEINTERLEAVE)
+    for (; x + 4 <= w; x += 4)
+    {
+        const float* i  = (const float*) in;
+        __m128       o0 = _mm_loadu_ps (i);     /* a0 b0 c0 a1 */
+        __m128       o1 = _mm_loadu_ps (i + 4); /* b1 c1 a2 b2 */
+        __m128       o2 = _mm_loadu_ps (i + 8); /* c2 a3 b3 c3 */
+        /* a2 b2 a3 b3 */
+        __m128 p = _mm_shuffle_ps (o1, o2, _MM_SHUFFLE (2, 1, 3, 2));
+        /* b0 c0 b1 c1 */
+        __m128 q = _mm_shuffle_ps (o0, o1, _MM_SHUFFLE (1, 0, 2, 1));
+
+        _mm_storeu_ps (
+            (float*) (out0 + x), _mm_shuffle_ps (o0, p, _MM_SHUFFLE (2, 0, 3, 0)));
+        _mm_storeu_ps (
+            (float*) (out1 + x), _mm_shuffle_ps (q, p, _MM_SHUFFLE (3, 1, 2, 0)));
+        _mm_storeu_ps (
+            (float*) (out2 + x), _mm_shuffle_ps (q, o2, _MM_SHUFFLE (3, 0, 3, 1)));
+        in += 12;
+    }
+#elif defined(PACK_USE_NEON_DEINTERLEAVE)
+    for (; x + 4 <= w; x += 4)
+    {
+        uint32x4x3_t v = vld3q_u32 (in);
+        vst1q_u32 (out0 + x, v.val[0]);
+        vst1q_u32 (out1 + x, v.val[1]);
+        vst1q_u32 (out2 + x, v.val[2]);
+        in += 12;
+    }
+#endif
+    for (; x < w; ++x)
+    {
+        out0[x] = in[0];
+        out1[x] = in[1];
+        out2[x] = in[2];
+        in += 3;
+    }
+}
+
+static inline void
+deinterleave_32bit_4chan (
+    uint32_t*       out0,
+    uint32_t*       out1,
+    uint32_t*       out2,
+    uint32_t*       out3,
+    const uint32_t* in,
+    int             w)
+{
+    int x = 0;
+#if defined(PACK_USE_SSE2_DEINTERLEAVE)
+    for (; x + 4 <= w; x += 4)
+    {
+        const float* i  = (const float*) in;
+        __m128       a  = _mm_loadu_ps (i);
+        __m128       b  = _mm_loadu_ps (i + 4);
+        __m128       c  = _mm_loadu_ps (i + 8);
+        __m128       d  = _mm_loadu_ps (i + 12);
+        __m128       t0 = _mm_unpacklo_ps (a, b);
+        __m128       t1 = _mm_unpackhi_ps (a, b);
+        __m128       t2 = _mm_unpacklo_ps (c, d);
+        __m128       t3 = _mm_unpackhi_ps (c, d);
+
+        _mm_storeu_ps ((float*) (out0 + x), _mm_movelh_ps (t0, t2));
+        _mm_storeu_ps ((float*) (out1 + x), _mm_movehl_ps (t2, t0));
+        _mm_storeu_ps ((float*) (out2 + x), _mm_movelh_ps (t1, t3));
+        _mm_storeu_ps ((float*) (out3 + x), _mm_movehl_ps (t3, t1));
+        in += 16;
+    }
+#elif defined(PACK_USE_NEON_DEINTERLEAVE)
+    for (; x + 4 <= w; x += 4)
+    {
+        uint32x4x4_t v = vld4q_u32 (in);
+        vst1q_u32 (out0 + x, v.val[0]);
+        vst1q_u32 (out1 + x, v.val[1]);
+        vst1q_u32 (out2 + x, v.val[2]);
+        vst1q_u32 (out3 + x, v.val[3]);
+        in += 16;
+    }
+#endif
+    for (; x < w; ++x)
+    {
+        out0[x] = in[0];
+        out1[x] = in[1];
+        out2[x] = in[2];
+        out3[x] = in[3];
+        in += 4;
+    }
+}
+
 /**************************************/
 
 static exr_result_t
@@ -187,11 +380,478 @@ default_pack (exr_encode_pipeline_t* encode)
     return EXR_ERR_SUCCESS;
 }
 
+#if !EXR_HOST_IS_NOT_LITTLE_ENDIAN
+
+/**************************************/
+
+/* all the channels are the same type as the file and each is a
+ * contiguous line in the user buffer, so this is a copy per line */
+static exr_result_t
+pack_planar (exr_encode_pipeline_t* encode)
+{
+    uint8_t* dstbuffer    = encode->packed_buffer;
+    uint64_t packed_bytes = 0;
+
+    for (int y = 0; y < encode->chunk.height; ++y)
+    {
+        for (int c = 0; c < encode->channel_count; ++c)
+        {
+            exr_coding_channel_info_t* encc = (encode->channels + c);
+            uint64_t                   chan_bytes =
+                (uint64_t) (encc->width) * (uint64_t) (encc->bytes_per_element);
+
+            memcpy (
+                dstbuffer,
+                encc->encode_from_ptr +
+                    (uint64_t) y * (uint64_t) encc->user_line_stride,
+                chan_bytes);
+            dstbuffer += chan_bytes;
+            packed_bytes += chan_bytes;
+        }
+    }
+
+    encode->packed_bytes = packed_bytes;
+
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+static exr_result_t
+pack_float_to_half_planar (exr_encode_pipeline_t* encode)
+{
+    uint8_t* dstbuffer    = encode->packed_buffer;
+    uint64_t packed_bytes = 0;
+
+    for (int y = 0; y < encode->chunk.height; ++y)
+    {
+        for (int c = 0; c < encode->channel_count; ++c)
+        {
+            exr_coding_channel_info_t* encc = (encode->channels + c);
+
+            float_to_half_buffer (
+                (uint16_t*) dstbuffer,
+                (const uint32_t*) (encc->encode_from_ptr +
+                                   (uint64_t) y *
+                                       (uint64_t) encc->user_line_stride),
+                encc->width);
+            dstbuffer += (uint64_t) encc->width * 2;
+            packed_bytes += (uint64_t) encc->width * 2;
+        }
+    }
+
+    encode->packed_bytes = packed_bytes;
+
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+static exr_result_t
+pack_half_to_float_planar (exr_encode_pipeline_t* encode)
+{
+    uint8_t* dstbuffer    = encode->packed_buffer;
+    uint64_t packed_bytes = 0;
+
+    for (int y = 0; y < encode->chunk.height; ++y)
+    {
+        for (int c = 0; c < encode->channel_count; ++c)
+        {
+            exr_coding_channel_info_t* encc = (encode->channels + c);
+
+            half_to_float_buffer (
+                (float*) dstbuffer,
+                (const uint16_t*) (encc->encode_from_ptr +
+                                   (uint64_t) y *
+                                       (uint64_t) encc->user_line_stride),
+                encc->width);
+            dstbuffer += (uint64_t) encc->width * 4;
+            packed_bytes += (uint64_t) encc->width * 4;
+        }
+    }
+
+    encode->packed_bytes = packed_bytes;
+
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+/* the interleaved user buffer starts at the first channel, or for
+ * the reversed (RGBA vs. ABGR) case at the last channel, and the
+ * packed lines are filled in channel order */
+static inline exr_result_t
+pack_interleave_impl (
+    exr_encode_pipeline_t* encode, int nchans, int rev, int bpc)
+{
+    uint8_t*       dstbuffer = encode->packed_buffer;
+    const uint8_t* src0;
+    uint8_t*       out[4];
+    int            w, h;
+    int            linc0;
+    uint64_t       line_bytes;
+
+    w          = encode->channels[0].width;
+    h          = encode->chunk.height;
+    linc0      = encode->channels[0].user_line_stride;
+    line_bytes = (uint64_t) w * (uint64_t) bpc;
+
+    src0 = encode->channels[rev ? nchans - 1 : 0].encode_from_ptr;
+
+    for (int y = 0; y < h; ++y)
+    {
+        for (int c = 0; c < nchans; ++c)
+            out[rev ? nchans - 1 - c : c] = dstbuffer + (uint64_t) c * line_bytes;
+
+        if (bpc == 4)
+        {
+            if (nchans == 4)
+                deinterleave_32bit_4chan (
+                    (uint32_t*) out[0],
+                    (uint32_t*) out[1],
+                    (uint32_t*) out[2],
+                    (uint32_t*) out[3],
+                    (const uint32_t*) src0,
+                    w);
+            else
+                deinterleave_32bit_3chan (
+                    (uint32_t*) out[0],
+                    (uint32_t*) out[1],
+                    (uint32_t*) out[2],
+                    (const uint32_t*) src0,
+                    w);
+        }
+        else
+        {
+            if (nchans == 4)
+                deinterleave_16bit_4chan (
+                    (uint16_t*) out[0],
+                    (uint16_t*) out[1],
+                    (uint16_t*) out[2],
+                    (uint16_t*) out[3],
+                    (const uint16_t*) src0,
+                    w);
+            else
+                deinterleave_16bit_3chan (
+                    (uint16_t*) out[0],
+                    (uint16_t*) out[1],
+                    (uint16_t*) out[2],
+                    (const uint16_t*) src0,
+                    w);
+        }
+
+        dstbuffer += line_bytes * (uint64_t) nchans;
+        src0 += linc0;
+    }
+
+    encode->packed_bytes = line_bytes * (uint64_t) nchans * (uint64_t) h;
+
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+pack_16bit_3chan_interleave (exr_encode_pipeline_t* encode)
+{
+    return pack_interleave_impl (encode, 3, 0, 2);
+}
+
+static exr_result_t
+pack_16bit_3chan_interleave_rev (exr_encode_pipeline_t* encode)
+{
+    return pack_interleave_impl (encode, 3, 1, 2);
+}
+
+static exr_result_t
+pack_16bit_4chan_interleave (exr_encode_pipeline_t* encode)
+{
+    return pack_interleave_impl (encode, 4, 0, 2);
+}
+
+static exr_result_t
+pack_16bit_4chan_interleave_rev (exr_encode_pipeline_t* encode)
+{
+    return pack_interleave_impl (encode, 4, 1, 2);
+}
+
+static exr_result_t
+pack_32bit_3chan_interleave (exr_encode_pipeline_t* encode)
+{
+    return pack_interleave_impl (encode, 3, 0, 4);
+}
+
+static exr_result_t
+pack_32bit_3chan_interleave_rev (exr_encode_pipeline_t* encode)
+{
+    return pack_interleave_impl (encode, 3, 1, 4);
+}
+
+static exr_result_t
+pack_32bit_4chan_interleave (exr_encode_pipeline_t* encode)
+{
+    return pack_interleave_impl (encode, 4, 0, 4);
+}
+
+static exr_result_t
+pack_32bit_4chan_interleave_rev (exr_encode_pipeline_t* encode)
+{
+    return pack_interleave_impl (encode, 4, 1, 4);
+}
+
+/**************************************/
+
+/* split the float pixels in to blocks of per-channel lines on the
+ * stack, then narrow those straight in to the packed buffer */
+#define PACK_NARROW_BLOCK 64
+
+static inline exr_result_t
+pack_float_to_half_interleave_impl (
+    exr_encode_pipeline_t* encode, int nchans, int rev)
+{
+    uint8_t*       dstbuffer = encode->packed_buffer;
+    const uint8_t* src0;
+    uint16_t*      out[4];
+    uint32_t       tmp[4][PACK_NARROW_BLOCK];
+    uint32_t*      tmpc[4];
+    int            w, h;
+    int            linc0;
+    uint64_t       line_bytes;
+
+    w          = encode->channels[0].width;
+    h          = encode->chunk.height;
+    linc0      = encode->channels[0].user_line_stride;
+    line_bytes = (uint64_t) w * 2;
+
+    src0 = encode->channels[rev ? nchans - 1 : 0].encode_from_ptr;
+
+    for (int c = 0; c < nchans; ++c)
+        tmpc[rev ? nchans - 1 - c : c] = tmp[c];
+
+    for (int y = 0; y < h; ++y)
+    {
+        const uint32_t* in = (const uint32_t*) src0;
+
+        for (int c = 0; c < nchans; ++c)
+            out[c] = (uint16_t*) (dstbuffer + (uint64_t) c * line_bytes);
+
+        for (int x = 0; x < w; x += PACK_NARROW_BLOCK)
+        {
+            int n = w - x;
+            if (n > PACK_NARROW_BLOCK) n = PACK_NARROW_BLOCK;
+
+            if (nchans == 4)
+                deinterleave_32bit_4chan (
+                    tmpc[0], tmpc[1], tmpc[2], tmpc[3], in, n);
+            else
+                deinterleave_32bit_3chan (tmpc[0], tmpc[1], tmpc[2], in, n);
+            in += n * nchans;
+
+            for (int c = 0; c < nchans; ++c)
+                float_to_half_buffer (out[c] + x, tmp[c], n);
+        }
+
+        dstbuffer += line_bytes * (uint64_t) nchans;
+        src0 += linc0;
+    }
+
+    encode->packed_bytes = line_bytes * (uint64_t) nchans * (uint64_t) h;
+
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+pack_float_to_half_3chan_interleave (exr_encode_pipeline_t* encode)
+{
+    return pack_float_to_half_interleave_impl (encode, 3, 0);
+}
+
+static exr_result_t
+pack_float_to_half_3chan_interleave_rev (exr_encode_pipeline_t* encode)
+{
+    return pack_float_to_half_interleave_impl (encode, 3, 1);
+}
+
+static exr_result_t
+pack_float_to_half_4chan_interleave (exr_encode_pipeline_t* encode)
+{
+    return pack_float_to_half_interleave_impl (encode, 4, 0);
+}
+
+static exr_result_t
+pack_float_to_half_4chan_interleave_rev (exr_encode_pipeline_t* encode)
+{
+    return pack_float_to_half_interleave_impl (encode, 4, 1);
+}
+
+#endif /* !EXR_HOST_IS_NOT_LITTLE_ENDIAN */
+
+/**************************************/
+
 internal_exr_pack_fn
 internal_exr_match_encode (exr_encode_pipeline_t* encode, int isdeep)
 {
-    (void) encode;
+#ifdef EXR_HAS_STD_ATOMICS
+    static atomic_int init_cpu_check = 1;
+#else
+    static int init_cpu_check = 1;
+#endif
+    if (init_cpu_check)
+    {
+        choose_half_to_float_impl ();
+        choose_float_to_half_impl ();
+        init_cpu_check = 0;
+    }
+
     if (isdeep) return &default_pack_deep;
 
+#if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+    return &default_pack;
+#else
+    int32_t sametype = -2, sameintype = -2, samebpc = 0, sameinbpc = 0,
+            hassampling = 0, hastypechange = 0, simpinterleave = 0,
+            simpinterleaverev = 0, sameininc = 0, missing = 0;
+    const uint8_t* interleaveptr = NULL;
+
+    for (int c = 0; c < encode->channel_count; ++c)
+    {
+        const exr_coding_channel_info_t* encc = (encode->channels + c);
+
+        if (encc->height == 0 || !encc->encode_from_ptr)
+        {
+            ++missing;
+            continue;
+        }
+
+        if (sametype == -2)
+            sametype = (int32_t) encc->data_type;
+        else if (sametype != (int32_t) encc->data_type)
+            sametype = -1;
+
+        if (sameintype == -2)
+            sameintype = (int32_t) encc->user_data_type;
+        else if (sameintype != (int32_t) encc->user_data_type)
+            sameintype = -1;
+
+        if (samebpc == 0)
+            samebpc = encc->bytes_per_element;
+        else if (samebpc != encc->bytes_per_element)
+            samebpc = -1;
+
+        if (sameinbpc == 0)
+            sameinbpc = encc->user_bytes_per_element;
+        else if (sameinbpc != encc->user_bytes_per_element)
+            sameinbpc = -1;
+
+        if (encc->x_samples != 1 || encc->y_samples != 1) hassampling = 1;
+
+        if (encc->user_data_type != encc->data_type) ++hastypechange;
+
+        if (simpinterleave == 0)
+        {
+            interleaveptr     = encc->encode_from_ptr;
+            simpinterleave    = encc->user_pixel_stride;
+            simpinterleaverev = encc->user_pixel_stride;
+        }
+        else
+        {
+            if (simpinterleave > 0 &&
+                encc->encode_from_ptr !=
+                    (interleaveptr + c * encc->user_bytes_per_element))
+            {
+                simpinterleave = -1;
+            }
+            if (simpinterleaverev > 0 &&
+                encc->encode_from_ptr !=
+                    (interleaveptr - c * encc->user_bytes_per_element))
+            {
+                simpinterleaverev = -1;
+            }
+        }
+
+        if (sameininc == 0)
+            sameininc = encc->user_pixel_stride;
+        else if (sameininc != encc->user_pixel_stride)
+            sameininc = -1;
+    }
+
+    if (simpinterleave != sameinbpc * encode->channel_count)
+        simpinterleave = -1;
+    if (simpinterleaverev != sameinbpc * encode->channel_count)
+        simpinterleaverev = -1;
+
+    if (missing > 0 || hassampling || samebpc <= 0 || sameinbpc <= 0)
+        return &default_pack;
+
+    if (hastypechange > 0)
+    {
+        if (sametype == (int) EXR_PIXEL_HALF &&
+            sameintype == (int) EXR_PIXEL_FLOAT)
+        {
+            if (simpinterleave > 0)
+            {
+                if (encode->channel_count == 4)
+                    return &pack_float_to_half_4chan_interleave;
+                if (encode->channel_count == 3)
+                    return &pack_float_to_half_3chan_interleave;
+            }
+
+            if (simpinterleaverev > 0)
+            {
+                if (encode->channel_count == 4)
+                    return &pack_float_to_half_4chan_interleave_rev;
+                if (encode->channel_count == 3)
+                    return &pack_float_to_half_3chan_interleave_rev;
+            }
+
+            if (sameininc == 4) return &pack_float_to_half_planar;
+        }
+
+        if (sametype == (int) EXR_PIXEL_FLOAT &&
+            sameintype == (int) EXR_PIXEL_HALF && sameininc == 2)
+            return &pack_half_to_float_planar;
+
+        return &default_pack;
+    }
+
+    if (sameininc == samebpc) return &pack_planar;
+
+    if (samebpc == 2)
+    {
+        if (simpinterleave > 0)
+        {
+            if (encode->channel_count == 4)
+                return &pack_16bit_4chan_interleave;
+            if (encode->channel_count == 3)
+                return &pack_16bit_3chan_interleave;
+        }
+
+        if (simpinterleaverev > 0)
+        {
+            if (encode->channel_count == 4)
+                return &pack_16bit_4chan_interleave_rev;
+            if (encode->channel_count == 3)
+                return &pack_16bit_3chan_interleave_rev;
+        }
+    }
+
+    if (samebpc == 4)
+    {
+        if (simpinterleave > 0)
+        {
+            if (encode->channel_count == 4)
+                return &pack_32bit_4chan_interleave;
+            if (encode->channel_count == 3)
+                return &pack_32bit_3chan_interleave;
+        }
+
+        if (simpinterleaverev > 0)
+        {
+            if (encode->channel_count == 4)
+                return &pack_32bit_4chan_interleave_rev;
+            if (encode->channel_count == 3)
+                return &pack_32bit_3chan_interleave_rev;
+        }
+    }
+
     return &default_pack;
+#endif
 }
@@ -629,3 +629,232 @@ exr_set_dwa_compression_level (exr_context_t ctxt, int part_index, float level)
 
     return EXR_UNLOCK_AND_RETURN (rv);
 }
+
+/**************************************/
+
+exr_result_t
+exr_get_piz_huffman_streams (
+    exr_const_context_t ctxt, int part_index, int* streams)
+{
+    int n;
+    EXR_LOCK_WRITE_AND_DEFINE_PART (part_index);
+    n = part->piz_huffman_streams;
+    if (ctxt->mode == EXR_CONTEXT_WRITE) internal_exr_unlock (ctxt);
+
+    if (!streams) return ctxt->standard_error (ctxt, EXR_ERR_INVALID_ARGUMENT);
+    *streams = n;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+exr_set_piz_huffman_streams (exr_context_t ctxt, int part_index, int streams)
+{
+    exr_result_t rv;
+    EXR_LOCK_AND_DEFINE_PART (part_index);
+
+    if (ctxt->mode != EXR_CONTEXT_WRITE && ctxt->mode != EXR_CONTEXT_TEMPORARY)
+        return EXR_UNLOCK_AND_RETURN (
+            ctxt->standard_error (ctxt, EXR_ERR_NOT_OPEN_WRITE));
+
+    if (streams >= 1 && streams <= 8)
+    {
+        part->piz_huffman_streams = streams;
+        rv                        = EXR_ERR_SUCCESS;
+    }
+    else
+    {
+        return EXR_UNLOCK_AND_RETURN (ctxt->report_error (
+            ctxt,
+            EXR_ERR_INVALID_ARGUMENT,
+            "Invalid PIZ Huffman stream count specified"));
+    }
+
+    return EXR_UNLOCK_AND_RETURN (rv);
+}
+
+/**************************************/
+
+exr_result_t
+exr_get_htj2k_block_size (
+    exr_const_context_t ctxt, int part_index, int* width, int* height)
+{
+    int w, h;
+    EXR_LOCK_WRITE_AND_DEFINE_PART (part_index);
+    w = part->htj2k_block_width;
+    h = part->htj2k_block_height;
+    if (ctxt->mode == EXR_CONTEXT_WRITE) internal_exr_unlock (ctxt);
+
+    if (!width || !height)
+        return ctxt->standard_error (ctxt, EXR_ERR_INVALID_ARGUMENT);
+    *width  = w;
+    *height = h;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+exr_set_htj2k_block_size (
+    exr_context_t ctxt, int part_index, int width, int height)
+{
+    exr_result_t rv;
+    EXR_LOCK_AND_DEFINE_PART (part_index);
+
+    if (ctxt->mode != EXR_CONTEXT_WRITE && ctxt->mode != EXR_CONTEXT_TEMPORARY)
+        return EXR_UNLOCK_AND_RETURN (
+            ctxt->standard_error (ctxt, EXR_ERR_NOT_OPEN_WRITE));
+
+    if (internal_exr_valid_htj2k_block_size (width, height))
+    {
+        part->htj2k_block_width  = width;
+        part->htj2k_block_height = height;
+        rv                       = EXR_ERR_SUCCESS;
+    }
+    else
+    {
+        return EXR_UNLOCK_AND_RETURN (ctxt->print_error (
+            ctxt,
+            EXR_ERR_INVALID_ARGUMENT,
+            "Invalid HTJ2K code-block size %d x %d specified",
+            width,
+            height));
+    }
+
+    return EXR_UNLOCK_AND_RETURN (rv);
+}
+
+/**************************************/
+
+exr_result_t
+exr_get_htj2k_levels (exr_const_context_t ctxt, int part_index, int* levels)
+{
+    int n;
+    EXR_LOCK_WRITE_AND_DEFINE_PART (part_index);
+    n = part->htj2k_levels;
+    if (ctxt->mode == EXR_CONTEXT_WRITE) internal_exr_unlock (ctxt);
+
+    if (!levels) return ctxt->standard_error (ctxt, EXR_ERR_INVALID_ARGUMENT);
+    *levels = n;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+exr_set_htj2k_levels (exr_context_t ctxt, int part_index, int levels)
+{
+    exr_result_t rv;
+    EXR_LOCK_AND_DEFINE_PART (part_index);
+
+    if (ctxt->mode != EXR_CONTEXT_WRITE && ctxt->mode != EXR_CONTEXT_TEMPORARY)
+        return EXR_UNLOCK_AND_RETURN (
+            ctxt->standard_error (ctxt, EXR_ERR_NOT_OPEN_WRITE));
+
+    if (levels >= 0 && levels <= EXR_HTJ2K_MAX_LEVELS)
+    {
+        part->htj2k_levels = levels;
+        rv                 = EXR_ERR_SUCCESS;
+    }
+    else
+    {
+        return EXR_UNLOCK_AND_RETURN (ctxt->report_error (
+            ctxt,
+            EXR_ERR_INVALID_ARGUMENT,
+            "Invalid HTJ2K decomposition level count specified"));
+    }
+
+    return EXR_UNLOCK_AND_RETURN (rv);
+}
+
+/**************************************/
+
+exr_result_t
+exr_get_htj2k_progression (
+    exr_const_context_t ctxt, int part_index, exr_htj2k_progression_t* order)
+{
+    int o;
+    EXR_LOCK_WRITE_AND_DEFINE_PART (part_index);
+    o = part->htj2k_progression;
+    if (ctxt->mode == EXR_CONTEXT_WRITE) internal_exr_unlock (ctxt);
+
+    if (!order) return ctxt->standard_error (ctxt, EXR_ERR_INVALID_ARGUMENT);
+    *order = (exr_htj2k_progression_t) o;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+exr_set_htj2k_progression (
+    exr_context_t ctxt, int part_index, exr_htj2k_progression_t order)
+{
+    exr_result_t rv;
+    EXR_LOCK_AND_DEFINE_PART (part_index);
+
+    if (ctxt->mode != EXR_CONTEXT_WRITE && ctxt->mode != EXR_CONTEXT_TEMPORARY)
+        return EXR_UNLOCK_AND_RETURN (
+            ctxt->standard_error (ctxt, EXR_ERR_NOT_OPEN_WRITE));
+
+    if ((int) order >= 0 && order < EXR_HTJ2K_PROGRESSION_LAST_TYPE)
+    {
+        part->htj2k_progression = (int32_t) order;
+        rv                      = EXR_ERR_SUCCESS;
+    }
+    else
+    {
+        return EXR_UNLOCK_AND_RETURN (ctxt->report_error (
+            ctxt,
+            EXR_ERR_INVALID_ARGUMENT,
+            "Invalid HTJ2K progression order specified"));
+    }
+
+    return EXR_UNLOCK_AND_RETURN (rv);
+}
+
+/**************************************/
+
+exr_result_t
+exr_get_htj2k_quantization_step (
+    exr_const_context_t ctxt, int part_index, float* step)
+{
+    float q;
+    EXR_LOCK_WRITE_AND_DEFINE_PART (part_index);
+    q = part->htj2k_quantization_step;
+    if (ctxt->mode == EXR_CONTEXT_WRITE) internal_exr_unlock (ctxt);
+
+    if (!step) return ctxt->standard_error (ctxt, EXR_ERR_INVALID_ARGUMENT);
+    *step = q;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+exr_set_htj2k_quantization_step (
+    exr_context_t ctxt, int part_index, float step)
+{
+    exr_result_t rv;
+    EXR_LOCK_AND_DEFINE_PART (part_index);
+
+    if (ctxt->mode != EXR_CONTEXT_WRITE && ctxt->mode != EXR_CONTEXT_TEMPORARY)
+        return EXR_UNLOCK_AND_RETURN (
+            ctxt->standard_error (ctxt, EXR_ERR_NOT_OPEN_WRITE));
+
+    // NaN fails both compares, so is rejected too
+    if (step >= 0.f && step <= 1.f)
+    {
+        part->htj2k_quantization_step = step;
+        rv                            = EXR_ERR_SUCCESS;
+    }
+    else
+    {
+        return EXR_UNLOCK_AND_RETURN (ctxt->report_error (
+            ctxt,
+            EXR_ERR_INVALID_ARGUMENT,
+            "Invalid HTJ2K quantization step specified"));
+    }
+
+    return EXR_UNLOCK_AND_RETURN (rv);
+}
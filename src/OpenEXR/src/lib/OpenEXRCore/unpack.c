@@ -4,8 +4,8 @@
 */
 
 #include "internal_coding.h"
+#include "internal_half_buffer.h"
 #include "internal_xdr.h"
-#include "internal_cpuid.h"
 
 #include "openexr_attr.h"
 
@@ -13,203 +13,239 @@
 
 /**************************************/
 
-/* TODO: learn arm neon intrinsics for this */
-#if (defined(__x86_64__) || defined(_M_X64))
-#    if defined(__AVX__) && (defined(__F16C__) || defined(__GNUC__) || defined(__clang__))
-#        define USE_F16C_INTRINSICS
-#    elif (defined(__GNUC__) || defined(__clang__))
-#        define ENABLE_F16C_TEST
+/* interleaving of 32-bit planes (float or uint, the bits are only
+ * moved, never interpreted) into 3 / 4 channel pixels. No byte
+ * swapping is done here, callers handle the little endian file data
+ * on big endian hosts (where only the scalar version is built) */
+#if !EXR_HOST_IS_NOT_LITTLE_ENDIAN
+#    if defined(__SSE2__) || defined(_M_X64) ||                                \
+        (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#        define UNPACK_USE_SSE2_INTERLEAVE
+#        include <emmintrin.h>
+#    elif defined(__ARM_NEON)
+#        define UNPACK_USE_NEON_INTERLEAVE
+#        include <arm_neon.h>
 #    endif
 #endif
 
-#if defined(USE_F16C_INTRINSICS) || defined(ENABLE_F16C_TEST)
-#    if defined(USE_F16C_INTRINSICS)
 static inline void
-half_to_float_buffer (float* out, const uint16_t* in, int w)
-#    elif defined(ENABLE_F16C_TEST)
-__attribute__ ((target ("f16c"))) static void
-half_to_float_buffer_f16c (float* out, const uint16_t* in, int w)
-#    endif
+interleave_32bit_3chan (
+    uint32_t*       out,
+    const uint32_t* in0,
+    const uint32_t* in1,
+    const uint32_t* in2,
+    int             w)
 {
-    while (w >= 8)
+    int x = 0;
+#if defined(UNPACK_USE_SSE2_INTERLEAVE)
+    for (; x + 4 <= w; x += 4)
     {
-        _mm256_storeu_ps (
-            out, _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i*) in)));
-        out += 8;
-        in += 8;
-        w -= 8;
+        __m128 a  = _mm_loadu_ps ((const float*) (in0 + x));
+        __m128 b  = _mm_loadu_ps ((const float*) (in1 + x));
+        __m128 c  = _mm_loadu_ps ((const float*) (in2 + x));
+        __m128 t0 = _mm_unpacklo_ps (a, b); /* a0 b0 a1 b1 */
+        __m128 t1 = _mm_unpackhi_ps (a, b); /* a2 b2 a3 b3 */
+        __m128 u  = _mm_shuffle_ps (c, t0, _MM_SHUFFLE (2, 2, 0, 0));
+        __m128 v  = _mm_shuffle_ps (t0, c, _MM_SHUFFLE (1, 1, 3, 3));
+        __m128 s  = _mm_shuffle_ps (c, t1, _MM_SHUFFLE (2, 2, 2, 2));
+        __m128 z  = _mm_shuffle_ps (t1, c, _MM_SHUFFLE (3, 3, 3, 3));
+        float* o  = (float*) out;
+
+        _mm_storeu_ps (o, _mm_shuffle_ps (t0, u, _MM_SHUFFLE (2, 0, 1, 0)));
+        _mm_storeu_ps (o + 4, _mm_shuffle_ps (v, t1, _MM_SHUFFLE (1, 0, 2, 0)));
+        _mm_storeu_ps (o + 8, _mm_shuffle_ps (s, z, _MM_SHUFFLE (2, 0, 2, 0)));
+        out += 12;
     }
-    // gcc < 9 does not have loadu_si64
-#    if defined(__clang__) || (__GNUC__ >= 9)
-    switch (w)
+#elif defined(UNPACK_USE_NEON_INTERLEAVE)
+    for (; x + 4 <= w; x += 4)
     {
-        case 7:
-            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            out[6] = half_to_float (in[6]);
-            break;
-        case 6:
-            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            break;
-        case 5:
-            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
-            out[4] = half_to_float (in[4]);
-            break;
-        case 4: _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in))); break;
-        case 3:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            out[2] = half_to_float (in[2]);
-            break;
-        case 2:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            break;
-        case 1: out[0] = half_to_float (in[0]); break;
+        uint32x4x3_t v;
+        v.val[0] = vld1q_u32 (in0 + x);
+        v.val[1] = vld1q_u32 (in1 + x);
+        v.val[2] = vld1q_u32 (in2 + x);
+        vst3q_u32 (out, v);
+        out += 12;
     }
-#    else
-    while (w > 0)
+#endif
+    for (; x < w; ++x)
     {
-        *out++ = half_to_float (*in++);
-        --w;
+        out[0] = in0[x];
+        out[1] = in1[x];
+        out[2] = in2[x];
+        out += 3;
     }
-#    endif
 }
-#endif
 
-#ifndef USE_F16C_INTRINSICS
 static inline void
-half_to_float4 (float* out, const uint16_t* src)
+interleave_32bit_4chan (
+    uint32_t*       out,
+    const uint32_t* in0,
+    const uint32_t* in1,
+    const uint32_t* in2,
+    const uint32_t* in3,
+    int             w)
 {
-    out[0] = half_to_float (src[0]);
-    out[1] = half_to_float (src[1]);
-    out[2] = half_to_float (src[2]);
-    out[3] = half_to_float (src[3]);
-}
-
-static inline void
-half_to_float8 (float* out, const uint16_t* src)
-{
-    half_to_float4 (out, src);
-    half_to_float4 (out + 4, src + 4);
-}
-#else
-/* when we explicitly compile against f16, force it in, do not need a chooser */
-static inline void
-choose_half_to_float_impl (void)
-{}
-#endif
-
-#ifdef ENABLE_F16C_TEST
-static void
-half_to_float_buffer_impl (float* out, const uint16_t* in, int w)
-{
-    while (w >= 8)
+    int x = 0;
+#if defined(UNPACK_USE_SSE2_INTERLEAVE)
+    for (; x + 4 <= w; x += 4)
+    {
+        __m128 a  = _mm_loadu_ps ((const float*) (in0 + x));
+        __m128 b  = _mm_loadu_ps ((const float*) (in1 + x));
+        __m128 c  = _mm_loadu_ps ((const float*) (in2 + x));
+        __m128 d  = _mm_loadu_ps ((const float*) (in3 + x));
+        __m128 t0 = _mm_unpacklo_ps (a, b); /* a0 b0 a1 b1 */
+        __m128 t1 = _mm_unpackhi_ps (a, b); /* a2 b2 a3 b3 */
+        __m128 t2 = _mm_unpacklo_ps (c, d); /* c0 d0 c1 d1 */
+        __m128 t3 = _mm_unpackhi_ps (c, d); /* c2 d2 c3 d3 */
+        float* o  = (float*) out;
+
+        _mm_storeu_ps (o, _mm_movelh_ps (t0, t2));
+        _mm_storeu_ps (o + 4, _mm_movehl_ps (t2, t0));
+        _mm_storeu_ps (o + 8, _mm_movelh_ps (t1, t3));
+        _mm_storeu_ps (o + 12, _mm_movehl_ps (t3, t1));
+        out += 16;
+    }
+#elif defined(UNPACK_USE_NEON_INTERLEAVE)
+    for (; x + 4 <= w; x += 4)
     {
-        half_to_float8 (out, in);
-        out += 8;
-        in += 8;
-        w -= 8;
+        uint32x4x4_t v;
+        v.val[0] = vld1q_u32 (in0 + x);
+        v.val[1] = vld1q_u32 (in1 + x);
+        v.val[2] = vld1q_u32 (in2 + x);
+        v.val[3] = vld1q_u32 (in3 + x);
+        vst4q_u32 (out, v);
+        out += 16;
     }
-    switch (w)
+#endif
+    for (; x < w; ++x)
     {
-        case 7:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            out[6] = half_to_float (in[6]);
-            break;
-        case 6:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            break;
-        case 5:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            break;
-        case 4: half_to_float4 (out, in); break;
-        case 3:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            out[2] = half_to_float (in[2]);
-            break;
-        case 2:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            break;
-        case 1: out[0] = half_to_float (in[0]); break;
+        out[0] = in0[x];
+        out[1] = in1[x];
+        out[2] = in2[x];
+        out[3] = in3[x];
+        out += 4;
     }
 }
 
-static void (*half_to_float_buffer) (float*, const uint16_t*, int) =
-    &half_to_float_buffer_impl;
+/* narrow and interleave, going through a small block on the stack so
+ * the (possibly dispatched) conversion runs over contiguous runs */
+#define UNPACK_NARROW_BLOCK 64
 
 static inline void
-choose_half_to_float_impl (void)
+interleave_float_to_half (
+    uint16_t* out, const uint32_t* const* in, int nchans, int w)
 {
-    if (has_native_half ()) half_to_float_buffer = &half_to_float_buffer_f16c;
-}
-
-#endif /* ENABLE_F16C_TEST */
+    uint16_t tmp[4][UNPACK_NARROW_BLOCK];
 
-#if !(defined(ENABLE_F16C_TEST) || defined(USE_F16C_INTRINSICS))
+    for (int x = 0; x < w; x += UNPACK_NARROW_BLOCK)
+    {
+        int n = w - x;
+        if (n > UNPACK_NARROW_BLOCK) n = UNPACK_NARROW_BLOCK;
+        for (int c = 0; c < nchans; ++c)
+            float_to_half_buffer (tmp[c], in[c] + x, n);
+        if (nchans == 4)
+        {
+            int i = 0;
+#if defined(UNPACK_USE_SSE2_INTERLEAVE)
+            for (; i + 8 <= n; i += 8)
+            {
+                __m128i a  = _mm_loadu_si128 ((const __m128i*) (tmp[0] + i));
+                __m128i b  = _mm_loadu_si128 ((const __m128i*) (tmp[1] + i));
+                __m128i c  = _mm_loadu_si128 ((const __m128i*) (tmp[2] + i));
+                __m128i d  = _mm_loadu_si128 ((const __m128i*) (tmp[3] + i));
+                __m128i t0 = _mm_unpacklo_epi16 (a, b);
+                __m128i t1 = _mm_unpackhi_epi16 (a, b);
+                __m128i t2 = _mm_unpacklo_epi16 (c, d);
+                __m128i t3 = _mm_unpackhi_epi16 (c, d);
+
+                _mm_storeu_si128 ((__m128i*) out, _mm_unpacklo_epi32 (t0, t2));
+                _mm_storeu_si128 (
+                    (__m128i*) (out + 8), _mm_unpackhi_epi32 (t0, t2));
+                _mm_storeu_si128 (
+                    (__m128i*) (out + 16), _mm_unpacklo_epi32 (t1, t3));
+                _mm_storeu_si128 (
+                    (__m128i*) (out + 24), _mm_unpackhi_epi32 (t1, t3));
+                out += 32;
+            }
+#elif defined(UNPACK_USE_NEON_INTERLEAVE)
+            for (; i + 8 <= n; i += 8)
+            {
+                uint16x8x4_t v;
+                v.val[0] = vld1q_u16 (tmp[0] + i);
+                v.val[1] = vld1q_u16 (tmp[1] + i);
+                v.val[2] = vld1q_u16 (tmp[2] + i);
+                v.val[3] = vld1q_u16 (tmp[3] + i);
+                vst4q_u16 (out, v);
+                out += 32;
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                out[0] = tmp[0][i];
+                out[1] = tmp[1][i];
+                out[2] = tmp[2][i];
+                out[3] = tmp[3][i];
+                out += 4;
+            }
+        }
+        else
+        {
+            int i = 0;
+#if defined(UNPACK_USE_NEON_INTERLEAVE)
+            for (; i + 8 <= n; i += 8)
+            {
+                uint16x8x3_t v;
+                v.val[0] = vld1q_u16 (tmp[0] + i);
+                v.val[1] = vld1q_u16 (tmp[1] + i);
+                v.val[2] = vld1q_u16 (tmp[2] + i);
+                vst3q_u16 (out, v);
+                out += 24;
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                out[0] = tmp[0][i];
+                out[1] = tmp[1][i];
+                out[2] = tmp[2][i];
+                out += 3;
+            }
+        }
+    }
+}
 
+/* same for widening, converting runs of each channel then
+ * interleaving the resulting floats */
 static inline void
-half_to_float_buffer (float* out, const uint16_t* in, int w)
+interleave_half_to_float (
+    float* out, const uint16_t* const* in, int nchans, int w)
 {
-#    if EXR_HOST_IS_NOT_LITTLE_ENDIAN
-    for (int x = 0; x < w; ++x)
-        out[x] = half_to_float (one_to_native16 (in[x]));
-#    else
-    while (w >= 8)
-    {
-        half_to_float8 (out, in);
-        out += 8;
-        in += 8;
-        w -= 8;
-    }
-    switch (w)
+    float tmp[4][UNPACK_NARROW_BLOCK];
+
+    for (int x = 0; x < w; x += UNPACK_NARROW_BLOCK)
     {
-        case 7:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            out[6] = half_to_float (in[6]);
-            break;
-        case 6:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            break;
-        case 5:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            break;
-        case 4: half_to_float4 (out, in); break;
-        case 3:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            out[2] = half_to_float (in[2]);
-            break;
-        case 2:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            break;
-        case 1: out[0] = half_to_float (in[0]); break;
+        int n = w - x;
+        if (n > UNPACK_NARROW_BLOCK) n = UNPACK_NARROW_BLOCK;
+        for (int c = 0; c < nchans; ++c)
+            half_to_float_buffer (tmp[c], in[c] + x, n);
+        if (nchans == 4)
+            interleave_32bit_4chan (
+                (uint32_t*) out,
+                (const uint32_t*) tmp[0],
+                (const uint32_t*) tmp[1],
+                (const uint32_t*) tmp[2],
+                (const uint32_t*) tmp[3],
+                n);
+        else
+            interleave_32bit_3chan (
+                (uint32_t*) out,
+                (const uint32_t*) tmp[0],
+                (const uint32_t*) tmp[1],
+                (const uint32_t*) tmp[2],
+                n);
+        out += n * nchans;
     }
-#    endif
 }
 
-static void
-choose_half_to_float_impl (void)
-{}
-
-#endif
-
 /**************************************/
 
 static exr_result_t
@@ -336,12 +372,9 @@ unpack_half_to_float_3chan_interleave (exr_decode_pipeline_t* decode)
         in2 = in1 + w;
 
         srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
         {
-            out[0] = half_to_float (one_to_native16 (in0[x]));
-            out[1] = half_to_float (one_to_native16 (in1[x]));
-            out[2] = half_to_float (one_to_native16 (in2[x]));
-            out += 3;
+            const uint16_t* in[3] = {in0, in1, in2};
+            interleave_half_to_float (out, in, 3, w);
         }
         out0 += linc0;
     }
@@ -382,12 +415,9 @@ unpack_half_to_float_3chan_interleave_rev (exr_decode_pipeline_t* decode)
         in2 = in1 + w;
 
         srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
         {
-            out[0] = half_to_float (one_to_native16 (in2[x]));
-            out[1] = half_to_float (one_to_native16 (in1[x]));
-            out[2] = half_to_float (one_to_native16 (in0[x]));
-            out += 3;
+            const uint16_t* in[3] = {in2, in1, in0};
+            interleave_half_to_float (out, in, 3, w);
         }
         out0 += linc0;
     }
@@ -702,13 +732,9 @@ unpack_half_to_float_4chan_interleave (exr_decode_pipeline_t* decode)
         in3        = in2 + w;
 
         srcbuffer += w * 8; // 4 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
         {
-            out[0] = half_to_float (one_to_native16 (in0[x]));
-            out[1] = half_to_float (one_to_native16 (in1[x]));
-            out[2] = half_to_float (one_to_native16 (in2[x]));
-            out[3] = half_to_float (one_to_native16 (in3[x]));
-            out += 4;
+            const uint16_t* in[4] = {in0, in1, in2, in3};
+            interleave_half_to_float (out, in, 4, w);
         }
         out0 += linc0;
     }
@@ -749,13 +775,9 @@ unpack_half_to_float_4chan_interleave_rev (exr_decode_pipeline_t* decode)
         in3        = in2 + w;
 
         srcbuffer += w * 8; // 4 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
         {
-            out[0] = half_to_float (one_to_native16 (in3[x]));
-            out[1] = half_to_float (one_to_native16 (in2[x]));
-            out[2] = half_to_float (one_to_native16 (in1[x]));
-            out[3] = half_to_float (one_to_native16 (in0[x]));
-            out += 4;
+            const uint16_t* in[4] = {in3, in2, in1, in0};
+            interleave_half_to_float (out, in, 4, w);
         }
         out0 += linc0;
     }
@@ -1007,8 +1029,177 @@ unpack_16bit (exr_decode_pipeline_t* decode)
     return EXR_ERR_SUCCESS;
 }
 
-//static exr_result_t unpack_32bit_3chan (exr_decode_pipeline_t* decode);
-//static exr_result_t unpack_32bit_4chan (exr_decode_pipeline_t* decode);
+/**************************************/
+
+static inline exr_result_t
+unpack_32bit_interleave_impl (
+    exr_decode_pipeline_t* decode, int nchans, int rev)
+{
+    /* we know we're unpacking all the channels and there is no subsampling */
+    const uint8_t*  srcbuffer = decode->unpacked_buffer;
+    const uint32_t* in[4];
+    uint8_t*        out0;
+    int             w, h;
+    int             linc0;
+
+    w     = decode->channels[0].width;
+    h     = decode->chunk.height - decode->user_line_end_ignore;
+    linc0 = decode->channels[0].user_line_stride;
+
+    out0 = decode->channels[rev ? nchans - 1 : 0].decode_to_ptr;
+
+    /*
+     * not actually using y in the loop, so just pre-increment
+     * the srcbuffer for any skip
+     */
+    srcbuffer += decode->user_line_begin_skip * w * 4 * nchans;
+
+    for (int y = decode->user_line_begin_skip; y < h; ++y)
+    {
+        for (int c = 0; c < nchans; ++c)
+            in[rev ? nchans - 1 - c : c] =
+                ((const uint32_t*) srcbuffer) + c * w;
+
+        if (nchans == 4)
+            interleave_32bit_4chan (
+                (uint32_t*) out0, in[0], in[1], in[2], in[3], w);
+        else
+            interleave_32bit_3chan ((uint32_t*) out0, in[0], in[1], in[2], w);
+#if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+        for (int x = 0; x < w * nchans; ++x)
+            ((uint32_t*) out0)[x] = one_to_native32 (((uint32_t*) out0)[x]);
+#endif
+
+        srcbuffer += w * 4 * nchans;
+        out0 += linc0;
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+unpack_32bit_3chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_32bit_interleave_impl (decode, 3, 0);
+}
+
+static exr_result_t
+unpack_32bit_3chan_interleave_rev (exr_decode_pipeline_t* decode)
+{
+    return unpack_32bit_interleave_impl (decode, 3, 1);
+}
+
+static exr_result_t
+unpack_32bit_4chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_32bit_interleave_impl (decode, 4, 0);
+}
+
+static exr_result_t
+unpack_32bit_4chan_interleave_rev (exr_decode_pipeline_t* decode)
+{
+    return unpack_32bit_interleave_impl (decode, 4, 1);
+}
+
+/**************************************/
+
+static inline exr_result_t
+unpack_float_to_half_interleave_impl (
+    exr_decode_pipeline_t* decode, int nchans, int rev)
+{
+    /* we know we're unpacking all the channels and there is no subsampling */
+    const uint8_t*  srcbuffer = decode->unpacked_buffer;
+    const uint32_t* in[4];
+    uint8_t*        out0;
+    int             w, h;
+    int             linc0;
+
+    w     = decode->channels[0].width;
+    h     = decode->chunk.height - decode->user_line_end_ignore;
+    linc0 = decode->channels[0].user_line_stride;
+
+    out0 = decode->channels[rev ? nchans - 1 : 0].decode_to_ptr;
+
+    /*
+     * not actually using y in the loop, so just pre-increment
+     * the srcbuffer for any skip
+     */
+    srcbuffer += decode->user_line_begin_skip * w * 4 * nchans;
+
+    for (int y = decode->user_line_begin_skip; y < h; ++y)
+    {
+        for (int c = 0; c < nchans; ++c)
+            in[rev ? nchans - 1 - c : c] =
+                ((const uint32_t*) srcbuffer) + c * w;
+
+        interleave_float_to_half ((uint16_t*) out0, in, nchans, w);
+
+        srcbuffer += w * 4 * nchans;
+        out0 += linc0;
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+unpack_float_to_half_3chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_float_to_half_interleave_impl (decode, 3, 0);
+}
+
+static exr_result_t
+unpack_float_to_half_3chan_interleave_rev (exr_decode_pipeline_t* decode)
+{
+    return unpack_float_to_half_interleave_impl (decode, 3, 1);
+}
+
+static exr_result_t
+unpack_float_to_half_4chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_float_to_half_interleave_impl (decode, 4, 0);
+}
+
+static exr_result_t
+unpack_float_to_half_4chan_interleave_rev (exr_decode_pipeline_t* decode)
+{
+    return unpack_float_to_half_interleave_impl (decode, 4, 1);
+}
+
+/**************************************/
+
+static exr_result_t
+unpack_float_to_half_planar (exr_decode_pipeline_t* decode)
+{
+    /* we know we're unpacking all the channels and there is no subsampling */
+    const uint8_t* srcbuffer = decode->unpacked_buffer;
+    int            w, h;
+
+    w = decode->channels[0].width;
+    h = decode->chunk.height - decode->user_line_end_ignore;
+
+    /*
+     * not actually using y in the loop, so just pre-increment
+     * the srcbuffer for any skip
+     */
+    srcbuffer += decode->user_line_begin_skip * w * 4 * decode->channel_count;
+
+    for (int y = decode->user_line_begin_skip; y < h; ++y)
+    {
+        int64_t yoff = (int64_t) (y - decode->user_line_begin_skip);
+        for (int c = 0; c < decode->channel_count; ++c)
+        {
+            exr_coding_channel_info_t* decc = (decode->channels + c);
+
+            float_to_half_buffer (
+                (uint16_t*) (decc->decode_to_ptr +
+                             yoff * (int64_t) decc->user_line_stride),
+                (const uint32_t*) srcbuffer,
+                w);
+            srcbuffer += w * 4;
+        }
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
 
 static exr_result_t
 unpack_32bit (exr_decode_pipeline_t* decode)
@@ -1709,6 +1900,7 @@ internal_exr_match_decode (
     if (init_cpu_check)
     {
         choose_half_to_float_impl ();
+        choose_float_to_half_impl ();
         init_cpu_check = 0;
     }
 
@@ -1754,6 +1946,30 @@ internal_exr_match_decode (
             }
         }
 
+        if (!hassampling &&
+            chanstofill == decode->channel_count &&
+            sametype == (int) EXR_PIXEL_FLOAT &&
+            sameouttype == (int) EXR_PIXEL_HALF)
+        {
+            if (simpinterleave > 0)
+            {
+                if (decode->channel_count == 4)
+                    return &unpack_float_to_half_4chan_interleave;
+                if (decode->channel_count == 3)
+                    return &unpack_float_to_half_3chan_interleave;
+            }
+
+            if (simpinterleaverev > 0)
+            {
+                if (decode->channel_count == 4)
+                    return &unpack_float_to_half_4chan_interleave_rev;
+                if (decode->channel_count == 3)
+                    return &unpack_float_to_half_3chan_interleave_rev;
+            }
+
+            if (sameoutinc == 2) return &unpack_float_to_half_planar;
+        }
+
         return &generic_unpack;
     }
 
@@ -1796,8 +2012,24 @@ internal_exr_match_decode (
 
     if (samebpc == 4)
     {
-        //if (decode->channel_count == 4) return &unpack_32bit_4chan;
-        //if (decode->channel_count == 3) return &unpack_32bit_3chan;
+        if (simpinterleave > 0)
+        {
+            if (decode->channel_count == 4)
+                return &unpack_32bit_4chan_interleave;
+            if (decode->channel_count == 3)
+                return &unpack_32bit_3chan_interleave;
+        }
+
+        if (simpinterleaverev > 0)
+        {
+            if (decode->channel_count == 4)
+                return &unpack_32bit_4chan_interleave_rev;
+            if (decode->channel_count == 3)
+                return &unpack_32bit_3chan_interleave_rev;
+        }
+
+        /* planar and strided destinations are already a straight
+         * memcpy / copy per channel line in unpack_32bit */
         return &unpack_32bit;
     }
 
@@ -0,0 +1,865 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#include "coding.h"
+
+#include "test_value.h"
+
+#include <openexr.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "internal_coding.h"
+#include "internal_half_buffer.h"
+#include "internal_huf.h"
+
+namespace
+{
+
+// how the user buffers of an image are laid out: a plane per channel,
+// or one buffer with the channels interleaved in file order or in
+// reverse (RGBA in memory for the alphabetical ABGR of the file)
+enum Arrange
+{
+    PLANAR,
+    INTERLEAVED,
+    REVERSED
+};
+
+struct Chan
+{
+    const char*      name;
+    exr_pixel_type_t type;
+    int              xs;
+    int              ys;
+};
+
+// in file (alphabetical) order
+typedef std::vector<Chan>             ChanList;
+typedef std::vector<exr_pixel_type_t> TypeList;
+
+size_t
+typeSize (exr_pixel_type_t t)
+{
+    return t == EXR_PIXEL_HALF ? 2 : 4;
+}
+
+// sample (sx, sy) of channel c as the given type; halves are finite,
+// floats mostly fall between halves so narrowing has to round
+uint32_t
+sourceBits (exr_pixel_type_t t, int c, int sx, int sy)
+{
+    if (t == EXR_PIXEL_HALF)
+        return ((uint32_t) (sx * 37 + sy * 101 + c * 13) & 0x7bffu) |
+               (((uint32_t) (sx + sy) & 1u) << 15);
+    if (t == EXR_PIXEL_FLOAT)
+    {
+        float    f = (float) ((sx * 7 + sy * 13 + c * 29) % 1001 - 500) / 17.f;
+        uint32_t b;
+        memcpy (&b, &f, sizeof (b));
+        return b;
+    }
+    return ((uint32_t) sx * 2654435761u) ^ ((uint32_t) sy * 40503u + c);
+}
+
+uint32_t
+convertBits (uint32_t bits, exr_pixel_type_t from, exr_pixel_type_t to)
+{
+    if (from == to) return bits;
+    if (from == EXR_PIXEL_HALF && to == EXR_PIXEL_FLOAT)
+        return half_to_float_int ((uint16_t) bits);
+    EXRCORE_TEST (from == EXR_PIXEL_FLOAT && to == EXR_PIXEL_HALF);
+    return float_to_half_int (bits);
+}
+
+struct UserImage
+{
+    ChanList             chans;
+    TypeList             types;
+    int                  width  = 0;
+    int                  height = 0;
+    std::vector<uint8_t> storage;
+    std::vector<size_t>  offset;
+    std::vector<int32_t> pixelStride;
+    std::vector<int32_t> lineStride;
+
+    uint8_t* sample (int c, int sx, int sy)
+    {
+        return storage.data () + offset[c] + (size_t) sy * lineStride[c] +
+               (size_t) sx * pixelStride[c];
+    }
+
+    uint32_t get (int c, int sx, int sy)
+    {
+        uint32_t v = 0;
+        memcpy (&v, sample (c, sx, sy), typeSize (types[c]));
+        return v;
+    }
+
+    void set (int c, int sx, int sy, uint32_t v)
+    {
+        memcpy (sample (c, sx, sy), &v, typeSize (types[c]));
+    }
+};
+
+// only planar buffers may hold sampled channels or mixed types
+UserImage
+makeUserImage (
+    const ChanList& chans,
+    const TypeList& types,
+    Arrange         arr,
+    int             width,
+    int             height)
+{
+    UserImage img;
+    size_t    n = chans.size ();
+
+    img.chans  = chans;
+    img.types  = types;
+    img.width  = width;
+    img.height = height;
+    img.offset.resize (n);
+    img.pixelStride.resize (n);
+    img.lineStride.resize (n);
+    if (arr == PLANAR)
+    {
+        size_t total = 0;
+        for (size_t c = 0; c < n; ++c)
+        {
+            size_t ts          = typeSize (types[c]);
+            img.offset[c]      = total;
+            img.pixelStride[c] = (int32_t) ts;
+            img.lineStride[c]  = (int32_t) (ts * (width / chans[c].xs));
+            total += (size_t) img.lineStride[c] * (height / chans[c].ys);
+        }
+        img.storage.assign (total, 0xcd);
+    }
+    else
+    {
+        size_t ts = typeSize (types[0]);
+        for (size_t c = 0; c < n; ++c)
+        {
+            img.offset[c]      = ts * (arr == INTERLEAVED ? c : n - 1 - c);
+            img.pixelStride[c] = (int32_t) (ts * n);
+            img.lineStride[c]  = (int32_t) (ts * n * width);
+        }
+        img.storage.assign (ts * n * width * height, 0xcd);
+    }
+    return img;
+}
+
+void
+fillUserImage (UserImage& img)
+{
+    for (size_t c = 0; c < img.chans.size (); ++c)
+        for (int sy = 0; sy < img.height / img.chans[c].ys; ++sy)
+            for (int sx = 0; sx < img.width / img.chans[c].xs; ++sx)
+                img.set (
+                    (int) c, sx, sy, sourceBits (img.types[c], (int) c, sx, sy));
+}
+
+// what a sample of a file written from sources of srcTypes reads back
+// as when decoded to dst's types
+void
+checkUserImage (UserImage& dst, const TypeList& srcTypes)
+{
+    for (size_t c = 0; c < dst.chans.size (); ++c)
+    {
+        exr_pixel_type_t ft = dst.chans[c].type;
+        for (int sy = 0; sy < dst.height / dst.chans[c].ys; ++sy)
+        {
+            for (int sx = 0; sx < dst.width / dst.chans[c].xs; ++sx)
+            {
+                uint32_t fbits = convertBits (
+                    sourceBits (srcTypes[c], (int) c, sx, sy), srcTypes[c], ft);
+                EXRCORE_TEST (
+                    dst.get ((int) c, sx, sy) ==
+                    convertBits (fbits, ft, dst.types[c]));
+            }
+        }
+    }
+}
+
+// points the coding channels of the chunk starting at line y at img
+template <typename Channels>
+void
+setUserChannels (Channels* chans, UserImage& img, int y, bool decode)
+{
+    for (size_t c = 0; c < img.chans.size (); ++c)
+    {
+        int      ys  = img.chans[c].ys;
+        uint8_t* ptr = nullptr;
+
+        if (chans[c].height > 0) ptr = img.sample ((int) c, 0, (y + ys - 1) / ys);
+        if (decode)
+            chans[c].decode_to_ptr = ptr;
+        else
+            chans[c].encode_from_ptr = ptr;
+        chans[c].user_pixel_stride      = img.pixelStride[c];
+        chans[c].user_line_stride       = img.lineStride[c];
+        chans[c].user_bytes_per_element = (int16_t) typeSize (img.types[c]);
+        chans[c].user_data_type         = (uint16_t) img.types[c];
+    }
+}
+
+void
+writeUserImage (
+    const std::string& fn, exr_compression_t comp, UserImage& src)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit   = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    exr_encode_pipeline_t     encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+    int                       partidx, lpc;
+
+    EXRCORE_TEST_RVAL (
+        exr_start_write (&f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (
+        exr_add_part (f, "layout", EXR_STORAGE_SCANLINE, &partidx));
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        f, partidx, src.width, src.height, comp));
+    for (const Chan& ch: src.chans)
+        EXRCORE_TEST_RVAL (exr_add_channel (
+            f,
+            partidx,
+            ch.name,
+            ch.type,
+            EXR_PERCEPTUALLY_LOGARITHMIC,
+            ch.xs,
+            ch.ys));
+    EXRCORE_TEST_RVAL (exr_write_header (f));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, partidx, &lpc));
+
+    for (int y = 0; y < src.height; y += lpc)
+    {
+        exr_chunk_info_t cinfo;
+
+        EXRCORE_TEST_RVAL (exr_write_scanline_chunk_info (f, partidx, y, &cinfo));
+        if (y == 0)
+            EXRCORE_TEST_RVAL (
+                exr_encoding_initialize (f, partidx, &cinfo, &encoder));
+        else
+            EXRCORE_TEST_RVAL (
+                exr_encoding_update (f, partidx, &cinfo, &encoder));
+        EXRCORE_TEST (encoder.channel_count == (int) src.chans.size ());
+        setUserChannels (encoder.channels, src, y, false);
+        if (y == 0)
+            EXRCORE_TEST_RVAL (
+                exr_encoding_choose_default_routines (f, partidx, &encoder));
+        EXRCORE_TEST_RVAL (exr_encoding_run (f, partidx, &encoder));
+    }
+    EXRCORE_TEST_RVAL (exr_encoding_destroy (f, &encoder));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+void
+readUserImage (const std::string& fn, UserImage& dst)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit   = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    exr_decode_pipeline_t     decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+    int                       lpc;
+
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &lpc));
+    for (int y = 0; y < dst.height; y += lpc)
+    {
+        exr_chunk_info_t cinfo;
+
+        EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+        if (y == 0)
+            EXRCORE_TEST_RVAL (exr_decoding_initialize (f, 0, &cinfo, &decoder));
+        else
+            EXRCORE_TEST_RVAL (exr_decoding_update (f, 0, &cinfo, &decoder));
+        EXRCORE_TEST (decoder.channel_count == (int) dst.chans.size ());
+        setUserChannels (decoder.channels, dst, y, true);
+        if (y == 0)
+            EXRCORE_TEST_RVAL (
+                exr_decoding_choose_default_routines (f, 0, &decoder));
+        EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoder));
+    }
+    EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoder));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+ChanList
+uniformChans (int nch, exr_pixel_type_t t)
+{
+    static const char* names[4] = {"A", "B", "G", "R"};
+    ChanList           chans;
+    for (int c = 4 - nch; c < 4; ++c)
+        chans.push_back ({names[c], t, 1, 1});
+    return chans;
+}
+
+TypeList
+fileTypes (const ChanList& chans)
+{
+    TypeList types;
+    for (const Chan& ch: chans)
+        types.push_back (ch.type);
+    return types;
+}
+
+// reads fn back into every arrangement, as the file types and as
+// outTypes (where given), checking against a file written from srcTypes
+void
+checkAllLayouts (
+    const std::string& fn,
+    const ChanList&    chans,
+    const TypeList&    srcTypes,
+    const TypeList&    outTypes,
+    int                width,
+    int                height)
+{
+    static const Arrange arrs[] = {PLANAR, INTERLEAVED, REVERSED};
+
+    for (Arrange arr: arrs)
+    {
+        UserImage dst =
+            makeUserImage (chans, fileTypes (chans), arr, width, height);
+        readUserImage (fn, dst);
+        checkUserImage (dst, srcTypes);
+
+        if (outTypes.empty ()) continue;
+        dst = makeUserImage (chans, outTypes, arr, width, height);
+        readUserImage (fn, dst);
+        checkUserImage (dst, srcTypes);
+    }
+}
+
+// the packed (uncompressed) chunks of fn must hold the samples of
+// src, converted to the file types, line by line in file order
+void
+checkPackedFile (const std::string& fn, const UserImage& src)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    std::vector<uint8_t>      packed, expected;
+
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    for (int y = 0; y < src.height; ++y)
+    {
+        exr_chunk_info_t cinfo;
+
+        expected.clear ();
+        for (size_t c = 0; c < src.chans.size (); ++c)
+        {
+            const Chan& ch = src.chans[c];
+            if (y % ch.ys != 0) continue;
+            for (int sx = 0; sx < src.width / ch.xs; ++sx)
+            {
+                uint32_t v = convertBits (
+                    sourceBits (src.types[c], (int) c, sx, y / ch.ys),
+                    src.types[c],
+                    ch.type);
+                uint8_t b[4];
+                memcpy (b, &v, sizeof (v));
+                expected.insert (expected.end (), b, b + typeSize (ch.type));
+            }
+        }
+
+        EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+        EXRCORE_TEST (cinfo.packed_size == expected.size ());
+        packed.assign (cinfo.packed_size, 0);
+        EXRCORE_TEST_RVAL (exr_read_chunk (f, 0, &cinfo, packed.data ()));
+        EXRCORE_TEST (packed == expected);
+    }
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+// the scalar lifting steps of the C++ library's ImfWav.cpp, which
+// define the PIZ format
+void
+refWenc14 (uint16_t a, uint16_t b, uint16_t& l, uint16_t& h)
+{
+    int16_t as = (int16_t) a;
+    int16_t bs = (int16_t) b;
+
+    l = (uint16_t) ((as + bs) >> 1);
+    h = (uint16_t) (as - bs);
+}
+
+void
+refWenc16 (uint16_t a, uint16_t b, uint16_t& l, uint16_t& h)
+{
+    int ao = (a + 0x8000) & 0xffff;
+    int m  = (ao + b) >> 1;
+    int d  = ao - b;
+
+    if (d < 0) m = (m + 0x8000) & 0xffff;
+
+    l = (uint16_t) m;
+    h = (uint16_t) (d & 0xffff);
+}
+
+void
+refWenc (bool w14, uint16_t a, uint16_t b, uint16_t& l, uint16_t& h)
+{
+    if (w14)
+        refWenc14 (a, b, l, h);
+    else
+        refWenc16 (a, b, l, h);
+}
+
+void
+refWav2DEncode (uint16_t* in, int nx, int ox, int ny, int oy, uint16_t mx)
+{
+    bool w14 = (mx < (1 << 14));
+    int  n   = (nx > ny) ? ny : nx;
+    int  p   = 1;
+    int  p2  = 2;
+
+    while (p2 <= n)
+    {
+        uint16_t* py  = in;
+        uint16_t* ey  = in + oy * (ny - p2);
+        int       oy1 = oy * p;
+        int       oy2 = oy * p2;
+        int       ox1 = ox * p;
+        int       ox2 = ox * p2;
+        uint16_t  i00, i01, i10, i11;
+
+        for (; py <= ey; py += oy2)
+        {
+            uint16_t* px = py;
+            uint16_t* ex = py + ox * (nx - p2);
+
+            for (; px <= ex; px += ox2)
+            {
+                uint16_t* p01 = px + ox1;
+                uint16_t* p10 = px + oy1;
+                uint16_t* p11 = p10 + ox1;
+
+                refWenc (w14, *px, *p01, i00, i01);
+                refWenc (w14, *p10, *p11, i10, i11);
+                refWenc (w14, i00, i10, *px, *p10);
+                refWenc (w14, i01, i11, *p01, *p11);
+            }
+
+            if (nx & p)
+            {
+                uint16_t* p10 = px + oy1;
+
+                refWenc (w14, *px, *p10, i00, *p10);
+                *px = i00;
+            }
+        }
+
+        if (ny & p)
+        {
+            uint16_t* px = py;
+            uint16_t* ex = py + ox * (nx - p2);
+
+            for (; px <= ex; px += ox2)
+            {
+                uint16_t* p01 = px + ox1;
+
+                refWenc (w14, *px, *p01, i00, *p01);
+                *px = i00;
+            }
+        }
+
+        p = p2;
+        p2 <<= 1;
+    }
+}
+
+// the PIZ chunk the scalar transform makes of lines [y, y + h) of
+// src, with the single Huffman stream written by default; empty when
+// it would not be smaller than the packed data, which is then stored
+std::vector<uint8_t>
+refPizChunk (const UserImage& src, int y, int h, uint16_t& maxValue)
+{
+    std::vector<uint16_t> words;
+    std::vector<uint8_t>  bitmap (8192, 0);
+    std::vector<uint16_t> lut (65536, 0);
+    std::vector<uint8_t>  out;
+    uint16_t              minNonZero = 8191, maxNonZero = 0, k = 0;
+
+    // a plane per channel, each value split in 16-bit words
+    for (size_t c = 0; c < src.chans.size (); ++c)
+    {
+        const Chan& ch = src.chans[c];
+        for (int yy = y; yy < y + h; ++yy)
+        {
+            if (yy % ch.ys != 0) continue;
+            for (int sx = 0; sx < src.width / ch.xs; ++sx)
+            {
+                uint32_t v = convertBits (
+                    sourceBits (src.types[c], (int) c, sx, yy / ch.ys),
+                    src.types[c],
+                    ch.type);
+                words.push_back ((uint16_t) v);
+                if (ch.type != EXR_PIXEL_HALF)
+                    words.push_back ((uint16_t) (v >> 16));
+            }
+        }
+    }
+
+    for (uint16_t v: words)
+        bitmap[v >> 3] |= (uint8_t) (1 << (v & 7));
+    bitmap[0] &= ~1;
+    for (int i = 0; i < 8192; ++i)
+    {
+        if (!bitmap[i]) continue;
+        if (minNonZero > i) minNonZero = (uint16_t) i;
+        if (maxNonZero < i) maxNonZero = (uint16_t) i;
+    }
+    for (int i = 0; i < 65536; ++i)
+        if (i == 0 || (bitmap[i >> 3] & (1 << (i & 7)))) lut[i] = k++;
+    maxValue = (uint16_t) (k - 1);
+    for (uint16_t& v: words)
+        v = lut[v];
+
+    size_t off = 0;
+    for (size_t c = 0; c < src.chans.size (); ++c)
+    {
+        const Chan& ch     = src.chans[c];
+        int         nx     = src.width / ch.xs;
+        int         ny     = 0;
+        int         wcount = (int) typeSize (ch.type) / 2;
+
+        for (int yy = y; yy < y + h; ++yy)
+            if (yy % ch.ys == 0) ++ny;
+        for (int j = 0; j < wcount; ++j)
+            refWav2DEncode (
+                words.data () + off + j, nx, wcount, ny, wcount * nx, maxValue);
+        off += (size_t) nx * ny * wcount;
+    }
+
+    uint64_t             packedSize = words.size () * 2;
+    uint64_t             nBytes     = 0;
+    std::vector<uint8_t> huf (packedSize * 2 + 65536);
+    std::vector<uint8_t> spare (internal_exr_huf_compress_spare_bytes ());
+
+    EXRCORE_TEST_RVAL (internal_huf_compress (
+        &nBytes,
+        huf.data (),
+        huf.size (),
+        words.data (),
+        words.size (),
+        1,
+        spare.data (),
+        spare.size ()));
+
+    out.push_back ((uint8_t) minNonZero);
+    out.push_back ((uint8_t) (minNonZero >> 8));
+    out.push_back ((uint8_t) maxNonZero);
+    out.push_back ((uint8_t) (maxNonZero >> 8));
+    if (minNonZero <= maxNonZero)
+        out.insert (
+            out.end (),
+            bitmap.begin () + minNonZero,
+            bitmap.begin () + maxNonZero + 1);
+    for (int i = 0; i < 4; ++i)
+        out.push_back ((uint8_t) (nBytes >> (8 * i)));
+    out.insert (out.end (), huf.begin (), huf.begin () + nBytes);
+    if (out.size () >= packedSize) out.clear ();
+    return out;
+}
+
+// every chunk of the PIZ file fn must match the scalar reference for
+// src; counts the compressed chunks taking the 14- and 16-bit paths
+void
+checkPizFile (const std::string& fn, const UserImage& src, int* paths)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    std::vector<uint8_t>      chunk;
+    int                       lpc;
+
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &lpc));
+    for (int y = 0; y < src.height; y += lpc)
+    {
+        exr_chunk_info_t     cinfo;
+        uint16_t             maxValue;
+        std::vector<uint8_t> ref;
+
+        EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+        ref = refPizChunk (src, y, cinfo.height, maxValue);
+        chunk.assign (cinfo.packed_size, 0);
+        EXRCORE_TEST_RVAL (exr_read_chunk (f, 0, &cinfo, chunk.data ()));
+        if (ref.empty ())
+        {
+            EXRCORE_TEST (cinfo.packed_size == cinfo.unpacked_size);
+        }
+        else
+        {
+            EXRCORE_TEST (chunk == ref);
+            ++paths[maxValue < (1 << 14) ? 0 : 1];
+        }
+    }
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+} // namespace
+
+void
+testUnpackLayouts (const std::string& tempdir)
+{
+    static const exr_pixel_type_t types[] = {
+        EXR_PIXEL_HALF, EXR_PIXEL_FLOAT, EXR_PIXEL_UINT};
+    // odd widths leave a tail after the vector loops
+    static const int widths[] = {37, 64, 5};
+
+    std::string fn = tempdir + "unpack_layouts.exr";
+
+    for (int nch = 3; nch <= 4; ++nch)
+    {
+        for (exr_pixel_type_t t: types)
+        {
+            for (int width: widths)
+            {
+                ChanList  chans = uniformChans (nch, t);
+                TypeList  ftypes = fileTypes (chans);
+                TypeList  otypes;
+                UserImage src =
+                    makeUserImage (chans, ftypes, PLANAR, width, 6);
+
+                fillUserImage (src);
+                writeUserImage (fn, EXR_COMPRESSION_NONE, src);
+                if (t == EXR_PIXEL_HALF)
+                    otypes.assign (nch, EXR_PIXEL_FLOAT);
+                else if (t == EXR_PIXEL_FLOAT)
+                    otypes.assign (nch, EXR_PIXEL_HALF);
+                checkAllLayouts (fn, chans, ftypes, otypes, width, 6);
+            }
+        }
+    }
+
+    // mixed types and sampled channels go through the generic unpacker
+    {
+        ChanList chans = {
+            {"A", EXR_PIXEL_HALF, 1, 1},
+            {"B", EXR_PIXEL_FLOAT, 1, 1},
+            {"C", EXR_PIXEL_UINT, 1, 1},
+            {"D", EXR_PIXEL_HALF, 2, 2}};
+        TypeList  ftypes = fileTypes (chans);
+        UserImage src    = makeUserImage (chans, ftypes, PLANAR, 38, 8);
+        UserImage dst;
+
+        fillUserImage (src);
+        writeUserImage (fn, EXR_COMPRESSION_ZIPS, src);
+
+        dst = makeUserImage (chans, ftypes, PLANAR, 38, 8);
+        readUserImage (fn, dst);
+        checkUserImage (dst, ftypes);
+
+        dst = makeUserImage (
+            chans,
+            {EXR_PIXEL_FLOAT, EXR_PIXEL_HALF, EXR_PIXEL_UINT, EXR_PIXEL_FLOAT},
+            PLANAR,
+            38,
+            8);
+        readUserImage (fn, dst);
+        checkUserImage (dst, ftypes);
+    }
+
+    remove (fn.c_str ());
+}
+
+void
+testPackLayouts (const std::string& tempdir)
+{
+    static const exr_pixel_type_t types[] = {
+        EXR_PIXEL_HALF, EXR_PIXEL_FLOAT, EXR_PIXEL_UINT};
+    static const Arrange arrs[]   = {PLANAR, INTERLEAVED, REVERSED};
+    static const int     widths[] = {37, 64, 5};
+
+    std::string fn = tempdir + "pack_layouts.exr";
+
+    for (int nch = 3; nch <= 4; ++nch)
+    {
+        for (exr_pixel_type_t t: types)
+        {
+            for (int width: widths)
+            {
+                ChanList chans  = uniformChans (nch, t);
+                TypeList ftypes = fileTypes (chans);
+
+                for (Arrange arr: arrs)
+                {
+                    // as the file type, and narrowing FLOAT into HALF
+                    for (int narrow = 0; narrow < 2; ++narrow)
+                    {
+                        TypeList stypes = ftypes;
+                        if (narrow && t != EXR_PIXEL_HALF) continue;
+                        if (narrow) stypes.assign (nch, EXR_PIXEL_FLOAT);
+
+                        UserImage src =
+                            makeUserImage (chans, stypes, arr, width, 6);
+                        UserImage dst =
+                            makeUserImage (chans, ftypes, PLANAR, width, 6);
+
+                        fillUserImage (src);
+                        writeUserImage (fn, EXR_COMPRESSION_NONE, src);
+                        checkPackedFile (fn, src);
+                        readUserImage (fn, dst);
+                        checkUserImage (dst, stypes);
+                    }
+                }
+
+                // widening planar HALF into FLOAT
+                if (t == EXR_PIXEL_FLOAT)
+                {
+                    TypeList  stypes (nch, EXR_PIXEL_HALF);
+                    UserImage src =
+                        makeUserImage (chans, stypes, PLANAR, width, 6);
+
+                    fillUserImage (src);
+                    writeUserImage (fn, EXR_COMPRESSION_NONE, src);
+                    checkPackedFile (fn, src);
+                }
+            }
+        }
+    }
+
+    // mixed types and sampled channels go through the generic packer
+    {
+        ChanList chans = {
+            {"A", EXR_PIXEL_HALF, 1, 1},
+            {"B", EXR_PIXEL_FLOAT, 1, 1},
+            {"C", EXR_PIXEL_UINT, 1, 1},
+            {"D", EXR_PIXEL_HALF, 2, 2}};
+        TypeList  stypes = {
+            EXR_PIXEL_FLOAT, EXR_PIXEL_HALF, EXR_PIXEL_UINT, EXR_PIXEL_HALF};
+        UserImage src = makeUserImage (chans, stypes, PLANAR, 38, 8);
+
+        fillUserImage (src);
+        writeUserImage (fn, EXR_COMPRESSION_NONE, src);
+        checkPackedFile (fn, src);
+    }
+
+    remove (fn.c_str ());
+}
+
+void
+testHalfFloatBuffers (const std::string&)
+{
+    std::vector<uint16_t> halves (65536), hout;
+    std::vector<float>    fout (65536 + 8);
+    std::vector<uint32_t> floats;
+
+    choose_half_to_float_impl ();
+    choose_float_to_half_impl ();
+
+    // every half, then every short length and alignment for the tails
+    for (int i = 0; i < 65536; ++i)
+        halves[i] = (uint16_t) i;
+    half_to_float_buffer (fout.data (), halves.data (), 65536);
+    for (int i = 0; i < 65536; ++i)
+    {
+        float ref = half_to_float (halves[i]);
+        if (std::isnan (ref)) { EXRCORE_TEST (std::isnan (fout[i])); }
+        else { EXRCORE_TEST (memcmp (&ref, &fout[i], sizeof (ref)) == 0); }
+    }
+    for (int start = 0; start < 4; ++start)
+    {
+        for (int w = 0; w < 20; ++w)
+        {
+            const uint16_t* in = halves.data () + 15360 + start * 97;
+            fout.assign (w + 1, -1.f);
+            half_to_float_buffer (fout.data (), in, w);
+            for (int x = 0; x < w; ++x)
+                EXRCORE_TEST (fout[x] == half_to_float (in[x]));
+            EXRCORE_TEST (fout[w] == -1.f);
+        }
+    }
+
+    // floats across the whole range, plus the ties halfway between
+    // neighbouring halves, which must round to even
+    for (uint64_t b = 0; b < 0x100000000ull; b += 4099)
+        floats.push_back ((uint32_t) b);
+    for (int i = 0; i < 0x7bff; ++i)
+    {
+        float    lo  = half_to_float ((uint16_t) i);
+        float    hi  = half_to_float ((uint16_t) (i + 1));
+        float    mid = lo + (hi - lo) * 0.5f;
+        uint32_t bits;
+        memcpy (&bits, &mid, sizeof (bits));
+        floats.push_back (bits);
+        floats.push_back (bits | 0x80000000u);
+    }
+    hout.assign (floats.size (), 0);
+    float_to_half_buffer (hout.data (), floats.data (), (int) floats.size ());
+    for (size_t i = 0; i < floats.size (); ++i)
+    {
+        float f;
+        memcpy (&f, &floats[i], sizeof (f));
+        if (std::isnan (f))
+        {
+            EXRCORE_TEST ((hout[i] & 0x7c00) == 0x7c00 && (hout[i] & 0x3ff));
+        }
+        else { EXRCORE_TEST (hout[i] == float_to_half_int (floats[i])); }
+    }
+    for (int start = 0; start < 4; ++start)
+    {
+        for (int w = 0; w < 20; ++w)
+        {
+            const uint32_t* in = floats.data () + 1000 + start * 31;
+            hout.assign (w + 1, 0xdead);
+            float_to_half_buffer (hout.data (), in, w);
+            for (int x = 0; x < w; ++x)
+                EXRCORE_TEST (hout[x] == float_to_half_int (in[x]));
+            EXRCORE_TEST (hout[w] == 0xdead);
+        }
+    }
+}
+
+void
+testPizRoundTrip (const std::string& tempdir)
+{
+    static const exr_pixel_type_t types[] = {
+        EXR_PIXEL_HALF, EXR_PIXEL_FLOAT, EXR_PIXEL_UINT};
+    // odd sizes leave odd rows and columns at every level, and the
+    // last chunk of 45 lines is 13 high
+    static const int widths[] = {37, 613, 5, 1};
+
+    std::string fn       = tempdir + "piz_round_trip.exr";
+    int         paths[2] = {0, 0};
+
+    for (exr_pixel_type_t t: types)
+    {
+        for (int width: widths)
+        {
+            ChanList  chans  = uniformChans (3, t);
+            TypeList  ftypes = fileTypes (chans);
+            UserImage src =
+                makeUserImage (chans, ftypes, PLANAR, width, 45);
+
+            fillUserImage (src);
+            writeUserImage (fn, EXR_COMPRESSION_PIZ, src);
+            checkPizFile (fn, src, paths);
+            checkAllLayouts (fn, chans, ftypes, TypeList (), width, 45);
+        }
+    }
+
+    // mixed types, with a sampled channel 37 wide and 3 high in the
+    // last chunk
+    {
+        ChanList chans = {
+            {"A", EXR_PIXEL_HALF, 1, 1},
+            {"B", EXR_PIXEL_FLOAT, 1, 1},
+            {"C", EXR_PIXEL_UINT, 1, 1},
+            {"D", EXR_PIXEL_HALF, 2, 2}};
+        TypeList  ftypes = fileTypes (chans);
+        UserImage src    = makeUserImage (chans, ftypes, PLANAR, 74, 70);
+        UserImage dst    = makeUserImage (chans, ftypes, PLANAR, 74, 70);
+
+        fillUserImage (src);
+        writeUserImage (fn, EXR_COMPRESSION_PIZ, src);
+        checkPizFile (fn, src, paths);
+        readUserImage (fn, dst);
+        checkUserImage (dst, ftypes);
+    }
+
+    EXRCORE_TEST (paths[0] > 0 && paths[1] > 0);
+
+    remove (fn.c_str ());
+}
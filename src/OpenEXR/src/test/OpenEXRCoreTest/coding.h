@@ -0,0 +1,16 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_CORE_TEST_CODING_H
+#define OPENEXR_CORE_TEST_CODING_H
+
+#include <string>
+
+void testUnpackLayouts (const std::string& tempdir);
+void testPackLayouts (const std::string& tempdir);
+void testHalfFloatBuffers (const std::string& tempdir);
+void testPizRoundTrip (const std::string& tempdir);
+
+#endif // OPENEXR_CORE_TEST_CODING_H
@@ -0,0 +1,125 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#include "compression.h"
+
+#include "test_value.h"
+
+#include <openexr.h>
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const int NUM_CHUNKS = 24;
+
+std::vector<uint8_t>
+makeChunk (int idx)
+{
+    // sizes straddle the small / large block paths of the deflater
+    std::vector<uint8_t> raw (257 + (size_t) idx * 3331);
+    uint32_t             state = 17u + (uint32_t) idx;
+
+    for (size_t i = 0; i < raw.size (); ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        // a mix of runs and noise so every chunk compresses differently
+        raw[i] = (idx & 1) ? (uint8_t) ((i / (idx + 3)) & 0xff)
+                           : (uint8_t) ((state >> 24) & (0x0f << (idx % 4)));
+    }
+    return raw;
+}
+
+std::vector<uint8_t>
+compress (exr_const_context_t ctxt, int level, const std::vector<uint8_t>& raw)
+{
+    std::vector<uint8_t> out (exr_compress_max_buffer_size (raw.size ()));
+    size_t               outSize = 0;
+
+    EXRCORE_TEST_RVAL (exr_compress_buffer (
+        ctxt, level, raw.data (), raw.size (), out.data (), out.size (),
+        &outSize));
+    out.resize (outSize);
+    return out;
+}
+
+void
+checkUncompress (
+    exr_const_context_t         ctxt,
+    const std::vector<uint8_t>& packed,
+    const std::vector<uint8_t>& raw)
+{
+    std::vector<uint8_t> out (raw.size ());
+    size_t               outSize = 0;
+
+    EXRCORE_TEST_RVAL (exr_uncompress_buffer (
+        ctxt, packed.data (), packed.size (), out.data (), out.size (),
+        &outSize));
+    EXRCORE_TEST (outSize == raw.size ());
+    EXRCORE_TEST (out == raw);
+}
+
+} // namespace
+
+void
+testDeflateStateCache (const std::string&)
+{
+    static const int levels[] = {-1, 1, 4, 9};
+
+    std::vector<std::vector<uint8_t>> raw;
+    std::vector<std::vector<uint8_t>> ref[4];
+    exr_context_t                     ctxt = nullptr;
+
+    for (int c = 0; c < NUM_CHUNKS; ++c)
+        raw.push_back (makeChunk (c));
+
+    // what each chunk compresses to without a context to cache in
+    for (int l = 0; l < 4; ++l)
+        for (int c = 0; c < NUM_CHUNKS; ++c)
+            ref[l].push_back (compress (nullptr, levels[l], raw[c]));
+
+    EXRCORE_TEST_RVAL (
+        exr_start_temporary_context (&ctxt, "deflate cache", nullptr));
+
+    // interleave the levels so every chunk reuses a state another
+    // chunk left behind, with both compressors and decompressors cached
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int c = 0; c < NUM_CHUNKS; ++c)
+        {
+            for (int l = 0; l < 4; ++l)
+            {
+                int ll = (l + c + pass) % 4;
+                EXRCORE_TEST (compress (ctxt, levels[ll], raw[c]) == ref[ll][c]);
+                checkUncompress (ctxt, ref[ll][c], raw[c]);
+            }
+        }
+    }
+
+    // several threads sharing the cache still get identical output
+    std::vector<std::thread> workers;
+    std::vector<int>         good (4, 0);
+    for (int t = 0; t < 4; ++t)
+    {
+        workers.emplace_back ([&, t] () {
+            for (int c = 0; c < NUM_CHUNKS; ++c)
+            {
+                int l = (c + t) % 4;
+                if (compress (ctxt, levels[l], raw[c]) == ref[l][c])
+                    ++good[t];
+            }
+        });
+    }
+    for (auto& w: workers)
+        w.join ();
+    for (int t = 0; t < 4; ++t)
+        EXRCORE_TEST (good[t] == NUM_CHUNKS);
+
+    EXRCORE_TEST_RVAL (exr_finish (&ctxt));
+}
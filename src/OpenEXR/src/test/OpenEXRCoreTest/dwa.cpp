@@ -0,0 +1,229 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#include "dwa.h"
+
+#include "test_value.h"
+
+#include <openexr.h>
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// GCC 12 warns about _mm512_undefined_ps inside its own headers
+#if defined(__GNUC__) && !defined(__clang__)
+#    pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+#include "internal_coding.h"
+#include "internal_cpuid.h"
+
+// the DWA kernels are only meant to be seen from internal_dwa.c
+#define IMF_INTERNAL_DWA_HELPERS_H_HAS_BEEN_INCLUDED
+#include "internal_dwa_simd.h"
+
+namespace
+{
+
+const int NUM_BLOCKS = 20000;
+
+uint32_t
+nextRandom (uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+// any finite half, which covers the whole range a DWA block sees
+uint16_t
+randomHalf (uint32_t& state)
+{
+    uint16_t h;
+    do
+    {
+        h = (uint16_t) nextRandom (state);
+    } while ((h & 0x7c00) == 0x7c00);
+    return h;
+}
+
+// pixel-like values, in a range where the transforms keep precision
+float
+randomPixelValue (uint32_t& state)
+{
+    return ((float) (nextRandom (state) % 200001) - 100000.f) / 1000.f;
+}
+
+void
+randomBlock (float* dst, uint32_t& state, int blk)
+{
+    for (int i = 0; i < 64; ++i)
+        dst[i] = (blk & 1) ? half_to_float (randomHalf (state))
+                           : randomPixelValue (state);
+}
+
+bool
+sameBits (const void* a, const void* b, size_t n)
+{
+    return memcmp (a, b, n) == 0;
+}
+
+#ifdef IMF_HAVE_AVX2_INTRINSICS
+
+void
+compareAvx2 ()
+{
+    typedef void (*dct_fn) (float*);
+
+    static const dct_fn inverseRef[8] = {
+        dctInverse8x8_sse2_0,
+        dctInverse8x8_sse2_1,
+        dctInverse8x8_sse2_2,
+        dctInverse8x8_sse2_3,
+        dctInverse8x8_sse2_4,
+        dctInverse8x8_sse2_5,
+        dctInverse8x8_sse2_6,
+        dctInverse8x8_sse2_7};
+    static const dct_fn inverseAvx2[8] = {
+        dctInverse8x8_avx2_0,
+        dctInverse8x8_avx2_1,
+        dctInverse8x8_avx2_2,
+        dctInverse8x8_avx2_3,
+        dctInverse8x8_avx2_4,
+        dctInverse8x8_avx2_5,
+        dctInverse8x8_avx2_6,
+        dctInverse8x8_avx2_7};
+
+    alignas (_SSE_ALIGNMENT) float ref[3][64];
+    alignas (_SSE_ALIGNMENT) float tst[3][64];
+    alignas (_SSE_ALIGNMENT) float tol[64];
+    uint16_t                       href[64], htst[64];
+    uint32_t                       state = 42;
+
+    for (int blk = 0; blk < NUM_BLOCKS; ++blk)
+    {
+        int zeroedRows = blk % 8;
+
+        randomBlock (ref[0], state, blk);
+        memcpy (tst[0], ref[0], sizeof (ref[0]));
+        dctForward8x8_sse2 (ref[0]);
+        dctForward8x8_avx2 (tst[0]);
+        EXRCORE_TEST (sameBits (ref[0], tst[0], sizeof (ref[0])));
+
+        // the decoder only passes zeroed rows that are actually zero
+        randomBlock (ref[0], state, blk);
+        for (int i = 64 - 8 * zeroedRows; i < 64; ++i)
+            ref[0][i] = 0.f;
+        memcpy (tst[0], ref[0], sizeof (ref[0]));
+        inverseRef[zeroedRows](ref[0]);
+        inverseAvx2[zeroedRows](tst[0]);
+        EXRCORE_TEST (sameBits (ref[0], tst[0], sizeof (ref[0])));
+
+        for (int c = 0; c < 3; ++c)
+            randomBlock (ref[c], state, blk);
+        memcpy (tst, ref, sizeof (ref));
+        csc709Inverse64_sse2 (ref[0], ref[1], ref[2]);
+        csc709Inverse64_avx2 (tst[0], tst[1], tst[2]);
+        EXRCORE_TEST (sameBits (ref, tst, sizeof (ref)));
+
+        for (int c = 0; c < 3; ++c)
+            randomBlock (ref[c], state, blk);
+        memcpy (tst, ref, sizeof (ref));
+        csc709Forward64_scalar (ref[0], ref[1], ref[2]);
+        csc709Forward64_avx2 (tst[0], tst[1], tst[2]);
+        EXRCORE_TEST (sameBits (ref, tst, sizeof (ref)));
+
+        randomBlock (ref[0], state, blk);
+        for (int i = 0; i < 64; ++i)
+            tol[i] = fabsf (randomPixelValue (state)) * 0.01f;
+        convertFloatToHalf64_scalar (href, ref[0]);
+        convertFloatToHalf64_avx2 (htst, ref[0]);
+        EXRCORE_TEST (sameBits (href, htst, sizeof (href)));
+
+        EXRCORE_TEST (
+            convertFloatToHalfTol64_scalar (href, ref[0], tol) ==
+            convertFloatToHalfTol64_avx2 (htst, ref[0], tol));
+        EXRCORE_TEST (sameBits (href, htst, sizeof (href)));
+
+        convertHalfToFloat64_scalar (ref[1], href);
+        convertHalfToFloat64_avx2 (tst[1], href);
+        EXRCORE_TEST (sameBits (ref[1], tst[1], sizeof (ref[1])));
+    }
+}
+
+#endif /* IMF_HAVE_AVX2_INTRINSICS */
+
+#ifdef IMF_HAVE_AVX512_INTRINSICS
+
+void
+compareAvx512 ()
+{
+    alignas (_SSE_ALIGNMENT) float ref[64];
+    alignas (_SSE_ALIGNMENT) float tst[64];
+    alignas (_SSE_ALIGNMENT) float tol[64];
+    uint16_t                       href[64], htst[64], src[64];
+    uint32_t                       state = 7;
+
+    for (int blk = 0; blk < NUM_BLOCKS; ++blk)
+    {
+        // NaN payloads are left out, F16C quiets signaling ones
+        for (int i = 0; i < 64; ++i)
+            src[i] = randomHalf (state);
+        memcpy (htst, src, sizeof (src));
+        fromHalfZigZag_scalar (src, ref);
+        fromHalfZigZag_avx512 (htst, tst);
+        EXRCORE_TEST (sameBits (ref, tst, sizeof (ref)));
+
+        toHalfZigZag_scalar (src, href);
+        toHalfZigZag_avx512 (src, htst);
+        EXRCORE_TEST (sameBits (href, htst, sizeof (href)));
+
+        randomBlock (ref, state, blk);
+        for (int i = 0; i < 64; ++i)
+            tol[i] = fabsf (randomPixelValue (state)) * 0.01f;
+        convertFloatToHalf64_scalar (href, ref);
+        convertFloatToHalf64_avx512 (htst, ref);
+        EXRCORE_TEST (sameBits (href, htst, sizeof (href)));
+
+        EXRCORE_TEST (
+            convertFloatToHalfTol64_scalar (href, ref, tol) ==
+            convertFloatToHalfTol64_avx512 (htst, ref, tol));
+        EXRCORE_TEST (sameBits (href, htst, sizeof (href)));
+
+        convertHalfToFloat64_scalar (ref, href);
+        convertHalfToFloat64_avx512 (tst, href);
+        EXRCORE_TEST (sameBits (ref, tst, sizeof (ref)));
+    }
+}
+
+#endif /* IMF_HAVE_AVX512_INTRINSICS */
+
+} // namespace
+
+void
+testDWASimdPaths (const std::string&)
+{
+    int avx2 = 0, avx512 = 0, f16c = 0, avx = 0, sse2 = 0;
+
+    check_for_x86_simd (&f16c, &avx, &sse2);
+    check_for_x86_avx2_avx512 (&avx2, &avx512);
+
+    // only here to keep the compiler quiet about it being unused
+    initializeFuncs ();
+
+#ifdef IMF_HAVE_AVX2_INTRINSICS
+    if (avx2 && f16c)
+        compareAvx2 ();
+    else
+        std::cout << "   no AVX2, skipping its kernels" << std::endl;
+#endif
+
+#ifdef IMF_HAVE_AVX512_INTRINSICS
+    if (avx512 && f16c)
+        compareAvx512 ();
+    else
+        std::cout << "   no AVX-512, skipping its kernels" << std::endl;
+#endif
+}
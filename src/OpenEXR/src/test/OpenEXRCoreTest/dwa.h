@@ -0,0 +1,13 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_CORE_TEST_DWA_H
+#define OPENEXR_CORE_TEST_DWA_H
+
+#include <string>
+
+void testDWASimdPaths (const std::string& tempdir);
+
+#endif // OPENEXR_CORE_TEST_DWA_H
@@ -0,0 +1,554 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#include "ht.h"
+
+#include "test_value.h"
+
+#include <openexr.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const int IMG_WIDTH    = 67;
+const int IMG_HEIGHT   = 64;
+const int IMG_CHANNELS = 4;
+
+typedef std::vector<uint16_t> HalfPlane;
+
+bool
+isFinite (uint16_t h)
+{
+    return (h & 0x7c00) != 0x7c00;
+}
+
+// finite halves only
+float
+halfValue (uint16_t h)
+{
+    int   e = (h >> 10) & 0x1f;
+    float v = e ? ldexpf ((float) ((h & 0x3ff) | 0x400), e - 25)
+                : ldexpf ((float) (h & 0x3ff), -24);
+    return (h & 0x8000) ? -v : v;
+}
+
+// position of a half in the order of the values, -0 just below +0
+int
+halfOrder (uint16_t h)
+{
+    return (h & 0x8000) ? -(int) (h & 0x7fff) - 1 : (int) h;
+}
+
+// what lossy coding starts from, Inf and NaN become the largest finite
+uint16_t
+clampedHalf (uint16_t h)
+{
+    return isFinite (h) ? h : (uint16_t) ((h & 0x8000) | 0x7bff);
+}
+
+// the half whose position in the order of the values is o
+uint16_t
+orderedHalf (int o)
+{
+    return o >= 0 ? (uint16_t) o : (uint16_t) (0x8000 | (-o - 1));
+}
+
+// smooth enough to compress, in bands of 16 lines: values over a
+// dozen exponents, values next to the largest finite ones of either
+// sign, values around zero of both signs, and large ones. And a few
+// Inf and NaN, which lossy coding cannot keep.
+void
+makeImage (HalfPlane* img)
+{
+    for (int c = 0; c < IMG_CHANNELS; ++c)
+    {
+        img[c].resize (IMG_WIDTH * IMG_HEIGHT);
+        for (int y = 0; y < IMG_HEIGHT; ++y)
+        {
+            for (int x = 0; x < IMG_WIDTH; ++x)
+            {
+                float w = sinf ((float) x * 0.07f + (float) y * 0.05f + (float) c);
+                int   o;
+
+                switch (y / 16)
+                {
+                    case 0: o = 0x3c00 + (int) (6000.f * w); break;
+                    case 1:
+                        o = 0x7bff - (int) (600.f * fabsf (w));
+                        if (c & 1) o = -o - 1;
+                        break;
+                    case 2: o = (int) (1500.f * w); break;
+                    default: o = 0x4c00 + (int) (3000.f * w); break;
+                }
+                img[c][y * IMG_WIDTH + x] = orderedHalf (o);
+            }
+        }
+        img[c][16 * IMG_WIDTH + c * 7]  = 0x7c00;
+        img[c][20 * IMG_WIDTH + c]      = 0xfc00;
+        img[c][24 * IMG_WIDTH + 9]      = 0x7e00;
+        img[c][50 * IMG_WIDTH + c * 11] = 0xffff;
+    }
+}
+
+void
+writeImage (const std::string& fn, const HalfPlane* img, float step)
+{
+    static const char*        names[IMG_CHANNELS] = {"A", "B", "G", "R"};
+    exr_context_t             f;
+    exr_context_initializer_t cinit   = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    exr_encode_pipeline_t     encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+    int                       partidx, lpc;
+
+    EXRCORE_TEST_RVAL (
+        exr_start_write (&f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (
+        exr_add_part (f, "beauty", EXR_STORAGE_SCANLINE, &partidx));
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        f, partidx, IMG_WIDTH, IMG_HEIGHT, EXR_COMPRESSION_HTJ2K32));
+    for (int c = 0; c < IMG_CHANNELS; ++c)
+        EXRCORE_TEST_RVAL (exr_add_channel (
+            f,
+            partidx,
+            names[c],
+            EXR_PIXEL_HALF,
+            EXR_PERCEPTUALLY_LOGARITHMIC,
+            1,
+            1));
+    EXRCORE_TEST_RVAL (exr_set_htj2k_quantization_step (f, partidx, step));
+    EXRCORE_TEST_RVAL (exr_write_header (f));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, partidx, &lpc));
+
+    for (int y = 0; y < IMG_HEIGHT; y += lpc)
+    {
+        exr_chunk_info_t cinfo;
+
+        EXRCORE_TEST_RVAL (exr_write_scanline_chunk_info (f, partidx, y, &cinfo));
+        if (y == 0)
+            EXRCORE_TEST_RVAL (
+                exr_encoding_initialize (f, partidx, &cinfo, &encoder));
+        else
+            EXRCORE_TEST_RVAL (
+                exr_encoding_update (f, partidx, &cinfo, &encoder));
+        for (int c = 0; c < encoder.channel_count; ++c)
+        {
+            encoder.channels[c].encode_from_ptr =
+                (const uint8_t*) (img[c].data () + y * IMG_WIDTH);
+            encoder.channels[c].user_pixel_stride      = 2;
+            encoder.channels[c].user_line_stride       = IMG_WIDTH * 2;
+            encoder.channels[c].user_bytes_per_element = 2;
+            encoder.channels[c].user_data_type         = EXR_PIXEL_HALF;
+        }
+        if (y == 0)
+            EXRCORE_TEST_RVAL (
+                exr_encoding_choose_default_routines (f, partidx, &encoder));
+        EXRCORE_TEST_RVAL (exr_encoding_run (f, partidx, &encoder));
+    }
+    EXRCORE_TEST_RVAL (exr_encoding_destroy (f, &encoder));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+void
+readImage (const std::string& fn, HalfPlane* img)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit   = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    exr_decode_pipeline_t     decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+    int                       lpc;
+
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &lpc));
+    for (int c = 0; c < IMG_CHANNELS; ++c)
+        img[c].assign (IMG_WIDTH * IMG_HEIGHT, 0);
+
+    for (int y = 0; y < IMG_HEIGHT; y += lpc)
+    {
+        exr_chunk_info_t cinfo;
+
+        EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+        if (y == 0)
+            EXRCORE_TEST_RVAL (exr_decoding_initialize (f, 0, &cinfo, &decoder));
+        else
+            EXRCORE_TEST_RVAL (exr_decoding_update (f, 0, &cinfo, &decoder));
+        EXRCORE_TEST (decoder.channel_count == IMG_CHANNELS);
+        for (int c = 0; c < decoder.channel_count; ++c)
+        {
+            decoder.channels[c].decode_to_ptr =
+                (uint8_t*) (img[c].data () + y * IMG_WIDTH);
+            decoder.channels[c].user_pixel_stride      = 2;
+            decoder.channels[c].user_line_stride       = IMG_WIDTH * 2;
+            decoder.channels[c].user_bytes_per_element = 2;
+            decoder.channels[c].user_data_type         = EXR_PIXEL_HALF;
+        }
+        if (y == 0)
+            EXRCORE_TEST_RVAL (
+                exr_decoding_choose_default_routines (f, 0, &decoder));
+        EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoder));
+    }
+    EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoder));
+    exr_finish (&f);
+}
+
+struct CacheChan
+{
+    const char*      name;
+    exr_pixel_type_t type;
+    int              xs;
+    int              ys;
+};
+
+// a plane per channel, in file (alphabetical) order
+struct CacheImage
+{
+    std::vector<CacheChan>            chans;
+    int                               width;
+    int                               height;
+    std::vector<std::vector<uint8_t>> planes;
+
+    size_t sampleSize (size_t c) const
+    {
+        return chans[c].type == EXR_PIXEL_HALF ? 2 : 4;
+    }
+
+    size_t lineBytes (size_t c) const
+    {
+        return sampleSize (c) * (size_t) (width / chans[c].xs);
+    }
+};
+
+// smooth enough that most chunks compress, for every pixel type
+CacheImage
+makeCacheImage (const std::vector<CacheChan>& chans, int width, int height)
+{
+    CacheImage img;
+
+    img.chans  = chans;
+    img.width  = width;
+    img.height = height;
+    img.planes.resize (chans.size ());
+    for (size_t c = 0; c < chans.size (); ++c)
+    {
+        int nx = width / chans[c].xs;
+        int ny = height / chans[c].ys;
+
+        img.planes[c].resize (img.sampleSize (c) * nx * ny);
+        for (int sy = 0; sy < ny; ++sy)
+        {
+            for (int sx = 0; sx < nx; ++sx)
+            {
+                float    w = sinf ((float) sx * 0.09f + (float) sy * 0.04f + c);
+                uint8_t* p = img.planes[c].data () +
+                             img.sampleSize (c) * ((size_t) sy * nx + sx);
+                uint32_t v;
+
+                if (chans[c].type == EXR_PIXEL_HALF)
+                {
+                    uint16_t h = orderedHalf (0x3c00 + (int) (3000.f * w));
+                    memcpy (p, &h, 2);
+                    continue;
+                }
+                if (chans[c].type == EXR_PIXEL_FLOAT)
+                {
+                    float f = 100.f * w;
+                    memcpy (&v, &f, 4);
+                }
+                else
+                    v = (uint32_t) ((sx * 3 + sy * 5 + (int) c) * 1000) +
+                        (uint32_t) ((sx * 7 ^ sy) & 3);
+                memcpy (p, &v, 4);
+            }
+        }
+    }
+    return img;
+}
+
+// a part holding lines [y, y + h) of img, so a part of a single
+// chunk can be written by a context that has not coded anything yet
+void
+addCachePart (
+    exr_context_t     f,
+    const char*       name,
+    const CacheImage& img,
+    int               y,
+    int               h,
+    int*              part)
+{
+    exr_attr_box2i_t dw = {{0, y}, {img.width - 1, y + h - 1}};
+
+    EXRCORE_TEST_RVAL (exr_add_part (f, name, EXR_STORAGE_SCANLINE, part));
+    // the parts of a file share their display window
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        f, *part, 128, 128, EXR_COMPRESSION_HTJ2K32));
+    EXRCORE_TEST_RVAL (exr_set_data_window (f, *part, &dw));
+    for (const CacheChan& ch: img.chans)
+        EXRCORE_TEST_RVAL (exr_add_channel (
+            f,
+            *part,
+            ch.name,
+            ch.type,
+            EXR_PERCEPTUALLY_LOGARITHMIC,
+            ch.xs,
+            ch.ys));
+}
+
+// points the coding channels of the chunk starting at line y at img
+template <typename Channels>
+void
+setCacheChannels (
+    Channels* chans, int count, const CacheImage& img, int y, bool decode)
+{
+    EXRCORE_TEST (count == (int) img.chans.size ());
+    for (int c = 0; c < count; ++c)
+    {
+        int      ys  = img.chans[c].ys;
+        uint8_t* ptr = nullptr;
+
+        if (chans[c].height > 0)
+            ptr = const_cast<uint8_t*> (img.planes[c].data ()) +
+                  img.lineBytes (c) * (size_t) ((y + ys - 1) / ys);
+        if (decode)
+            chans[c].decode_to_ptr = ptr;
+        else
+            chans[c].encode_from_ptr = ptr;
+        chans[c].user_pixel_stride      = (int32_t) img.sampleSize (c);
+        chans[c].user_line_stride       = (int32_t) img.lineBytes (c);
+        chans[c].user_bytes_per_element = (int16_t) img.sampleSize (c);
+        chans[c].user_data_type         = (uint16_t) img.chans[c].type;
+    }
+}
+
+void
+encodeCacheChunk (
+    exr_context_t          f,
+    int                    part,
+    const CacheImage&      img,
+    int                    y,
+    exr_encode_pipeline_t* encoder)
+{
+    exr_chunk_info_t cinfo;
+    bool             first = encoder->context == nullptr;
+
+    EXRCORE_TEST_RVAL (exr_write_scanline_chunk_info (f, part, y, &cinfo));
+    if (first)
+        EXRCORE_TEST_RVAL (exr_encoding_initialize (f, part, &cinfo, encoder));
+    else
+        EXRCORE_TEST_RVAL (exr_encoding_update (f, part, &cinfo, encoder));
+    setCacheChannels (encoder->channels, encoder->channel_count, img, y, false);
+    if (first)
+        EXRCORE_TEST_RVAL (
+            exr_encoding_choose_default_routines (f, part, encoder));
+    EXRCORE_TEST_RVAL (exr_encoding_run (f, part, encoder));
+}
+
+std::vector<uint8_t>
+readCacheChunk (exr_const_context_t f, int part, int y)
+{
+    exr_chunk_info_t     cinfo;
+    std::vector<uint8_t> data;
+
+    EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, part, y, &cinfo));
+    data.resize (cinfo.packed_size);
+    EXRCORE_TEST_RVAL (exr_read_chunk (f, part, &cinfo, data.data ()));
+    return data;
+}
+
+// decodes every chunk of the part into a copy of img, which must
+// then match it
+bool
+decodeCachePart (exr_const_context_t f, int part, const CacheImage& img)
+{
+    exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+    CacheImage            dst     = img;
+
+    for (auto& p: dst.planes)
+        std::fill (p.begin (), p.end (), 0xcd);
+    for (int y = 0; y < img.height; y += 32)
+    {
+        exr_chunk_info_t cinfo;
+
+        if (exr_read_scanline_chunk_info (f, part, y, &cinfo)) return false;
+        if (y == 0)
+        {
+            if (exr_decoding_initialize (f, part, &cinfo, &decoder))
+                return false;
+        }
+        else if (exr_decoding_update (f, part, &cinfo, &decoder))
+            return false;
+        setCacheChannels (
+            decoder.channels, decoder.channel_count, dst, y, true);
+        if (y == 0 && exr_decoding_choose_default_routines (f, part, &decoder))
+            return false;
+        if (exr_decoding_run (f, part, &decoder)) return false;
+    }
+    if (exr_decoding_destroy (f, &decoder)) return false;
+    return dst.planes == img.planes;
+}
+
+} // namespace
+
+void
+testHTJ2KLossyRoundTrip (const std::string& tempdir)
+{
+    std::string fn = tempdir + "htj2k_lossy.exr";
+    HalfPlane   src[IMG_CHANNELS], dst[IMG_CHANNELS];
+
+    makeImage (src);
+
+    // the default stays lossless, Inf and NaN included
+    writeImage (fn, src, 0.f);
+    readImage (fn, dst);
+    for (int c = 0; c < IMG_CHANNELS; ++c)
+        EXRCORE_TEST (src[c] == dst[c]);
+
+    for (float step: {1.f / 65536.f, 1.f / 1024.f, 1.f / 64.f})
+    {
+        // the step is relative to the 65536 codes of a half, and
+        // the wavelet and the color transform add up to a few steps
+        int maxCodes = (int) (4.f * step * 65536.f) + 2;
+
+        writeImage (fn, src, step);
+        readImage (fn, dst);
+        for (int c = 0; c < IMG_CHANNELS; ++c)
+        {
+            for (size_t i = 0; i < src[c].size (); ++i)
+            {
+                uint16_t in  = clampedHalf (src[c][i]);
+                uint16_t out = dst[c][i];
+                int      off = abs (halfOrder (in) - halfOrder (out));
+
+                EXRCORE_TEST (isFinite (out));
+                EXRCORE_TEST (off <= maxCodes);
+
+                // within an exponent a code is 2^-10 of the value, and
+                // at most twice that going up to the next exponent
+                if (step <= 1.f / 65536.f && (in & 0x7c00) != 0)
+                {
+                    float rel = 2.f * (float) off / 1024.f;
+                    float a   = halfValue (in);
+                    EXRCORE_TEST (fabsf (a - halfValue (out)) <= rel * fabsf (a));
+                }
+            }
+        }
+    }
+
+    remove (fn.c_str ());
+}
+
+void
+testHTJ2KCodestreamCache (const std::string& tempdir)
+{
+    // an RGB image, coded with the color transform, and one mixing
+    // pixel types with a sampled channel, both odd sized so their last
+    // chunks are 6 lines high; the sampled channel is 47 wide
+    const CacheImage imgs[2] = {
+        makeCacheImage (
+            {{"B", EXR_PIXEL_HALF, 1, 1},
+             {"G", EXR_PIXEL_HALF, 1, 1},
+             {"R", EXR_PIXEL_HALF, 1, 1}},
+            67,
+            70),
+        makeCacheImage (
+            {{"A", EXR_PIXEL_FLOAT, 1, 1},
+             {"B", EXR_PIXEL_HALF, 1, 1},
+             {"C", EXR_PIXEL_UINT, 1, 1},
+             {"D", EXR_PIXEL_HALF, 2, 2}},
+            94,
+            70)};
+    // parts are written in order, so the first chunk of each part is
+    // coded by the cached codestream the previous part finished with
+    static const char* names[3] = {"rgb", "mixed", "rgb again"};
+    static const int   which[3] = {0, 1, 0};
+
+    std::string               fn    = tempdir + "htj2k_cache.exr";
+    std::string               fresh = tempdir + "htj2k_cache_chunk.exr";
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    int                       parts[3];
+
+    EXRCORE_TEST_RVAL (
+        exr_start_write (&f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    for (int p = 0; p < 3; ++p)
+    {
+        const CacheImage& img = imgs[which[p]];
+        addCachePart (f, names[p], img, 0, img.height, &parts[p]);
+    }
+    EXRCORE_TEST_RVAL (exr_write_header (f));
+    for (int p = 0; p < 3; ++p)
+    {
+        exr_encode_pipeline_t encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+        const CacheImage&     img     = imgs[which[p]];
+
+        for (int y = 0; y < img.height; y += 32)
+            encodeCacheChunk (f, parts[p], img, y, &encoder);
+        EXRCORE_TEST_RVAL (exr_encoding_destroy (f, &encoder));
+    }
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+
+    // each chunk must be what a fresh codestream makes of it
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    for (int p = 0; p < 3; ++p)
+    {
+        const CacheImage& img = imgs[which[p]];
+
+        for (int y = 0; y < img.height; y += 32)
+        {
+            exr_context_t         single;
+            exr_encode_pipeline_t encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+            int                   h       = std::min (32, img.height - y);
+            int                   part;
+
+            EXRCORE_TEST_RVAL (exr_start_write (
+                &single, fresh.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+            addCachePart (single, names[p], img, y, h, &part);
+            EXRCORE_TEST_RVAL (exr_write_header (single));
+            encodeCacheChunk (single, part, img, y, &encoder);
+            EXRCORE_TEST_RVAL (exr_encoding_destroy (single, &encoder));
+            EXRCORE_TEST_RVAL (exr_finish (&single));
+
+            EXRCORE_TEST_RVAL (
+                exr_start_read (&single, fresh.c_str (), &cinit));
+            EXRCORE_TEST (
+                readCacheChunk (f, p, y) == readCacheChunk (single, 0, y));
+            EXRCORE_TEST_RVAL (exr_finish (&single));
+        }
+    }
+
+    // the cached decoders switch between the images too, and are
+    // lossless
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int p = 0; p < 3; ++p)
+            EXRCORE_TEST (decodeCachePart (f, p, imgs[which[p]]));
+    }
+
+    // several threads sharing the cached decoders
+    std::vector<std::thread> workers;
+    std::vector<int>         good (4, 0);
+    for (int t = 0; t < 4; ++t)
+    {
+        workers.emplace_back ([&, t] () {
+            for (int i = 0; i < 9; ++i)
+            {
+                int p = (i + t) % 3;
+                if (decodeCachePart (f, p, imgs[which[p]])) ++good[t];
+            }
+        });
+    }
+    for (auto& w: workers)
+        w.join ();
+    for (int t = 0; t < 4; ++t)
+        EXRCORE_TEST (good[t] == 9);
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+
+    remove (fresh.c_str ());
+    remove (fn.c_str ());
+}
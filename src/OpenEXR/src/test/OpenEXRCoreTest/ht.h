@@ -0,0 +1,14 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_CORE_TEST_HT_H
+#define OPENEXR_CORE_TEST_HT_H
+
+#include <string>
+
+void testHTJ2KLossyRoundTrip (const std::string& tempdir);
+void testHTJ2KCodestreamCache (const std::string& tempdir);
+
+#endif // OPENEXR_CORE_TEST_HT_H
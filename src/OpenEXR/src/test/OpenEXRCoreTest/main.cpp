@@ -0,0 +1,60 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#include "coding.h"
+#include "compression.h"
+#include "dwa.h"
+#include "ht.h"
+#include "read.h"
+#include "write.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#define TEST(x, y)                                                             \
+    if (helpMode) { std::cout << "  " << #x << " (" << y << ")" << std::endl; } \
+    else if (!strcmp (argv[1], #x))                                            \
+    {                                                                          \
+        std::cout << "-- " << #x << std::endl;                                 \
+        x (tempDir);                                                           \
+        return 0;                                                              \
+    }
+
+int
+main (int argc, char* argv[])
+{
+    bool        helpMode = (argc < 2 || !strcmp (argv[1], "--help"));
+    std::string tempDir  = (argc > 2) ? argv[2] : ".";
+
+    if (!tempDir.empty () && tempDir.back () != '/' && tempDir.back () != '\\')
+        tempDir += '/';
+
+    if (helpMode) std::cout << "OpenEXRCoreTest <test> [tempdir]" << std::endl;
+
+    TEST (testWriteReorderBuffer, "write");
+    TEST (testWriteReorderFailure, "write");
+    TEST (testWritePooledBuffers, "write");
+    TEST (testReadChunks, "read");
+    TEST (testReadChunksQueued, "read");
+    TEST (testReadChunksLongRun, "read");
+    TEST (testReadMemory, "read");
+    TEST (testReadMemoryMapped, "read");
+    TEST (testReadDamagedChunkTable, "read");
+    TEST (testReadPipelineStats, "read");
+    TEST (testUnpackLayouts, "coding");
+    TEST (testPackLayouts, "coding");
+    TEST (testHalfFloatBuffers, "coding");
+    TEST (testDeflateStateCache, "compression");
+    TEST (testDWASimdPaths, "compression");
+    TEST (testPizRoundTrip, "compression");
+    TEST (testHTJ2KLossyRoundTrip, "compression");
+    TEST (testHTJ2KCodestreamCache, "compression");
+
+    if (helpMode) return 0;
+
+    std::cerr << "Unknown test '" << argv[1] << "'" << std::endl;
+    return 1;
+}
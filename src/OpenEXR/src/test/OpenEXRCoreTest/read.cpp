@@ -0,0 +1,910 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#include "read.h"
+
+#include "test_value.h"
+
+#include <openexr.h>
+
+// for the older initializer layouts
+#include "backward_compatibility.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// wide enough that skipping a chunk leaves a gap too big to read across
+const int IMG_WIDTH  = 1200;
+const int IMG_HEIGHT = 24;
+
+struct MemFile
+{
+    std::vector<uint8_t> bytes;
+    int                  reads       = 0;
+    int                  vectorReads = 0;
+    int                  maxVecs     = 0;
+};
+
+int64_t
+memRead (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    void*                       buffer,
+    uint64_t                    sz,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb)
+{
+    MemFile* mf = static_cast<MemFile*> (userdata);
+
+    ++mf->reads;
+    if (offset >= mf->bytes.size ()) return 0;
+    if (sz > mf->bytes.size () - offset) sz = mf->bytes.size () - offset;
+    memcpy (buffer, mf->bytes.data () + offset, sz);
+    return (int64_t) sz;
+}
+
+int64_t
+memReadVector (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    const exr_read_vector_t*    vecs,
+    int                         count,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb)
+{
+    MemFile* mf    = static_cast<MemFile*> (userdata);
+    int64_t  total = 0;
+
+    ++mf->vectorReads;
+    if (count > mf->maxVecs) mf->maxVecs = count;
+    for (int v = 0; v < count; ++v)
+    {
+        uint64_t sz = vecs[v].size;
+        if (offset >= mf->bytes.size ()) break;
+        if (sz > mf->bytes.size () - offset) sz = mf->bytes.size () - offset;
+        memcpy (vecs[v].buffer, mf->bytes.data () + offset, sz);
+        total += (int64_t) sz;
+        offset += sz;
+    }
+    return total;
+}
+
+int64_t
+memSize (exr_const_context_t ctxt, void* userdata)
+{
+    return (int64_t) static_cast<MemFile*> (userdata)->bytes.size ();
+}
+
+void
+writeTestFile (const std::string& fn, int width, int height)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    std::vector<uint8_t>      line (width * 4);
+    int                       partidx;
+
+    EXRCORE_TEST_RVAL (
+        exr_start_write (&f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (
+        exr_add_part (f, "scanlines", EXR_STORAGE_SCANLINE, &partidx));
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        f, partidx, width, height, EXR_COMPRESSION_NONE));
+    EXRCORE_TEST_RVAL (exr_add_channel (
+        f, partidx, "Y", EXR_PIXEL_FLOAT, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1));
+    EXRCORE_TEST_RVAL (exr_write_header (f));
+    for (int y = 0; y < height; ++y)
+    {
+        for (size_t b = 0; b < line.size (); ++b)
+            line[b] = (uint8_t) (b * 7 + y * 31);
+        EXRCORE_TEST_RVAL (exr_write_scanline_chunk (
+            f, partidx, y, line.data (), line.size ()));
+    }
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+// reads the listed chunks in one go and checks them against
+// reading them one at a time; the counters of mf only cover the
+// exr_read_chunks call
+void
+checkReadChunks (
+    exr_const_context_t f, const std::vector<int>& lines, MemFile* mf = nullptr)
+{
+    std::vector<exr_chunk_info_t>     cinfos (lines.size ());
+    std::vector<std::vector<uint8_t>> bufs (lines.size ());
+    std::vector<void*>                ptrs (lines.size ());
+    std::vector<uint8_t>              expected;
+
+    for (size_t i = 0; i < lines.size (); ++i)
+    {
+        EXRCORE_TEST_RVAL (
+            exr_read_scanline_chunk_info (f, 0, lines[i], &cinfos[i]));
+        bufs[i].assign (cinfos[i].packed_size, 0xee);
+        ptrs[i] = bufs[i].data ();
+    }
+    if (mf) mf->reads = mf->vectorReads = mf->maxVecs = 0;
+    EXRCORE_TEST_RVAL (exr_read_chunks (
+        f, 0, cinfos.data (), (int) cinfos.size (), ptrs.data ()));
+    MemFile counts;
+    if (mf) counts = *mf;
+
+    for (size_t i = 0; i < lines.size (); ++i)
+    {
+        for (size_t b = 0; b < bufs[i].size (); ++b)
+            EXRCORE_TEST (bufs[i][b] == (uint8_t) (b * 7 + lines[i] * 31));
+        expected.resize (bufs[i].size ());
+        EXRCORE_TEST_RVAL (
+            exr_read_chunk (f, 0, &cinfos[i], expected.data ()));
+        EXRCORE_TEST (expected == bufs[i]);
+    }
+    if (mf)
+    {
+        mf->reads       = counts.reads;
+        mf->vectorReads = counts.vectorReads;
+        mf->maxVecs     = counts.maxVecs;
+    }
+}
+
+// the packed bytes of the listed chunks, fetched with one
+// exr_read_chunks call
+std::vector<std::vector<uint8_t>>
+readChunks (exr_const_context_t f, const std::vector<int>& lines)
+{
+    std::vector<exr_chunk_info_t>     cinfos (lines.size ());
+    std::vector<std::vector<uint8_t>> bufs (lines.size ());
+    std::vector<void*>                ptrs (lines.size ());
+
+    for (size_t i = 0; i < lines.size (); ++i)
+    {
+        EXRCORE_TEST_RVAL (
+            exr_read_scanline_chunk_info (f, 0, lines[i], &cinfos[i]));
+        bufs[i].assign (cinfos[i].packed_size, 0xee);
+        ptrs[i] = bufs[i].data ();
+    }
+    EXRCORE_TEST_RVAL (exr_read_chunks (
+        f, 0, cinfos.data (), (int) cinfos.size (), ptrs.data ()));
+    return bufs;
+}
+
+std::vector<int>
+allLines (bool reversed, int height = IMG_HEIGHT)
+{
+    std::vector<int> lines;
+    for (int y = 0; y < height; ++y)
+        lines.push_back (reversed ? height - 1 - y : y);
+    return lines;
+}
+
+// pixels of the decoded images, a half and a float channel
+struct Image
+{
+    std::vector<uint16_t> h;
+    std::vector<float>    y;
+    int                   borrowed = 0;
+};
+
+uint16_t
+halfPixel (int x, int y)
+{
+    // finite halves only
+    return (uint16_t) ((x * 3 + y * 5) & 0x3bff);
+}
+
+float
+floatPixel (int x, int y)
+{
+    return (float) (x % 37) * 0.25f - (float) (y % 11);
+}
+
+void
+writeImageFile (const std::string& fn, exr_compression_t comp)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit   = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    exr_encode_pipeline_t     encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+    Image                     img;
+    int                       partidx, lpc;
+
+    for (int y = 0; y < IMG_HEIGHT; ++y)
+    {
+        for (int x = 0; x < IMG_WIDTH; ++x)
+        {
+            img.h.push_back (halfPixel (x, y));
+            img.y.push_back (floatPixel (x, y));
+        }
+    }
+
+    EXRCORE_TEST_RVAL (
+        exr_start_write (&f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (
+        exr_add_part (f, "scanlines", EXR_STORAGE_SCANLINE, &partidx));
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        f, partidx, IMG_WIDTH, IMG_HEIGHT, comp));
+    EXRCORE_TEST_RVAL (exr_add_channel (
+        f, partidx, "H", EXR_PIXEL_HALF, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1));
+    EXRCORE_TEST_RVAL (exr_add_channel (
+        f, partidx, "Y", EXR_PIXEL_FLOAT, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1));
+    EXRCORE_TEST_RVAL (exr_write_header (f));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, partidx, &lpc));
+
+    for (int y = 0; y < IMG_HEIGHT; y += lpc)
+    {
+        exr_chunk_info_t cinfo;
+
+        EXRCORE_TEST_RVAL (exr_write_scanline_chunk_info (f, partidx, y, &cinfo));
+        if (y == 0)
+            EXRCORE_TEST_RVAL (
+                exr_encoding_initialize (f, partidx, &cinfo, &encoder));
+        else
+            EXRCORE_TEST_RVAL (
+                exr_encoding_update (f, partidx, &cinfo, &encoder));
+        EXRCORE_TEST (encoder.channel_count == 2);
+        encoder.channels[0].encode_from_ptr =
+            (const uint8_t*) (img.h.data () + y * IMG_WIDTH);
+        encoder.channels[0].user_pixel_stride      = 2;
+        encoder.channels[0].user_line_stride       = IMG_WIDTH * 2;
+        encoder.channels[0].user_bytes_per_element = 2;
+        encoder.channels[0].user_data_type         = EXR_PIXEL_HALF;
+        encoder.channels[1].encode_from_ptr =
+            (const uint8_t*) (img.y.data () + y * IMG_WIDTH);
+        encoder.channels[1].user_pixel_stride      = 4;
+        encoder.channels[1].user_line_stride       = IMG_WIDTH * 4;
+        encoder.channels[1].user_bytes_per_element = 4;
+        encoder.channels[1].user_data_type         = EXR_PIXEL_FLOAT;
+        if (y == 0)
+            EXRCORE_TEST_RVAL (
+                exr_encoding_choose_default_routines (f, partidx, &encoder));
+        EXRCORE_TEST_RVAL (exr_encoding_run (f, partidx, &encoder));
+    }
+    EXRCORE_TEST_RVAL (exr_encoding_destroy (f, &encoder));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+// decodes all of part 0 and checks the pixels, counting the chunks
+// whose packed buffer was borrowed (a zero alloc size) rather than read
+// into a buffer of the pipeline; with a base, they must be borrowed
+// from the size bytes there
+Image
+decodeImageFile (
+    exr_const_context_t f, const void* base = nullptr, uint64_t size = 0)
+{
+    exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+    const uint8_t*        lo      = static_cast<const uint8_t*> (base);
+    Image                 img;
+    int                   lpc;
+
+    img.h.assign (IMG_WIDTH * IMG_HEIGHT, 0);
+    img.y.assign (IMG_WIDTH * IMG_HEIGHT, 0.f);
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &lpc));
+    for (int y = 0; y < IMG_HEIGHT; y += lpc)
+    {
+        exr_chunk_info_t cinfo;
+
+        EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+        if (y == 0)
+            EXRCORE_TEST_RVAL (exr_decoding_initialize (f, 0, &cinfo, &decoder));
+        else
+            EXRCORE_TEST_RVAL (exr_decoding_update (f, 0, &cinfo, &decoder));
+        EXRCORE_TEST (decoder.channel_count == 2);
+        decoder.channels[0].decode_to_ptr =
+            (uint8_t*) (img.h.data () + y * IMG_WIDTH);
+        decoder.channels[0].user_pixel_stride      = 2;
+        decoder.channels[0].user_line_stride       = IMG_WIDTH * 2;
+        decoder.channels[0].user_bytes_per_element = 2;
+        decoder.channels[0].user_data_type         = EXR_PIXEL_HALF;
+        decoder.channels[1].decode_to_ptr =
+            (uint8_t*) (img.y.data () + y * IMG_WIDTH);
+        decoder.channels[1].user_pixel_stride      = 4;
+        decoder.channels[1].user_line_stride       = IMG_WIDTH * 4;
+        decoder.channels[1].user_bytes_per_element = 4;
+        decoder.channels[1].user_data_type         = EXR_PIXEL_FLOAT;
+        if (y == 0)
+            EXRCORE_TEST_RVAL (
+                exr_decoding_choose_default_routines (f, 0, &decoder));
+        EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoder));
+
+        const uint8_t* packed =
+            static_cast<const uint8_t*> (decoder.packed_buffer);
+        if (packed && decoder.packed_alloc_size == 0)
+        {
+            if (lo) EXRCORE_TEST (packed >= lo && packed < lo + size);
+            ++img.borrowed;
+        }
+    }
+    EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoder));
+
+    for (int y = 0; y < IMG_HEIGHT; ++y)
+    {
+        for (int x = 0; x < IMG_WIDTH; ++x)
+        {
+            EXRCORE_TEST (img.h[y * IMG_WIDTH + x] == halfPixel (x, y));
+            EXRCORE_TEST (img.y[y * IMG_WIDTH + x] == floatPixel (x, y));
+        }
+    }
+    return img;
+}
+
+std::vector<uint8_t>
+loadFile (const std::string& fn)
+{
+    std::ifstream        in (fn, std::ios::binary);
+    std::vector<uint8_t> bytes (
+        (std::istreambuf_iterator<char> (in)), std::istreambuf_iterator<char> ());
+    return bytes;
+}
+
+void
+saveFile (const std::string& fn, const std::vector<uint8_t>& bytes)
+{
+    std::ofstream out (fn, std::ios::binary | std::ios::trunc);
+    out.write (reinterpret_cast<const char*> (bytes.data ()), bytes.size ());
+}
+
+const int TABLE_WIDTH  = 40;
+const int TABLE_HEIGHT = 150;
+const int TABLE_TILE   = 16;
+
+// an uncompressed file with many small chunks, scanlines or tiles
+void
+writeTableFile (const std::string& fn, bool tiled)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    int                       partidx;
+
+    EXRCORE_TEST_RVAL (
+        exr_start_write (&f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (exr_add_part (
+        f,
+        "table",
+        tiled ? EXR_STORAGE_TILED : EXR_STORAGE_SCANLINE,
+        &partidx));
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        f, partidx, TABLE_WIDTH, TABLE_HEIGHT, EXR_COMPRESSION_NONE));
+    EXRCORE_TEST_RVAL (exr_add_channel (
+        f, partidx, "Y", EXR_PIXEL_FLOAT, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1));
+    if (tiled)
+        EXRCORE_TEST_RVAL (exr_set_tile_descriptor (
+            f,
+            partidx,
+            TABLE_TILE,
+            TABLE_TILE,
+            EXR_TILE_ONE_LEVEL,
+            EXR_TILE_ROUND_DOWN));
+    EXRCORE_TEST_RVAL (exr_write_header (f));
+
+    if (tiled)
+    {
+        for (int ty = 0; ty * TABLE_TILE < TABLE_HEIGHT; ++ty)
+        {
+            for (int tx = 0; tx * TABLE_TILE < TABLE_WIDTH; ++tx)
+            {
+                exr_chunk_info_t     cinfo;
+                std::vector<uint8_t> data;
+
+                EXRCORE_TEST_RVAL (
+                    exr_write_tile_chunk_info (f, 0, tx, ty, 0, 0, &cinfo));
+                data.assign (cinfo.unpacked_size, (uint8_t) (tx * 7 + ty));
+                EXRCORE_TEST_RVAL (exr_write_tile_chunk (
+                    f, 0, tx, ty, 0, 0, data.data (), data.size ()));
+            }
+        }
+    }
+    else
+    {
+        std::vector<uint8_t> line (TABLE_WIDTH * 4);
+        for (int y = 0; y < TABLE_HEIGHT; ++y)
+        {
+            for (size_t b = 0; b < line.size (); ++b)
+                line[b] = (uint8_t) (b + y * 3);
+            EXRCORE_TEST_RVAL (exr_write_scanline_chunk (
+                f, 0, y, line.data (), line.size ()));
+        }
+    }
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+// where each chunk of part 0 starts, through the chunk table
+std::vector<uint64_t>
+chunkOffsets (exr_const_context_t f)
+{
+    std::vector<uint64_t> offsets;
+    exr_storage_t         storage;
+    exr_chunk_info_t      cinfo;
+
+    EXRCORE_TEST_RVAL (exr_get_storage (f, 0, &storage));
+    if (storage == EXR_STORAGE_TILED)
+    {
+        for (int ty = 0; ty * TABLE_TILE < TABLE_HEIGHT; ++ty)
+        {
+            for (int tx = 0; tx * TABLE_TILE < TABLE_WIDTH; ++tx)
+            {
+                EXRCORE_TEST_RVAL (
+                    exr_read_tile_chunk_info (f, 0, tx, ty, 0, 0, &cinfo));
+                offsets.push_back (cinfo.data_offset);
+            }
+        }
+    }
+    else
+    {
+        for (int y = 0; y < TABLE_HEIGHT; ++y)
+        {
+            EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+            offsets.push_back (cinfo.data_offset);
+        }
+    }
+    return offsets;
+}
+
+// opens fn (or mf, when given) and returns the chunk offsets it ends
+// up with
+std::vector<uint64_t>
+damagedOffsets (
+    const std::string& fn,
+    int                nthreads,
+    const std::string& sidecar,
+    MemFile*           mf = nullptr)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    std::vector<uint64_t>     offsets;
+
+    if (mf)
+    {
+        cinit.user_data = mf;
+        cinit.read_fn   = &memRead;
+        cinit.size_fn   = &memSize;
+        mf->reads       = 0;
+    }
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    EXRCORE_TEST_RVAL (exr_set_chunk_reconstruct_threads (f, nthreads));
+    if (!sidecar.empty ())
+        EXRCORE_TEST_RVAL (exr_set_chunk_index_sidecar (f, sidecar.c_str ()));
+    offsets = chunkOffsets (f);
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+    return offsets;
+}
+
+bool
+fileExists (const std::string& fn)
+{
+    std::ifstream in (fn, std::ios::binary);
+    return in.good ();
+}
+
+} // namespace
+
+void
+testReadChunks (const std::string& tempdir)
+{
+    std::string   fn = tempdir + "read_chunks.exr";
+    exr_context_t f;
+
+    writeTestFile (fn, IMG_WIDTH, IMG_HEIGHT);
+
+    // the built-in file backend, in whatever way it reads runs
+    {
+        exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+        checkReadChunks (f, allLines (true));
+        checkReadChunks (f, {0, 1, 2, 10, 11, 20});
+        checkReadChunks (f, {3});
+        EXRCORE_TEST_RVAL (exr_set_read_queue_depth (f, 4));
+        checkReadChunks (f, allLines (false));
+        checkReadChunks (f, {23, 5, 4, 12});
+        exr_finish (&f);
+    }
+
+    MemFile mf;
+    {
+        std::ifstream in (fn, std::ios::binary);
+        mf.bytes.assign (
+            std::istreambuf_iterator<char> (in),
+            std::istreambuf_iterator<char> ());
+    }
+    EXRCORE_TEST (!mf.bytes.empty ());
+
+    // a custom vectored read, set through the v4 initializer layout
+    {
+        struct _exr_context_initializer_v4 cinit;
+
+        memset (&cinit, 0, sizeof (cinit));
+        cinit.size           = sizeof (cinit);
+        cinit.user_data      = &mf;
+        cinit.read_fn        = &memRead;
+        cinit.size_fn        = &memSize;
+        cinit.read_vector_fn = &memReadVector;
+        cinit.zip_level      = -2;
+        cinit.dwa_quality    = -1.f;
+        EXRCORE_TEST_RVAL (exr_start_read (
+            &f,
+            "<memory>",
+            reinterpret_cast<const exr_context_initializer_t*> (&cinit)));
+
+        // consecutive chunks are one request, leaders and all
+        checkReadChunks (f, allLines (true), &mf);
+        EXRCORE_TEST (mf.vectorReads == 1);
+        EXRCORE_TEST (mf.maxVecs == 2 * IMG_HEIGHT - 1);
+        EXRCORE_TEST (mf.reads == 0);
+
+        // skipping a chunk is too big a gap to read across
+        checkReadChunks (f, {0, 1, 2, 10, 11, 20}, &mf);
+        EXRCORE_TEST (mf.vectorReads == 2);
+        EXRCORE_TEST (mf.reads == 1);
+
+        checkReadChunks (f, {0, 2, 4, 6}, &mf);
+        EXRCORE_TEST (mf.vectorReads == 0);
+        EXRCORE_TEST (mf.reads == 4);
+        exr_finish (&f);
+    }
+
+    // without one, runs are staged through read_fn
+    {
+        exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+
+        cinit.user_data = &mf;
+        cinit.read_fn   = &memRead;
+        cinit.size_fn   = &memSize;
+        EXRCORE_TEST_RVAL (exr_start_read (&f, "<memory>", &cinit));
+
+        checkReadChunks (f, allLines (false), &mf);
+        EXRCORE_TEST (mf.vectorReads == 0);
+        EXRCORE_TEST (mf.reads == 1);
+
+        checkReadChunks (f, {20, 11, 10, 2, 1, 0}, &mf);
+        EXRCORE_TEST (mf.reads == 3);
+        exr_finish (&f);
+    }
+
+    remove (fn.c_str ());
+}
+
+void
+testReadChunksQueued (const std::string& tempdir)
+{
+    std::string   fn = tempdir + "read_chunks_queued.exr";
+    exr_context_t queued, plain;
+
+    writeTestFile (fn, IMG_WIDTH, IMG_HEIGHT);
+
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    EXRCORE_TEST_RVAL (exr_start_read (&queued, fn.c_str (), &cinit));
+    EXRCORE_TEST_RVAL (exr_start_read (&plain, fn.c_str (), &cinit));
+    EXRCORE_TEST_RVAL (exr_set_read_queue_depth (queued, 4));
+
+    // every other line is a separate request, so several are in
+    // flight at once; the first batch builds the ring and the rest
+    // reuse it
+    std::vector<int> even, odd;
+    for (int y = 0; y < IMG_HEIGHT; ++y)
+        (y % 2 ? odd : even).push_back (y);
+    std::vector<std::vector<int>> batches = {
+        even, odd, allLines (true), {23, 5, 4, 12, 17}, even};
+
+    for (auto& lines: batches)
+        EXRCORE_TEST (readChunks (queued, lines) == readChunks (plain, lines));
+
+    // a deeper queue than the ring was built for rebuilds it
+    EXRCORE_TEST_RVAL (exr_set_read_queue_depth (queued, 16));
+    for (auto& lines: batches)
+        EXRCORE_TEST (readChunks (queued, lines) == readChunks (plain, lines));
+
+    // callers racing for the ring fall back to plain reads meanwhile
+    auto expected = readChunks (plain, even);
+    std::vector<std::thread> workers;
+    std::vector<int>         good (4, 0);
+    for (int t = 0; t < 4; ++t)
+    {
+        workers.emplace_back ([&, t] () {
+            for (int i = 0; i < 20; ++i)
+                if (readChunks (queued, even) == expected) ++good[t];
+        });
+    }
+    for (auto& w: workers)
+        w.join ();
+    for (int t = 0; t < 4; ++t)
+        EXRCORE_TEST (good[t] == 20);
+
+    checkReadChunks (queued, odd);
+    exr_finish (&queued);
+    exr_finish (&plain);
+    remove (fn.c_str ());
+}
+
+void
+testReadChunksLongRun (const std::string& tempdir)
+{
+    // narrow chunks, so a run of them needs more entries than a
+    // single vectored read may take
+    const int     height = 2000;
+    std::string   fn     = tempdir + "read_chunks_long.exr";
+    exr_context_t f;
+
+    writeTestFile (fn, 16, height);
+
+    {
+        exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+        checkReadChunks (f, allLines (false, height));
+        EXRCORE_TEST_RVAL (exr_set_read_queue_depth (f, 8));
+        checkReadChunks (f, allLines (true, height));
+        exr_finish (&f);
+    }
+
+    MemFile mf;
+    {
+        std::ifstream in (fn, std::ios::binary);
+        mf.bytes.assign (
+            std::istreambuf_iterator<char> (in),
+            std::istreambuf_iterator<char> ());
+    }
+
+    {
+        exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+
+        cinit.user_data      = &mf;
+        cinit.read_fn        = &memRead;
+        cinit.size_fn        = &memSize;
+        cinit.read_vector_fn = &memReadVector;
+        EXRCORE_TEST_RVAL (exr_start_read (&f, "<memory>", &cinit));
+        checkReadChunks (f, allLines (false, height), &mf);
+        EXRCORE_TEST (mf.maxVecs <= 1024);
+        // a chunk and the leader before it per pair of entries
+        EXRCORE_TEST (mf.vectorReads == (height + 511) / 512);
+        exr_finish (&f);
+    }
+
+    remove (fn.c_str ());
+}
+
+void
+testReadMemory (const std::string& tempdir)
+{
+    std::string   fn = tempdir + "read_memory.exr";
+    exr_context_t f;
+
+    for (exr_compression_t comp:
+         {EXR_COMPRESSION_ZIP, EXR_COMPRESSION_PIZ, EXR_COMPRESSION_NONE})
+    {
+        exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+        Image                     fromFile, fromMemory;
+
+        writeImageFile (fn, comp);
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+        fromFile = decodeImageFile (f);
+        exr_finish (&f);
+
+        // a copy the context may only read from
+        const std::vector<uint8_t> bytes = loadFile (fn);
+        EXRCORE_TEST_RVAL (exr_start_read_memory (
+            &f, "<memory>", bytes.data (), bytes.size (), &cinit));
+        fromMemory = decodeImageFile (f, bytes.data (), bytes.size ());
+        EXRCORE_TEST (fromMemory.h == fromFile.h);
+        EXRCORE_TEST (fromMemory.y == fromFile.y);
+
+        // compressed chunks are decompressed straight from the memory
+        if (comp != EXR_COMPRESSION_NONE)
+        {
+            int chunks;
+            EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &chunks));
+            EXRCORE_TEST (fromMemory.borrowed == chunks);
+        }
+        exr_finish (&f);
+        EXRCORE_TEST (bytes == loadFile (fn));
+    }
+
+    // chunk reads copy out of the memory
+    {
+        writeTestFile (fn, IMG_WIDTH, IMG_HEIGHT);
+        const std::vector<uint8_t> bytes = loadFile (fn);
+        EXRCORE_TEST_RVAL (exr_start_read_memory (
+            &f, "<memory>", bytes.data (), bytes.size (), nullptr));
+        checkReadChunks (f, allLines (true));
+        checkReadChunks (f, {0, 2, 4, 23});
+        exr_finish (&f);
+    }
+
+    EXRCORE_TEST (
+        exr_start_read_memory (&f, "<memory>", nullptr, 0, nullptr) ==
+        EXR_ERR_INVALID_ARGUMENT);
+    EXRCORE_TEST (f == nullptr);
+
+    remove (fn.c_str ());
+}
+
+void
+testReadMemoryMapped (const std::string& tempdir)
+{
+    std::string   fn = tempdir + "read_mapped.exr";
+    exr_context_t f;
+
+    for (exr_compression_t comp:
+         {EXR_COMPRESSION_ZIP, EXR_COMPRESSION_RLE, EXR_COMPRESSION_NONE})
+    {
+        exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+        Image                     plain, mapped;
+        int                       chunks;
+
+        writeImageFile (fn, comp);
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+        plain = decodeImageFile (f);
+        EXRCORE_TEST (plain.borrowed == 0);
+        exr_finish (&f);
+
+        cinit.flags |= EXR_CONTEXT_FLAG_MEMORY_MAP_FILE;
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+        EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &chunks));
+        mapped = decodeImageFile (f);
+        EXRCORE_TEST (mapped.h == plain.h);
+        EXRCORE_TEST (mapped.y == plain.y);
+#ifndef _WIN32
+        // compressed chunks are decompressed straight from the mapping
+        if (comp != EXR_COMPRESSION_NONE)
+            EXRCORE_TEST (mapped.borrowed == chunks);
+#endif
+        exr_finish (&f);
+    }
+
+    remove (fn.c_str ());
+}
+
+void
+testReadDamagedChunkTable (const std::string& tempdir)
+{
+    for (int tiled = 0; tiled < 2; ++tiled)
+    {
+        std::string fn      = tempdir + "read_damaged_table.exr";
+        std::string sidecar = tempdir + "read_damaged_table.cidx";
+        std::vector<uint64_t> expected;
+        std::vector<uint8_t>  bytes;
+        uint64_t              tableOffset;
+        int32_t               count;
+
+        writeTableFile (fn, tiled != 0);
+        {
+            exr_context_t             f;
+            exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+            EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+            EXRCORE_TEST_RVAL (exr_get_chunk_table_offset (f, 0, &tableOffset));
+            EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &count));
+            expected = chunkOffsets (f);
+            EXRCORE_TEST_RVAL (exr_finish (&f));
+        }
+        EXRCORE_TEST (count > 8);
+
+        // as if the writer died: the back half of the table was never
+        // written, and one entry points past the end of the file
+        bytes = loadFile (fn);
+        memset (
+            bytes.data () + tableOffset + 8 * (count / 2),
+            0,
+            8 * (count - count / 2));
+        memset (bytes.data () + tableOffset + 8, 0x7f, 8);
+        saveFile (fn, bytes);
+        remove (sidecar.c_str ());
+
+        // serial and threaded scans find the same chunks
+        EXRCORE_TEST (damagedOffsets (fn, 0, "") == expected);
+        EXRCORE_TEST (damagedOffsets (fn, 4, "") == expected);
+        EXRCORE_TEST (!fileExists (sidecar));
+
+        // the first open with a sidecar rebuilds and saves the table,
+        // the next one loads it
+        EXRCORE_TEST (damagedOffsets (fn, 4, sidecar) == expected);
+        EXRCORE_TEST (fileExists (sidecar));
+        EXRCORE_TEST (damagedOffsets (fn, 0, sidecar) == expected);
+        remove (sidecar.c_str ());
+
+        // through a stream, where reloading has to skip the scan
+        MemFile mf;
+        int     rebuildReads;
+        mf.bytes = bytes;
+        EXRCORE_TEST (damagedOffsets (fn, 0, sidecar, &mf) == expected);
+        rebuildReads = mf.reads;
+        EXRCORE_TEST (damagedOffsets (fn, 0, sidecar, &mf) == expected);
+        EXRCORE_TEST (mf.reads < rebuildReads);
+
+        // a file rewritten to the same size does not reuse the table
+        memset (bytes.data () + tableOffset + 16, 0x7e, 8);
+        mf.bytes = bytes;
+        EXRCORE_TEST (damagedOffsets (fn, 0, sidecar, &mf) == expected);
+        EXRCORE_TEST (mf.reads >= rebuildReads);
+        EXRCORE_TEST (damagedOffsets (fn, 2, sidecar, &mf) == expected);
+        EXRCORE_TEST (mf.reads < rebuildReads);
+
+        remove (sidecar.c_str ());
+        remove (fn.c_str ());
+    }
+}
+
+void
+testReadPipelineStats (const std::string& tempdir)
+{
+    static const exr_compression_t comps[] = {
+        EXR_COMPRESSION_ZIP, EXR_COMPRESSION_NONE};
+
+    for (exr_compression_t comp: comps)
+    {
+        std::string               fn = tempdir + "read_stats.exr";
+        exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+        exr_context_t             f;
+        exr_pipeline_stats_t      stats, zero;
+        exr_compression_stats_t   cstats, czero;
+        uint64_t                  packed = 0, unpacked = 0;
+        int32_t                   chunks;
+        int                       lpc;
+
+        memset (&zero, 0, sizeof (zero));
+        memset (&czero, 0, sizeof (czero));
+        writeImageFile (fn, comp);
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+        EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &chunks));
+        EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &lpc));
+        for (int y = 0; y < IMG_HEIGHT; y += lpc)
+        {
+            exr_chunk_info_t cinfo;
+            EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+            packed += cinfo.packed_size;
+            unpacked += cinfo.unpacked_size;
+        }
+
+        // nothing is counted until collection is turned on
+        decodeImageFile (f);
+        EXRCORE_TEST_RVAL (exr_get_pipeline_stats (f, &stats));
+        EXRCORE_TEST (memcmp (&stats, &zero, sizeof (stats)) == 0);
+
+        EXRCORE_TEST_RVAL (exr_set_pipeline_stats (f, 1));
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            decodeImageFile (f);
+            EXRCORE_TEST_RVAL (exr_get_pipeline_stats (f, &stats));
+            EXRCORE_TEST (stats.decode_chunks == (uint64_t) chunks);
+            EXRCORE_TEST (stats.read_bytes == packed);
+            EXRCORE_TEST (stats.encode_chunks == 0);
+            EXRCORE_TEST (stats.packed_bytes == 0);
+            EXRCORE_TEST (stats.write_bytes == 0);
+            EXRCORE_TEST_RVAL (
+                exr_get_pipeline_compression_stats (f, comp, &cstats));
+            if (comp == EXR_COMPRESSION_NONE)
+            {
+                EXRCORE_TEST (stats.decompress_bytes == 0);
+                EXRCORE_TEST (memcmp (&cstats, &czero, sizeof (cstats)) == 0);
+            }
+            else
+            {
+                EXRCORE_TEST (stats.decompress_bytes == unpacked);
+                EXRCORE_TEST (cstats.decompress_chunks == (uint64_t) chunks);
+                EXRCORE_TEST (cstats.decompress_in_bytes == packed);
+                EXRCORE_TEST (cstats.decompress_out_bytes == unpacked);
+                EXRCORE_TEST (cstats.compress_chunks == 0);
+            }
+
+            // a reset zeroes everything, and counting starts over
+            EXRCORE_TEST_RVAL (exr_reset_pipeline_stats (f));
+            EXRCORE_TEST_RVAL (exr_get_pipeline_stats (f, &stats));
+            EXRCORE_TEST (memcmp (&stats, &zero, sizeof (stats)) == 0);
+            EXRCORE_TEST_RVAL (
+                exr_get_pipeline_compression_stats (f, comp, &cstats));
+            EXRCORE_TEST (memcmp (&cstats, &czero, sizeof (cstats)) == 0);
+        }
+
+        // turning it off keeps the totals but stops adding to them
+        decodeImageFile (f);
+        EXRCORE_TEST_RVAL (exr_set_pipeline_stats (f, 0));
+        decodeImageFile (f);
+        EXRCORE_TEST_RVAL (exr_get_pipeline_stats (f, &stats));
+        EXRCORE_TEST (stats.decode_chunks == (uint64_t) chunks);
+        EXRCORE_TEST (stats.read_bytes == packed);
+
+        EXRCORE_TEST_RVAL (exr_finish (&f));
+        remove (fn.c_str ());
+    }
+}
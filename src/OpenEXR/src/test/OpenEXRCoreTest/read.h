@@ -0,0 +1,19 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_CORE_TEST_READ_H
+#define OPENEXR_CORE_TEST_READ_H
+
+#include <string>
+
+void testReadChunks (const std::string& tempdir);
+void testReadChunksQueued (const std::string& tempdir);
+void testReadChunksLongRun (const std::string& tempdir);
+void testReadMemory (const std::string& tempdir);
+void testReadMemoryMapped (const std::string& tempdir);
+void testReadDamagedChunkTable (const std::string& tempdir);
+void testReadPipelineStats (const std::string& tempdir);
+
+#endif // OPENEXR_CORE_TEST_READ_H
@@ -0,0 +1,41 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_CORE_TEST_VALUE_H
+#define OPENEXR_CORE_TEST_VALUE_H
+
+#include <openexr.h>
+
+#include <cstdlib>
+#include <iostream>
+
+inline void
+core_test_fail (const char* expr, const char* file, int line)
+{
+    std::cerr << "Core Test failed '" << expr << "' at " << file << ":"
+              << line << std::endl;
+    std::abort ();
+}
+
+inline void
+core_test_fail_rval (exr_result_t rv, const char* expr, const char* file, int line)
+{
+    std::cerr << "Core Test failed '" << expr << "' (" << exr_get_error_code_as_string (rv)
+              << ") at " << file << ":" << line << std::endl;
+    std::abort ();
+}
+
+#define EXRCORE_TEST(x)                                                        \
+    if (!(x)) core_test_fail (#x, __FILE__, __LINE__)
+
+#define EXRCORE_TEST_RVAL(x)                                                   \
+    do                                                                         \
+    {                                                                          \
+        exr_result_t test_rv_ = (x);                                           \
+        if (test_rv_ != EXR_ERR_SUCCESS)                                       \
+            core_test_fail_rval (test_rv_, #x, __FILE__, __LINE__);            \
+    } while (0)
+
+#endif /* OPENEXR_CORE_TEST_VALUE_H */
@@ -0,0 +1,431 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#include "write.h"
+
+#include "test_value.h"
+
+#include <openexr.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const int IMG_WIDTH    = 61;
+const int IMG_HEIGHT   = 203;
+const int IMG_CHANNELS = 3;
+const int TILE_SIZE    = 16;
+
+struct TestImage
+{
+    std::vector<float> data[IMG_CHANNELS];
+
+    TestImage ()
+    {
+        for (int c = 0; c < IMG_CHANNELS; ++c)
+        {
+            data[c].resize (IMG_WIDTH * IMG_HEIGHT);
+            for (int y = 0; y < IMG_HEIGHT; ++y)
+                for (int x = 0; x < IMG_WIDTH; ++x)
+                    data[c][y * IMG_WIDTH + x] =
+                        (float) ((x * 7 + y * 13 + c * 29) % 101) / 37.f +
+                        (float) (y % 5) * 0.125f;
+        }
+    }
+};
+
+struct ChunkWriter
+{
+    exr_context_t    f     = nullptr;
+    bool             tiled = false;
+    int              lpc   = 1;
+    int              ntx   = 1;
+    int              count = 0;
+    const TestImage* img   = nullptr;
+};
+
+void
+startWrite (
+    ChunkWriter&       w,
+    const std::string& fn,
+    const TestImage&   img,
+    exr_compression_t  comp,
+    bool               tiled,
+    int                slots)
+{
+    static const char*        names[IMG_CHANNELS] = {"B", "G", "R"};
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    int                       partidx;
+
+    w.img   = &img;
+    w.tiled = tiled;
+    EXRCORE_TEST_RVAL (
+        exr_start_write (&w.f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (exr_add_part (
+        w.f,
+        "beauty",
+        tiled ? EXR_STORAGE_TILED : EXR_STORAGE_SCANLINE,
+        &partidx));
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        w.f, partidx, IMG_WIDTH, IMG_HEIGHT, comp));
+    for (int c = 0; c < IMG_CHANNELS; ++c)
+        EXRCORE_TEST_RVAL (exr_add_channel (
+            w.f,
+            partidx,
+            names[c],
+            EXR_PIXEL_FLOAT,
+            EXR_PERCEPTUALLY_LOGARITHMIC,
+            1,
+            1));
+    if (tiled)
+    {
+        EXRCORE_TEST_RVAL (exr_set_tile_descriptor (
+            w.f,
+            partidx,
+            TILE_SIZE,
+            TILE_SIZE,
+            EXR_TILE_ONE_LEVEL,
+            EXR_TILE_ROUND_DOWN));
+        w.ntx = (IMG_WIDTH + TILE_SIZE - 1) / TILE_SIZE;
+        w.count = w.ntx * ((IMG_HEIGHT + TILE_SIZE - 1) / TILE_SIZE);
+    }
+    EXRCORE_TEST_RVAL (exr_write_header (w.f));
+    if (!tiled)
+    {
+        EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (w.f, 0, &w.lpc));
+        w.count = (IMG_HEIGHT + w.lpc - 1) / w.lpc;
+    }
+    if (slots > 0)
+        EXRCORE_TEST_RVAL (exr_encoding_set_reorder_buffer (w.f, slots));
+}
+
+// prepares the pipeline for chunk idx, leaving it ready to run
+void
+setupChunk (
+    ChunkWriter& w, int idx, exr_encode_pipeline_t& encoder, bool& first)
+{
+    exr_chunk_info_t cinfo;
+    int              x = 0, y = 0;
+
+    if (w.tiled)
+    {
+        int tx = idx % w.ntx, ty = idx / w.ntx;
+        EXRCORE_TEST_RVAL (
+            exr_write_tile_chunk_info (w.f, 0, tx, ty, 0, 0, &cinfo));
+        x = tx * TILE_SIZE;
+        y = ty * TILE_SIZE;
+    }
+    else
+    {
+        y = idx * w.lpc;
+        EXRCORE_TEST_RVAL (exr_write_scanline_chunk_info (w.f, 0, y, &cinfo));
+    }
+
+    if (first)
+        EXRCORE_TEST_RVAL (
+            exr_encoding_initialize (w.f, 0, &cinfo, &encoder));
+    else
+        EXRCORE_TEST_RVAL (exr_encoding_update (w.f, 0, &cinfo, &encoder));
+
+    for (int c = 0; c < encoder.channel_count; ++c)
+    {
+        exr_coding_channel_info_t& outc = encoder.channels[c];
+
+        outc.encode_from_ptr = reinterpret_cast<const uint8_t*> (
+            w.img->data[c].data () + y * IMG_WIDTH + x);
+        outc.user_pixel_stride      = sizeof (float);
+        outc.user_line_stride       = IMG_WIDTH * sizeof (float);
+        outc.user_bytes_per_element = sizeof (float);
+        outc.user_data_type         = EXR_PIXEL_FLOAT;
+    }
+
+    if (first)
+    {
+        EXRCORE_TEST_RVAL (
+            exr_encoding_choose_default_routines (w.f, 0, &encoder));
+        first = false;
+    }
+}
+
+void
+writeInOrder (ChunkWriter& w, const std::vector<int>& order)
+{
+    exr_encode_pipeline_t encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+    bool                  first   = true;
+
+    for (int idx: order)
+    {
+        setupChunk (w, idx, encoder, first);
+        EXRCORE_TEST_RVAL (exr_encoding_run (w.f, 0, &encoder));
+    }
+    EXRCORE_TEST_RVAL (exr_encoding_destroy (w.f, &encoder));
+}
+
+#if ILMTHREAD_THREADING_ENABLED
+void
+writeThreaded (ChunkWriter& w, int nthreads)
+{
+    std::atomic<int>         next{0};
+    std::atomic<int>         failed{0};
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < nthreads; ++t)
+    {
+        threads.emplace_back ([&w, &next, &failed, t] () {
+            exr_encode_pipeline_t encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+            bool                  first   = true;
+            int                   idx;
+
+            while ((idx = next++) < w.count)
+            {
+                setupChunk (w, idx, encoder, first);
+                // shuffle the arrival order a little
+                std::this_thread::sleep_for (
+                    std::chrono::microseconds (((idx + t) * 37) % 200));
+                if (exr_encoding_run (w.f, 0, &encoder) != EXR_ERR_SUCCESS)
+                    ++failed;
+            }
+            if (!first) exr_encoding_destroy (w.f, &encoder);
+        });
+    }
+    for (auto& th: threads)
+        th.join ();
+    EXRCORE_TEST (failed == 0);
+}
+#endif
+
+std::vector<char>
+readFile (const std::string& fn)
+{
+    std::ifstream f (fn, std::ios::binary);
+    return std::vector<char> (
+        std::istreambuf_iterator<char> (f), std::istreambuf_iterator<char> ());
+}
+
+std::vector<int>
+inOrder (int count)
+{
+    std::vector<int> order;
+    for (int i = 0; i < count; ++i)
+        order.push_back (i);
+    return order;
+}
+
+std::set<void*> trackedAllocs;
+int             untrackedFrees = 0;
+
+void*
+trackedAlloc (size_t bytes)
+{
+    void* p = malloc (bytes);
+    if (p) trackedAllocs.insert (p);
+    return p;
+}
+
+void
+trackedFree (void* p)
+{
+    if (trackedAllocs.erase (p) == 0) ++untrackedFrees;
+    free (p);
+}
+
+} // namespace
+
+void
+testWriteReorderBuffer (const std::string& tempdir)
+{
+    TestImage         img;
+    std::string       reffn = tempdir + "reorder_ref.exr";
+    std::string       outfn = tempdir + "reorder_out.exr";
+    exr_compression_t comps[] = {
+        EXR_COMPRESSION_NONE, EXR_COMPRESSION_ZIP, EXR_COMPRESSION_PIZ};
+
+    for (int tiled = 0; tiled < 2; ++tiled)
+    {
+        for (exr_compression_t comp: comps)
+        {
+            ChunkWriter ref;
+            startWrite (ref, reffn, img, comp, tiled != 0, 0);
+            writeInOrder (ref, inOrder (ref.count));
+            EXRCORE_TEST_RVAL (exr_finish (&ref.f));
+            std::vector<char> expected = readFile (reffn);
+            EXRCORE_TEST (!expected.empty ());
+
+            // swapped pairs only ever need one chunk held back
+            ChunkWriter      swapped;
+            std::vector<int> order;
+            startWrite (swapped, outfn, img, comp, tiled != 0, 1);
+            for (int i = 0; i < swapped.count; i += 2)
+            {
+                if (i + 1 < swapped.count) order.push_back (i + 1);
+                order.push_back (i);
+            }
+            writeInOrder (swapped, order);
+            EXRCORE_TEST_RVAL (exr_finish (&swapped.f));
+            EXRCORE_TEST (readFile (outfn) == expected);
+
+#if ILMTHREAD_THREADING_ENABLED
+            for (int slots: {1, 3, 8})
+            {
+                ChunkWriter par;
+                startWrite (par, outfn, img, comp, tiled != 0, slots);
+                writeThreaded (par, 6);
+                EXRCORE_TEST_RVAL (exr_finish (&par.f));
+                EXRCORE_TEST (readFile (outfn) == expected);
+            }
+#endif
+        }
+    }
+    remove (reffn.c_str ());
+    remove (outfn.c_str ());
+}
+
+void
+testWriteReorderFailure (const std::string& tempdir)
+{
+    TestImage             img;
+    std::string           outfn   = tempdir + "reorder_fail.exr";
+    ChunkWriter           w;
+    exr_encode_pipeline_t encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+    bool                  first   = true;
+    exr_result_t          rv;
+
+    startWrite (w, outfn, img, EXR_COMPRESSION_NONE, false, 2);
+    EXRCORE_TEST (w.count > 4);
+
+    setupChunk (w, 0, encoder, first);
+    EXRCORE_TEST_RVAL (exr_encoding_run (w.f, 0, &encoder));
+    setupChunk (w, 2, encoder, first);
+    EXRCORE_TEST_RVAL (exr_encoding_run (w.f, 0, &encoder));
+
+    // chunk 1 fails before it gets to be written...
+    setupChunk (w, 1, encoder, first);
+    encoder.convert_and_pack_fn = NULL;
+    encoder.packed_buffer       = NULL;
+    rv = exr_encoding_run (w.f, 0, &encoder);
+    EXRCORE_TEST (rv != EXR_ERR_SUCCESS);
+
+    // ...so nothing queued behind it may wait for it
+    setupChunk (w, 3, encoder, first);
+    EXRCORE_TEST (exr_encoding_run (w.f, 0, &encoder) == rv);
+    EXRCORE_TEST_RVAL (exr_encoding_destroy (w.f, &encoder));
+    exr_finish (&w.f);
+
+#if ILMTHREAD_THREADING_ENABLED
+    // same with threads blocked on a full buffer when the failure comes
+    ChunkWriter              par;
+    std::atomic<int>         next{0};
+    std::atomic<int>         written{0};
+    std::atomic<int>         failed{0};
+    std::vector<std::thread> threads;
+
+    startWrite (par, outfn, img, EXR_COMPRESSION_NONE, false, 1);
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back ([&] () {
+            exr_encode_pipeline_t tenc   = EXR_ENCODE_PIPELINE_INITIALIZER;
+            bool                  tfirst = true;
+            int                   idx;
+
+            while ((idx = next++) < par.count)
+            {
+                setupChunk (par, idx, tenc, tfirst);
+                if (idx == 1)
+                {
+                    std::this_thread::sleep_for (
+                        std::chrono::milliseconds (50));
+                    tenc.convert_and_pack_fn = NULL;
+                    tenc.packed_buffer       = NULL;
+                }
+                if (exr_encoding_run (par.f, 0, &tenc) == EXR_ERR_SUCCESS)
+                    ++written;
+                else
+                    ++failed;
+            }
+            if (!tfirst) exr_encoding_destroy (par.f, &tenc);
+        });
+    }
+    for (auto& th: threads)
+        th.join ();
+    // chunk 0 and at most one held back behind the lost chunk
+    EXRCORE_TEST (written <= 2);
+    EXRCORE_TEST (failed == par.count - written);
+    exr_finish (&par.f);
+#endif
+    remove (outfn.c_str ());
+}
+
+void
+testWritePooledBuffers (const std::string& tempdir)
+{
+    // one line of 1024 floats is exactly the smallest pool size class
+    const int                 width = 1024;
+    std::string               outfn = tempdir + "pooled_buffers.exr";
+    std::vector<float>        line (width, 0.5f);
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    exr_context_t             f;
+    exr_buffer_pool_t         pool;
+    exr_encode_pipeline_t     encoder;
+    exr_chunk_info_t          cinfo;
+    uint64_t                  cached;
+    int                       partidx;
+
+    cinit.alloc_fn = &trackedAlloc;
+    cinit.free_fn  = &trackedFree;
+    EXRCORE_TEST_RVAL (exr_buffer_pool_create (&pool, 0));
+    EXRCORE_TEST_RVAL (
+        exr_start_write (&f, outfn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (exr_set_buffer_pool (f, pool));
+    EXRCORE_TEST_RVAL (
+        exr_add_part (f, "beauty", EXR_STORAGE_SCANLINE, &partidx));
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        f, partidx, width, 2, EXR_COMPRESSION_NONE));
+    EXRCORE_TEST_RVAL (exr_add_channel (
+        f, partidx, "Y", EXR_PIXEL_FLOAT, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1));
+    EXRCORE_TEST_RVAL (exr_write_header (f));
+
+    for (int y = 0; y < 2; ++y)
+    {
+        encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+        EXRCORE_TEST_RVAL (exr_write_scanline_chunk_info (f, 0, y, &cinfo));
+        EXRCORE_TEST_RVAL (exr_encoding_initialize (f, 0, &cinfo, &encoder));
+        encoder.channels[0].encode_from_ptr =
+            reinterpret_cast<const uint8_t*> (line.data ());
+        encoder.channels[0].user_pixel_stride      = sizeof (float);
+        encoder.channels[0].user_line_stride       = width * sizeof (float);
+        encoder.channels[0].user_bytes_per_element = sizeof (float);
+        encoder.channels[0].user_data_type         = EXR_PIXEL_FLOAT;
+        // the first chunk brings its own buffer, from the context
+        // allocator, which happens to be a pool size
+        if (y == 0)
+        {
+            encoder.packed_alloc_size = width * sizeof (float);
+            encoder.packed_buffer     = trackedAlloc (encoder.packed_alloc_size);
+        }
+        EXRCORE_TEST_RVAL (exr_encoding_choose_default_routines (f, 0, &encoder));
+        EXRCORE_TEST_RVAL (exr_encoding_run (f, 0, &encoder));
+        EXRCORE_TEST_RVAL (exr_encoding_destroy (f, &encoder));
+
+        // ...so only the buffer of the second chunk goes to the pool
+        EXRCORE_TEST_RVAL (exr_buffer_pool_get_cached_bytes (pool, &cached));
+        EXRCORE_TEST (cached == (y == 0 ? 0 : width * sizeof (float)));
+        EXRCORE_TEST (untrackedFrees == 0);
+    }
+
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+    EXRCORE_TEST_RVAL (exr_buffer_pool_destroy (&pool));
+    EXRCORE_TEST (trackedAllocs.empty ());
+    EXRCORE_TEST (untrackedFrees == 0);
+    remove (outfn.c_str ());
+}
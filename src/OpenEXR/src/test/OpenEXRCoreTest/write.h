@@ -0,0 +1,15 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_CORE_TEST_WRITE_H
+#define OPENEXR_CORE_TEST_WRITE_H
+
+#include <string>
+
+void testWriteReorderBuffer (const std::string& tempdir);
+void testWriteReorderFailure (const std::string& tempdir);
+void testWritePooledBuffers (const std::string& tempdir);
+
+#endif // OPENEXR_CORE_TEST_WRITE_H
@@ -3,6 +3,7 @@
 #include <R.h>
 #include <R_ext/Rdynload.h>
 #include <Rinternals.h>
+#include <R_ext/Altrep.h>
 
 #include <ImathBox.h>
 #include <ImfArray.h>
@@ -12,14 +13,41 @@
 #include <ImfCompression.h>
 #include <ImfFrameBuffer.h>
 #include <ImfHeader.h>
-#include <ImfInputFile.h>
 #include <ImfOutputFile.h>
 #include <ImfStandardAttributes.h>
+#include <ImfThreading.h>
+#include <IlmThreadPool.h>
+#include <half.h>
+#include <openexr.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <cstring>
+#include <list>
 #include <cstdlib>
 #include <cmath>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define LIBOPENEXR_BIG_ENDIAN 1
+#endif
+
+#if !defined(LIBOPENEXR_BIG_ENDIAN) && defined(__x86_64__) &&                  \
+    (defined(__GNUC__) || defined(__clang__))
+#define LIBOPENEXR_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if !defined(LIBOPENEXR_BIG_ENDIAN) && defined(__aarch64__) &&                 \
+    defined(__ARM_NEON)
+#define LIBOPENEXR_NEON_SIMD 1
+#include <arm_neon.h>
+#endif
+
 using namespace OPENEXR_IMF_NAMESPACE;
 using namespace IMATH_NAMESPACE;
 
@@ -107,11 +135,11 @@ void set_adopted_neutral_metadata(SEXP metadata, int index, const V2f &value) {
   UNPROTECT(2);
 }
 
-const char *envmap_name(Envmap value) {
+const char *envmap_name(exr_envmap_t value) {
   switch (value) {
-  case ENVMAP_LATLONG:
+  case EXR_ENVMAP_LATLONG:
     return "latlong";
-  case ENVMAP_CUBE:
+  case EXR_ENVMAP_CUBE:
     return "cube";
   default:
     return "unknown";
@@ -119,37 +147,60 @@ const char *envmap_name(Envmap value) {
 }
 
 // Returns one protected object; caller must UNPROTECT it.
-SEXP build_metadata_list(const Header &header) {
+SEXP build_metadata_list(exr_const_context_t ctxt, int part) {
+  // Attributes that are missing or stored with an unexpected type are
+  // skipped, as the Imf has*() helpers do.
+  exr_attr_chromaticities_t chroma;
+  exr_attr_v2f_t neutral;
+  float luminance = 0.0f;
+  exr_envmap_t envmap = EXR_ENVMAP_LATLONG;
+  const bool has_chromaticities =
+      exr_attr_get_chromaticities(ctxt, part, "chromaticities", &chroma) ==
+      EXR_ERR_SUCCESS;
+  const bool has_adopted_neutral =
+      exr_attr_get_v2f(ctxt, part, "adoptedNeutral", &neutral) ==
+      EXR_ERR_SUCCESS;
+  const bool has_white_luminance =
+      exr_attr_get_float(ctxt, part, "whiteLuminance", &luminance) ==
+      EXR_ERR_SUCCESS;
+  const bool has_envmap =
+      exr_attr_get_envmap(ctxt, part, "envmap", &envmap) == EXR_ERR_SUCCESS;
+
   int metadata_count = 0;
-  metadata_count += hasChromaticities(header) ? 1 : 0;
-  metadata_count += hasAdoptedNeutral(header) ? 1 : 0;
-  metadata_count += hasWhiteLuminance(header) ? 1 : 0;
-  metadata_count += hasEnvmap(header) ? 1 : 0;
+  metadata_count += has_chromaticities ? 1 : 0;
+  metadata_count += has_adopted_neutral ? 1 : 0;
+  metadata_count += has_white_luminance ? 1 : 0;
+  metadata_count += has_envmap ? 1 : 0;
 
   SEXP metadata = PROTECT(Rf_allocVector(VECSXP, metadata_count));
   SEXP names = PROTECT(Rf_allocVector(STRSXP, metadata_count));
 
   int index = 0;
-  if (hasChromaticities(header)) {
+  if (has_chromaticities) {
     SET_STRING_ELT(names, index, Rf_mkChar("chromaticities"));
-    set_chromaticities_metadata(metadata, index, chromaticities(header));
+    set_chromaticities_metadata(
+        metadata, index,
+        Chromaticities(V2f(chroma.red_x, chroma.red_y),
+                       V2f(chroma.green_x, chroma.green_y),
+                       V2f(chroma.blue_x, chroma.blue_y),
+                       V2f(chroma.white_x, chroma.white_y)));
     ++index;
   }
-  if (hasAdoptedNeutral(header)) {
+  if (has_adopted_neutral) {
     SET_STRING_ELT(names, index, Rf_mkChar("adoptedNeutral"));
-    set_adopted_neutral_metadata(metadata, index, adoptedNeutral(header));
+    set_adopted_neutral_metadata(metadata, index, V2f(neutral.x, neutral.y));
     ++index;
   }
-  if (hasWhiteLuminance(header)) {
+  if (has_white_luminance) {
     SET_STRING_ELT(names, index, Rf_mkChar("whiteLuminance"));
-    SEXP value = PROTECT(Rf_ScalarReal(whiteLuminance(header)));
+    SEXP value = PROTECT(Rf_ScalarReal(luminance));
     SET_VECTOR_ELT(metadata, index, value);
     UNPROTECT(1);
     ++index;
   }
-  if (hasEnvmap(header)) {
+  if (has_envmap) {
     SET_STRING_ELT(names, index, Rf_mkChar("envmap"));
-    SEXP value = PROTECT(Rf_mkString(envmap_name(envmap(header))));
+    SEXP value = PROTECT(Rf_mkString(envmap_name(envmap)));
     SET_VECTOR_ELT(metadata, index, value);
     UNPROTECT(1);
   }
@@ -206,73 +257,1300 @@ void add_metadata_to_header(Header &header, SEXP metadata) {
   }
 }
 
+// The context flags for the `mmap` argument of the pixel readers.
+int read_flags_from_sexp(SEXP mmap_SEXP) {
+  check_bool(TYPEOF(mmap_SEXP) == LGLSXP && Rf_xlength(mmap_SEXP) == 1 &&
+                 LOGICAL(mmap_SEXP)[0] != NA_LOGICAL,
+             "`mmap` must be TRUE or FALSE");
+  return LOGICAL(mmap_SEXP)[0] ? EXR_CONTEXT_FLAG_MEMORY_MAP_FILE : 0;
+}
+
+// Grow the Imf global worker pool so a file opened with `threads` workers
+// can keep them all busy. The pool is never shrunk here: other open files
+// (or other packages linking OpenEXR) may already rely on its size.
+int prepare_thread_pool(SEXP threads_SEXP) {
+  check_bool(TYPEOF(threads_SEXP) == INTSXP && Rf_xlength(threads_SEXP) == 1 &&
+                 INTEGER(threads_SEXP)[0] != NA_INTEGER &&
+                 INTEGER(threads_SEXP)[0] >= 1,
+             "`threads` must be a positive integer scalar");
+
+  const int threads = INTEGER(threads_SEXP)[0];
+  if (threads > 1 && globalThreadCount() < threads)
+    setGlobalThreadCount(threads);
+  return threads;
+}
+
+// ---------------------------------------------------------------------
+// pixel conversion kernels
+//
+// EXR sample data is little-endian. The SIMD paths below are taken on
+// little-endian x86-64 (SSE2 is baseline, F16C is detected at runtime) and
+// AArch64 (NEON is baseline); everything else uses the scalar loops.
+
+inline uint16_t load_le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t load_le32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+inline float load_le_float(const uint8_t *p) {
+  const uint32_t bits = load_le32(p);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+#ifdef LIBOPENEXR_X86_SIMD
+bool cpu_has_f16c() {
+  static const bool has_f16c =
+      __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return has_f16c;
+}
+
+__attribute__((target("avx,f16c"))) int widen_half_f16c(const uint8_t *src,
+                                                          int n, double *out) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 f = _mm256_cvtph_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i)));
+    _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm256_castps256_ps128(f)));
+    _mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)));
+  }
+  return i;
+}
+#endif
+
+void widen_half(const uint8_t *src, int n, double *out) {
+  int i = 0;
+#if defined(LIBOPENEXR_X86_SIMD)
+  if (cpu_has_f16c())
+    i = widen_half_f16c(src, n, out);
+#elif defined(LIBOPENEXR_NEON_SIMD)
+  for (; i + 4 <= n; i += 4) {
+    const float32x4_t f =
+        vcvt_f32_f16(vreinterpret_f16_u8(vld1_u8(src + 2 * i)));
+    vst1q_f64(out + i, vcvt_f64_f32(vget_low_f32(f)));
+    vst1q_f64(out + i + 2, vcvt_high_f64_f32(f));
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = imath_half_to_float(load_le16(src + 2 * i));
+}
+
+void widen_float(const uint8_t *src, int n, double *out) {
+  int i = 0;
+#if defined(LIBOPENEXR_X86_SIMD)
+  for (; i + 4 <= n; i += 4) {
+    const __m128 f = _mm_loadu_ps(reinterpret_cast<const float *>(src + 4 * i));
+    _mm_storeu_pd(out + i, _mm_cvtps_pd(f));
+    _mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+  }
+#elif defined(LIBOPENEXR_NEON_SIMD)
+  for (; i + 4 <= n; i += 4) {
+    const float32x4_t f = vreinterpretq_f32_u8(vld1q_u8(src + 4 * i));
+    vst1q_f64(out + i, vcvt_f64_f32(vget_low_f32(f)));
+    vst1q_f64(out + i + 2, vcvt_high_f64_f32(f));
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = load_le_float(src + 4 * i);
+}
+
+// Widen `n` consecutive little-endian samples of an EXR pixel type.
+void widen_samples(const uint8_t *src, uint16_t type, int n, double *out) {
+  switch (type) {
+  case EXR_PIXEL_HALF:
+    widen_half(src, n, out);
+    break;
+  case EXR_PIXEL_FLOAT:
+    widen_float(src, n, out);
+    break;
+  default:
+    for (int i = 0; i < n; ++i)
+      out[i] = load_le32(src + 4 * i);
+    break;
+  }
+}
+
+// Widen a `width` x `lines` block of row-major samples (rows `src_stride`
+// bytes apart) into a column-major double matrix with leading dimension
+// `dst_stride`. The block is walked in square tiles small enough to stay in
+// L1, so both the reads and the column writes are contiguous runs.
+constexpr int kTransposeTile = 32;
+
+void transpose_to_double(const uint8_t *src, size_t src_stride, uint16_t type,
+                         int width, int lines, double *dst,
+                         R_xlen_t dst_stride) {
+  const int bytes = type == EXR_PIXEL_HALF ? 2 : 4;
+  double tile[kTransposeTile][kTransposeTile];
+
+  for (int ty = 0; ty < lines; ty += kTransposeTile) {
+    const int nl = std::min(kTransposeTile, lines - ty);
+    for (int tx = 0; tx < width; tx += kTransposeTile) {
+      const int nx = std::min(kTransposeTile, width - tx);
+      for (int j = 0; j < nl; ++j)
+        widen_samples(src + (size_t)(ty + j) * src_stride + (size_t)tx * bytes,
+                      type, nx, tile[j]);
+      for (int i = 0; i < nx; ++i) {
+        double *column = dst + (R_xlen_t)(tx + i) * dst_stride + ty;
+        for (int j = 0; j < nl; ++j)
+          column[j] = tile[j][i];
+      }
+    }
+  }
+}
+
+// Narrow `n` doubles to float. Non-finite values (NaN, NA, +/-Inf) become 0,
+// which is how write_exr() has always treated them.
+#ifdef LIBOPENEXR_X86_SIMD
+bool cpu_has_avx() {
+  static const bool has_avx = __builtin_cpu_supports("avx");
+  return has_avx;
+}
+
+__attribute__((target("avx"))) int narrow_finite_avx(const double *src, int n,
+                                                     float *out) {
+  // x - x is 0 for finite x and NaN otherwise, so the compare is a finite mask
+  const __m256d zero = _mm256_setzero_pd();
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256d v = _mm256_loadu_pd(src + i);
+    const __m256d finite = _mm256_cmp_pd(_mm256_sub_pd(v, v), zero, _CMP_EQ_OQ);
+    _mm_storeu_ps(out + i, _mm256_cvtpd_ps(_mm256_and_pd(v, finite)));
+  }
+  return i;
+}
+#endif
+
+void narrow_finite(const double *src, int n, float *out) {
+  int i = 0;
+#if defined(LIBOPENEXR_X86_SIMD)
+  if (cpu_has_avx()) {
+    i = narrow_finite_avx(src, n, out);
+  } else {
+    const __m128d zero = _mm_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+      const __m128d lo = _mm_loadu_pd(src + i);
+      const __m128d hi = _mm_loadu_pd(src + i + 2);
+      const __m128 flo = _mm_cvtpd_ps(
+          _mm_and_pd(lo, _mm_cmpeq_pd(_mm_sub_pd(lo, lo), zero)));
+      const __m128 fhi = _mm_cvtpd_ps(
+          _mm_and_pd(hi, _mm_cmpeq_pd(_mm_sub_pd(hi, hi), zero)));
+      _mm_storeu_ps(out + i, _mm_movelh_ps(flo, fhi));
+    }
+  }
+#elif defined(LIBOPENEXR_NEON_SIMD)
+  for (; i + 4 <= n; i += 4) {
+    const float64x2_t lo = vld1q_f64(src + i);
+    const float64x2_t hi = vld1q_f64(src + i + 2);
+    const uint64x2_t flo = vceqq_f64(vsubq_f64(lo, lo), vdupq_n_f64(0.0));
+    const uint64x2_t fhi = vceqq_f64(vsubq_f64(hi, hi), vdupq_n_f64(0.0));
+    const float32x2_t nlo = vcvt_f32_f64(
+        vreinterpretq_f64_u64(vandq_u64(vreinterpretq_u64_f64(lo), flo)));
+    const float32x4_t n4 = vcvt_high_f32_f64(
+        nlo, vreinterpretq_f64_u64(vandq_u64(vreinterpretq_u64_f64(hi), fhi)));
+    vst1q_f32(out + i, n4);
+  }
+#endif
+  for (; i < n; ++i)
+    out[i] = std::isfinite(src[i]) ? static_cast<float>(src[i]) : 0.0f;
+}
+
+// The inverse of transpose_to_double: narrow a `width` x `lines` block of a
+// column-major double matrix (leading dimension `src_stride`) into row-major
+// floats with `dst_stride` floats per row.
+void transpose_to_float(const double *src, R_xlen_t src_stride, int width,
+                        int lines, float *dst, size_t dst_stride) {
+  float tile[kTransposeTile][kTransposeTile];
+
+  for (int tx = 0; tx < width; tx += kTransposeTile) {
+    const int nx = std::min(kTransposeTile, width - tx);
+    for (int ty = 0; ty < lines; ty += kTransposeTile) {
+      const int nl = std::min(kTransposeTile, lines - ty);
+      for (int i = 0; i < nx; ++i)
+        narrow_finite(src + (R_xlen_t)(tx + i) * src_stride + ty, nl, tile[i]);
+      for (int j = 0; j < nl; ++j) {
+        float *row = dst + (size_t)(ty + j) * dst_stride + tx;
+        for (int i = 0; i < nx; ++i)
+          row[i] = tile[i][j];
+      }
+    }
+  }
+}
+
+// Round floats to half with round-to-nearest-even, matching Imath's half.
+#ifdef LIBOPENEXR_X86_SIMD
+__attribute__((target("avx,f16c"))) size_t narrow_half_f16c(const float *src,
+                                                             size_t n,
+                                                             uint16_t *out) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m128i h =
+        _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), h);
+  }
+  return i;
+}
+#endif
+
+void narrow_half(const float *src, size_t n, uint16_t *out) {
+  size_t i = 0;
+#if defined(LIBOPENEXR_X86_SIMD)
+  if (cpu_has_f16c())
+    i = narrow_half_f16c(src, n, out);
+#elif defined(LIBOPENEXR_NEON_SIMD)
+  for (; i + 4 <= n; i += 4)
+    vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+#endif
+  for (; i < n; ++i)
+    out[i] = imath_float_to_half(src[i]);
+}
+
+// ---------------------------------------------------------------------
+// OpenEXRCore read path
+//
+// Pixels are decoded with OpenEXRCore. A custom unpack_and_convert_fn
+// writes every decoded chunk straight into the column-major double
+// matrices handed back to R, so no full-image float buffers are needed.
+
+// OpenEXRCore reports errors on the thread that hit them, so the last
+// message is kept per thread and attached to the exception thrown there.
+thread_local std::string core_error_message;
+
+void record_core_error(exr_const_context_t, exr_result_t, const char *msg) {
+  core_error_message = msg ? msg : "";
+}
+
+[[noreturn]] void throw_core_error(exr_result_t rv, const char *what) {
+  std::string message(what);
+  message += ": ";
+  message += core_error_message.empty() ? exr_get_default_error_message(rv)
+                                        : core_error_message;
+  core_error_message.clear();
+  throw std::runtime_error(message);
+}
+
+inline void check_core(exr_result_t rv, const char *what) {
+  if (rv != EXR_ERR_SUCCESS)
+    throw_core_error(rv, what);
+}
+
+// Owns an OpenEXRCore context and finishes it when going out of scope.
+class CoreContext {
+public:
+  CoreContext() = default;
+  ~CoreContext() {
+    if (ctxt_)
+      exr_finish(&ctxt_);
+  }
+  CoreContext(const CoreContext &) = delete;
+  CoreContext &operator=(const CoreContext &) = delete;
+
+  exr_context_t *out() { return &ctxt_; }
+  exr_context_t get() const { return ctxt_; }
+
+private:
+  exr_context_t ctxt_ = nullptr;
+};
+
+exr_context_initializer_t core_initializer() {
+  exr_context_initializer_t init = EXR_DEFAULT_CONTEXT_INITIALIZER;
+  init.error_handler_fn = &record_core_error;
+  return init;
+}
+
+// `flags` are OpenEXRCore context flags. read_exr(mmap = TRUE) and
+// read_exr_sequence(mmap = TRUE) map the file
+// (EXR_CONTEXT_FLAG_MEMORY_MAP_FILE) so chunks are decoded straight from the
+// page cache. That is opt-in: a mapped file that is truncated or replaced
+// while it is read raises SIGBUS, which takes down the R session, where a
+// plain read fails with an error. Lazy reads always use plain reads.
+void open_core_file(CoreContext &ctxt, const char *path, int flags = 0) {
+  exr_context_initializer_t init = core_initializer();
+  init.flags |= flags;
+  check_core(exr_start_read(ctxt.out(), path, &init), "Unable to open file");
+}
+
+// Read an EXR file held in memory, such as the contents of an R raw vector.
+// Chunks are decoded straight out of `data`, which must stay alive and
+// unchanged until the context is finished.
+void open_core_memory(CoreContext &ctxt, const void *data, uint64_t size) {
+  exr_context_initializer_t init = core_initializer();
+  check_core(exr_start_read_memory(ctxt.out(), "<raw vector>", data, size,
+                                   &init),
+             "Unable to open raw vector");
+}
+
+// Where the decoded channels of one part go. `outputs` is indexed like the
+// part's channel list; channels with a null output are decoded but not
+// copied. Every output is a column-major matrix with `rows` rows covering
+// the inclusive pixel box `window`.
+struct CoreDecodeTarget {
+  exr_const_context_t ctxt = nullptr;
+  int part = 0;
+  exr_storage_t storage = EXR_STORAGE_SCANLINE;
+  exr_attr_box2i_t data_window{};
+  exr_attr_box2i_t window{};
+  int32_t lines_per_chunk = 1;
+  int32_t tile_width = 0;
+  int32_t tile_height = 0;
+  const exr_attr_chlist_t *channels = nullptr;
+  R_xlen_t rows = 0;
+  std::vector<double *> outputs;
+};
+
+CoreDecodeTarget describe_part(exr_const_context_t ctxt, int part) {
+  CoreDecodeTarget target;
+  target.ctxt = ctxt;
+  target.part = part;
+  check_core(exr_get_storage(ctxt, part, &target.storage),
+             "Unable to query storage type");
+  if (target.storage != EXR_STORAGE_SCANLINE &&
+      target.storage != EXR_STORAGE_TILED)
+    throw std::runtime_error("Deep EXR images are not supported");
+
+  check_core(exr_get_data_window(ctxt, part, &target.data_window),
+             "Unable to query data window");
+  check_core(exr_get_channels(ctxt, part, &target.channels),
+             "Unable to query channel list");
+  if (target.storage == EXR_STORAGE_SCANLINE) {
+    check_core(exr_get_scanlines_per_chunk(ctxt, part, &target.lines_per_chunk),
+               "Unable to query scanlines per chunk");
+  } else {
+    check_core(exr_get_tile_sizes(ctxt, part, 0, 0, &target.tile_width,
+                                  &target.tile_height),
+               "Unable to query tile size");
+  }
+
+  target.window = target.data_window;
+  target.rows = (R_xlen_t)target.window.max.y - target.window.min.y + 1;
+  target.outputs.assign(target.channels->num_channels, nullptr);
+  return target;
+}
+
+// Parse `window`, an integer vector c(xmin, ymin, xmax, ymax) of inclusive
+// pixel coordinates, on the R thread. Returns false for NULL.
+bool window_from_sexp(SEXP window_SEXP, exr_attr_box2i_t *window) {
+  if (Rf_isNull(window_SEXP))
+    return false;
+  check_bool(TYPEOF(window_SEXP) == INTSXP && Rf_xlength(window_SEXP) == 4,
+             "`window` must be an integer vector of length 4");
+  const int *win = INTEGER(window_SEXP);
+  window->min.x = win[0];
+  window->min.y = win[1];
+  window->max.x = win[2];
+  window->max.y = win[3];
+  return true;
+}
+
+// Restrict decoding to `window`, which must lie inside the data window.
+void set_target_window(CoreDecodeTarget &target,
+                       const exr_attr_box2i_t &window) {
+  const exr_attr_box2i_t &dw = target.data_window;
+  if (window.min.x > window.max.x || window.min.y > window.max.y ||
+      window.min.x < dw.min.x || window.min.y < dw.min.y ||
+      window.max.x > dw.max.x || window.max.y > dw.max.y) {
+    throw std::runtime_error(
+        "`window` must be a non-empty box inside the data window c(" +
+        std::to_string(dw.min.x) + ", " + std::to_string(dw.min.y) + ", " +
+        std::to_string(dw.max.x) + ", " + std::to_string(dw.max.y) + ")");
+  }
+
+  target.window = window;
+  target.rows = (R_xlen_t)window.max.y - window.min.y + 1;
+}
+
+int find_channel(const CoreDecodeTarget &target, const char *name) {
+  for (int c = 0; c < target.channels->num_channels; ++c) {
+    if (std::strcmp(target.channels->entries[c].name.str, name) == 0)
+      return c;
+  }
+  return -1;
+}
+
+// A chunk to decode: the first scanline (scanline parts) or the level 0
+// tile indices (tiled parts).
+struct ChunkRef {
+  int x;
+  int y;
+};
+
+std::vector<ChunkRef> chunks_in_window(const CoreDecodeTarget &target) {
+  const exr_attr_box2i_t &dw = target.data_window;
+  const exr_attr_box2i_t &win = target.window;
+  std::vector<ChunkRef> chunks;
+
+  if (target.storage == EXR_STORAGE_SCANLINE) {
+    const int64_t lpc = target.lines_per_chunk;
+    const int64_t first = ((int64_t)win.min.y - dw.min.y) / lpc;
+    const int64_t last = ((int64_t)win.max.y - dw.min.y) / lpc;
+    chunks.reserve((size_t)(last - first + 1));
+    for (int64_t c = first; c <= last; ++c)
+      chunks.push_back({0, (int)(dw.min.y + c * lpc)});
+  } else {
+    const int64_t tx0 = ((int64_t)win.min.x - dw.min.x) / target.tile_width;
+    const int64_t tx1 = ((int64_t)win.max.x - dw.min.x) / target.tile_width;
+    const int64_t ty0 = ((int64_t)win.min.y - dw.min.y) / target.tile_height;
+    const int64_t ty1 = ((int64_t)win.max.y - dw.min.y) / target.tile_height;
+    chunks.reserve((size_t)((tx1 - tx0 + 1) * (ty1 - ty0 + 1)));
+    for (int64_t ty = ty0; ty <= ty1; ++ty)
+      for (int64_t tx = tx0; tx <= tx1; ++tx)
+        chunks.push_back({(int)tx, (int)ty});
+  }
+  return chunks;
+}
+
+inline int floor_div(int64_t a, int64_t b) {
+  return (int)(a >= 0 ? a / b : -((-a + b - 1) / b));
+}
+
+// Fallback for parts with x/y subsampled channels: every stored sample is
+// replicated over the pixels it covers.
+exr_result_t unpack_sampled_to_r(exr_decode_pipeline_t *decode,
+                                 const CoreDecodeTarget &target, int x0,
+                                 int y0) {
+  const exr_attr_box2i_t &win = target.window;
+  const uint8_t *src = static_cast<const uint8_t *>(decode->unpacked_buffer);
+  const uint8_t *end = src + decode->chunk.unpacked_size;
+  std::vector<double> line;
+
+  for (int iy = 0; iy < decode->chunk.height; ++iy) {
+    const int y = y0 + iy;
+    for (int c = 0; c < decode->channel_count; ++c) {
+      const exr_coding_channel_info_t &ch = decode->channels[c];
+      if (y % ch.y_samples != 0)
+        continue;
+
+      const size_t line_bytes = (size_t)ch.width * ch.bytes_per_element;
+      if ((size_t)(end - src) < line_bytes)
+        return EXR_ERR_CORRUPT_CHUNK;
+
+      double *out = target.outputs[c];
+      if (out && ch.width > 0) {
+        line.resize(ch.width);
+        widen_samples(src, ch.data_type, ch.width, line.data());
+        const int first_x =
+            floor_div((int64_t)x0 + ch.x_samples - 1, ch.x_samples) *
+            ch.x_samples;
+        for (int k = 0; k < ch.width; ++k) {
+          const int px0 = std::max(first_x + k * ch.x_samples, win.min.x);
+          const int px1 =
+              std::min(first_x + (k + 1) * ch.x_samples - 1, win.max.x);
+          const int py0 = std::max(y, win.min.y);
+          const int py1 = std::min(y + ch.y_samples - 1, win.max.y);
+          for (int px = px0; px <= px1; ++px)
+            for (int py = py0; py <= py1; ++py)
+              out[(R_xlen_t)(px - win.min.x) * target.rows + (py - win.min.y)] =
+                  line[k];
+        }
+      }
+      src += line_bytes;
+    }
+  }
+  return EXR_ERR_SUCCESS;
+}
+
+// unpack_and_convert_fn for the decode pipeline: copy the part of the
+// decompressed chunk that falls in the target window into the R matrices.
+exr_result_t unpack_to_r(exr_decode_pipeline_t *decode) {
+  const CoreDecodeTarget &target =
+      *static_cast<const CoreDecodeTarget *>(decode->decoding_user_data);
+  const exr_chunk_info_t &chunk = decode->chunk;
+  const exr_attr_box2i_t &win = target.window;
+
+  int x0 = chunk.start_x;
+  int y0 = chunk.start_y;
+  if (target.storage == EXR_STORAGE_TILED) {
+    x0 = target.data_window.min.x + chunk.start_x * target.tile_width;
+    y0 = target.data_window.min.y + chunk.start_y * target.tile_height;
+  }
+
+  bool sampled = false;
+  size_t line_bytes = 0;
+  for (int c = 0; c < decode->channel_count; ++c) {
+    const exr_coding_channel_info_t &ch = decode->channels[c];
+    sampled = sampled || ch.x_samples != 1 || ch.y_samples != 1;
+    line_bytes += (size_t)ch.width * ch.bytes_per_element;
+  }
+  if (sampled)
+    return unpack_sampled_to_r(decode, target, x0, y0);
+  if (line_bytes * (size_t)chunk.height > chunk.unpacked_size)
+    return EXR_ERR_CORRUPT_CHUNK;
+
+  const int cx0 = std::max(x0, win.min.x);
+  const int cx1 = std::min(x0 + chunk.width - 1, win.max.x);
+  const int cy0 = std::max(y0, win.min.y);
+  const int cy1 = std::min(y0 + chunk.height - 1, win.max.y);
+  if (cx0 > cx1 || cy0 > cy1)
+    return EXR_ERR_SUCCESS;
+
+  const uint8_t *src = static_cast<const uint8_t *>(decode->unpacked_buffer) +
+                       (size_t)(cy0 - y0) * line_bytes;
+  size_t channel_offset = 0;
+  for (int c = 0; c < decode->channel_count; ++c) {
+    const exr_coding_channel_info_t &ch = decode->channels[c];
+    double *out = target.outputs[c];
+    if (out) {
+      transpose_to_double(
+          src + channel_offset + (size_t)(cx0 - x0) * ch.bytes_per_element,
+          line_bytes, ch.data_type, cx1 - cx0 + 1, cy1 - cy0 + 1,
+          out + (R_xlen_t)(cx0 - win.min.x) * target.rows + (cy0 - win.min.y),
+          target.rows);
+    }
+    channel_offset += (size_t)ch.width * ch.bytes_per_element;
+  }
+  return EXR_ERR_SUCCESS;
+}
+
+// Decode a run of chunks with one pipeline so its buffers are reused.
+void decode_chunk_range(const CoreDecodeTarget &target, const ChunkRef *begin,
+                        const ChunkRef *end) {
+  exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+  struct PipelineGuard {
+    exr_const_context_t ctxt;
+    exr_decode_pipeline_t *decoder;
+    ~PipelineGuard() { exr_decoding_destroy(ctxt, decoder); }
+  } guard{target.ctxt, &decoder};
+
+  bool first = true;
+  for (const ChunkRef *ref = begin; ref != end; ++ref) {
+    exr_chunk_info_t cinfo;
+    if (target.storage == EXR_STORAGE_SCANLINE) {
+      check_core(
+          exr_read_scanline_chunk_info(target.ctxt, target.part, ref->y, &cinfo),
+          "Unable to query scanline chunk");
+    } else {
+      check_core(exr_read_tile_chunk_info(target.ctxt, target.part, ref->x,
+                                          ref->y, 0, 0, &cinfo),
+                 "Unable to query tile chunk");
+    }
+
+    if (first) {
+      check_core(
+          exr_decoding_initialize(target.ctxt, target.part, &cinfo, &decoder),
+          "Unable to initialize decode pipeline");
+      // No channel has a decode_to_ptr, so the default routines only pick
+      // the read and decompress steps; unpacking is replaced below.
+      check_core(exr_decoding_choose_default_routines(target.ctxt, target.part,
+                                                      &decoder),
+                 "Unable to choose decode routines");
+      decoder.decoding_user_data = const_cast<CoreDecodeTarget *>(&target);
+      decoder.unpack_and_convert_fn = &unpack_to_r;
+      first = false;
+    } else {
+      check_core(
+          exr_decoding_update(target.ctxt, target.part, &cinfo, &decoder),
+          "Unable to update decode pipeline");
+    }
+
+    check_core(exr_decoding_run(target.ctxt, target.part, &decoder),
+               "Unable to decode pixel data");
+  }
+}
+
+// First failure reported by any of the tasks sharing it.
+class TaskFailure {
+public:
+  void record(const std::string &message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (message_.empty())
+      message_ = message;
+  }
+
+  void rethrow() const {
+    if (!message_.empty())
+      throw std::runtime_error(message_);
+  }
+
+private:
+  std::mutex mutex_;
+  std::string message_;
+};
+
+// Prefix an error message with the file it came from, if known.
+std::string labelled_error(const char *label, const char *message) {
+  return label ? std::string(label) + ": " + message : std::string(message);
+}
+
+class DecodeChunksTask final : public ILMTHREAD_NAMESPACE::Task {
+public:
+  DecodeChunksTask(ILMTHREAD_NAMESPACE::TaskGroup *group,
+                   const CoreDecodeTarget *target, const ChunkRef *begin,
+                   const ChunkRef *end, TaskFailure *failure,
+                   const char *label)
+      : Task(group), target_(target), begin_(begin), end_(end),
+        failure_(failure), label_(label) {}
+
+  void execute() override {
+    try {
+      decode_chunk_range(*target_, begin_, end_);
+    } catch (const std::exception &e) {
+      failure_->record(labelled_error(label_, e.what()));
+    } catch (...) {
+      failure_->record(labelled_error(label_, "Unknown decode failure"));
+    }
+  }
+
+private:
+  const CoreDecodeTarget *target_;
+  const ChunkRef *begin_;
+  const ChunkRef *end_;
+  TaskFailure *failure_;
+  const char *label_;
+};
+
+// Queue `chunks` on the global pool as `tasks` contiguous ranges.
+void add_decode_tasks(ILMTHREAD_NAMESPACE::TaskGroup *group,
+                      const CoreDecodeTarget &target,
+                      const std::vector<ChunkRef> &chunks, size_t tasks,
+                      TaskFailure *failure, const char *label = nullptr) {
+  tasks = std::max<size_t>(1, std::min(tasks, chunks.size()));
+  for (size_t i = 0; i < tasks; ++i) {
+    const size_t begin = chunks.size() * i / tasks;
+    const size_t end = chunks.size() * (i + 1) / tasks;
+    if (begin == end)
+      continue;
+    ILMTHREAD_NAMESPACE::ThreadPool::addGlobalTask(
+        new DecodeChunksTask(group, &target, chunks.data() + begin,
+                             chunks.data() + end, failure, label));
+  }
+}
+
+// Decode `chunks` into the target, spreading them over `threads` workers of
+// the IlmThread global pool. Each chunk writes a disjoint set of output
+// elements, so the result does not depend on the thread count.
+void decode_chunks(const CoreDecodeTarget &target,
+                   const std::vector<ChunkRef> &chunks, int threads) {
+  // A few tasks per thread keep the workers balanced when chunk costs vary.
+  const size_t tasks = std::min(chunks.size(), (size_t)threads * 4);
+  if (threads <= 1 || tasks <= 1) {
+    decode_chunk_range(target, chunks.data(), chunks.data() + chunks.size());
+    return;
+  }
+
+  TaskFailure failure;
+  {
+    ILMTHREAD_NAMESPACE::TaskGroup group;
+    add_decode_tasks(&group, target, chunks, tasks, &failure);
+  }
+  failure.rethrow();
+}
+
 // ---------------------------------------------------------------------
-// .Call("C_read_exr", "path/to/file.exr")
+// .Call("C_read_exr", "path/to/file.exr", threads, channels, window, mmap)
+// .Call("C_read_exr_raw", raw, threads, channels, window)
+
+// Without `channels`, R/G/B/A are returned as r/g/b/a and channels missing
+// from the file are filled: RGB with 0, alpha with 1. Requested channels
+// must all exist and are returned under their own names.
+const char *const rgba_channel_names[4] = {"R", "G", "B", "A"};
+const char *const rgba_element_names[4] = {"r", "g", "b", "a"};
+const double rgba_fill_values[4] = {0.0, 0.0, 0.0, 1.0};
 
-extern "C" SEXP C_read_exr(SEXP path_SEXP) {
+// Index in the part's channel list of every matrix read_exr() returns, or
+// -1 for a missing RGBA channel. Throws if a requested channel is missing.
+std::vector<int> output_channel_indices(const CoreDecodeTarget &target,
+                                        SEXP channels_SEXP) {
+  const bool rgba = Rf_isNull(channels_SEXP);
+  const int n = rgba ? 4 : (int)Rf_xlength(channels_SEXP);
+  std::vector<int> indices(n);
+  std::string missing;
+  for (int k = 0; k < n; ++k) {
+    const char *name =
+        rgba ? rgba_channel_names[k] : CHAR(STRING_ELT(channels_SEXP, k));
+    indices[k] = find_channel(target, name);
+    if (indices[k] < 0 && !rgba)
+      missing += missing.empty() ? name : std::string(", ") + name;
+  }
+  if (!missing.empty())
+    throw std::runtime_error("Channel(s) not found: " + missing);
+  return indices;
+}
+
+SEXP output_channel_name(SEXP channels_SEXP, int k) {
+  return Rf_isNull(channels_SEXP) ? Rf_mkChar(rgba_element_names[k])
+                                  : STRING_ELT(channels_SEXP, k);
+}
+
+// Set the width, height and metadata elements that follow the `n` channel
+// matrices of a read_exr() list, and its names.
+void finish_image_list(SEXP out, SEXP names, int n, int w, int h,
+                       exr_const_context_t ctxt) {
+  SET_VECTOR_ELT(out, n, Rf_ScalarInteger(w));
+  SET_VECTOR_ELT(out, n + 1, Rf_ScalarInteger(h));
+  SEXP metadata = build_metadata_list(ctxt, 0);
+  SET_VECTOR_ELT(out, n + 2, metadata);
+  UNPROTECT(1);
+  SET_STRING_ELT(names, n, Rf_mkChar("width"));
+  SET_STRING_ELT(names, n + 1, Rf_mkChar("height"));
+  SET_STRING_ELT(names, n + 2, Rf_mkChar("metadata"));
+  Rf_setAttrib(out, R_NamesSymbol, names);
+}
+
+// Decode part 0 of an opened file into the list returned by read_exr().
+// Throws on failure; the R arguments must already have been checked.
+SEXP read_exr_list(const CoreContext &ctxt, int threads, SEXP channels_SEXP,
+                   bool has_window, const exr_attr_box2i_t &window) {
+  CoreDecodeTarget target = describe_part(ctxt.get(), 0);
+  if (has_window)
+    set_target_window(target, window);
+  const int w = target.window.max.x - target.window.min.x + 1;
+  const int h = target.window.max.y - target.window.min.y + 1;
+
+  const std::vector<int> indices =
+      output_channel_indices(target, channels_SEXP);
+  const int n = (int)indices.size();
+
+  // Column-major double matrices for R, decoded into directly.
+  SEXP out = PROTECT(Rf_allocVector(VECSXP, n + 3));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, n + 3));
+  for (int k = 0; k < n; ++k) {
+    SEXP mat = Rf_allocMatrix(REALSXP, h, w);
+    SET_VECTOR_ELT(out, k, mat);
+    SET_STRING_ELT(names, k, output_channel_name(channels_SEXP, k));
+    if (indices[k] >= 0) {
+      target.outputs[indices[k]] = REAL(mat);
+    } else {
+      std::fill(REAL(mat), REAL(mat) + Rf_xlength(mat), rgba_fill_values[k]);
+    }
+  }
+
+  decode_chunks(target, chunks_in_window(target), threads);
+
+  // A channel requested twice is decoded once and copied.
+  for (int k = 0; k < n; ++k) {
+    SEXP mat = VECTOR_ELT(out, k);
+    if (indices[k] >= 0 && target.outputs[indices[k]] != REAL(mat)) {
+      const double *src = target.outputs[indices[k]];
+      std::copy(src, src + Rf_xlength(mat), REAL(mat));
+    }
+  }
+
+  finish_image_list(out, names, n, w, h, ctxt.get());
+  UNPROTECT(2);
+  return out;
+}
+
+extern "C" SEXP C_read_exr(SEXP path_SEXP, SEXP threads_SEXP,
+                           SEXP channels_SEXP, SEXP window_SEXP,
+                           SEXP mmap_SEXP) {
   const char *path = CHAR(STRING_ELT(path_SEXP, 0));
+  const int threads = prepare_thread_pool(threads_SEXP);
+  const int flags = read_flags_from_sexp(mmap_SEXP);
+  check_bool(Rf_isNull(channels_SEXP) || TYPEOF(channels_SEXP) == STRSXP,
+             "`channels` must be NULL or a character vector");
+  exr_attr_box2i_t window;
+  const bool has_window = window_from_sexp(window_SEXP, &window);
+  try {
+    CoreContext ctxt;
+    open_core_file(ctxt, path, flags);
+    return read_exr_list(ctxt, threads, channels_SEXP, has_window, window);
+  } catch (const std::exception &e) {
+    Rf_error("OpenEXR read error: %s", e.what());
+  }
+}
+
+extern "C" SEXP C_read_exr_raw(SEXP raw_SEXP, SEXP threads_SEXP,
+                               SEXP channels_SEXP, SEXP window_SEXP) {
+  check_bool(TYPEOF(raw_SEXP) == RAWSXP, "`raw` must be a raw vector");
+  const int threads = prepare_thread_pool(threads_SEXP);
+  check_bool(Rf_isNull(channels_SEXP) || TYPEOF(channels_SEXP) == STRSXP,
+             "`channels` must be NULL or a character vector");
+  exr_attr_box2i_t window;
+  const bool has_window = window_from_sexp(window_SEXP, &window);
+  // The vector is protected by the caller for the whole call, so the
+  // context can borrow its bytes instead of copying chunks out of it.
   try {
-    // Use a single worker thread for deterministic behavior across toolchains.
-    InputFile file(path, 1);
-    const Header &hdr = file.header();
-    Box2i dw = hdr.dataWindow();
-    const int w = dw.max.x - dw.min.x + 1;
-    const int h = dw.max.y - dw.min.y + 1;
+    CoreContext ctxt;
+    open_core_memory(ctxt, RAW(raw_SEXP), (uint64_t)Rf_xlength(raw_SEXP));
+    return read_exr_list(ctxt, threads, channels_SEXP, has_window, window);
+  } catch (const std::exception &e) {
+    Rf_error("OpenEXR read error: %s", e.what());
+  }
+}
 
-    // allocate float row-major buffers
-    std::vector<float> r32(w*h), g32(w*h), b32(w*h), a32(w*h, 1.0f);
+// ---------------------------------------------------------------------
+// .Call("C_read_exr_lazy", "path/to/file.exr", threads, channels, window)
+//
+// read_exr(lazy = TRUE) returns ALTREP matrices backed by the open file.
+// Element and region reads decode only the chunks they touch, keeping the
+// most recently used ones in a small cache shared by all channels of the
+// file. A channel is decoded in full only when R asks for its data pointer.
 
-    FrameBuffer fb;
-    const size_t xs = sizeof(float), ys = sizeof(float) * (size_t)w;
+// Decoded chunks are cached up to this many bytes per file; at least one
+// chunk is always kept.
+const size_t kLazyCacheBytes = (size_t)64 << 20;
 
-    // map (dw.min.x, dw.min.y) to r32[0]
-    char *baseR = (char*)r32.data() - (dw.min.x*xs + dw.min.y*ys);
-    char *baseG = (char*)g32.data() - (dw.min.x*xs + dw.min.y*ys);
-    char *baseB = (char*)b32.data() - (dw.min.x*xs + dw.min.y*ys);
-    char *baseA = (char*)a32.data() - (dw.min.x*xs + dw.min.y*ys);
+// One decoded chunk, clipped to the window: a column-major matrix of the
+// box for each cached channel, one after the other.
+struct LazyChunk {
+  int64_t key;
+  exr_attr_box2i_t box;
+  std::vector<double> values;
+};
 
-    // If channel missing, you can skip inserting; here we assume R,G,B exist
-    fb.insert("R", Slice(FLOAT, baseR, xs, ys));
-    fb.insert("G", Slice(FLOAT, baseG, xs, ys));
-    fb.insert("B", Slice(FLOAT, baseB, xs, ys));
-    if (hdr.channels().findChannel("A")) // optional alpha
-      fb.insert("A", Slice(FLOAT, baseA, xs, ys));
+// A file opened by read_exr(lazy = TRUE). It is shared by the channel
+// matrices read from it and closed when the last of them is collected.
+struct LazyExrFile {
+  CoreContext ctxt;
+  CoreDecodeTarget target;
+  int threads = 1;
+  // Position of each part channel in a cached chunk, or -1 if no matrix
+  // reads it.
+  std::vector<int> slots;
+  int slot_count = 0;
+  std::list<LazyChunk> chunks;
+  std::unordered_map<int64_t, std::list<LazyChunk>::iterator> chunk_index;
+  size_t cached_bytes = 0;
 
-    file.setFrameBuffer(fb);
-    file.readPixels(dw.min.y, dw.max.y);
-
-    // Convert row-major float -> column-major double matrices for R
-    SEXP rMat = PROTECT(Rf_allocMatrix(REALSXP, h, w));
-    SEXP gMat = PROTECT(Rf_allocMatrix(REALSXP, h, w));
-    SEXP bMat = PROTECT(Rf_allocMatrix(REALSXP, h, w));
-    SEXP aMat = PROTECT(Rf_allocMatrix(REALSXP, h, w));
-    double *r = REAL(rMat), *g = REAL(gMat), *b = REAL(bMat), *a = REAL(aMat);
-
-    for (int y = 0; y < h; ++y)
-      for (int x = 0; x < w; ++x) {
-        const ptrdiff_t pos_col = x * (ptrdiff_t)h + y;
-        const ptrdiff_t pos_row = y * (ptrdiff_t)w + x;
-        r[pos_col] = r32[pos_row];
-        g[pos_col] = g32[pos_row];
-        b[pos_col] = b32[pos_row];
-        a[pos_col] = a32[pos_row];
+  const LazyChunk &chunk_at(int x, int y);
+};
+
+// The cached chunk holding pixel (x, y) of the window, decoded on a miss.
+const LazyChunk &LazyExrFile::chunk_at(int x, int y) {
+  const exr_attr_box2i_t &dw = target.data_window;
+  const exr_attr_box2i_t &win = target.window;
+  ChunkRef ref;
+  int64_t key;
+  exr_attr_box2i_t box = win;
+  if (target.storage == EXR_STORAGE_SCANLINE) {
+    const int64_t c = ((int64_t)y - dw.min.y) / target.lines_per_chunk;
+    ref = {0, (int)(dw.min.y + c * target.lines_per_chunk)};
+    key = c;
+    box.min.y = std::max(ref.y, win.min.y);
+    box.max.y = (int)std::min<int64_t>(
+        (int64_t)ref.y + target.lines_per_chunk - 1, win.max.y);
+  } else {
+    const int64_t tx = ((int64_t)x - dw.min.x) / target.tile_width;
+    const int64_t ty = ((int64_t)y - dw.min.y) / target.tile_height;
+    const int64_t tiles_x =
+        ((int64_t)dw.max.x - dw.min.x) / target.tile_width + 1;
+    ref = {(int)tx, (int)ty};
+    key = ty * tiles_x + tx;
+    const int64_t x0 = dw.min.x + tx * target.tile_width;
+    const int64_t y0 = dw.min.y + ty * target.tile_height;
+    box.min.x = (int)std::max<int64_t>(x0, win.min.x);
+    box.min.y = (int)std::max<int64_t>(y0, win.min.y);
+    box.max.x = (int)std::min<int64_t>(x0 + target.tile_width - 1, win.max.x);
+    box.max.y = (int)std::min<int64_t>(y0 + target.tile_height - 1, win.max.y);
+  }
+
+  auto found = chunk_index.find(key);
+  if (found != chunk_index.end()) {
+    chunks.splice(chunks.begin(), chunks, found->second);
+    return chunks.front();
+  }
+
+  // Decode into a fresh entry through a target restricted to the chunk.
+  const size_t box_size = ((size_t)box.max.x - box.min.x + 1) *
+                          ((size_t)box.max.y - box.min.y + 1);
+  LazyChunk chunk{key, box, std::vector<double>(box_size * slot_count)};
+  CoreDecodeTarget chunk_target = target;
+  chunk_target.window = box;
+  chunk_target.rows = (R_xlen_t)box.max.y - box.min.y + 1;
+  for (size_t c = 0; c < slots.size(); ++c) {
+    chunk_target.outputs[c] =
+        slots[c] >= 0 ? chunk.values.data() + box_size * slots[c] : nullptr;
+  }
+  decode_chunk_range(chunk_target, &ref, &ref + 1);
+
+  while (!chunks.empty() &&
+         cached_bytes + chunk.values.size() * sizeof(double) >
+             kLazyCacheBytes) {
+    cached_bytes -= chunks.back().values.size() * sizeof(double);
+    chunk_index.erase(chunks.back().key);
+    chunks.pop_back();
+  }
+  cached_bytes += chunk.values.size() * sizeof(double);
+  chunks.push_front(std::move(chunk));
+  chunk_index[key] = chunks.begin();
+  return chunks.front();
+}
+
+// The state behind one lazy matrix: part channel `channel` of `file`, or a
+// matrix of `fill` for a missing RGBA channel. The file is released once
+// the matrix has been materialized.
+struct LazyChannel {
+  std::shared_ptr<LazyExrFile> file;
+  int channel;
+  double fill;
+  R_xlen_t rows;
+  R_xlen_t length;
+};
+
+R_altrep_class_t lazy_channel_class;
+
+// data1 is an external pointer to the LazyChannel, data2 the materialized
+// matrix data (NULL until R asks for the data pointer).
+LazyChannel *lazy_channel(SEXP x) {
+  LazyChannel *state =
+      static_cast<LazyChannel *>(R_ExternalPtrAddr(R_altrep_data1(x)));
+  check_bool(state != nullptr, "Lazy EXR channel is no longer available");
+  return state;
+}
+
+void lazy_channel_finalize(SEXP ptr) {
+  delete static_cast<LazyChannel *>(R_ExternalPtrAddr(ptr));
+  R_ClearExternalPtr(ptr);
+}
+
+R_xlen_t lazy_channel_length(SEXP x) { return lazy_channel(x)->length; }
+
+R_xlen_t lazy_channel_get_region(SEXP x, R_xlen_t i, R_xlen_t n,
+                                 double *buf) {
+  SEXP data = R_altrep_data2(x);
+  LazyChannel *state = lazy_channel(x);
+  n = std::max<R_xlen_t>(0, std::min(n, state->length - i));
+  if (data != R_NilValue) {
+    std::copy(REAL(data) + i, REAL(data) + i + n, buf);
+    return n;
+  }
+  if (state->channel < 0) {
+    std::fill(buf, buf + n, state->fill);
+    return n;
+  }
+
+  try {
+    LazyExrFile &file = *state->file;
+    const exr_attr_box2i_t &win = file.target.window;
+    const int slot = file.slots[state->channel];
+    // Copy column runs, each lying within one chunk.
+    for (R_xlen_t done = 0; done < n;) {
+      const R_xlen_t k = i + done;
+      const int x = win.min.x + (int)(k / state->rows);
+      const int y = win.min.y + (int)(k % state->rows);
+      const LazyChunk &chunk = file.chunk_at(x, y);
+      const exr_attr_box2i_t &box = chunk.box;
+      const size_t box_rows = (size_t)box.max.y - box.min.y + 1;
+      const size_t box_size = ((size_t)box.max.x - box.min.x + 1) * box_rows;
+      const R_xlen_t run =
+          std::min<R_xlen_t>(n - done, (R_xlen_t)box.max.y - y + 1);
+      const double *src = chunk.values.data() + box_size * slot +
+                          (size_t)(x - box.min.x) * box_rows + (y - box.min.y);
+      std::copy(src, src + run, buf + done);
+      done += run;
+    }
+  } catch (const std::exception &e) {
+    Rf_error("OpenEXR read error: %s", e.what());
+  }
+  return n;
+}
+
+double lazy_channel_elt(SEXP x, R_xlen_t i) {
+  double value = NA_REAL;
+  lazy_channel_get_region(x, i, 1, &value);
+  return value;
+}
+
+void *lazy_channel_dataptr(SEXP x, Rboolean) {
+  SEXP data = R_altrep_data2(x);
+  if (data != R_NilValue)
+    return REAL(data);
+
+  LazyChannel *state = lazy_channel(x);
+  data = PROTECT(Rf_allocVector(REALSXP, state->length));
+  if (state->channel < 0) {
+    std::fill(REAL(data), REAL(data) + state->length, state->fill);
+  } else {
+    try {
+      // Decode the whole window at once rather than through the cache.
+      LazyExrFile &file = *state->file;
+      CoreDecodeTarget target = file.target;
+      target.outputs[state->channel] = REAL(data);
+      decode_chunks(target, chunks_in_window(target), file.threads);
+    } catch (const std::exception &e) {
+      Rf_error("OpenEXR read error: %s", e.what());
+    }
+  }
+  R_set_altrep_data2(x, data);
+  state->file.reset();
+  UNPROTECT(1);
+  return REAL(data);
+}
+
+const void *lazy_channel_dataptr_or_null(SEXP x) {
+  SEXP data = R_altrep_data2(x);
+  return data == R_NilValue ? nullptr : REAL(data);
+}
+
+Rboolean lazy_channel_inspect(SEXP x, int, int, int,
+                              void (*)(SEXP, int, int, int)) {
+  Rprintf(" libopenexr lazy channel (%s)\n",
+          R_altrep_data2(x) == R_NilValue ? "on demand" : "materialized");
+  return TRUE;
+}
+
+void register_lazy_channel_class(DllInfo *dll) {
+  lazy_channel_class =
+      R_make_altreal_class("exr_lazy_channel", "libopenexr", dll);
+  R_set_altrep_Length_method(lazy_channel_class, lazy_channel_length);
+  R_set_altrep_Inspect_method(lazy_channel_class, lazy_channel_inspect);
+  R_set_altvec_Dataptr_method(lazy_channel_class, lazy_channel_dataptr);
+  R_set_altvec_Dataptr_or_null_method(lazy_channel_class,
+                                      lazy_channel_dataptr_or_null);
+  R_set_altreal_Elt_method(lazy_channel_class, lazy_channel_elt);
+  R_set_altreal_Get_region_method(lazy_channel_class, lazy_channel_get_region);
+}
+
+// A lazy h x w matrix for `state`. The result is not protected.
+SEXP new_lazy_channel(LazyChannel *state, int h, int w) {
+  SEXP ptr = PROTECT(R_MakeExternalPtr(state, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(ptr, lazy_channel_finalize, TRUE);
+  SEXP mat = PROTECT(R_new_altrep(lazy_channel_class, ptr, R_NilValue));
+  SEXP dim = Rf_allocVector(INTSXP, 2);
+  INTEGER(dim)[0] = h;
+  INTEGER(dim)[1] = w;
+  Rf_setAttrib(mat, R_DimSymbol, dim);
+  UNPROTECT(2);
+  return mat;
+}
+
+extern "C" SEXP C_read_exr_lazy(SEXP path_SEXP, SEXP threads_SEXP,
+                                SEXP channels_SEXP, SEXP window_SEXP) {
+  const char *path = CHAR(STRING_ELT(path_SEXP, 0));
+  const int threads = prepare_thread_pool(threads_SEXP);
+  check_bool(Rf_isNull(channels_SEXP) || TYPEOF(channels_SEXP) == STRSXP,
+             "`channels` must be NULL or a character vector");
+  exr_attr_box2i_t window;
+  const bool has_window = window_from_sexp(window_SEXP, &window);
+
+  try {
+    std::shared_ptr<LazyExrFile> file = std::make_shared<LazyExrFile>();
+    open_core_file(file->ctxt, path);
+    CoreDecodeTarget &target = file->target;
+    target = describe_part(file->ctxt.get(), 0);
+    if (has_window)
+      set_target_window(target, window);
+    const std::vector<int> indices =
+        output_channel_indices(target, channels_SEXP);
+    file->threads = threads;
+    file->slots.assign(target.channels->num_channels, -1);
+    for (int index : indices) {
+      if (index >= 0 && file->slots[index] < 0)
+        file->slots[index] = file->slot_count++;
+    }
+
+    const int w = target.window.max.x - target.window.min.x + 1;
+    const int h = target.window.max.y - target.window.min.y + 1;
+    const int n = (int)indices.size();
+    SEXP out = PROTECT(Rf_allocVector(VECSXP, n + 3));
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, n + 3));
+    for (int k = 0; k < n; ++k) {
+      const double fill = indices[k] < 0 ? rgba_fill_values[k] : 0.0;
+      LazyChannel *state =
+          new LazyChannel{file, indices[k], fill, (R_xlen_t)h, (R_xlen_t)h * w};
+      SET_VECTOR_ELT(out, k, new_lazy_channel(state, h, w));
+      SET_STRING_ELT(names, k, output_channel_name(channels_SEXP, k));
+    }
+    finish_image_list(out, names, n, w, h, file->ctxt.get());
+    UNPROTECT(2);
+    return out;
+  } catch (const std::exception &e) {
+    Rf_error("OpenEXR read error: %s", e.what());
+  }
+}
+
+// ---------------------------------------------------------------------
+// .Call("C_read_exr_sequence", paths, threads, channels, window, mmap)
+//
+// Frames are decoded a batch at a time. The files of a batch are opened in
+// parallel, then the chunks of every open frame are decoded as one flat set
+// of pool tasks, so small files still keep all workers busy. Tasks never
+// wait on other tasks, which would deadlock a fully occupied pool.
+
+// What every frame of a sequence decodes into: `base` is a
+// width x height x channels x frames array, one channel plane per name.
+struct SequenceLayout {
+  std::vector<std::string> channels;
+  bool rgba = false;
+  bool has_window = false;
+  exr_attr_box2i_t window{};
+  int open_flags = 0;
+  int width = 0;
+  int height = 0;
+  double *base = nullptr;
+};
+
+// An open frame of a sequence, ready to decode.
+struct SequenceFrame {
+  CoreContext ctxt;
+  CoreDecodeTarget target;
+  std::vector<ChunkRef> chunks;
+};
+
+void open_sequence_frame(SequenceFrame &frame, const char *path,
+                         const SequenceLayout &layout, R_xlen_t index) {
+  open_core_file(frame.ctxt, path, layout.open_flags);
+  frame.target = describe_part(frame.ctxt.get(), 0);
+  if (layout.has_window)
+    set_target_window(frame.target, layout.window);
+
+  const exr_attr_box2i_t &win = frame.target.window;
+  if (win.max.x - win.min.x + 1 != layout.width ||
+      win.max.y - win.min.y + 1 != layout.height) {
+    throw std::runtime_error("Image is " +
+                             std::to_string(win.max.x - win.min.x + 1) + "x" +
+                             std::to_string(win.max.y - win.min.y + 1) +
+                             " but the sequence is " +
+                             std::to_string(layout.width) + "x" +
+                             std::to_string(layout.height));
+  }
+
+  const R_xlen_t plane = (R_xlen_t)layout.width * layout.height;
+  const R_xlen_t nchannels = (R_xlen_t)layout.channels.size();
+  const double fill_values[4] = {0.0, 0.0, 0.0, 1.0};
+  for (R_xlen_t k = 0; k < nchannels; ++k) {
+    double *out = layout.base + (index * nchannels + k) * plane;
+    const int c = find_channel(frame.target, layout.channels[k].c_str());
+    if (c >= 0) {
+      frame.target.outputs[c] = out;
+    } else if (layout.rgba) {
+      std::fill(out, out + plane, fill_values[k]);
+    } else {
+      throw std::runtime_error("Channel not found: " + layout.channels[k]);
+    }
+  }
+  frame.chunks = chunks_in_window(frame.target);
+}
+
+class OpenFrameTask final : public ILMTHREAD_NAMESPACE::Task {
+public:
+  OpenFrameTask(ILMTHREAD_NAMESPACE::TaskGroup *group, SequenceFrame *frame,
+                const char *path, const SequenceLayout *layout, R_xlen_t index,
+                TaskFailure *failure)
+      : Task(group), frame_(frame), path_(path), layout_(layout),
+        index_(index), failure_(failure) {}
+
+  void execute() override {
+    try {
+      open_sequence_frame(*frame_, path_, *layout_, index_);
+    } catch (const std::exception &e) {
+      failure_->record(labelled_error(path_, e.what()));
+    } catch (...) {
+      failure_->record(labelled_error(path_, "Unknown open failure"));
+    }
+  }
+
+private:
+  SequenceFrame *frame_;
+  const char *path_;
+  const SequenceLayout *layout_;
+  R_xlen_t index_;
+  TaskFailure *failure_;
+};
+
+void decode_sequence(const std::vector<const char *> &paths,
+                     const SequenceLayout &layout, int threads) {
+  const R_xlen_t nframes = (R_xlen_t)paths.size();
+  if (threads <= 1) {
+    for (R_xlen_t f = 0; f < nframes; ++f) {
+      try {
+        SequenceFrame frame;
+        open_sequence_frame(frame, paths[f], layout, f);
+        decode_chunk_range(frame.target, frame.chunks.data(),
+                           frame.chunks.data() + frame.chunks.size());
+      } catch (const std::exception &e) {
+        throw std::runtime_error(labelled_error(paths[f], e.what()));
       }
+    }
+    return;
+  }
 
-    SEXP metadata = build_metadata_list(hdr);
-    SEXP out = PROTECT(Rf_allocVector(VECSXP, 7));
-    SET_VECTOR_ELT(out, 0, rMat);
-    SET_VECTOR_ELT(out, 1, gMat);
-    SET_VECTOR_ELT(out, 2, bMat);
-    SET_VECTOR_ELT(out, 3, aMat);
-    SET_VECTOR_ELT(out, 4, Rf_ScalarInteger(w));
-    SET_VECTOR_ELT(out, 5, Rf_ScalarInteger(h));
-    SET_VECTOR_ELT(out, 6, metadata);
-    SEXP names = PROTECT(Rf_allocVector(STRSXP, 7));
-    const char *nms[7] = {"r","g","b","a","width","height","metadata"};
-    for (int i=0;i<7;++i) SET_STRING_ELT(names, i, Rf_mkChar(nms[i]));
-    Rf_setAttrib(out, R_NamesSymbol, names);
+  // Two files per worker keeps the open/decode barriers infrequent while
+  // bounding the number of open files.
+  const R_xlen_t batch = (R_xlen_t)threads * 2;
+  for (R_xlen_t first = 0; first < nframes; first += batch) {
+    const R_xlen_t count = std::min(batch, nframes - first);
+    std::vector<std::unique_ptr<SequenceFrame>> frames(count);
+    for (auto &frame : frames)
+      frame.reset(new SequenceFrame);
+
+    TaskFailure failure;
+    {
+      ILMTHREAD_NAMESPACE::TaskGroup group;
+      for (R_xlen_t i = 0; i < count; ++i) {
+        ILMTHREAD_NAMESPACE::ThreadPool::addGlobalTask(
+            new OpenFrameTask(&group, frames[i].get(), paths[first + i],
+                              &layout, first + i, &failure));
+      }
+    }
+    failure.rethrow();
+
+    {
+      ILMTHREAD_NAMESPACE::TaskGroup group;
+      const size_t tasks_per_frame =
+          std::max<size_t>(1, (size_t)threads * 4 / (size_t)count);
+      for (R_xlen_t i = 0; i < count; ++i) {
+        add_decode_tasks(&group, frames[i]->target, frames[i]->chunks,
+                         tasks_per_frame, &failure, paths[first + i]);
+      }
+    }
+    failure.rethrow();
+  }
+}
+
+extern "C" SEXP C_read_exr_sequence(SEXP paths_SEXP, SEXP threads_SEXP,
+                                    SEXP channels_SEXP, SEXP window_SEXP,
+                                    SEXP mmap_SEXP) {
+  check_bool(TYPEOF(paths_SEXP) == STRSXP && Rf_xlength(paths_SEXP) > 0,
+             "`paths` must be a non-empty character vector");
+  check_bool(Rf_isNull(channels_SEXP) || TYPEOF(channels_SEXP) == STRSXP,
+             "`channels` must be NULL or a character vector");
+  const int threads = prepare_thread_pool(threads_SEXP);
+
+  // Everything the workers need is copied out of R objects up front.
+  const R_xlen_t nframes = Rf_xlength(paths_SEXP);
+  std::vector<const char *> paths(nframes);
+  for (R_xlen_t f = 0; f < nframes; ++f)
+    paths[f] = CHAR(STRING_ELT(paths_SEXP, f));
+
+  SequenceLayout layout;
+  layout.has_window = window_from_sexp(window_SEXP, &layout.window);
+  layout.open_flags = read_flags_from_sexp(mmap_SEXP);
+  layout.rgba = Rf_isNull(channels_SEXP);
+  if (layout.rgba) {
+    layout.channels = {"R", "G", "B", "A"};
+  } else {
+    for (R_xlen_t k = 0; k < Rf_xlength(channels_SEXP); ++k)
+      layout.channels.push_back(CHAR(STRING_ELT(channels_SEXP, k)));
+  }
+
+  try {
+    // The first frame fixes the size of the sequence and its metadata.
+    SEXP metadata;
+    {
+      CoreContext ctxt;
+      open_core_file(ctxt, paths[0]);
+      CoreDecodeTarget target = describe_part(ctxt.get(), 0);
+      if (layout.has_window)
+        set_target_window(target, layout.window);
+      layout.width = target.window.max.x - target.window.min.x + 1;
+      layout.height = target.window.max.y - target.window.min.y + 1;
+      metadata = build_metadata_list(ctxt.get(), 0);
+    }
 
-    UNPROTECT(7);
+    // The one R allocation for the whole sequence.
+    SEXP dims = PROTECT(Rf_allocVector(INTSXP, 4));
+    INTEGER(dims)[0] = layout.width;
+    INTEGER(dims)[1] = layout.height;
+    INTEGER(dims)[2] = (int)layout.channels.size();
+    INTEGER(dims)[3] = (int)nframes;
+    SEXP out = PROTECT(Rf_allocArray(REALSXP, dims));
+    layout.base = REAL(out);
+
+    decode_sequence(paths, layout, threads);
+
+    if (!layout.rgba) {
+      SEXP dimnames = PROTECT(Rf_allocVector(VECSXP, 4));
+      SET_VECTOR_ELT(dimnames, 2, channels_SEXP);
+      Rf_setAttrib(out, R_DimNamesSymbol, dimnames);
+      UNPROTECT(1);
+    }
+    Rf_setAttrib(out, Rf_install("metadata"), metadata);
+    UNPROTECT(3);
     return out;
   } catch (const std::exception &e) {
     Rf_error("OpenEXR read error: %s", e.what());
@@ -280,13 +1558,440 @@ extern "C" SEXP C_read_exr(SEXP path_SEXP) {
 }
 
 // ---------------------------------------------------------------------
-// .Call("C_write_exr", path, r, g, b, a, width, height, metadata)
-extern "C" SEXP C_write_exr(SEXP path_SEXP, SEXP rMat, SEXP gMat, SEXP bMat,
-                            SEXP aMat, SEXP w_SEXP, SEXP h_SEXP,
-                            SEXP metadata_SEXP) {
-  const char *path = CHAR(STRING_ELT(path_SEXP, 0));
-  const int w = INTEGER(w_SEXP)[0];
-  const int h = INTEGER(h_SEXP)[0];
+// .Call("C_exr_info", paths, threads)
+//
+// Headers are parsed in parallel, a batch of files at a time; nothing past
+// the header (chunk tables, pixel data) is read. The R values are built on
+// the R thread from the parsed contexts afterwards.
+
+SEXP real_values(const double *values, int n) {
+  SEXP out = Rf_allocVector(REALSXP, n);
+  std::copy(values, values + n, REAL(out));
+  return out;
+}
+
+SEXP integer_values(const int32_t *values, int n) {
+  SEXP out = Rf_allocVector(INTSXP, n);
+  std::copy(values, values + n, INTEGER(out));
+  return out;
+}
+
+// Square matrix from row-major values.
+template <typename T> SEXP matrix_values(const T *values, int n) {
+  SEXP out = Rf_allocMatrix(REALSXP, n, n);
+  for (int row = 0; row < n; ++row)
+    for (int col = 0; col < n; ++col)
+      REAL(out)[col * n + row] = values[row * n + col];
+  return out;
+}
+
+const char *storage_name(exr_storage_t storage) {
+  switch (storage) {
+  case EXR_STORAGE_SCANLINE:
+    return "scanline";
+  case EXR_STORAGE_TILED:
+    return "tiled";
+  case EXR_STORAGE_DEEP_SCANLINE:
+    return "deep_scanline";
+  case EXR_STORAGE_DEEP_TILED:
+    return "deep_tiled";
+  default:
+    return "unknown";
+  }
+}
+
+const char *pixel_type_name(exr_pixel_type_t type) {
+  switch (type) {
+  case EXR_PIXEL_UINT:
+    return "uint";
+  case EXR_PIXEL_HALF:
+    return "half";
+  case EXR_PIXEL_FLOAT:
+    return "float";
+  default:
+    return "unknown";
+  }
+}
+
+std::string compression_name(int compression) {
+  std::string name = "unknown";
+  if (isValidCompression(compression))
+    getCompressionNameFromId((Compression)compression, name);
+  return name;
+}
+
+// Convert one attribute to an R value. The result is not protected.
+SEXP attribute_value(const exr_attribute_t *attr) {
+  switch (attr->type) {
+  case EXR_ATTR_BOX2I: {
+    const int32_t v[4] = {attr->box2i->min.x, attr->box2i->min.y,
+                          attr->box2i->max.x, attr->box2i->max.y};
+    return integer_values(v, 4);
+  }
+  case EXR_ATTR_BOX2F: {
+    const double v[4] = {attr->box2f->min.x, attr->box2f->min.y,
+                         attr->box2f->max.x, attr->box2f->max.y};
+    return real_values(v, 4);
+  }
+  case EXR_ATTR_CHLIST: {
+    // Pixel type of each channel, named by channel.
+    const exr_attr_chlist_t *chlist = attr->chlist;
+    SEXP types = PROTECT(Rf_allocVector(STRSXP, chlist->num_channels));
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, chlist->num_channels));
+    for (int c = 0; c < chlist->num_channels; ++c) {
+      SET_STRING_ELT(types, c,
+                     Rf_mkChar(pixel_type_name(chlist->entries[c].pixel_type)));
+      SET_STRING_ELT(names, c, Rf_mkChar(chlist->entries[c].name.str));
+    }
+    Rf_setAttrib(types, R_NamesSymbol, names);
+    UNPROTECT(2);
+    return types;
+  }
+  case EXR_ATTR_CHROMATICITIES: {
+    const exr_attr_chromaticities_t *c = attr->chromaticities;
+    SEXP out = PROTECT(Rf_allocVector(VECSXP, 1));
+    set_chromaticities_metadata(out, 0,
+                                Chromaticities(V2f(c->red_x, c->red_y),
+                                               V2f(c->green_x, c->green_y),
+                                               V2f(c->blue_x, c->blue_y),
+                                               V2f(c->white_x, c->white_y)));
+    UNPROTECT(1);
+    return VECTOR_ELT(out, 0);
+  }
+  case EXR_ATTR_COMPRESSION:
+    return Rf_mkString(compression_name(attr->uc).c_str());
+  case EXR_ATTR_DOUBLE:
+    return Rf_ScalarReal(attr->d);
+  case EXR_ATTR_ENVMAP:
+    return Rf_mkString(envmap_name((exr_envmap_t)attr->uc));
+  case EXR_ATTR_FLOAT:
+    return Rf_ScalarReal(attr->f);
+  case EXR_ATTR_FLOAT_VECTOR: {
+    SEXP out = Rf_allocVector(REALSXP, attr->floatvector->length);
+    std::copy(attr->floatvector->arr,
+              attr->floatvector->arr + attr->floatvector->length, REAL(out));
+    return out;
+  }
+  case EXR_ATTR_INT:
+  case EXR_ATTR_DEEP_IMAGE_STATE:
+    return Rf_ScalarInteger(attr->type == EXR_ATTR_INT ? attr->i : attr->uc);
+  case EXR_ATTR_KEYCODE: {
+    const exr_attr_keycode_t *k = attr->keycode;
+    const int32_t v[7] = {k->film_mfc_code,   k->film_type,
+                          k->prefix,          k->count,
+                          k->perf_offset,     k->perfs_per_frame,
+                          k->perfs_per_count};
+    return integer_values(v, 7);
+  }
+  case EXR_ATTR_LINEORDER:
+    return Rf_mkString(attr->uc == EXR_LINEORDER_INCREASING_Y ? "increasing_y"
+                       : attr->uc == EXR_LINEORDER_DECREASING_Y
+                           ? "decreasing_y"
+                           : "random_y");
+  case EXR_ATTR_M33F:
+    return matrix_values(attr->m33f->m, 3);
+  case EXR_ATTR_M33D:
+    return matrix_values(attr->m33d->m, 3);
+  case EXR_ATTR_M44F:
+    return matrix_values(attr->m44f->m, 4);
+  case EXR_ATTR_M44D:
+    return matrix_values(attr->m44d->m, 4);
+  case EXR_ATTR_PREVIEW: {
+    // Preview pixels are not returned, only their size.
+    const int32_t v[2] = {(int32_t)attr->preview->width,
+                          (int32_t)attr->preview->height};
+    return integer_values(v, 2);
+  }
+  case EXR_ATTR_RATIONAL: {
+    const double v[2] = {(double)attr->rational->num,
+                         (double)attr->rational->denom};
+    return real_values(v, 2);
+  }
+  case EXR_ATTR_STRING:
+    return Rf_ScalarString(Rf_mkCharLenCE(attr->string->str,
+                                          attr->string->length, CE_UTF8));
+  case EXR_ATTR_STRING_VECTOR: {
+    const exr_attr_string_vector_t *sv = attr->stringvector;
+    SEXP out = PROTECT(Rf_allocVector(STRSXP, sv->n_strings));
+    for (int i = 0; i < sv->n_strings; ++i) {
+      SET_STRING_ELT(out, i,
+                     Rf_mkCharLenCE(sv->strings[i].str, sv->strings[i].length,
+                                    CE_UTF8));
+    }
+    UNPROTECT(1);
+    return out;
+  }
+  case EXR_ATTR_TILEDESC: {
+    const exr_attr_tiledesc_t *t = attr->tiledesc;
+    const char *levels[3] = {"one_level", "mipmap", "ripmap"};
+    const int level = EXR_GET_TILE_LEVEL_MODE(*t);
+    SEXP out = PROTECT(Rf_allocVector(VECSXP, 4));
+    SET_VECTOR_ELT(out, 0, Rf_ScalarInteger((int)t->x_size));
+    SET_VECTOR_ELT(out, 1, Rf_ScalarInteger((int)t->y_size));
+    SET_VECTOR_ELT(out, 2,
+                   Rf_mkString(level < 3 ? levels[level] : "unknown"));
+    SET_VECTOR_ELT(out, 3,
+                   Rf_mkString(EXR_GET_TILE_ROUND_MODE(*t) == EXR_TILE_ROUND_UP
+                                   ? "up"
+                                   : "down"));
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, 4));
+    SET_STRING_ELT(names, 0, Rf_mkChar("x_size"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("y_size"));
+    SET_STRING_ELT(names, 2, Rf_mkChar("level_mode"));
+    SET_STRING_ELT(names, 3, Rf_mkChar("rounding_mode"));
+    Rf_setAttrib(out, R_NamesSymbol, names);
+    UNPROTECT(2);
+    return out;
+  }
+  case EXR_ATTR_TIMECODE: {
+    // Both fields are unsigned 32-bit, so they are returned as doubles.
+    const double v[2] = {(double)attr->timecode->time_and_flags,
+                         (double)attr->timecode->user_data};
+    return real_values(v, 2);
+  }
+  case EXR_ATTR_V2I:
+    return integer_values(&attr->v2i->x, 2);
+  case EXR_ATTR_V2F: {
+    const double v[2] = {attr->v2f->x, attr->v2f->y};
+    return real_values(v, 2);
+  }
+  case EXR_ATTR_V2D:
+    return real_values(&attr->v2d->x, 2);
+  case EXR_ATTR_V3I:
+    return integer_values(&attr->v3i->x, 3);
+  case EXR_ATTR_V3F: {
+    const double v[3] = {attr->v3f->x, attr->v3f->y, attr->v3f->z};
+    return real_values(v, 3);
+  }
+  case EXR_ATTR_V3D:
+    return real_values(&attr->v3d->x, 3);
+  case EXR_ATTR_OPAQUE: {
+    // Unknown attribute types are returned as their raw bytes.
+    const exr_attr_opaquedata_t *o = attr->opaque;
+    const int32_t size = o->packed_data ? o->size : 0;
+    SEXP out = Rf_allocVector(RAWSXP, size);
+    if (size > 0)
+      std::memcpy(RAW(out), o->packed_data, size);
+    return out;
+  }
+  default:
+    return R_NilValue;
+  }
+}
+
+// Every attribute of one part, in file order. The result is not protected.
+SEXP attribute_list(exr_const_context_t ctxt, int part) {
+  int32_t count = 0;
+  if (exr_get_attribute_count(ctxt, part, &count) != EXR_ERR_SUCCESS)
+    count = 0;
+  SEXP out = PROTECT(Rf_allocVector(VECSXP, count));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, count));
+  for (int32_t i = 0; i < count; ++i) {
+    const exr_attribute_t *attr = nullptr;
+    if (exr_get_attribute_by_index(ctxt, part, EXR_ATTR_LIST_FILE_ORDER, i,
+                                   &attr) != EXR_ERR_SUCCESS)
+      continue;
+    SET_STRING_ELT(names, i, Rf_mkChar(attr->name));
+    SET_VECTOR_ELT(out, i, attribute_value(attr));
+  }
+  Rf_setAttrib(out, R_NamesSymbol, names);
+  UNPROTECT(2);
+  return out;
+}
+
+// A file whose header is being scanned.
+struct HeaderScan {
+  CoreContext ctxt;
+  std::string error;
+};
+
+class OpenHeaderTask final : public ILMTHREAD_NAMESPACE::Task {
+public:
+  OpenHeaderTask(ILMTHREAD_NAMESPACE::TaskGroup *group, HeaderScan *scan,
+                 const char *path)
+      : Task(group), scan_(scan), path_(path) {}
+
+  void execute() override {
+    try {
+      open_core_file(scan_->ctxt, path_);
+    } catch (const std::exception &e) {
+      scan_->error = e.what();
+    }
+  }
+
+private:
+  HeaderScan *scan_;
+  const char *path_;
+};
+
+enum ExrInfoColumn {
+  INFO_PATH,
+  INFO_PARTS,
+  INFO_STORAGE,
+  INFO_WIDTH,
+  INFO_HEIGHT,
+  INFO_CHANNELS,
+  INFO_COMPRESSION,
+  INFO_TILED,
+  INFO_TILE_WIDTH,
+  INFO_TILE_HEIGHT,
+  INFO_ATTRIBUTES,
+  INFO_ERROR,
+  INFO_COLUMNS
+};
+
+// Fill row `i` of the info columns from an opened header. Files that could
+// not be read keep NA values and report why in `error`.
+void fill_info_row(SEXP columns, R_xlen_t i, const HeaderScan &scan) {
+  std::string error = scan.error;
+  if (error.empty()) {
+    try {
+      exr_const_context_t ctxt = scan.ctxt.get();
+      int parts = 0;
+      exr_storage_t storage;
+      exr_attr_box2i_t dw;
+      exr_compression_t compression;
+      const exr_attr_chlist_t *chlist = nullptr;
+      check_core(exr_get_count(ctxt, &parts), "Unable to count parts");
+      check_core(exr_get_storage(ctxt, 0, &storage),
+                 "Unable to query storage type");
+      check_core(exr_get_data_window(ctxt, 0, &dw),
+                 "Unable to query data window");
+      check_core(exr_get_compression(ctxt, 0, &compression),
+                 "Unable to query compression");
+      check_core(exr_get_channels(ctxt, 0, &chlist),
+                 "Unable to query channel list");
+
+      const bool tiled =
+          storage == EXR_STORAGE_TILED || storage == EXR_STORAGE_DEEP_TILED;
+      INTEGER(VECTOR_ELT(columns, INFO_PARTS))[i] = parts;
+      SET_STRING_ELT(VECTOR_ELT(columns, INFO_STORAGE), i,
+                     Rf_mkChar(storage_name(storage)));
+      INTEGER(VECTOR_ELT(columns, INFO_WIDTH))[i] = dw.max.x - dw.min.x + 1;
+      INTEGER(VECTOR_ELT(columns, INFO_HEIGHT))[i] = dw.max.y - dw.min.y + 1;
+      SET_STRING_ELT(VECTOR_ELT(columns, INFO_COMPRESSION), i,
+                     Rf_mkChar(compression_name(compression).c_str()));
+      LOGICAL(VECTOR_ELT(columns, INFO_TILED))[i] = tiled;
+      if (tiled) {
+        uint32_t tile_x = 0, tile_y = 0;
+        exr_tile_level_mode_t level;
+        exr_tile_round_mode_t round;
+        check_core(
+            exr_get_tile_descriptor(ctxt, 0, &tile_x, &tile_y, &level, &round),
+            "Unable to query tile descriptor");
+        INTEGER(VECTOR_ELT(columns, INFO_TILE_WIDTH))[i] = (int)tile_x;
+        INTEGER(VECTOR_ELT(columns, INFO_TILE_HEIGHT))[i] = (int)tile_y;
+      }
+
+      SEXP channels = PROTECT(Rf_allocVector(STRSXP, chlist->num_channels));
+      for (int c = 0; c < chlist->num_channels; ++c)
+        SET_STRING_ELT(channels, c, Rf_mkChar(chlist->entries[c].name.str));
+      SET_VECTOR_ELT(VECTOR_ELT(columns, INFO_CHANNELS), i, channels);
+      UNPROTECT(1);
+
+      SET_VECTOR_ELT(VECTOR_ELT(columns, INFO_ATTRIBUTES), i,
+                     attribute_list(ctxt, 0));
+      return;
+    } catch (const std::exception &e) {
+      error = e.what();
+    }
+  }
+  SET_STRING_ELT(VECTOR_ELT(columns, INFO_ERROR), i, Rf_mkChar(error.c_str()));
+}
+
+extern "C" SEXP C_exr_info(SEXP paths_SEXP, SEXP threads_SEXP) {
+  check_bool(TYPEOF(paths_SEXP) == STRSXP,
+             "`paths` must be a character vector");
+  const int threads = prepare_thread_pool(threads_SEXP);
+  const R_xlen_t n = Rf_xlength(paths_SEXP);
+
+  const char *names[INFO_COLUMNS] = {
+      "path",        "parts",       "storage",    "width",
+      "height",      "channels",    "compression", "tiled",
+      "tile_width",  "tile_height", "attributes", "error"};
+  const SEXPTYPE types[INFO_COLUMNS] = {
+      STRSXP, INTSXP, STRSXP, INTSXP, INTSXP, VECSXP,
+      STRSXP, LGLSXP, INTSXP, INTSXP, VECSXP, STRSXP};
+
+  SEXP columns = PROTECT(Rf_allocVector(VECSXP, INFO_COLUMNS));
+  SEXP column_names = PROTECT(Rf_allocVector(STRSXP, INFO_COLUMNS));
+  for (int col = 0; col < INFO_COLUMNS; ++col) {
+    SEXP column = Rf_allocVector(types[col], n);
+    SET_VECTOR_ELT(columns, col, column);
+    SET_STRING_ELT(column_names, col, Rf_mkChar(names[col]));
+    for (R_xlen_t i = 0; i < n; ++i) {
+      if (types[col] == STRSXP)
+        SET_STRING_ELT(column, i, NA_STRING);
+      else if (types[col] == INTSXP)
+        INTEGER(column)[i] = NA_INTEGER;
+      else if (types[col] == LGLSXP)
+        LOGICAL(column)[i] = NA_LOGICAL;
+    }
+  }
+  Rf_setAttrib(columns, R_NamesSymbol, column_names);
+
+  std::vector<const char *> paths(n);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    paths[i] = CHAR(STRING_ELT(paths_SEXP, i));
+    SET_STRING_ELT(VECTOR_ELT(columns, INFO_PATH), i,
+                   STRING_ELT(paths_SEXP, i));
+  }
+
+  // Batches bound the number of files held open at once.
+  const R_xlen_t batch = std::min<R_xlen_t>(256, (R_xlen_t)threads * 16);
+  for (R_xlen_t first = 0; first < n; first += batch) {
+    const R_xlen_t count = std::min(batch, n - first);
+    std::vector<std::unique_ptr<HeaderScan>> scans(count);
+    for (auto &scan : scans)
+      scan.reset(new HeaderScan);
+
+    if (threads <= 1) {
+      for (R_xlen_t i = 0; i < count; ++i) {
+        try {
+          open_core_file(scans[i]->ctxt, paths[first + i]);
+        } catch (const std::exception &e) {
+          scans[i]->error = e.what();
+        }
+      }
+    } else {
+      ILMTHREAD_NAMESPACE::TaskGroup group;
+      for (R_xlen_t i = 0; i < count; ++i) {
+        ILMTHREAD_NAMESPACE::ThreadPool::addGlobalTask(
+            new OpenHeaderTask(&group, scans[i].get(), paths[first + i]));
+      }
+    }
+
+    for (R_xlen_t i = 0; i < count; ++i)
+      fill_info_row(columns, first + i, *scans[i]);
+  }
+
+  UNPROTECT(2);
+  return columns;
+}
+
+// ---------------------------------------------------------------------
+// .Call("C_write_exr", path, r, g, b, a, width, height, metadata,
+//       compression, pixel_type, zip_level, dwa_quality, threads)
+// .Call("C_write_exr_raw", r, g, b, a, width, height, metadata,
+//       compression, pixel_type, zip_level, dwa_quality, threads)
+
+// Checked write_exr() arguments shared by the file and raw writers.
+struct RgbaWrite {
+  int width;
+  int height;
+  Compression compression;
+  PixelType pixel_type;
+  int threads;
+  const double *channels[4];
+};
+
+// Leaves four protected objects; caller must UNPROTECT them.
+RgbaWrite check_write_args(SEXP rMat, SEXP gMat, SEXP bMat, SEXP aMat,
+                           SEXP w_SEXP, SEXP h_SEXP, SEXP compression_SEXP,
+                           SEXP pixel_type_SEXP, SEXP threads_SEXP) {
+  RgbaWrite req;
+  const int w = req.width = INTEGER(w_SEXP)[0];
+  const int h = req.height = INTEGER(h_SEXP)[0];
 
   check_bool(Rf_isMatrix(rMat) && Rf_isMatrix(gMat) && Rf_isMatrix(bMat) && Rf_isMatrix(aMat),
              "All channels must be matrices");
@@ -297,50 +2002,129 @@ extern "C" SEXP C_write_exr(SEXP path_SEXP, SEXP rMat, SEXP gMat, SEXP bMat,
       Rf_nrows(aMat) == h && Rf_ncols(aMat) == w,
       "Dimension mismatch");
 
+  check_bool(TYPEOF(compression_SEXP) == STRSXP &&
+                 Rf_xlength(compression_SEXP) == 1,
+             "`compression` must be a character scalar");
+  req.compression = NUM_COMPRESSION_METHODS;
+  getCompressionIdFromName(CHAR(STRING_ELT(compression_SEXP, 0)),
+                           req.compression);
+  check_bool(req.compression != NUM_COMPRESSION_METHODS,
+             "Unknown EXR compression method");
+
+  check_bool(TYPEOF(pixel_type_SEXP) == STRSXP &&
+                 Rf_xlength(pixel_type_SEXP) == 1,
+             "`pixel_type` must be a character scalar");
+  const char *pixel_type_name = CHAR(STRING_ELT(pixel_type_SEXP, 0));
+  check_bool(std::strcmp(pixel_type_name, "float") == 0 ||
+                 std::strcmp(pixel_type_name, "half") == 0,
+             "`pixel_type` must be \"float\" or \"half\"");
+  req.pixel_type = std::strcmp(pixel_type_name, "half") == 0 ? HALF : FLOAT;
+
+  req.threads = prepare_thread_pool(threads_SEXP);
+
   SEXP rNum = PROTECT(Rf_coerceVector(rMat, REALSXP));
   SEXP gNum = PROTECT(Rf_coerceVector(gMat, REALSXP));
   SEXP bNum = PROTECT(Rf_coerceVector(bMat, REALSXP));
   SEXP aNum = PROTECT(Rf_coerceVector(aMat, REALSXP));
+  req.channels[0] = REAL(rNum);
+  req.channels[1] = REAL(gNum);
+  req.channels[2] = REAL(bNum);
+  req.channels[3] = REAL(aNum);
+  return req;
+}
+
+Header make_rgba_header(const RgbaWrite &req, SEXP metadata_SEXP,
+                        SEXP zip_level_SEXP, SEXP dwa_quality_SEXP) {
+  Header header(req.width, req.height); // dataWindow [0..w-1],[0..h-1]
+  for (int k = 0; k < 4; ++k)
+    header.channels().insert(rgba_channel_names[k], Channel(req.pixel_type));
+  header.compression() = req.compression;
+  if (!Rf_isNull(zip_level_SEXP))
+    header.zipCompressionLevel() = Rf_asInteger(zip_level_SEXP);
+  if (!Rf_isNull(dwa_quality_SEXP))
+    header.dwaCompressionLevel() = (float)Rf_asReal(dwa_quality_SEXP);
+  add_metadata_to_header(header, metadata_SEXP);
+  return header;
+}
+
+// Chunks are always written in increasing y order, so the file bytes do not
+// depend on the thread count.
+void write_rgba_pixels(OutputFile &file, const RgbaWrite &req) {
+  const int w = req.width;
+  const int h = req.height;
 
-  const double *rD = REAL(rNum), *gD = REAL(gNum), *bD = REAL(bNum), *aD = REAL(aNum);
-
-  // Pack into row-major float buffers (EXR expects x to stride fastest)
-  std::vector<float> r32(w * h), g32(w * h), b32(w * h), a32(w * h);
-  for (int y = 0; y < h; ++y) {
-    for (int x = 0; x < w; ++x) {
-      const ptrdiff_t pos_colmajor = x * (ptrdiff_t)h + y;   // R column-major
-      const ptrdiff_t pos_rowmajor = y * (ptrdiff_t)w + x;   // EXR row-major
-      auto ffin = [](double v) -> float {
-        return std::isfinite(v) ? static_cast<float>(v) : 0.0f;
-      };
-      r32[pos_rowmajor] = ffin(rD[pos_colmajor]);
-      g32[pos_rowmajor] = ffin(gD[pos_colmajor]);
-      b32[pos_rowmajor] = ffin(bD[pos_colmajor]);
-      a32[pos_rowmajor] = ffin(aD[pos_colmajor]);
+  // Convert and write a batch of scanlines at a time, so the staging
+  // buffers (EXR expects x to stride fastest) stay a few chunks in size.
+  // Each batch holds one chunk per worker thread so all of them have work.
+  const int lines = (int)std::min<int64_t>(
+      h, (int64_t)getCompressionNumScanlines(req.compression) * req.threads);
+  const size_t samples = (size_t)w * lines;
+  std::vector<float> staging[4];
+  std::vector<uint16_t> staging_half[4];
+  for (int k = 0; k < 4; ++k) {
+    staging[k].resize(samples);
+    if (req.pixel_type == HALF)
+      staging_half[k].resize(samples);
+  }
+
+  for (int y = 0; y < h; y += lines) {
+    const int n = std::min(lines, h - y);
+    FrameBuffer fb;
+    for (int k = 0; k < 4; ++k) {
+      float *rows = staging[k].data();
+      transpose_to_float(req.channels[k] + y, h, w, n, rows, w);
+      if (req.pixel_type == HALF) {
+        narrow_half(rows, (size_t)w * n, staging_half[k].data());
+        fb.insert(rgba_channel_names[k],
+                  Slice::Make(HALF, staging_half[k].data(), V2i(0, y), w, n,
+                              sizeof(uint16_t), sizeof(uint16_t) * (size_t)w));
+      } else {
+        fb.insert(rgba_channel_names[k],
+                  Slice::Make(FLOAT, rows, V2i(0, y), w, n, sizeof(float),
+                              sizeof(float) * (size_t)w));
+      }
     }
+    file.setFrameBuffer(fb);
+    file.writePixels(n);
   }
+}
 
-  try {
-    Header header(w, h); // dataWindow [0..w-1],[0..h-1]
-    header.channels().insert("R", Channel(FLOAT));
-    header.channels().insert("G", Channel(FLOAT));
-    header.channels().insert("B", Channel(FLOAT));
-    header.channels().insert("A", Channel(FLOAT));
-    header.compression() = ZIP_COMPRESSION;
-    add_metadata_to_header(header, metadata_SEXP);
+// Growable in-memory output stream for write_exr_raw().
+class MemoryOStream : public OStream {
+public:
+  MemoryOStream() : OStream("<raw vector>") {}
 
-    FrameBuffer fb;
-    const size_t xs = sizeof(float), ys = sizeof(float) * (size_t)w;
+  void write(const char c[], int n) override {
+    if (pos_ + n > data_.size())
+      data_.resize(pos_ + n);
+    std::memcpy(data_.data() + pos_, c, n);
+    pos_ += n;
+  }
+  uint64_t tellp() override { return pos_; }
+  void seekp(uint64_t pos) override { pos_ = pos; }
 
-    fb.insert("R", Slice(FLOAT, (char*)r32.data(), xs, ys));
-    fb.insert("G", Slice(FLOAT, (char*)g32.data(), xs, ys));
-    fb.insert("B", Slice(FLOAT, (char*)b32.data(), xs, ys));
-    fb.insert("A", Slice(FLOAT, (char*)a32.data(), xs, ys));
+  const std::vector<char> &data() const { return data_; }
 
-    // Use a single worker thread for deterministic behavior across toolchains.
-    OutputFile file(path, header, 1);
-    file.setFrameBuffer(fb);
-    file.writePixels(h);
+private:
+  std::vector<char> data_;
+  uint64_t pos_ = 0;
+};
+
+extern "C" SEXP C_write_exr(SEXP path_SEXP, SEXP rMat, SEXP gMat, SEXP bMat,
+                            SEXP aMat, SEXP w_SEXP, SEXP h_SEXP,
+                            SEXP metadata_SEXP, SEXP compression_SEXP,
+                            SEXP pixel_type_SEXP, SEXP zip_level_SEXP,
+                            SEXP dwa_quality_SEXP, SEXP threads_SEXP) {
+  const char *path = CHAR(STRING_ELT(path_SEXP, 0));
+  const RgbaWrite req =
+      check_write_args(rMat, gMat, bMat, aMat, w_SEXP, h_SEXP,
+                       compression_SEXP, pixel_type_SEXP, threads_SEXP);
+
+  try {
+    Header header =
+        make_rgba_header(req, metadata_SEXP, zip_level_SEXP, dwa_quality_SEXP);
+    OutputFile file(path, header, req.threads);
+    write_rgba_pixels(file, req);
   } catch (const std::exception &e) {
     UNPROTECT(4);
     Rf_error("OpenEXR write error: %s", e.what());
@@ -350,14 +2134,49 @@ extern "C" SEXP C_write_exr(SEXP path_SEXP, SEXP rMat, SEXP gMat, SEXP bMat,
   return R_NilValue;
 }
 
+extern "C" SEXP C_write_exr_raw(SEXP rMat, SEXP gMat, SEXP bMat, SEXP aMat,
+                                SEXP w_SEXP, SEXP h_SEXP, SEXP metadata_SEXP,
+                                SEXP compression_SEXP, SEXP pixel_type_SEXP,
+                                SEXP zip_level_SEXP, SEXP dwa_quality_SEXP,
+                                SEXP threads_SEXP) {
+  const RgbaWrite req =
+      check_write_args(rMat, gMat, bMat, aMat, w_SEXP, h_SEXP,
+                       compression_SEXP, pixel_type_SEXP, threads_SEXP);
+
+  MemoryOStream stream;
+  try {
+    Header header =
+        make_rgba_header(req, metadata_SEXP, zip_level_SEXP, dwa_quality_SEXP);
+    // The offset table is written when the file closes, so the stream is
+    // only complete once `file` goes out of scope.
+    OutputFile file(stream, header, req.threads);
+    write_rgba_pixels(file, req);
+  } catch (const std::exception &e) {
+    UNPROTECT(4);
+    Rf_error("OpenEXR write error: %s", e.what());
+  }
+
+  const std::vector<char> &bytes = stream.data();
+  SEXP out = PROTECT(Rf_allocVector(RAWSXP, (R_xlen_t)bytes.size()));
+  std::memcpy(RAW(out), bytes.data(), bytes.size());
+  UNPROTECT(5);
+  return out;
+}
+
 // ---------------------------------------------------------------------
 // registration
 static const R_CallMethodDef callTable[] = {
-    {"C_read_exr", (DL_FUNC)&C_read_exr, 1},
-    {"C_write_exr", (DL_FUNC)&C_write_exr, 8},
+    {"C_exr_info", (DL_FUNC)&C_exr_info, 2},
+    {"C_read_exr", (DL_FUNC)&C_read_exr, 5},
+    {"C_read_exr_lazy", (DL_FUNC)&C_read_exr_lazy, 4},
+    {"C_read_exr_raw", (DL_FUNC)&C_read_exr_raw, 4},
+    {"C_read_exr_sequence", (DL_FUNC)&C_read_exr_sequence, 5},
+    {"C_write_exr", (DL_FUNC)&C_write_exr, 13},
+    {"C_write_exr_raw", (DL_FUNC)&C_write_exr_raw, 12},
     {NULL, NULL, 0}};
 
 extern "C" void R_init_libopenexr(DllInfo *dll) {
   R_registerRoutines(dll, NULL, callTable, NULL, NULL);
   R_useDynamicSymbols(dll, FALSE);
+  register_lazy_channel_class(dll);
 }